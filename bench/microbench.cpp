@@ -0,0 +1,601 @@
+// Copyright 2014 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Microbenchmarks for individual pipeline stages. Links the core and compiler
+// objects directly and drives each stage on the calling thread with synthetic
+// input, reporting the best-of-N cycles per primitive, pixel or texel as JSON.
+//
+// usage: swrmicrobench [--reps N] [--stage name]
+
+#include "api.h"
+#include "context.h"
+#include "pa.h"
+#include "frontend.h"
+#include "backend.h"
+#include "tilemgr.h"
+#include "formats.h"
+#include "texture_unit.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+// internal entry points that are not exported through the core headers
+DRAW_CONTEXT *GetDrawContext(SWR_CONTEXT *pContext);
+void SetupMacroTileScissors(DRAW_CONTEXT *pDC);
+void BinTriangles(DRAW_CONTEXT *pDC, PA_STATE &pa, simdvector tri[3], UINT numTris);
+
+static const UINT RT_WIDTH = 1024;
+static const UINT RT_HEIGHT = 1024;
+static const UINT NUM_TRIS = 16384;
+
+static UINT gReps = 9;
+static const char *gStageFilter = NULL;
+static bool gFirstResult = true;
+
+static UINT64 gPixelShaderInvocations = 0;
+
+static void CountingPixelFunc(const SWR_TRIANGLE_DESC &desc, SWR_PIXELOUTPUT &out)
+{
+    gPixelShaderInvocations++;
+}
+
+static UINT64 Elapsed(UINT64 start)
+{
+    return (UINT64)__rdtsc() - start;
+}
+
+static bool StageEnabled(const char *stage)
+{
+    return gStageFilter == NULL || strcmp(gStageFilter, stage) == 0;
+}
+
+static void Report(const char *stage, const std::string &variant, double cycles, UINT64 units, const char *unit)
+{
+    printf("%s    { \"stage\": \"%s\", \"variant\": \"%s\", \"cycles_per_%s\": %.2f, \"%ss\": %llu }",
+           gFirstResult ? "" : ",\n", stage, variant.c_str(), unit, units ? cycles / units : 0.0, unit, (unsigned long long)units);
+    gFirstResult = false;
+}
+
+// Synthetic vertex stream in clip space, laid out per topology so that every
+// assembled triangle has roughly the requested screen size.
+struct VertexStream
+{
+    std::vector<float> x, y;
+    UINT numVerts;
+    UINT numPrims;
+};
+
+static float ToClipX(float px)
+{
+    return px / RT_WIDTH * 2.0f - 1.0f;
+}
+
+static float ToClipY(float py)
+{
+    return py / RT_HEIGHT * 2.0f - 1.0f;
+}
+
+static void BuildStream(PRIMITIVE_TOPOLOGY topology, float triSize, VertexStream &stream)
+{
+    stream.x.clear();
+    stream.y.clear();
+
+    UINT cellsPerRow = std::max(1U, (UINT)(RT_WIDTH / (triSize + 1.0f)));
+    UINT cellsPerCol = std::max(1U, (UINT)(RT_HEIGHT / (triSize + 1.0f)));
+    auto push = [&](float px, float py)
+    {
+        stream.x.push_back(ToClipX(px));
+        stream.y.push_back(ToClipY(py));
+    };
+
+    switch (topology)
+    {
+    case TOP_TRIANGLE_LIST:
+        for (UINT i = 0; i < NUM_TRIS; ++i)
+        {
+            float cx = (float)((i % cellsPerRow) * (triSize + 1.0f));
+            float cy = (float)(((i / cellsPerRow) % cellsPerCol) * (triSize + 1.0f));
+            push(cx, cy);
+            push(cx + triSize, cy);
+            push(cx, cy + triSize);
+        }
+        break;
+    case TOP_QUAD_LIST:
+        for (UINT i = 0; i < NUM_TRIS / 2; ++i)
+        {
+            float cx = (float)((i % cellsPerRow) * (triSize + 1.0f));
+            float cy = (float)(((i / cellsPerRow) % cellsPerCol) * (triSize + 1.0f));
+            push(cx, cy);
+            push(cx + triSize, cy);
+            push(cx + triSize, cy + triSize);
+            push(cx, cy + triSize);
+        }
+        break;
+    case TOP_TRIANGLE_FAN:
+    {
+        // a fan around the viewport center, NUM_TRIS thin slices
+        float cx = RT_WIDTH / 2.0f, cy = RT_HEIGHT / 2.0f;
+        push(cx, cy);
+        for (UINT i = 0; i <= NUM_TRIS; ++i)
+        {
+            float a = (float)i / NUM_TRIS * 6.2831853f;
+            push(cx + cosf(a) * triSize, cy + sinf(a) * triSize);
+        }
+        break;
+    }
+    default:
+        // strips (triangle, quad and line) zig-zag along rows of cells
+        for (UINT i = 0; i < NUM_TRIS + 2; ++i)
+        {
+            UINT col = (i / 2) % cellsPerRow;
+            UINT row = ((i / 2) / cellsPerRow) % cellsPerCol;
+            float cx = (float)(col * triSize);
+            float cy = (float)(row * (triSize + 1.0f)) + ((i & 1) ? triSize : 0.0f);
+            push(cx, cy);
+        }
+        break;
+    }
+
+    stream.numVerts = (UINT)stream.x.size();
+    stream.numPrims = NumElementsGivenIndices(topology, stream.numVerts);
+
+    // pad to a whole simd so the loader never reads past the end
+    while (stream.x.size() % KNOB_VS_SIMD_WIDTH)
+    {
+        stream.x.push_back(0.0f);
+        stream.y.push_back(0.0f);
+    }
+}
+
+// Runs the PA state machine over the stream the same way ProcessDraw does,
+// optionally binning every assembled simd of triangles. Returns the number of
+// triangles assembled.
+template <bool Bin>
+static UINT64 AssembleStream(DRAW_CONTEXT *pDC, const VertexStream &stream)
+{
+    PA_STATE pa(pDC, stream.numPrims);
+    UINT64 numTris = 0;
+    UINT v = 0;
+
+    while (PaHasWork(pa))
+    {
+        VERTEXOUTPUT &vout = PaGetNextVsOutput(pa);
+        if (v < stream.numVerts)
+        {
+            vout.vertex[VS_SLOT_POSITION].x = _simd_loadu_ps(&stream.x[v]);
+            vout.vertex[VS_SLOT_POSITION].y = _simd_loadu_ps(&stream.y[v]);
+            vout.vertex[VS_SLOT_POSITION].z = _simd_set1_ps(0.5f);
+            vout.vertex[VS_SLOT_POSITION].w = _simd_set1_ps(1.0f);
+            vout.vertex[VS_SLOT_COLOR0].x = _simd_set1_ps(1.0f);
+            vout.vertex[VS_SLOT_COLOR0].y = _simd_set1_ps(0.5f);
+            vout.vertex[VS_SLOT_COLOR0].z = _simd_set1_ps(0.25f);
+            vout.vertex[VS_SLOT_COLOR0].w = _simd_set1_ps(1.0f);
+        }
+
+        do
+        {
+            simdvector tri[3];
+            if (PaAssemble(pa, VS_SLOT_POSITION, tri))
+            {
+                numTris += PaNumTris(pa);
+                if (Bin)
+                {
+                    BinTriangles(pDC, pa, tri, PaNumTris(pa));
+                }
+            }
+        } while (PaNextPrim(pa));
+
+        v += KNOB_VS_SIMD_WIDTH;
+    }
+    return numTris;
+}
+
+// Executes all binned work on the calling thread and retires the macro tiles.
+static void DrainTiles(DRAW_CONTEXT *pDC)
+{
+    MacroTileMgr *pTileMgr = pDC->pTileMgr;
+    std::vector<UINT> usedTiles = pTileMgr->getUsedTiles();
+    for (UINT i = 0; i < usedTiles.size(); ++i)
+    {
+        MacroTile &tile = pTileMgr->getMacroTile(usedTiles[i]);
+        BE_WORK *pWork;
+        while ((pWork = tile.m_Fifo.peek()) != NULL)
+        {
+            pWork->pfnWork(pDC, usedTiles[i], &pWork->desc);
+            tile.m_Fifo.dequeue_noinc();
+        }
+        pTileMgr->markTileComplete(usedTiles[i]);
+    }
+}
+
+static void ResetDraw(DRAW_CONTEXT *pDC)
+{
+    DrainTiles(pDC);
+    pDC->pTileMgr->initialize(BGRA8_UNORM);
+    pDC->arena.Reset();
+}
+
+static const char *TopologyName(PRIMITIVE_TOPOLOGY topology)
+{
+    switch (topology)
+    {
+    case TOP_TRIANGLE_LIST:
+        return "tri_list";
+    case TOP_TRIANGLE_STRIP:
+        return "tri_strip";
+    case TOP_TRIANGLE_FAN:
+        return "tri_fan";
+    case TOP_QUAD_LIST:
+        return "quad_list";
+    case TOP_QUAD_STRIP:
+        return "quad_strip";
+    case TOP_LINE_LIST:
+        return "line_list";
+    case TOP_LINE_STRIP:
+        return "line_strip";
+    default:
+        return "unknown";
+    }
+}
+
+static void BenchPaAssemble(DRAW_CONTEXT *pDC)
+{
+    static const PRIMITIVE_TOPOLOGY topologies[] = {
+        TOP_TRIANGLE_LIST, TOP_TRIANGLE_STRIP, TOP_TRIANGLE_FAN, TOP_QUAD_LIST, TOP_QUAD_STRIP, TOP_LINE_LIST, TOP_LINE_STRIP
+    };
+
+    VertexStream stream;
+    for (UINT t = 0; t < sizeof(topologies) / sizeof(topologies[0]); ++t)
+    {
+        pDC->state.topology = topologies[t];
+        BuildStream(topologies[t], 8.0f, stream);
+
+        UINT64 best = ~0ULL, numTris = 0;
+        for (UINT r = 0; r < gReps; ++r)
+        {
+            UINT64 start = __rdtsc();
+            numTris = AssembleStream<false>(pDC, stream);
+            best = std::min(best, Elapsed(start));
+        }
+        Report("PaAssemble", TopologyName(topologies[t]), (double)best, numTris, "primitive");
+    }
+}
+
+// BinTriangles cost is measured as the assemble+bin loop minus the assemble
+// only loop over the same stream. The binned work is then executed to time
+// the rasterizer per triangle and per pixel shader tile invocation.
+static void BenchBinAndRasterize(DRAW_CONTEXT *pDC)
+{
+    static const float triSizes[] = { 1.0f, 4.0f, 16.0f, 64.0f, 256.0f };
+
+    VertexStream stream;
+    pDC->state.topology = TOP_TRIANGLE_LIST;
+    for (UINT s = 0; s < sizeof(triSizes) / sizeof(triSizes[0]); ++s)
+    {
+        BuildStream(TOP_TRIANGLE_LIST, triSizes[s], stream);
+
+        UINT64 bestPa = ~0ULL, bestBin = ~0ULL, bestRast = ~0ULL, numTris = 0, invocations = 0;
+        for (UINT r = 0; r < gReps; ++r)
+        {
+            UINT64 start = __rdtsc();
+            AssembleStream<false>(pDC, stream);
+            bestPa = std::min(bestPa, Elapsed(start));
+
+            start = __rdtsc();
+            numTris = AssembleStream<true>(pDC, stream);
+            bestBin = std::min(bestBin, Elapsed(start));
+
+            gPixelShaderInvocations = 0;
+            start = __rdtsc();
+            DrainTiles(pDC);
+            bestRast = std::min(bestRast, Elapsed(start));
+            invocations = gPixelShaderInvocations;
+
+            ResetDraw(pDC);
+        }
+
+        char variant[64];
+        sprintf(variant, "tri_list_%upx", (UINT)triSizes[s]);
+        Report("BinTriangles", variant, (double)(bestBin > bestPa ? bestBin - bestPa : 0), numTris, "primitive");
+        Report("RasterizeTriangle", variant, (double)bestRast, numTris, "primitive");
+        sprintf(variant, "tri_list_%upx_%ux%u_tiles", (UINT)triSizes[s], KNOB_TILE_X_DIM, KNOB_TILE_Y_DIM);
+        Report("RasterizeTriangle", variant, (double)bestRast, invocations * KNOB_TILE_X_DIM * KNOB_TILE_Y_DIM, "pixel");
+    }
+}
+
+static void BenchStoreTile(SWR_CONTEXT *pContext, RENDERTARGET *pRT)
+{
+    std::vector<BYTE> dst(RT_WIDTH * RT_HEIGHT * 4);
+    UINT tilesX = RT_WIDTH >> KNOB_TILE_X_DIM_SHIFT;
+    UINT tilesY = RT_HEIGHT >> KNOB_TILE_Y_DIM_SHIFT;
+
+    UINT64 best = ~0ULL;
+    for (UINT r = 0; r < gReps; ++r)
+    {
+        UINT64 start = __rdtsc();
+        for (UINT y = 0; y < tilesY; ++y)
+        {
+            for (UINT x = 0; x < tilesX; ++x)
+            {
+#if KNOB_VS_SIMD_WIDTH == 4
+                storeTilePartial(pContext->driverType, x, y, KNOB_TILE_X_DIM, KNOB_TILE_Y_DIM, pRT, &dst[0], RT_WIDTH * 4);
+#else
+                storeTile(pContext->driverType, x, y, pRT, &dst[0], RT_WIDTH * 4);
+#endif
+            }
+        }
+        best = std::min(best, Elapsed(start));
+    }
+    Report("storeTile", "BGRA8_UNORM", (double)best, (UINT64)RT_WIDTH * RT_HEIGHT, "pixel");
+}
+
+static const char *FormatName(SWR_FORMAT format)
+{
+    switch (format)
+    {
+    case RGBA32_FLOAT:
+        return "RGBA32_FLOAT";
+    case RGB32_FLOAT:
+        return "RGB32_FLOAT";
+    case RGBA8_UNORM:
+        return "RGBA8_UNORM";
+    case RGB8_UNORM:
+        return "RGB8_UNORM";
+    case BGRA8_UNORM:
+        return "BGRA8_UNORM";
+    case BGR8_UNORM:
+        return "BGR8_UNORM";
+    case A32_FLOAT:
+        return "A32_FLOAT";
+    default:
+        return "unknown";
+    }
+}
+
+static void BenchConvertPixel()
+{
+    static const SWR_FORMAT pairs[][2] = {
+        { RGBA8_UNORM, RGBA32_FLOAT },
+        { BGRA8_UNORM, RGBA32_FLOAT },
+        { RGB8_UNORM, RGBA32_FLOAT },
+        { BGR8_UNORM, RGBA32_FLOAT },
+        { RGBA32_FLOAT, RGBA8_UNORM },
+        { RGBA32_FLOAT, BGRA8_UNORM },
+        { RGBA32_FLOAT, RGB32_FLOAT },
+    };
+    const UINT numPixels = 64 * 1024;
+
+    std::vector<float> src(numPixels * 4, 0.5f);
+    std::vector<float> dst(numPixels * 4);
+    for (UINT p = 0; p < sizeof(pairs) / sizeof(pairs[0]); ++p)
+    {
+        UINT srcBpp = GetFormatInfo(pairs[p][0]).Bpp;
+        UINT dstBpp = GetFormatInfo(pairs[p][1]).Bpp;
+
+        UINT64 best = ~0ULL;
+        for (UINT r = 0; r < gReps; ++r)
+        {
+            BYTE *pSrc = (BYTE *)&src[0];
+            BYTE *pDst = (BYTE *)&dst[0];
+            UINT64 start = __rdtsc();
+            for (UINT i = 0; i < numPixels; ++i, pSrc += srcBpp, pDst += dstBpp)
+            {
+                ConvertPixel(pairs[p][0], pSrc, pairs[p][1], pDst);
+            }
+            best = std::min(best, Elapsed(start));
+        }
+        Report("ConvertPixel", std::string(FormatName(pairs[p][0])) + "->" + FormatName(pairs[p][1]), (double)best, numPixels, "pixel");
+    }
+}
+
+typedef void (*PFN_SAMPLE_QUAD)(TextureView const &, Sampler const &, TexCoord const &, WideColor &);
+typedef void (*PFN_SAMPLE_MIPS)(TextureView const &, Sampler const &, TexCoord const &, UINT (&)[4], WideColor &);
+
+struct SampleFunc
+{
+    const char *name;
+    PFN_SAMPLE_QUAD pfnQuad;
+    PFN_SAMPLE_MIPS pfnMips;
+    UINT eltSize;
+    SWR_FORMAT format;
+};
+
+// Samples footprint x footprint textures with either pixel coherent coords
+// (one texel step per pixel, like a magnified quad) or uniformly random ones.
+static void BenchSample(HANDLE hContext)
+{
+    static const SampleFunc funcs[] = {
+        { "SampleSimplePointQuadRGBAU8", SampleSimplePointQuadRGBAU8, NULL, 4, RGBA8_UNORM },
+        { "SampleSimplePointRGBAU8", NULL, SampleSimplePointRGBAU8, 4, RGBA8_UNORM },
+        { "SampleSimplePointQuadRGBAF32", SampleSimplePointQuadRGBAF32, NULL, 16, RGBA32_FLOAT },
+        { "SampleSimplePointRGBAF32", NULL, SampleSimplePointRGBAF32, 16, RGBA32_FLOAT },
+        { "SampleSimpleLinearQuadRGBAF32", SampleSimpleLinearQuadRGBAF32, NULL, 16, RGBA32_FLOAT },
+        { "SampleSimpleLinearRGBAF32", NULL, SampleSimpleLinearRGBAF32, 16, RGBA32_FLOAT },
+    };
+    static const UINT footprints[] = { 64, 512, 2048 };
+    const UINT numCoords = 64 * 1024;
+
+    SWR_CREATESAMPLER smpArgs = { SWR_AM_WRAP, AS_2D, TF_Linear, { 0, 0, 0, 0 } };
+    Sampler sampler(smpArgs);
+
+    for (UINT fp = 0; fp < sizeof(footprints) / sizeof(footprints[0]); ++fp)
+    {
+        UINT size = footprints[fp];
+
+        // coords in simd batches; coherent coords walk 2x(simd/2) pixel quads across rows
+        std::vector<TexCoord> coherent(numCoords / KNOB_VS_SIMD_WIDTH);
+        std::vector<TexCoord> random(numCoords / KNOB_VS_SIMD_WIDTH);
+        for (UINT i = 0; i < coherent.size(); ++i)
+        {
+            OSALIGNSIMD(float) u[KNOB_VS_SIMD_WIDTH], v[KNOB_VS_SIMD_WIDTH], ru[KNOB_VS_SIMD_WIDTH], rv[KNOB_VS_SIMD_WIDTH];
+            for (UINT l = 0; l < KNOB_VS_SIMD_WIDTH; ++l)
+            {
+                UINT px = (i * (KNOB_VS_SIMD_WIDTH / 2) + l % (KNOB_VS_SIMD_WIDTH / 2)) % size;
+                UINT py = ((i * (KNOB_VS_SIMD_WIDTH / 2) / size) * 2 + l / (KNOB_VS_SIMD_WIDTH / 2)) % size;
+                u[l] = (px + 0.5f) / size;
+                v[l] = (py + 0.5f) / size;
+                ru[l] = (float)rand() / RAND_MAX;
+                rv[l] = (float)rand() / RAND_MAX;
+            }
+            coherent[i].U = _simd_load_ps(u);
+            coherent[i].V = _simd_load_ps(v);
+            coherent[i].W = _simd_setzero_ps();
+            random[i].U = _simd_load_ps(ru);
+            random[i].V = _simd_load_ps(rv);
+            random[i].W = _simd_setzero_ps();
+        }
+
+        for (UINT f = 0; f < sizeof(funcs) / sizeof(funcs[0]); ++f)
+        {
+            SWR_CREATETEXTURE ct = { 0 };
+            ct.eltSizeInBytes = funcs[f].eltSize;
+            ct.width = size;
+            ct.height = size;
+            ct.planes = 1;
+            ct.mipLevels = 1;
+            ct.lockFlags = LOCK_NONE;
+            HANDLE hTexture = SwrCreateTexture(hContext, ct);
+
+            Texture *pTexture = reinterpret_cast<Texture *>(hTexture);
+            memset(pTexture->mSubtextures[0], 0x3f, pTexture->mPhysicalWidth[0] * pTexture->mPhysicalHeight[0] * funcs[f].eltSize);
+
+            SWR_TEXTUREVIEW viewArgs = { hTexture, funcs[f].format, 0, 0 };
+            TextureView view(viewArgs);
+
+            for (UINT pattern = 0; pattern < 2; ++pattern)
+            {
+                const std::vector<TexCoord> &coords = pattern ? random : coherent;
+                UINT mips[4] = { 0, 0, 0, 0 };
+                WideColor color;
+                simdscalar sink = _simd_setzero_ps();
+
+                UINT64 best = ~0ULL;
+                for (UINT r = 0; r < gReps; ++r)
+                {
+                    UINT64 start = __rdtsc();
+                    for (UINT i = 0; i < coords.size(); ++i)
+                    {
+                        if (funcs[f].pfnQuad)
+                        {
+                            funcs[f].pfnQuad(view, sampler, coords[i], color);
+                        }
+                        else
+                        {
+                            funcs[f].pfnMips(view, sampler, coords[i], mips, color);
+                        }
+                        sink = _simd_add_ps(sink, color.R);
+                    }
+                    best = std::min(best, Elapsed(start));
+                }
+
+                // keep the samples observable
+                OSALIGNSIMD(float) sunk[KNOB_VS_SIMD_WIDTH];
+                _simd_store_ps(sunk, sink);
+                if (sunk[0] == 12345.0f)
+                {
+                    printf(" ");
+                }
+
+                char variant[64];
+                sprintf(variant, "%ux%u_%s", size, size, pattern ? "random" : "coherent");
+                Report(funcs[f].name, variant, (double)best, numCoords, "texel");
+            }
+
+            SwrDestroyTexture(hContext, hTexture);
+        }
+    }
+}
+
+static const char *ArchName()
+{
+#if KNOB_ARCH == KNOB_ARCH_SSE
+    return "SSE4.2";
+#elif KNOB_ARCH == KNOB_ARCH_AVX
+    return "AVX";
+#elif KNOB_ARCH == KNOB_ARCH_AVX2
+    return "CORE-AVX2";
+#else
+    return "unknown";
+#endif
+}
+
+int main(int argc, char **argv)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--reps") == 0 && i + 1 < argc)
+            gReps = std::max(atoi(argv[++i]), 1);
+        else if (strcmp(argv[i], "--stage") == 0 && i + 1 < argc)
+            gStageFilter = argv[++i];
+        else
+        {
+            fprintf(stderr, "usage: %s [--reps N] [--stage PaAssemble|BinTriangles|storeTile|ConvertPixel|Sample]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    HANDLE hContext = SwrCreateContext(GL);
+    SWR_CONTEXT *pContext = (SWR_CONTEXT *)hContext;
+
+    HANDLE hRT = SwrCreateRenderTarget(hContext, RT_WIDTH, RT_HEIGHT, BGRA8_UNORM);
+    HANDLE hDepth = SwrCreateRenderTarget(hContext, RT_WIDTH, RT_HEIGHT, R32_FLOAT);
+    SwrSetRenderTargets(hContext, hRT, hDepth);
+
+    RASTSTATE rast;
+    SwrGetRastState(hContext, &rast);
+    rast.cullMode = NONE;
+    rast.scissorEnable = false;
+    rast.vp.x = 0.0f;
+    rast.vp.y = 0.0f;
+    rast.vp.width = (FLOAT)RT_WIDTH;
+    rast.vp.height = (FLOAT)RT_HEIGHT;
+    rast.vp.halfWidth = RT_WIDTH / 2.0f;
+    rast.vp.halfHeight = RT_HEIGHT / 2.0f;
+    rast.vp.minZ = 0.0f;
+    rast.vp.maxZ = 1.0f;
+    SwrSetRastState(hContext, &rast);
+
+    SwrSetPixelFunc(hContext, CountingPixelFunc);
+    SwrSetLinkageMaskFrontFace(hContext, 1 << VS_SLOT_COLOR0);
+    SwrSetLinkageMaskBackFace(hContext, 1 << VS_SLOT_COLOR0);
+
+    // The draw context is never queued, so the workers stay idle and every
+    // stage below runs on this thread.
+    DRAW_CONTEXT *pDC = GetDrawContext(pContext);
+    SetupMacroTileScissors(pDC);
+    pDC->state.linkageTotalCount = 1;
+
+    printf("{\n  \"arch\": \"%s\",\n  \"simd_width\": %u,\n  \"reps\": %u,\n  \"results\": [\n", ArchName(), KNOB_VS_SIMD_WIDTH, gReps);
+
+    if (StageEnabled("PaAssemble"))
+        BenchPaAssemble(pDC);
+    if (StageEnabled("BinTriangles") || StageEnabled("RasterizeTriangle"))
+        BenchBinAndRasterize(pDC);
+    if (StageEnabled("storeTile"))
+        BenchStoreTile(pContext, (RENDERTARGET *)hRT);
+    if (StageEnabled("ConvertPixel"))
+        BenchConvertPixel();
+    if (StageEnabled("Sample"))
+        BenchSample(hContext);
+
+    printf("\n  ]\n}\n");
+
+    SwrDestroyContext(hContext);
+    return 0;
+}
@@ -0,0 +1,475 @@
+// Copyright 2014 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Headless benchmark harness. Renders canonical synthetic workloads through
+// the OSMesa interface and reports frame time distributions, throughput and
+// the per-bucket rdtsc breakdown as JSON.
+//
+// usage: swrbench [--frames N] [--warmup N] [--width W] [--height H]
+//                 [--workload name] [--out file.json] [--trace-dir dir]
+
+#include <gl/osmesa.h>
+
+#include "rdtsc.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+struct BenchOptions
+{
+    UINT frames;
+    UINT warmup;
+    UINT width;
+    UINT height;
+    const char *workload;
+    const char *outFile;
+    const char *traceDir;
+};
+
+struct Workload
+{
+    const char *name;
+    void (*pfnSetup)(const BenchOptions &opts);
+    // renders one frame, returns the number of primitives submitted
+    UINT64 (*pfnFrame)(const BenchOptions &opts);
+    void (*pfnTeardown)();
+};
+
+static std::vector<GLfloat> gPositions;
+static std::vector<GLfloat> gColors;
+static std::vector<GLfloat> gTexCoords;
+static std::vector<BYTE> gReadback;
+static GLuint gTexture = 0;
+static GLuint gDisplayList = 0;
+
+static void SetupOrtho(const BenchOptions &opts)
+{
+    glViewport(0, 0, opts.width, opts.height);
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+    glOrtho(0.0, (GLdouble)opts.width, 0.0, (GLdouble)opts.height, -1.0, 1.0);
+    glMatrixMode(GL_MODELVIEW);
+    glLoadIdentity();
+}
+
+// Tessellates the viewport into a grid of cellSize x cellSize quads, two
+// triangles each, with a per-vertex color gradient.
+static void BuildGrid(const BenchOptions &opts, UINT cellSize, bool texCoords)
+{
+    gPositions.clear();
+    gColors.clear();
+    gTexCoords.clear();
+
+    UINT cellsX = opts.width / cellSize;
+    UINT cellsY = opts.height / cellSize;
+    for (UINT y = 0; y < cellsY; ++y)
+    {
+        for (UINT x = 0; x < cellsX; ++x)
+        {
+            GLfloat x0 = (GLfloat)(x * cellSize), x1 = x0 + cellSize;
+            GLfloat y0 = (GLfloat)(y * cellSize), y1 = y0 + cellSize;
+            GLfloat quad[6][2] = { { x0, y0 }, { x1, y0 }, { x1, y1 }, { x0, y0 }, { x1, y1 }, { x0, y1 } };
+            for (UINT v = 0; v < 6; ++v)
+            {
+                gPositions.push_back(quad[v][0]);
+                gPositions.push_back(quad[v][1]);
+                gPositions.push_back(0.0f);
+
+                gColors.push_back(quad[v][0] / opts.width);
+                gColors.push_back(quad[v][1] / opts.height);
+                gColors.push_back(0.5f);
+                gColors.push_back(1.0f);
+
+                if (texCoords)
+                {
+                    gTexCoords.push_back((quad[v][0] - x0) / cellSize);
+                    gTexCoords.push_back((quad[v][1] - y0) / cellSize);
+                }
+            }
+        }
+    }
+}
+
+static UINT64 DrawGridArrays()
+{
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    glVertexPointer(3, GL_FLOAT, 0, &gPositions[0]);
+    glColorPointer(4, GL_FLOAT, 0, &gColors[0]);
+    if (!gTexCoords.empty())
+    {
+        glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+        glTexCoordPointer(2, GL_FLOAT, 0, &gTexCoords[0]);
+    }
+
+    GLsizei numVerts = (GLsizei)(gPositions.size() / 3);
+    glDrawArrays(GL_TRIANGLES, 0, numVerts);
+
+    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    glDisableClientState(GL_COLOR_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    return numVerts / 3;
+}
+
+static void DrawGridImmediate()
+{
+    glBegin(GL_TRIANGLES);
+    for (size_t v = 0; v < gPositions.size() / 3; ++v)
+    {
+        glColor4fv(&gColors[v * 4]);
+        glVertex3fv(&gPositions[v * 3]);
+    }
+    glEnd();
+}
+
+static void ClearFrame()
+{
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+static void NoTeardown()
+{
+}
+
+// dense mesh of 2x2 pixel triangles, dominated by setup and binning
+static void SmallTrisSetup(const BenchOptions &opts)
+{
+    SetupOrtho(opts);
+    glDisable(GL_DEPTH_TEST);
+    BuildGrid(opts, 4, false);
+}
+
+static UINT64 ArraysFrame(const BenchOptions &opts)
+{
+    ClearFrame();
+    return DrawGridArrays();
+}
+
+// layers of full screen blended quads, dominated by pixel shading and blending
+static const UINT OVERDRAW_LAYERS = 8;
+
+static void OverdrawSetup(const BenchOptions &opts)
+{
+    SetupOrtho(opts);
+    glDisable(GL_DEPTH_TEST);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+}
+
+static UINT64 OverdrawFrame(const BenchOptions &opts)
+{
+    ClearFrame();
+    GLfloat w = (GLfloat)opts.width, h = (GLfloat)opts.height;
+    glBegin(GL_QUADS);
+    for (UINT i = 0; i < OVERDRAW_LAYERS; ++i)
+    {
+        glColor4f((GLfloat)i / OVERDRAW_LAYERS, 0.5f, 1.0f - (GLfloat)i / OVERDRAW_LAYERS, 0.25f);
+        glVertex3f(0.0f, 0.0f, 0.0f);
+        glVertex3f(w, 0.0f, 0.0f);
+        glVertex3f(w, h, 0.0f);
+        glVertex3f(0.0f, h, 0.0f);
+    }
+    glEnd();
+    return OVERDRAW_LAYERS * 2;
+}
+
+static void OverdrawTeardown()
+{
+    glDisable(GL_BLEND);
+}
+
+// 32x32 pixel quads sampling a 256x256 RGBA8 texture
+static void TexturedSetup(const BenchOptions &opts)
+{
+    SetupOrtho(opts);
+    glDisable(GL_DEPTH_TEST);
+    BuildGrid(opts, 32, true);
+
+    const UINT texSize = 256;
+    std::vector<BYTE> texels(texSize * texSize * 4);
+    for (UINT y = 0; y < texSize; ++y)
+    {
+        for (UINT x = 0; x < texSize; ++x)
+        {
+            BYTE *pTexel = &texels[(y * texSize + x) * 4];
+            BYTE checker = ((x ^ y) & 0x10) ? 0xFF : 0x40;
+            pTexel[0] = checker;
+            pTexel[1] = (BYTE)x;
+            pTexel[2] = (BYTE)y;
+            pTexel[3] = 0xFF;
+        }
+    }
+
+    glGenTextures(1, &gTexture);
+    glBindTexture(GL_TEXTURE_2D, gTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, texSize, texSize, 0, GL_RGBA, GL_UNSIGNED_BYTE, &texels[0]);
+    glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+    glEnable(GL_TEXTURE_2D);
+}
+
+static void TexturedTeardown()
+{
+    glDisable(GL_TEXTURE_2D);
+    glDeleteTextures(1, &gTexture);
+    gTexture = 0;
+}
+
+// the small triangle mesh again, submitted one vertex at a time
+static void ImmediateSetup(const BenchOptions &opts)
+{
+    SetupOrtho(opts);
+    glDisable(GL_DEPTH_TEST);
+    BuildGrid(opts, 8, false);
+}
+
+static UINT64 ImmediateFrame(const BenchOptions &opts)
+{
+    ClearFrame();
+    DrawGridImmediate();
+    return gPositions.size() / 9;
+}
+
+// the immediate mode mesh compiled once into a display list
+static void DisplayListSetup(const BenchOptions &opts)
+{
+    ImmediateSetup(opts);
+    gDisplayList = glGenLists(1);
+    glNewList(gDisplayList, GL_COMPILE);
+    DrawGridImmediate();
+    glEndList();
+}
+
+static UINT64 DisplayListFrame(const BenchOptions &opts)
+{
+    ClearFrame();
+    glCallList(gDisplayList);
+    return gPositions.size() / 9;
+}
+
+static void DisplayListTeardown()
+{
+    glDeleteLists(gDisplayList, 1);
+    gDisplayList = 0;
+}
+
+// a light scene followed by a full frame glReadPixels every frame
+static void ReadbackSetup(const BenchOptions &opts)
+{
+    SetupOrtho(opts);
+    glDisable(GL_DEPTH_TEST);
+    BuildGrid(opts, 64, false);
+    gReadback.resize(opts.width * opts.height * 4);
+}
+
+static UINT64 ReadbackFrame(const BenchOptions &opts)
+{
+    ClearFrame();
+    UINT64 numPrims = DrawGridArrays();
+    glReadPixels(0, 0, opts.width, opts.height, GL_BGRA, GL_UNSIGNED_BYTE, &gReadback[0]);
+    return numPrims;
+}
+
+static const Workload gWorkloads[] = {
+    { "small_tris", SmallTrisSetup, ArraysFrame, NoTeardown },
+    { "overdraw", OverdrawSetup, OverdrawFrame, OverdrawTeardown },
+    { "textured_quads", TexturedSetup, ArraysFrame, TexturedTeardown },
+    { "immediate", ImmediateSetup, ImmediateFrame, NoTeardown },
+    { "display_list", DisplayListSetup, DisplayListFrame, DisplayListTeardown },
+    { "readback", ReadbackSetup, ReadbackFrame, NoTeardown },
+};
+
+static double Percentile(const std::vector<double> &sorted, double p)
+{
+    size_t idx = (size_t)ceil(p / 100.0 * sorted.size());
+    idx = std::min(std::max(idx, (size_t)1), sorted.size());
+    return sorted[idx - 1];
+}
+
+static void RunWorkload(FILE *out, const Workload &workload, const BenchOptions &opts, bool first)
+{
+    workload.pfnSetup(opts);
+
+    for (UINT i = 0; i < opts.warmup; ++i)
+    {
+        workload.pfnFrame(opts);
+        OSMesaFinishSWR();
+    }
+
+#ifdef KNOB_ENABLE_RDTSC
+    // profile exactly the measured frames; the frame counter advances on
+    // present, so one more unmeasured frame starts the range at a frame
+    // boundary and the last measured frame ends it and writes the trace
+    std::string traceFile;
+    if (opts.traceDir)
+    {
+        traceFile = std::string(opts.traceDir) + "/" + workload.name + ".trace.json";
+    }
+    rdtscSetFrameRange(g_CurrentFrame + 1, g_CurrentFrame + 1 + opts.frames, opts.traceDir ? traceFile.c_str() : NULL);
+    workload.pfnFrame(opts);
+    OSMesaFinishSWR();
+#endif
+
+    std::vector<double> frameTimes;
+    UINT64 numPrims = 0;
+    for (UINT i = 0; i < opts.frames; ++i)
+    {
+        auto start = std::chrono::steady_clock::now();
+        numPrims += workload.pfnFrame(opts);
+        OSMesaFinishSWR();
+        auto stop = std::chrono::steady_clock::now();
+        frameTimes.push_back(std::chrono::duration<double, std::milli>(stop - start).count());
+    }
+
+    double totalMs = 0.0;
+    for (size_t i = 0; i < frameTimes.size(); ++i)
+    {
+        totalMs += frameTimes[i];
+    }
+    std::vector<double> sorted = frameTimes;
+    std::sort(sorted.begin(), sorted.end());
+
+    double seconds = totalMs / 1000.0;
+    fprintf(out, "%s    {\n", first ? "" : ",\n");
+    fprintf(out, "      \"name\": \"%s\",\n", workload.name);
+    fprintf(out, "      \"frames\": %u,\n", opts.frames);
+    fprintf(out, "      \"frame_ms\": { \"mean\": %.4f, \"min\": %.4f, \"p50\": %.4f, \"p90\": %.4f, \"p99\": %.4f, \"max\": %.4f },\n",
+            totalMs / opts.frames, sorted.front(), Percentile(sorted, 50), Percentile(sorted, 90), Percentile(sorted, 99), sorted.back());
+    fprintf(out, "      \"throughput\": { \"fps\": %.2f, \"prims_per_sec\": %.0f, \"pixels_per_sec\": %.0f },\n",
+            opts.frames / seconds, numPrims / seconds, (double)opts.width * opts.height * opts.frames / seconds);
+
+    // per bucket cycles per frame, summed over every thread
+    fprintf(out, "      \"rdtsc\": {");
+#ifdef KNOB_ENABLE_RDTSC
+    bool firstBucket = true;
+    for (UINT b = 1; b < MAX_BUCKETS; ++b)
+    {
+        if (s_BucketDefs[b].name == NULL)
+            continue;
+
+        UINT64 elapsed = 0, count = 0;
+        for (UINT t = 0; t < KNOB_MAX_NUM_THREADS + 2; ++t)
+        {
+            elapsed += g_Buckets[t][b].elapsed;
+            count += g_Buckets[t][b].count;
+        }
+        if (count == 0)
+            continue;
+
+        fprintf(out, "%s\n        \"%s\": { \"cycles_per_frame\": %llu, \"events_per_frame\": %llu }",
+                firstBucket ? "" : ",", s_BucketDefs[b].name,
+                (unsigned long long)(elapsed / opts.frames), (unsigned long long)(count / opts.frames));
+        firstBucket = false;
+    }
+    fprintf(out, "\n      ");
+#endif
+    fprintf(out, "}\n    }");
+
+    workload.pfnTeardown();
+}
+
+static bool ParseArgs(int argc, char **argv, BenchOptions &opts)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        bool hasValue = (i + 1 < argc);
+        if (strcmp(argv[i], "--frames") == 0 && hasValue)
+            opts.frames = std::max(atoi(argv[++i]), 1);
+        else if (strcmp(argv[i], "--warmup") == 0 && hasValue)
+            opts.warmup = std::max(atoi(argv[++i]), 0);
+        else if (strcmp(argv[i], "--width") == 0 && hasValue)
+            opts.width = std::max(atoi(argv[++i]), 64);
+        else if (strcmp(argv[i], "--height") == 0 && hasValue)
+            opts.height = std::max(atoi(argv[++i]), 64);
+        else if (strcmp(argv[i], "--workload") == 0 && hasValue)
+            opts.workload = argv[++i];
+        else if (strcmp(argv[i], "--out") == 0 && hasValue)
+            opts.outFile = argv[++i];
+        else if (strcmp(argv[i], "--trace-dir") == 0 && hasValue)
+            opts.traceDir = argv[++i];
+        else
+        {
+            fprintf(stderr, "usage: %s [--frames N] [--warmup N] [--width W] [--height H] [--workload name] [--out file.json] [--trace-dir dir]\n", argv[0]);
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    BenchOptions opts = { 100, 10, 1024, 768, NULL, NULL, NULL };
+    if (!ParseArgs(argc, argv, opts))
+    {
+        return 1;
+    }
+
+    // OSMesa caps the framebuffer at 2048x2048
+    opts.width = std::min(opts.width, 2048u);
+    opts.height = std::min(opts.height, 2048u);
+
+    OSMesaContext ctx = OSMesaCreateContextExt(OSMESA_BGRA, 32, 0, 0, NULL);
+    std::vector<BYTE> frameBuffer(opts.width * opts.height * 4);
+    if (!ctx || !OSMesaMakeCurrent(ctx, &frameBuffer[0], GL_UNSIGNED_BYTE, opts.width, opts.height))
+    {
+        fprintf(stderr, "failed to create an OSMesa context\n");
+        return 1;
+    }
+
+    FILE *out = opts.outFile ? fopen(opts.outFile, "w") : stdout;
+    if (out == NULL)
+    {
+        fprintf(stderr, "could not open %s\n", opts.outFile);
+        return 1;
+    }
+
+    fprintf(out, "{\n");
+    fprintf(out, "  \"width\": %u,\n  \"height\": %u,\n  \"simd_width\": %u,\n", opts.width, opts.height, KNOB_VS_SIMD_WIDTH);
+    fprintf(out, "  \"workloads\": [\n");
+
+    bool first = true;
+    bool found = false;
+    for (size_t i = 0; i < sizeof(gWorkloads) / sizeof(gWorkloads[0]); ++i)
+    {
+        if (opts.workload && strcmp(opts.workload, gWorkloads[i].name) != 0)
+            continue;
+
+        RunWorkload(out, gWorkloads[i], opts, first);
+        first = false;
+        found = true;
+    }
+
+    fprintf(out, "\n  ]\n}\n");
+    if (out != stdout)
+    {
+        fclose(out);
+    }
+
+    OSMesaDestroyContext(ctx);
+
+    if (!found)
+    {
+        fprintf(stderr, "unknown workload %s\n", opts.workload);
+        return 1;
+    }
+    return 0;
+}
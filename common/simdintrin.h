@@ -31,6 +31,16 @@
 #define simdscalari __m256i
 #endif
 
+// simdscalar for template arguments. GCC drops the may_alias attribute of
+// __m128/__m256 there and warns; the bare vector type is the same type.
+#if defined(__GNUC__) && (KNOB_VS_SIMD_WIDTH == 4)
+typedef float simdscalar_t __attribute__((vector_size(16)));
+#elif defined(__GNUC__)
+typedef float simdscalar_t __attribute__((vector_size(32)));
+#else
+typedef simdscalar simdscalar_t;
+#endif
+
 // simd vector
 OSALIGNSIMD(union) simdvector
 {
@@ -83,6 +93,7 @@ OSALIGNSIMD(union) simdvector
 #define _simd_blendv_ps _mm_blendv_ps
 #define _simd_and_ps _mm_and_ps
 #define _simd_or_ps _mm_or_ps
+#define _simd_xor_ps _mm_xor_ps
 #define _simd_andnot_ps _mm_andnot_ps
 #define _simd_round_ps _mm_round_ps
 
@@ -207,6 +218,7 @@ void _simd128_maskstore_ps(float *mem_addr, __m128i mask, __m128 a)
 #define _simd_cmple_ps(a, b) _mm256_cmp_ps(a, b, _CMP_LE_OQ)
 #define _simd_and_ps _mm256_and_ps
 #define _simd_or_ps _mm256_or_ps
+#define _simd_xor_ps _mm256_xor_ps
 
 #define _simd_rcp_ps _mm256_rcp_ps
 #define _simd_div_ps _mm256_div_ps
@@ -407,6 +407,9 @@ struct SWRC_FETCHGEN
             case SWR_TYPE_UINT16:
                 indices = mShG->mBuilder.CreateBitCast(indices, Type::getInt16PtrTy(mShG->mContext, 0));
                 break;
+            case SWR_TYPE_UINT8:
+                indices = mShG->mBuilder.CreateBitCast(indices, Type::getInt8PtrTy(mShG->mContext, 0));
+                break;
             case SWR_TYPE_UINT32:
                 break; // incoming type is already 32bit int
             default:
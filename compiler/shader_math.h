@@ -128,7 +128,7 @@ const __m256 vQuadOffsetsY = { 0.5, 0.5, 1.5, 1.5, 0.5, 0.5, 1.5, 1.5 };
 template <typename AttrSelector, SWR_ZFUNCTION ZFunc = ZFUNC_LE, bool ZWrite = true, int XIterations = KNOB_TILE_X_DIM / SIMD_TILE_X_DIM, int YIterations = KNOB_TILE_Y_DIM / SIMD_TILE_Y_DIM>
 struct GenericPixelShader
 {
-    typedef WideVector<AttrSelector::NUM_ATTRIBUTES, simdscalar> WV;
+    typedef WideVector<AttrSelector::NUM_ATTRIBUTES, simdscalar_t> WV;
 
     void run(const SWR_TRIANGLE_DESC &work, SWR_PIXELOUTPUT &pOut, AttrSelector &attrSel)
     {
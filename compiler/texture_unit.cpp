@@ -88,7 +88,284 @@ void vTranspose8x4(WideColor &dst, __m128 &row0, __m128 &row1, __m128 &row2, __m
 }
 #endif
 
-template <bool UseFloat, bool Brolinear, SWR_ADDRESSING_MODE AddrModeU, SWR_ADDRESSING_MODE AddrModeV>
+// Loads one storage element per lane, zero-extended to 32 bits.
+template <typename T>
+INLINE simdscalari GatherTexels(BYTE const *pBase, UINT const (&offsets)[KNOB_VS_SIMD_WIDTH])
+{
+    OSALIGN(UINT, 32) texels[KNOB_VS_SIMD_WIDTH];
+    for (UINT i = 0; i < KNOB_VS_SIMD_WIDTH; ++i)
+    {
+        texels[i] = *(T const *)(pBase + offsets[i]);
+    }
+    return _simd_load_si((simdscalari const *)&texels[0]);
+}
+
+template <UINT Shift, UINT Bits>
+INLINE simdscalar UnpackUnorm(simdscalari texels)
+{
+    simdscalari c = _simd_and_si(_simd_srai_epi32(texels, Shift), _simd_set1_epi32((1 << Bits) - 1));
+    return _simd_mul_ps(_simd_cvtepi32_ps(c), _simd_set1_ps(1.0f / (float)((1 << Bits) - 1)));
+}
+
+// SIMD MortonSpread, spreads the low 8 bits to the even bit positions.
+INLINE simdscalari vMortonSpread(simdscalari v)
+{
+    v = _simd_and_si(_simd_or_si(v, _simd_slli_epi32(v, 4)), _simd_set1_epi32(0x0F0F0F0F));
+    v = _simd_and_si(_simd_or_si(v, _simd_slli_epi32(v, 2)), _simd_set1_epi32(0x33333333));
+    v = _simd_and_si(_simd_or_si(v, _simd_slli_epi32(v, 1)), _simd_set1_epi32(0x55555555));
+    return v;
+}
+
+// SIMD TexelOffset for TF_TileZ, in texels.
+template <UINT Shift>
+INLINE simdscalari vTileZIndex(simdscalari x, simdscalari y, simdscalari physWidth)
+{
+    simdscalari mask = _simd_set1_epi32((1 << Shift) - 1);
+    simdscalari page = _simd_mullo_epi32(_simd_srai_epi32(y, Shift), _simd_srai_epi32(physWidth, Shift));
+    page = _simd_add_epi32(page, _simd_srai_epi32(x, Shift));
+
+    simdscalari index = _simd_slli_epi32(page, 2 * Shift);
+    index = _simd_or_si(index, vMortonSpread(_simd_and_si(x, mask)));
+    index = _simd_or_si(index, _simd_slli_epi32(vMortonSpread(_simd_and_si(y, mask)), 1));
+    return index;
+}
+
+// Fetches and expands texels of the normalized integer storage formats.
+template <SWR_FORMAT Format>
+INLINE void FetchUnorm(BYTE const *pBase, UINT const (&offsets)[KNOB_VS_SIMD_WIDTH], WideColor &color)
+{
+    simdscalar one = _simd_set1_ps(1.0f);
+    simdscalari texels;
+
+    switch (Format)
+    {
+    case RGBA8_UNORM:
+        texels = GatherTexels<UINT>(pBase, offsets);
+        color.R = UnpackUnorm<0, 8>(texels);
+        color.G = UnpackUnorm<8, 8>(texels);
+        color.B = UnpackUnorm<16, 8>(texels);
+        color.A = UnpackUnorm<24, 8>(texels);
+        break;
+    case BGRA8_UNORM:
+        texels = GatherTexels<UINT>(pBase, offsets);
+        color.B = UnpackUnorm<0, 8>(texels);
+        color.G = UnpackUnorm<8, 8>(texels);
+        color.R = UnpackUnorm<16, 8>(texels);
+        color.A = UnpackUnorm<24, 8>(texels);
+        break;
+    case A8_UNORM:
+        // XXX: RGB of 1 matches the old A32 upload path; GL specifies 0.
+        texels = GatherTexels<BYTE>(pBase, offsets);
+        color.R = color.G = color.B = one;
+        color.A = UnpackUnorm<0, 8>(texels);
+        break;
+    case L8_UNORM:
+        texels = GatherTexels<BYTE>(pBase, offsets);
+        color.R = color.G = color.B = UnpackUnorm<0, 8>(texels);
+        color.A = one;
+        break;
+    case LA8_UNORM:
+        texels = GatherTexels<unsigned short>(pBase, offsets);
+        color.R = color.G = color.B = UnpackUnorm<0, 8>(texels);
+        color.A = UnpackUnorm<8, 8>(texels);
+        break;
+    case B5G6R5_UNORM:
+        texels = GatherTexels<unsigned short>(pBase, offsets);
+        color.B = UnpackUnorm<0, 5>(texels);
+        color.G = UnpackUnorm<5, 6>(texels);
+        color.R = UnpackUnorm<11, 5>(texels);
+        color.A = one;
+        break;
+    default:
+        assert(false && "Unsupported texture storage format");
+        break;
+    }
+}
+
+template <SWR_FORMAT Format>
+INLINE void FetchTexels(BYTE const *pBase, simdscalari offset, WideColor &color)
+{
+    OSALIGN(UINT, 32) offsets[KNOB_VS_SIMD_WIDTH];
+    _simd_store_si((simdscalari *)&offsets[0], offset);
+
+    if (Format == RGBA32_FLOAT)
+    {
+        __m128 result[KNOB_VS_SIMD_WIDTH];
+        for (UINT i = 0; i < KNOB_VS_SIMD_WIDTH; ++i)
+        {
+            result[i] = _mm_loadu_ps((float *)(pBase + offsets[i]));
+        }
+
+#if KNOB_VS_SIMD_WIDTH == 4
+        color.R = result[0];
+        color.G = result[1];
+        color.B = result[2];
+        color.A = result[3];
+        vTranspose(color.R, color.G, color.B, color.A);
+#elif KNOB_VS_SIMD_WIDTH == 8
+        vTranspose8x4(color, result[0], result[1], result[2], result[3], result[4], result[5], result[6], result[7]);
+#endif
+    }
+    else if (Format == R32_FLOAT)
+    {
+        color.R = _simd_castsi_ps(GatherTexels<UINT>(pBase, offsets));
+        color.G = color.B = _simd_setzero_ps();
+        color.A = _simd_set1_ps(1.0f);
+    }
+    else
+    {
+        FetchUnorm<Format>(pBase, offsets, color);
+    }
+}
+
+// Byte offsets of texels (x, y) in a level of the given physical width.
+INLINE simdscalari TexelOffsets(Texture const &tex, simdscalari physWidth, simdscalari x, simdscalari y)
+{
+    simdscalari index;
+    if (tex.mTilingFormat == TF_TileZ)
+    {
+        switch (TileZShift(tex.mElementSizeInBytes))
+        {
+        case 4:
+            index = vTileZIndex<4>(x, y, physWidth);
+            break;
+        case 5:
+            index = vTileZIndex<5>(x, y, physWidth);
+            break;
+        default:
+            index = vTileZIndex<6>(x, y, physWidth);
+            break;
+        }
+    }
+    else
+    {
+        index = _simd_add_epi32(_simd_mullo_epi32(y, physWidth), x);
+    }
+    return _simd_mullo_epi32(index, _simd_set1_epi32(tex.mElementSizeInBytes));
+}
+
+// Decodes S3TC texels. Each lane reads the 4x4 block at offset holding its
+// texel (x, y); the endpoints and the texel's selectors are pulled out with
+// scalar loads, the expansion and interpolation run in SIMD.
+template <SWR_FORMAT Format>
+INLINE void FetchBlockTexels(BYTE const *pBase, simdscalari offset, simdscalari x, simdscalari y, WideColor &color)
+{
+    const bool hasAlphaBlock = (Format == DXT3_UNORM) || (Format == DXT5_UNORM);
+
+    simdscalari three = _simd_set1_epi32(3);
+    simdscalari texel = _simd_or_si(_simd_slli_epi32(_simd_and_si(y, three), 2), _simd_and_si(x, three));
+
+    OSALIGN(UINT, 32) offsets[KNOB_VS_SIMD_WIDTH];
+    OSALIGN(UINT, 32) texels[KNOB_VS_SIMD_WIDTH];
+    OSALIGN(UINT, 32) endpoints[KNOB_VS_SIMD_WIDTH];
+    OSALIGN(UINT, 32) selectors[KNOB_VS_SIMD_WIDTH];
+    OSALIGN(float, 32) alphas[KNOB_VS_SIMD_WIDTH];
+    _simd_store_si((simdscalari *)&offsets[0], offset);
+    _simd_store_si((simdscalari *)&texels[0], texel);
+
+    for (UINT i = 0; i < KNOB_VS_SIMD_WIDTH; ++i)
+    {
+        BYTE const *pBlock = pBase + offsets[i];
+        BYTE const *pColor = hasAlphaBlock ? pBlock + 8 : pBlock;
+        endpoints[i] = *(UINT const *)pColor;
+        selectors[i] = (*(UINT const *)(pColor + 4) >> (2 * texels[i])) & 3;
+
+        if (Format == DXT3_UNORM)
+        {
+            UINT64 bits = *(UINT64 const *)pBlock;
+            alphas[i] = (float)((bits >> (4 * texels[i])) & 0xF) * (1.0f / 15.0f);
+        }
+        else if (Format == DXT5_UNORM)
+        {
+            UINT a0 = pBlock[0];
+            UINT a1 = pBlock[1];
+            UINT64 bits = *(UINT64 const *)pBlock >> 16;
+            UINT sel = (UINT)(bits >> (3 * texels[i])) & 7;
+
+            float a;
+            if (sel <= 1)
+            {
+                a = (float)(sel ? a1 : a0);
+            }
+            else if (a0 > a1)
+            {
+                a = (float)((8 - sel) * a0 + (sel - 1) * a1) * (1.0f / 7.0f);
+            }
+            else if (sel < 6)
+            {
+                a = (float)((6 - sel) * a0 + (sel - 1) * a1) * (1.0f / 5.0f);
+            }
+            else
+            {
+                a = (sel == 6) ? 0.0f : 255.0f;
+            }
+            alphas[i] = a * (1.0f / 255.0f);
+        }
+    }
+
+    simdscalari c = _simd_load_si((simdscalari const *)&endpoints[0]);
+    simdscalari sel = _simd_load_si((simdscalari const *)&selectors[0]);
+
+    // DXT1 blocks with c0 <= c1 hold two colors, their midpoint and black.
+    simdscalar threeColor = _simd_setzero_ps();
+    if (!hasAlphaBlock)
+    {
+        simdscalari mask = _simd_set1_epi32(0xFFFF);
+        simdscalari c0 = _simd_and_si(c, mask);
+        simdscalari c1 = _simd_and_si(_simd_srai_epi32(c, 16), mask);
+        threeColor = _simd_castsi_ps(_simd_or_si(_simd_cmplt_epi32(c0, c1), _simd_cmpeq_epi32(c0, c1)));
+    }
+
+    // Weight of c1 per selector: 0, 1, 1/3 and 2/3, or 1/2 and black.
+    simdscalar sel1 = _simd_castsi_ps(_simd_cmpeq_epi32(sel, _simd_set1_epi32(1)));
+    simdscalar sel2 = _simd_castsi_ps(_simd_cmpeq_epi32(sel, _simd_set1_epi32(2)));
+    simdscalar sel3 = _simd_castsi_ps(_simd_cmpeq_epi32(sel, three));
+    simdscalar w = _simd_and_ps(sel1, _simd_set1_ps(1.0f));
+    w = _simd_blendv_ps(w, _simd_blendv_ps(_simd_set1_ps(1.0f / 3.0f), _simd_set1_ps(0.5f), threeColor), sel2);
+    w = _simd_blendv_ps(w, _simd_set1_ps(2.0f / 3.0f), sel3);
+
+    simdscalar r0 = UnpackUnorm<11, 5>(c);
+    simdscalar g0 = UnpackUnorm<5, 6>(c);
+    simdscalar b0 = UnpackUnorm<0, 5>(c);
+    color.R = _simd_add_ps(r0, _simd_mul_ps(w, _simd_sub_ps(UnpackUnorm<27, 5>(c), r0)));
+    color.G = _simd_add_ps(g0, _simd_mul_ps(w, _simd_sub_ps(UnpackUnorm<21, 6>(c), g0)));
+    color.B = _simd_add_ps(b0, _simd_mul_ps(w, _simd_sub_ps(UnpackUnorm<16, 5>(c), b0)));
+
+    if (hasAlphaBlock)
+    {
+        color.A = _simd_load_ps(alphas);
+    }
+    else
+    {
+        simdscalar black = _simd_and_ps(threeColor, sel3);
+        color.A = _simd_set1_ps(1.0f);
+        color.R = _simd_andnot_ps(black, color.R);
+        color.G = _simd_andnot_ps(black, color.G);
+        color.B = _simd_andnot_ps(black, color.B);
+        if (Format == DXT1A_UNORM)
+        {
+            color.A = _simd_andnot_ps(black, color.A);
+        }
+    }
+}
+
+// Fetches texels (x, y) of a level at byte offset base from pBase.
+template <SWR_FORMAT Format>
+INLINE void FetchTexelsAt(Texture const &tex, BYTE const *pBase, simdscalari base, simdscalari physWidth, simdscalari x, simdscalari y, WideColor &color)
+{
+    if (IsBlockCompressed(Format))
+    {
+        simdscalari offset = TexelOffsets(tex, physWidth, _simd_srai_epi32(x, 2), _simd_srai_epi32(y, 2));
+        FetchBlockTexels<Format>(pBase, _simd_add_epi32(offset, base), x, y, color);
+    }
+    else
+    {
+        simdscalari offset = TexelOffsets(tex, physWidth, x, y);
+        FetchTexels<Format>(pBase, _simd_add_epi32(offset, base), color);
+    }
+}
+
+template <SWR_FORMAT Format, bool Brolinear, SWR_ADDRESSING_MODE AddrModeU, SWR_ADDRESSING_MODE AddrModeV>
 void SampleSimplePointRGBA(TextureView const &txView, Sampler const &smp, TexCoord const &tc, UINT (&mips)[4], WideColor &color)
 {
     // Widths and heights.
@@ -185,151 +462,671 @@ void SampleSimplePointRGBA(TextureView const &txView, Sampler const &smp, TexCoo
 	simdscalari z	= _simd_cvtps_epi32(Z);
 #endif
 
-    // Get offset.
-    simdscalari offset = _simd_mullo_epi32(y, pyW);
-    offset = _simd_add_epi32(offset, x);
-    offset = _simd_mullo_epi32(offset, _simd_set1_epi32(txView.mpTexture->mElementSizeInBytes));
-
     // Fetch color data. Ignore Z; ignore MIP.
-    OSALIGN(UINT, 32) offsets[KNOB_VS_SIMD_WIDTH];
-    _simd_store_si((simdscalari *)&offsets[0], offset);
+    FetchTexelsAt<Format>(*txView.mpTexture, txView.mpTexture->mSubtextures[0], _simd_setzero_si(), pyW, x, y, color);
+}
+
+// Level of detail of each lane, from the texcoord derivatives across its
+// 2x2 quad. Lanes are ordered TL, TR, BL, BR within every quad.
+INLINE simdscalar QuadLod(Texture const &tex, TexCoord const &tc)
+{
+    simdscalar u = _simd_mul_ps(tc.U, _simd_set1_ps((float)tex.mTexelWidth[0]));
+    simdscalar v = _simd_mul_ps(tc.V, _simd_set1_ps((float)tex.mTexelHeight[0]));
+
+    simdscalar u0 = _simd_shuffle_ps(u, u, _MM_SHUFFLE(0, 0, 0, 0));
+    simdscalar v0 = _simd_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0));
+    simdscalar dudx = _simd_sub_ps(_simd_shuffle_ps(u, u, _MM_SHUFFLE(1, 1, 1, 1)), u0);
+    simdscalar dvdx = _simd_sub_ps(_simd_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1)), v0);
+    simdscalar dudy = _simd_sub_ps(_simd_shuffle_ps(u, u, _MM_SHUFFLE(2, 2, 2, 2)), u0);
+    simdscalar dvdy = _simd_sub_ps(_simd_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2)), v0);
+
+    simdscalar rhoX = _simd_add_ps(_simd_mul_ps(dudx, dudx), _simd_mul_ps(dvdx, dvdx));
+    simdscalar rhoY = _simd_add_ps(_simd_mul_ps(dudy, dudy), _simd_mul_ps(dvdy, dvdy));
+    simdscalar rho2 = _simd_max_ps(rhoX, rhoY);
+
+    // log2(rho) = log2(rho^2) / 2. The float bits of rho^2 are a piecewise
+    // linear log2, which is plenty to pick and blend levels.
+    simdscalar log2Rho2 = _simd_cvtepi32_ps(_simd_castps_si(rho2));
+    log2Rho2 = _simd_sub_ps(_simd_mul_ps(log2Rho2, _simd_set1_ps(1.0f / (1 << 23))), _simd_set1_ps(127.0f));
+    return _simd_mul_ps(log2Rho2, _simd_set1_ps(0.5f));
+}
+
+// Per lane geometry of the sampled mip level.
+struct MipGeometry
+{
+    simdscalar width;
+    simdscalar height;
+    simdscalari physWidth;
+    simdscalari base; // byte offset of the level in the texture storage
+};
 
-    if (UseFloat)
+// Cube faces are planes of the texture, each with its own mip chain.
+INLINE void LoadMipGeometry(Texture const &tex, simdscalari level, simdscalari face, MipGeometry &geo)
+{
+    OSALIGN(UINT, 32) levels[KNOB_VS_SIMD_WIDTH];
+    OSALIGN(UINT, 32) faces[KNOB_VS_SIMD_WIDTH];
+    OSALIGN(float, 32) width[KNOB_VS_SIMD_WIDTH];
+    OSALIGN(float, 32) height[KNOB_VS_SIMD_WIDTH];
+    OSALIGN(UINT, 32) physWidth[KNOB_VS_SIMD_WIDTH];
+    OSALIGN(UINT, 32) base[KNOB_VS_SIMD_WIDTH];
+
+    _simd_store_si((simdscalari *)&levels[0], level);
+    _simd_store_si((simdscalari *)&faces[0], face);
+    for (UINT i = 0; i < KNOB_VS_SIMD_WIDTH; ++i)
     {
-        __m128 result[KNOB_VS_SIMD_WIDTH];
-        for (UINT i = 0; i < KNOB_VS_SIMD_WIDTH; ++i)
+        UINT l = levels[i];
+        width[i] = (float)tex.mTexelWidth[l];
+        height[i] = (float)tex.mTexelHeight[l];
+        physWidth[i] = tex.mPhysicalWidth[l];
+        base[i] = tex.mSubtextureOffsets[faces[i] * tex.mNumMipLevels + l];
+    }
+
+    geo.width = _simd_load_ps(width);
+    geo.height = _simd_load_ps(height);
+    geo.physWidth = _simd_load_si((simdscalari const *)&physWidth[0]);
+    geo.base = _simd_load_si((simdscalari const *)&base[0]);
+}
+
+INLINE void LerpColor(WideColor &dst, WideColor const &c0, WideColor const &c1, simdscalar t)
+{
+    dst.R = _simd_add_ps(c0.R, _simd_mul_ps(t, _simd_sub_ps(c1.R, c0.R)));
+    dst.G = _simd_add_ps(c0.G, _simd_mul_ps(t, _simd_sub_ps(c1.G, c0.G)));
+    dst.B = _simd_add_ps(c0.B, _simd_mul_ps(t, _simd_sub_ps(c1.B, c0.B)));
+    dst.A = _simd_add_ps(c0.A, _simd_mul_ps(t, _simd_sub_ps(c1.A, c0.A)));
+}
+
+// Applies an addressing mode to integral texel coords X of a level of size
+// dim. Taps outside a SWR_AM_DEFAULT level are flagged in border.
+INLINE simdscalar AddressTexel(SWR_ADDRESSING_MODE mode, simdscalar X, simdscalar dim, simdscalar &border)
+{
+    simdscalar zero = _simd_setzero_ps();
+    simdscalar dimMinus1 = _simd_sub_ps(dim, _simd_set1_ps(1.0f));
+
+    switch (mode)
+    {
+    case SWR_AM_WRAP:
+        return _simd_sub_ps(X, _simd_mul_ps(_simd_round_ps(_simd_div_ps(X, dim), _MM_FROUND_TO_NEG_INF), dim));
+    case SWR_AM_MIRROR:
+    {
+        simdscalar period = _simd_add_ps(dim, dim);
+        X = _simd_sub_ps(X, _simd_mul_ps(_simd_round_ps(_simd_div_ps(X, period), _MM_FROUND_TO_NEG_INF), period));
+        simdscalar mirrored = _simd_sub_ps(_simd_sub_ps(period, _simd_set1_ps(1.0f)), X);
+        return _simd_blendv_ps(X, mirrored, _simd_cmpge_ps(X, dim));
+    }
+    case SWR_AM_DEFAULT:
+        border = _simd_or_ps(border, _simd_or_ps(_simd_cmplt_ps(X, zero), _simd_cmpgt_ps(X, dimMinus1)));
+    // fall through; the clamped address keeps the fetch in bounds.
+    case SWR_AM_CLAMP:
+    default:
+        return _simd_min_ps(_simd_max_ps(X, zero), dimMinus1);
+    }
+}
+
+INLINE void BlendBorder(Sampler const &smp, simdscalar border, WideColor &color)
+{
+    color.R = _simd_blendv_ps(color.R, _simd_set1_ps(smp.mDefaultColor[0]), border);
+    color.G = _simd_blendv_ps(color.G, _simd_set1_ps(smp.mDefaultColor[1]), border);
+    color.B = _simd_blendv_ps(color.B, _simd_set1_ps(smp.mDefaultColor[2]), border);
+    color.A = _simd_blendv_ps(color.A, _simd_set1_ps(smp.mDefaultColor[3]), border);
+}
+
+// Bilinear footprint of the unnormalized coords X, Y; the top left tap and
+// the weights of the right and bottom taps.
+struct LinearFootprint
+{
+    simdscalar X0, X1, Y0, Y1;
+    simdscalar alpha, beta;
+    simdscalar border00, border10, border01, border11;
+};
+
+INLINE void ComputeFootprint(Sampler const &smp, MipGeometry const &geo, simdscalar U, simdscalar V, LinearFootprint &fp)
+{
+    simdscalar one = _simd_set1_ps(1.0f);
+    simdscalar X = _simd_sub_ps(_simd_mul_ps(U, geo.width), _simd_set1_ps(0.5f));
+    simdscalar Y = _simd_sub_ps(_simd_mul_ps(V, geo.height), _simd_set1_ps(0.5f));
+    simdscalar X0 = _simd_round_ps(X, _MM_FROUND_TO_NEG_INF);
+    simdscalar Y0 = _simd_round_ps(Y, _MM_FROUND_TO_NEG_INF);
+    fp.alpha = _simd_sub_ps(X, X0);
+    fp.beta = _simd_sub_ps(Y, Y0);
+
+    simdscalar bx0 = _simd_setzero_ps(), bx1 = _simd_setzero_ps();
+    simdscalar by0 = _simd_setzero_ps(), by1 = _simd_setzero_ps();
+    fp.X0 = AddressTexel(smp.mAddressU, X0, geo.width, bx0);
+    fp.X1 = AddressTexel(smp.mAddressU, _simd_add_ps(X0, one), geo.width, bx1);
+    fp.Y0 = AddressTexel(smp.mAddressV, Y0, geo.height, by0);
+    fp.Y1 = AddressTexel(smp.mAddressV, _simd_add_ps(Y0, one), geo.height, by1);
+
+    fp.border00 = _simd_or_ps(bx0, by0);
+    fp.border10 = _simd_or_ps(bx1, by0);
+    fp.border01 = _simd_or_ps(bx0, by1);
+    fp.border11 = _simd_or_ps(bx1, by1);
+}
+
+// U, V are normalized and unwrapped.
+template <SWR_FORMAT Format>
+INLINE void SampleLevelPoint(Texture const &tex, Sampler const &smp, MipGeometry const &geo, simdscalar U, simdscalar V, WideColor &color)
+{
+    simdscalar border = _simd_setzero_ps();
+    simdscalar X = _simd_round_ps(_simd_mul_ps(U, geo.width), _MM_FROUND_TO_NEG_INF);
+    simdscalar Y = _simd_round_ps(_simd_mul_ps(V, geo.height), _MM_FROUND_TO_NEG_INF);
+    X = AddressTexel(smp.mAddressU, X, geo.width, border);
+    Y = AddressTexel(smp.mAddressV, Y, geo.height, border);
+
+    FetchTexelsAt<Format>(tex, tex.mpStorage, geo.base, geo.physWidth, _simd_cvtps_epi32(X), _simd_cvtps_epi32(Y), color);
+
+    if ((smp.mAddressU == SWR_AM_DEFAULT) || (smp.mAddressV == SWR_AM_DEFAULT))
+    {
+        BlendBorder(smp, border, color);
+    }
+}
+
+template <SWR_FORMAT Format>
+INLINE void FetchTap(Texture const &tex, Sampler const &smp, MipGeometry const &geo, simdscalar X, simdscalar Y, simdscalar border, WideColor &color)
+{
+    FetchTexelsAt<Format>(tex, tex.mpStorage, geo.base, geo.physWidth, _simd_cvtps_epi32(X), _simd_cvtps_epi32(Y), color);
+
+    if ((smp.mAddressU == SWR_AM_DEFAULT) || (smp.mAddressV == SWR_AM_DEFAULT))
+    {
+        BlendBorder(smp, border, color);
+    }
+}
+
+template <SWR_FORMAT Format>
+INLINE void SampleLevelLinear(Texture const &tex, Sampler const &smp, MipGeometry const &geo, simdscalar U, simdscalar V, WideColor &color)
+{
+    LinearFootprint fp;
+    ComputeFootprint(smp, geo, U, V, fp);
+
+    WideColor c00, c10, c01, c11;
+    FetchTap<Format>(tex, smp, geo, fp.X0, fp.Y0, fp.border00, c00);
+    FetchTap<Format>(tex, smp, geo, fp.X1, fp.Y0, fp.border10, c10);
+    FetchTap<Format>(tex, smp, geo, fp.X0, fp.Y1, fp.border01, c01);
+    FetchTap<Format>(tex, smp, geo, fp.X1, fp.Y1, fp.border11, c11);
+
+    LerpColor(c00, c00, c10, fp.alpha);
+    LerpColor(c01, c01, c11, fp.alpha);
+    LerpColor(color, c00, c01, fp.beta);
+}
+
+template <SWR_FORMAT Format>
+INLINE void SampleLevel(Texture const &tex, Sampler const &smp, SWR_FILTER filter, simdscalari level, simdscalari face, simdscalar U, simdscalar V, WideColor &color)
+{
+    MipGeometry geo;
+    LoadMipGeometry(tex, level, face, geo);
+    if (filter == SWR_FILTER_LINEAR)
+    {
+        SampleLevelLinear<Format>(tex, smp, geo, U, V, color);
+    }
+    else
+    {
+        SampleLevelPoint<Format>(tex, smp, geo, U, V, color);
+    }
+}
+
+// 8-bit per channel kernels. Texels are expanded to packed RGBA8, then
+// filtered four lanes at a time as 16-bit channels with 7 fractional bits,
+// weights in Q15.
+#define SIMD_QUARTERS (KNOB_VS_SIMD_WIDTH / 4)
+
+INLINE __m128i SimdQuarter(simdscalari v, UINT q)
+{
+#if KNOB_VS_SIMD_WIDTH == 4
+    return v;
+#else
+    return (q == 0) ? _mm256_castsi256_si128(v) : _mm256_extractf128_si256(v, 1);
+#endif
+}
+
+template <SWR_FORMAT Format>
+INLINE __m128i ExpandToRGBA8(__m128i t)
+{
+    switch (Format)
+    {
+    case BGRA8_UNORM:
+        return _mm_shuffle_epi8(t, _mm_set_epi8(15, 12, 13, 14, 11, 8, 9, 10, 7, 4, 5, 6, 3, 0, 1, 2));
+    case A8_UNORM:
+        // XXX: RGB of 1, as in FetchUnorm.
+        return _mm_or_si128(_mm_slli_epi32(t, 24), _mm_set1_epi32(0x00FFFFFF));
+    case L8_UNORM:
+        return _mm_or_si128(_mm_mullo_epi32(t, _mm_set1_epi32(0x00010101)), _mm_set1_epi32(0xFF000000));
+    case LA8_UNORM:
+        return _mm_or_si128(_mm_mullo_epi32(_mm_and_si128(t, _mm_set1_epi32(0xFF)), _mm_set1_epi32(0x00010101)),
+                            _mm_slli_epi32(_mm_and_si128(t, _mm_set1_epi32(0xFF00)), 16));
+    case RGBA8_UNORM:
+    default:
+        return t;
+    }
+}
+
+// Gathers one quarter of the taps at the given byte offsets as RGBA8.
+template <SWR_FORMAT Format>
+INLINE __m128i GatherRGBA8(BYTE const *pBase, UINT const *pOffsets)
+{
+    OSALIGN(UINT, 16) texels[4];
+    for (UINT i = 0; i < 4; ++i)
+    {
+        switch (GetFormatInfo(Format).Bpp)
         {
-            result[i] = _mm_loadu_ps((float *)(txView.mpTexture->mSubtextures[0] + offsets[i]));
+        case 1:
+            texels[i] = *(pBase + pOffsets[i]);
+            break;
+        case 2:
+            texels[i] = *(unsigned short const *)(pBase + pOffsets[i]);
+            break;
+        default:
+            texels[i] = *(UINT const *)(pBase + pOffsets[i]);
+            break;
         }
+    }
+    return ExpandToRGBA8<Format>(_mm_load_si128((__m128i const *)&texels[0]));
+}
 
-//if ((AddrModeU == SWR_AM_DEFAULT) || (AddrModeV == SWR_AM_DEFAULT))
-//{
-//  __m128 defClr	= _mm_loadu_ps(smp.mDefaultColor);
-//	clr7		= _mm_blendv_ps(clr7, defClr, outOfBounds);
-//	clr6		= _mm_blendv_ps(clr6, defClr, outOfBounds);
-//	clr5		= _mm_blendv_ps(clr5, defClr, outOfBounds);
-//	clr4		= _mm_blendv_ps(clr4, defClr, outOfBounds);
-//	clr3		= _mm_blendv_ps(clr3, defClr, outOfBounds);
-//	clr2		= _mm_blendv_ps(clr2, defClr, outOfBounds);
-//	clr1		= _mm_blendv_ps(clr1, defClr, outOfBounds);
-//	clr0		= _mm_blendv_ps(clr0, defClr, outOfBounds);
-//}
+// Four lanes of 16-bit RGBA, lanes 0-1 in lo and 2-3 in hi.
+struct Texels16
+{
+    __m128i lo;
+    __m128i hi;
+};
+
+INLINE void ExpandTexels16(__m128i rgba8, Texels16 &t)
+{
+    __m128i zero = _mm_setzero_si128();
+    t.lo = _mm_slli_epi16(_mm_unpacklo_epi8(rgba8, zero), 7);
+    t.hi = _mm_slli_epi16(_mm_unpackhi_epi8(rgba8, zero), 7);
+}
+
+// Replicates the Q15 weight of each lane across its four channels.
+template <bool Hi>
+INLINE __m128i SplatWeights(__m128i w)
+{
+    return Hi ? _mm_shuffle_epi8(w, _mm_set_epi8(13, 12, 13, 12, 13, 12, 13, 12, 9, 8, 9, 8, 9, 8, 9, 8))
+              : _mm_shuffle_epi8(w, _mm_set_epi8(5, 4, 5, 4, 5, 4, 5, 4, 1, 0, 1, 0, 1, 0, 1, 0));
+}
+
+// dst = t0 + (t1 - t0) * w, rounded to nearest.
+INLINE void LerpTexels16(Texels16 &dst, Texels16 const &t0, Texels16 const &t1, __m128i w)
+{
+    dst.lo = _mm_add_epi16(t0.lo, _mm_mulhrs_epi16(_mm_sub_epi16(t1.lo, t0.lo), SplatWeights<false>(w)));
+    dst.hi = _mm_add_epi16(t0.hi, _mm_mulhrs_epi16(_mm_sub_epi16(t1.hi, t0.hi), SplatWeights<true>(w)));
+}
+
+INLINE simdscalari ToQ15(simdscalar w)
+{
+    return _simd_cvtps_epi32(_simd_mul_ps(w, _simd_set1_ps(32767.0f)));
+}
+
+INLINE void UnpackTexels16(Texels16 const (&t)[SIMD_QUARTERS], WideColor &color)
+{
+    __m128 scale = _mm_set1_ps(1.0f / (255.0f * 128.0f));
+    __m128 rows[KNOB_VS_SIMD_WIDTH];
+    for (UINT q = 0; q < SIMD_QUARTERS; ++q)
+    {
+        rows[q * 4 + 0] = _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepu16_epi32(t[q].lo)), scale);
+        rows[q * 4 + 1] = _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepu16_epi32(_mm_srli_si128(t[q].lo, 8))), scale);
+        rows[q * 4 + 2] = _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepu16_epi32(t[q].hi)), scale);
+        rows[q * 4 + 3] = _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepu16_epi32(_mm_srli_si128(t[q].hi, 8))), scale);
+    }
 
-#if 0
-		if (Brolinear)
-		{
-			__m128 alpha	= _mm_sub_ps(X, _mm_cvtepi32_ps(x));
-			__m128 beta		= _mm_sub_ps(Y, _mm_cvtepi32_ps(y));
-			__m128 _1_alpha	= _mm_sub_ps(_mm_set1_ps(1.0f), alpha);
-			__m128 _1_beta	= _mm_sub_ps(_mm_set1_ps(1.0f), beta);
-
-			__m128 a_b		= _mm_mul_ps(alpha, beta);
-			__m128 a_1b		= _mm_mul_ps(alpha, _1_beta);
-			__m128 _1a_b	= _mm_mul_ps(_1_alpha, beta);
-			__m128 _1a_1b	= _mm_mul_ps(_1_alpha, _1_beta);
-
-			clr3			= _mm_mul_ps(clr3, a_b);
-			clr2			= _mm_mul_ps(clr2, a_b);
-			clr1			= _mm_mul_ps(clr1, a_b);
-			clr0			= _mm_mul_ps(clr0, a_b);
-
-			__m128i Xnext	= _mm_add_epi32(offset, _mm_set1_epi32(txView.mpTexture->mElementSizeInBytes));
-			__m128i Ynext	= _mm_add_epi32(offset, _mm_mullo_epi32(pyW, _mm_set1_epi32(txView.mpTexture->mElementSizeInBytes)));
-			__m128i XYnext	= _mm_add_epi32(Ynext, _mm_set1_epi32(txView.mpTexture->mElementSizeInBytes));
-
-            simdscalar txW1	= _simd_sub_ps(txW, _simd_set1_ps(1.0f));
-            simdscalar txH1	= _simd_sub_ps(txH, _simd_set1_ps(1.0f));
-
-			__m128 xlt		= _mm_cmplt_ps(X, txW1);
-			__m128 ylt		= _mm_cmplt_ps(Y, txH1);
-
-			_mm_store_si128((__m128i*)&offsets[0],
-				_mm_castps_si128(
-					_mm_blendv_ps(
-						_mm_castsi128_ps(offset),
-						_mm_castsi128_ps(Xnext),
-						xlt)));
-			clr3	= _mm_add_ps(clr3, _mm_mul_ps(_1a_b, _mm_loadu_ps((float*)(txView.mpTexture->mSubtextures[mips[gO[0]]]+offsets[gO[0]]))));
-			clr2	= _mm_add_ps(clr2, _mm_mul_ps(_1a_b, _mm_loadu_ps((float*)(txView.mpTexture->mSubtextures[mips[gO[1]]]+offsets[gO[1]]))));
-			clr1	= _mm_add_ps(clr1, _mm_mul_ps(_1a_b, _mm_loadu_ps((float*)(txView.mpTexture->mSubtextures[mips[gO[2]]]+offsets[gO[2]]))));
-			clr0	= _mm_add_ps(clr0, _mm_mul_ps(_1a_b, _mm_loadu_ps((float*)(txView.mpTexture->mSubtextures[mips[gO[3]]]+offsets[gO[3]]))));
-
-			if ((AddrModeU == SWR_AM_DEFAULT) || (AddrModeV == SWR_AM_DEFAULT))
-			{
-				assert(false && "Default color for mip is ... complicated. Bailing, for now.");
-			}
-
-			_mm_store_si128((__m128i*)&offsets[0],
-				_mm_castps_si128(
-					_mm_blendv_ps(
-						_mm_castsi128_ps(offset),
-						_mm_castsi128_ps(Ynext),
-						ylt)));
-			clr3	= _mm_add_ps(clr3, _mm_mul_ps(a_1b, _mm_loadu_ps((float*)(txView.mpTexture->mSubtextures[mips[gO[0]]]+offsets[gO[0]]))));
-			clr2	= _mm_add_ps(clr2, _mm_mul_ps(a_1b, _mm_loadu_ps((float*)(txView.mpTexture->mSubtextures[mips[gO[1]]]+offsets[gO[1]]))));
-			clr1	= _mm_add_ps(clr1, _mm_mul_ps(a_1b, _mm_loadu_ps((float*)(txView.mpTexture->mSubtextures[mips[gO[2]]]+offsets[gO[2]]))));
-			clr0	= _mm_add_ps(clr0, _mm_mul_ps(a_1b, _mm_loadu_ps((float*)(txView.mpTexture->mSubtextures[mips[gO[3]]]+offsets[gO[3]]))));
-
-			if ((AddrModeU == SWR_AM_DEFAULT) || (AddrModeV == SWR_AM_DEFAULT))
-			{
-				assert(false && "Default color for mip is ... complicated. Bailing, for now.");
-			}
-
-			_mm_store_si128((__m128i*)&offsets[0],
-				_mm_castps_si128(
-					_mm_blendv_ps(
-						_mm_blendv_ps(
-							_mm_castsi128_ps(Xnext),
-							_mm_blendv_ps(
-								_mm_castsi128_ps(Ynext),
-								_mm_castsi128_ps(offset),
-								xlt),
-							ylt),
-						_mm_castsi128_ps(XYnext),
-						_mm_and_ps(xlt, ylt))));
-
-			clr3	= _mm_add_ps(clr3, _mm_mul_ps(_1a_1b, _mm_loadu_ps((float*)(txView.mpTexture->mSubtextures[mips[gO[0]]]+offsets[gO[0]]))));
-			clr2	= _mm_add_ps(clr2, _mm_mul_ps(_1a_1b, _mm_loadu_ps((float*)(txView.mpTexture->mSubtextures[mips[gO[1]]]+offsets[gO[1]]))));
-			clr1	= _mm_add_ps(clr1, _mm_mul_ps(_1a_1b, _mm_loadu_ps((float*)(txView.mpTexture->mSubtextures[mips[gO[2]]]+offsets[gO[2]]))));
-			clr0	= _mm_add_ps(clr0, _mm_mul_ps(_1a_1b, _mm_loadu_ps((float*)(txView.mpTexture->mSubtextures[mips[gO[3]]]+offsets[gO[3]]))));
-		}
-#endif
 #if KNOB_VS_SIMD_WIDTH == 4
-        color.R = result[0];
-        color.G = result[1];
-        color.B = result[2];
-        color.A = result[3];
-        vTranspose(color.R, color.G, color.B, color.A);
+    color.R = rows[0];
+    color.G = rows[1];
+    color.B = rows[2];
+    color.A = rows[3];
+    vTranspose(color.R, color.G, color.B, color.A);
 #elif KNOB_VS_SIMD_WIDTH == 8
-        vTranspose8x4(color, result[0], result[1], result[2], result[3], result[4], result[5], result[6], result[7]);
+    vTranspose8x4(color, rows[0], rows[1], rows[2], rows[3], rows[4], rows[5], rows[6], rows[7]);
 #endif
+}
+
+// Bilinear filter of one level in fixed point.
+template <SWR_FORMAT Format>
+INLINE void SampleLevelLinear8(Texture const &tex, Sampler const &smp, simdscalari level, simdscalari face, simdscalar U, simdscalar V, Texels16 (&result)[SIMD_QUARTERS])
+{
+    MipGeometry geo;
+    LoadMipGeometry(tex, level, face, geo);
+
+    LinearFootprint fp;
+    ComputeFootprint(smp, geo, U, V, fp);
+
+    simdscalari x0 = _simd_cvtps_epi32(fp.X0);
+    simdscalari x1 = _simd_cvtps_epi32(fp.X1);
+    simdscalari y0 = _simd_cvtps_epi32(fp.Y0);
+    simdscalari y1 = _simd_cvtps_epi32(fp.Y1);
+
+    OSALIGN(UINT, 32) offsets[4][KNOB_VS_SIMD_WIDTH];
+    _simd_store_si((simdscalari *)&offsets[0][0], _simd_add_epi32(TexelOffsets(tex, geo.physWidth, x0, y0), geo.base));
+    _simd_store_si((simdscalari *)&offsets[1][0], _simd_add_epi32(TexelOffsets(tex, geo.physWidth, x1, y0), geo.base));
+    _simd_store_si((simdscalari *)&offsets[2][0], _simd_add_epi32(TexelOffsets(tex, geo.physWidth, x0, y1), geo.base));
+    _simd_store_si((simdscalari *)&offsets[3][0], _simd_add_epi32(TexelOffsets(tex, geo.physWidth, x1, y1), geo.base));
+
+    bool hasBorder = (smp.mAddressU == SWR_AM_DEFAULT) || (smp.mAddressV == SWR_AM_DEFAULT);
+    __m128i borderColor = _mm_setzero_si128();
+    if (hasBorder)
+    {
+        UINT packed = 0;
+        for (UINT c = 0; c < 4; ++c)
+        {
+            float v = std::min(std::max(smp.mDefaultColor[c], 0.0f), 1.0f);
+            packed |= (UINT)(v * 255.0f + 0.5f) << (c * 8);
+        }
+        borderColor = _mm_set1_epi32(packed);
+    }
+
+    simdscalari alpha = ToQ15(fp.alpha);
+    simdscalari beta = ToQ15(fp.beta);
+    simdscalar borders[4] = { fp.border00, fp.border10, fp.border01, fp.border11 };
+
+    for (UINT q = 0; q < SIMD_QUARTERS; ++q)
+    {
+        Texels16 taps[4];
+        for (UINT t = 0; t < 4; ++t)
+        {
+            __m128i rgba8 = GatherRGBA8<Format>(tex.mpStorage, &offsets[t][q * 4]);
+            if (hasBorder)
+            {
+                rgba8 = _mm_blendv_epi8(rgba8, borderColor, SimdQuarter(_simd_castps_si(borders[t]), q));
+            }
+            ExpandTexels16(rgba8, taps[t]);
+        }
+
+        __m128i a = SimdQuarter(alpha, q);
+        LerpTexels16(taps[0], taps[0], taps[1], a);
+        LerpTexels16(taps[2], taps[2], taps[3], a);
+        LerpTexels16(result[q], taps[0], taps[2], SimdQuarter(beta, q));
+    }
+}
+
+template <SWR_FORMAT Format>
+struct IsRGBA8Filterable
+{
+    enum
+    {
+        value = (Format == RGBA8_UNORM) || (Format == BGRA8_UNORM) || (Format == A8_UNORM) ||
+                (Format == L8_UNORM) || (Format == LA8_UNORM)
+    };
+};
+
+// Samples one level, with the integer kernel for linear 8-bit filtering.
+template <SWR_FORMAT Format>
+INLINE void SampleLevelAny(Texture const &tex, Sampler const &smp, SWR_FILTER filter, simdscalari level, simdscalari face, simdscalar U, simdscalar V, WideColor &color)
+{
+    if (IsRGBA8Filterable<Format>::value && (filter == SWR_FILTER_LINEAR))
+    {
+        Texels16 texels[SIMD_QUARTERS];
+        SampleLevelLinear8<Format>(tex, smp, level, face, U, V, texels);
+        UnpackTexels16(texels, color);
     }
     else
     {
-#if 0
-		assert(false && "This is not going to work, so suck it.");
-		__m128i clr	= _mm_setzero_si128();
-		// Oh, gather! Where art thou!
-		clr			= _mm_insert_epi32(clr, *(UINT32*)(txView.mpTexture->mSubtextures[mips[gO[0]]]+offsets[gO[0]]), 0);
-		clr			= _mm_insert_epi32(clr, *(UINT32*)(txView.mpTexture->mSubtextures[mips[gO[1]]]+offsets[gO[1]]), 1);
-		clr			= _mm_insert_epi32(clr, *(UINT32*)(txView.mpTexture->mSubtextures[mips[gO[2]]]+offsets[gO[2]]), 2);
-		clr			= _mm_insert_epi32(clr, *(UINT32*)(txView.mpTexture->mSubtextures[mips[gO[3]]]+offsets[gO[3]]), 3);
-
-		// Split & upconvert.
-		color.R		= _mm_cvtepi32_ps(_mm_and_si128(clr, _mm_set1_epi32(0xFF)));
-		clr			= _mm_srai_epi32(clr, 8);
-		color.G		= _mm_cvtepi32_ps(_mm_and_si128(clr, _mm_set1_epi32(0xFF)));
-		clr			= _mm_srai_epi32(clr, 8);
-		color.B		= _mm_cvtepi32_ps(_mm_and_si128(clr, _mm_set1_epi32(0xFF)));
-		clr			= _mm_srai_epi32(clr, 8);
-		color.A		= _mm_cvtepi32_ps(_mm_and_si128(clr, _mm_set1_epi32(0xFF)));
-#endif
+        SampleLevel<Format>(tex, smp, filter, level, face, U, V, color);
+    }
+}
+
+// Selects the cube face of direction (U, V, W) by its major axis and
+// projects the direction onto it, per the ARB_texture_cube_map face table.
+INLINE void ProjectCubeFace(TexCoord const &dir, TexCoord &tc, simdscalari &face)
+{
+    simdscalar zero = _simd_setzero_ps();
+    simdscalar one = _simd_set1_ps(1.0f);
+    simdscalar signMask = _simd_set1_ps(-0.0f);
+
+    simdscalar x = dir.U, y = dir.V, z = dir.W;
+    simdscalar ax = _simd_andnot_ps(signMask, x);
+    simdscalar ay = _simd_andnot_ps(signMask, y);
+    simdscalar az = _simd_andnot_ps(signMask, z);
+    simdscalar sx = _simd_and_ps(signMask, x);
+    simdscalar sy = _simd_and_ps(signMask, y);
+    simdscalar sz = _simd_and_ps(signMask, z);
+
+    // Ties go to X, then Y.
+    simdscalar isX = _simd_and_ps(_simd_cmpge_ps(ax, ay), _simd_cmpge_ps(ax, az));
+    simdscalar isY = _simd_andnot_ps(isX, _simd_cmpge_ps(ay, az));
+
+    // +-X: sc = -+z, tc = -y; +-Y: sc = x, tc = +-z; +-Z: sc = +-x, tc = -y.
+    simdscalar sc = _simd_xor_ps(x, sz);
+    sc = _simd_blendv_ps(sc, x, isY);
+    sc = _simd_blendv_ps(sc, _simd_xor_ps(_simd_xor_ps(z, signMask), sx), isX);
+    simdscalar tc_ = _simd_xor_ps(y, signMask);
+    tc_ = _simd_blendv_ps(tc_, _simd_xor_ps(z, sy), isY);
+
+    simdscalar ma = _simd_blendv_ps(_simd_blendv_ps(az, ay, isY), ax, isX);
+    simdscalar negative = _simd_and_ps(_simd_cmplt_ps(_simd_blendv_ps(_simd_blendv_ps(z, y, isY), x, isX), zero), one);
+    simdscalar axis = _simd_blendv_ps(_simd_blendv_ps(_simd_set1_ps(4.0f), _simd_set1_ps(2.0f), isY), zero, isX);
+    face = _simd_cvtps_epi32(_simd_add_ps(axis, negative));
+
+    // A zero direction samples the center of +X rather than NaNs.
+    simdscalar halfOverMa = _simd_div_ps(_simd_set1_ps(0.5f), _simd_max_ps(ma, _simd_set1_ps(1e-30f)));
+    simdscalar half = _simd_set1_ps(0.5f);
+    tc.U = _simd_fmadd_ps(sc, halfOverMa, half);
+    tc.V = _simd_fmadd_ps(tc_, halfOverMa, half);
+    tc.W = zero;
+}
+
+// Filters with the sampler's min/mag/mip filters and address modes.
+template <SWR_FORMAT Format>
+void SampleQuadRGBA(TextureView const &txView, Sampler const &smp, TexCoord const &dir, WideColor &color)
+{
+    Texture const &tex = *txView.mpTexture;
+
+    // XXX: faces are filtered independently, quads straddling a cube edge
+    // get a large lod and taps clamp at the face edge instead of crossing it.
+    TexCoord tc = dir;
+    simdscalari face = _simd_setzero_si();
+    if (smp.mArraySpec == AS_TexCube)
+    {
+        ProjectCubeFace(dir, tc, face);
+    }
+
+    simdscalar lod = QuadLod(tex, tc);
+    simdscalar vMag = _simd_cmple_ps(lod, _simd_setzero_ps());
+    UINT magMask = _simd_movemask_ps(vMag);
+    simdscalari level0 = _simd_setzero_si();
+
+    if (magMask == (1 << KNOB_VS_SIMD_WIDTH) - 1)
+    {
+        SampleLevelAny<Format>(tex, smp, smp.mMagFilter, level0, face, tc.U, tc.V, color);
+        return;
+    }
+
+    simdscalar maxLod = _simd_set1_ps((float)(tex.mNumMipLevels - 1));
+    lod = _simd_min_ps(_simd_max_ps(lod, _simd_setzero_ps()), maxLod);
+
+    switch (smp.mMipFilter)
+    {
+    case SWR_MIPFILTER_POINT:
+        SampleLevelAny<Format>(tex, smp, smp.mMinFilter, _simd_cvtps_epi32(lod), face, tc.U, tc.V, color);
+        break;
+    case SWR_MIPFILTER_LINEAR:
+    {
+        simdscalar lodFloor = _simd_round_ps(lod, _MM_FROUND_TO_NEG_INF);
+        simdscalar lodCeil = _simd_min_ps(_simd_add_ps(lodFloor, _simd_set1_ps(1.0f)), maxLod);
+        simdscalari lo = _simd_cvtps_epi32(lodFloor);
+        simdscalari hi = _simd_cvtps_epi32(lodCeil);
+
+        if (IsRGBA8Filterable<Format>::value && (smp.mMinFilter == SWR_FILTER_LINEAR))
+        {
+            // Trilinear stays in fixed point until the final expand.
+            Texels16 loTexels[SIMD_QUARTERS], hiTexels[SIMD_QUARTERS];
+            SampleLevelLinear8<Format>(tex, smp, lo, face, tc.U, tc.V, loTexels);
+            SampleLevelLinear8<Format>(tex, smp, hi, face, tc.U, tc.V, hiTexels);
+            simdscalari w = ToQ15(_simd_sub_ps(lod, lodFloor));
+            for (UINT q = 0; q < SIMD_QUARTERS; ++q)
+            {
+                LerpTexels16(loTexels[q], loTexels[q], hiTexels[q], SimdQuarter(w, q));
+            }
+            UnpackTexels16(loTexels, color);
+        }
+        else
+        {
+            WideColor hiColor;
+            SampleLevel<Format>(tex, smp, smp.mMinFilter, lo, face, tc.U, tc.V, color);
+            SampleLevel<Format>(tex, smp, smp.mMinFilter, hi, face, tc.U, tc.V, hiColor);
+            LerpColor(color, color, hiColor, _simd_sub_ps(lod, lodFloor));
+        }
+    }
+    break;
+    default:
+        SampleLevelAny<Format>(tex, smp, smp.mMinFilter, level0, face, tc.U, tc.V, color);
+        break;
+    }
+
+    if (magMask)
+    {
+        WideColor magColor;
+        SampleLevelAny<Format>(tex, smp, smp.mMagFilter, level0, face, tc.U, tc.V, magColor);
+        color.R = _simd_blendv_ps(color.R, magColor.R, vMag);
+        color.G = _simd_blendv_ps(color.G, magColor.G, vMag);
+        color.B = _simd_blendv_ps(color.B, magColor.B, vMag);
+        color.A = _simd_blendv_ps(color.A, magColor.A, vMag);
+    }
+}
+
+// 1.0 in lanes where ref passes func against the texel depth, else 0.0.
+INLINE simdscalar CompareDepth(SWR_ZFUNCTION func, simdscalar ref, simdscalar depth)
+{
+    simdscalar pass;
+    switch (func)
+    {
+    case ZFUNC_LE:
+        pass = _simd_cmple_ps(ref, depth);
+        break;
+    case ZFUNC_LT:
+        pass = _simd_cmplt_ps(ref, depth);
+        break;
+    case ZFUNC_GT:
+        pass = _simd_cmpgt_ps(ref, depth);
+        break;
+    case ZFUNC_GE:
+        pass = _simd_cmpge_ps(ref, depth);
+        break;
+    case ZFUNC_EQ:
+        pass = _simd_cmpeq_ps(ref, depth);
+        break;
+    case ZFUNC_NEVER:
+        return _simd_setzero_ps();
+    case ZFUNC_ALWAYS:
+    default:
+        return _simd_set1_ps(1.0f);
+    }
+    return _simd_and_ps(pass, _simd_set1_ps(1.0f));
+}
+
+// Taps are compared before they are filtered, so linear filtering is 2x2
+// percentage closer filtering.
+INLINE simdscalar SampleLevelCompare(Texture const &tex, Sampler const &smp, SWR_FILTER filter, simdscalari level, simdscalar U, simdscalar V, simdscalar ref)
+{
+    MipGeometry geo;
+    LoadMipGeometry(tex, level, _simd_setzero_si(), geo);
+
+    if (filter == SWR_FILTER_LINEAR)
+    {
+        LinearFootprint fp;
+        ComputeFootprint(smp, geo, U, V, fp);
+
+        WideColor c00, c10, c01, c11;
+        FetchTap<R32_FLOAT>(tex, smp, geo, fp.X0, fp.Y0, fp.border00, c00);
+        FetchTap<R32_FLOAT>(tex, smp, geo, fp.X1, fp.Y0, fp.border10, c10);
+        FetchTap<R32_FLOAT>(tex, smp, geo, fp.X0, fp.Y1, fp.border01, c01);
+        FetchTap<R32_FLOAT>(tex, smp, geo, fp.X1, fp.Y1, fp.border11, c11);
+
+        simdscalar p00 = CompareDepth(smp.mCompareFunc, ref, c00.R);
+        simdscalar p10 = CompareDepth(smp.mCompareFunc, ref, c10.R);
+        simdscalar p01 = CompareDepth(smp.mCompareFunc, ref, c01.R);
+        simdscalar p11 = CompareDepth(smp.mCompareFunc, ref, c11.R);
+
+        simdscalar top = _simd_add_ps(p00, _simd_mul_ps(fp.alpha, _simd_sub_ps(p10, p00)));
+        simdscalar bottom = _simd_add_ps(p01, _simd_mul_ps(fp.alpha, _simd_sub_ps(p11, p01)));
+        return _simd_add_ps(top, _simd_mul_ps(fp.beta, _simd_sub_ps(bottom, top)));
+    }
+
+    WideColor texel;
+    SampleLevelPoint<R32_FLOAT>(tex, smp, geo, U, V, texel);
+    return CompareDepth(smp.mCompareFunc, ref, texel.R);
+}
+
+// Filtered compare of texcoord R, clamped to [0, 1], against the depth
+// texture, with the same level selection as SampleQuadRGBA.
+INLINE simdscalar SampleQuadCompare(TextureView const &txView, Sampler const &smp, TexCoord const &tc)
+{
+    Texture const &tex = *txView.mpTexture;
+    simdscalar zero = _simd_setzero_ps();
+    simdscalar ref = _simd_min_ps(_simd_max_ps(tc.W, zero), _simd_set1_ps(1.0f));
+    simdscalari level0 = _simd_setzero_si();
+
+    simdscalar lod = QuadLod(tex, tc);
+    simdscalar vMag = _simd_cmple_ps(lod, zero);
+    UINT magMask = _simd_movemask_ps(vMag);
+    simdscalar result = zero;
+
+    if (magMask != (1 << KNOB_VS_SIMD_WIDTH) - 1)
+    {
+        simdscalar maxLod = _simd_set1_ps((float)(tex.mNumMipLevels - 1));
+        lod = _simd_min_ps(_simd_max_ps(lod, zero), maxLod);
+
+        switch (smp.mMipFilter)
+        {
+        case SWR_MIPFILTER_POINT:
+            result = SampleLevelCompare(tex, smp, smp.mMinFilter, _simd_cvtps_epi32(lod), tc.U, tc.V, ref);
+            break;
+        case SWR_MIPFILTER_LINEAR:
+        {
+            simdscalar lodFloor = _simd_round_ps(lod, _MM_FROUND_TO_NEG_INF);
+            simdscalar lodCeil = _simd_min_ps(_simd_add_ps(lodFloor, _simd_set1_ps(1.0f)), maxLod);
+            simdscalar lo = SampleLevelCompare(tex, smp, smp.mMinFilter, _simd_cvtps_epi32(lodFloor), tc.U, tc.V, ref);
+            simdscalar hi = SampleLevelCompare(tex, smp, smp.mMinFilter, _simd_cvtps_epi32(lodCeil), tc.U, tc.V, ref);
+            result = _simd_add_ps(lo, _simd_mul_ps(_simd_sub_ps(lod, lodFloor), _simd_sub_ps(hi, lo)));
+        }
+        break;
+        default:
+            result = SampleLevelCompare(tex, smp, smp.mMinFilter, level0, tc.U, tc.V, ref);
+            break;
+        }
+    }
+
+    if (magMask)
+    {
+        simdscalar magResult = SampleLevelCompare(tex, smp, smp.mMagFilter, level0, tc.U, tc.V, ref);
+        result = _simd_blendv_ps(result, magResult, vMag);
+    }
+
+    return result;
+}
+
+// Depth textures return the depth, or with compare enabled the filtered
+// compare result, in the channels of the sampler's depth mode.
+INLINE void SampleQuadDepth(TextureView const &txView, Sampler const &smp, TexCoord const &tc, WideColor &color)
+{
+    simdscalar d;
+    if (smp.mCompareEnable)
+    {
+        d = SampleQuadCompare(txView, smp, tc);
+    }
+    else
+    {
+        SampleQuadRGBA<R32_FLOAT>(txView, smp, tc, color);
+        d = color.R;
+    }
+
+    switch (smp.mDepthMode)
+    {
+    case SWR_DEPTH_INTENSITY:
+        color.R = color.G = color.B = color.A = d;
+        break;
+    case SWR_DEPTH_ALPHA:
+        color.R = color.G = color.B = _simd_setzero_ps();
+        color.A = d;
+        break;
+    case SWR_DEPTH_LUMINANCE:
+    default:
+        color.R = color.G = color.B = d;
+        color.A = _simd_set1_ps(1.0f);
+        break;
     }
 }
 
 #if 0
 
-template <bool UseFloat, bool Brolinear, SWR_ADDRESSING_MODE AddrModeU, SWR_ADDRESSING_MODE AddrModeV>
+template <SWR_FORMAT Format, bool Brolinear, SWR_ADDRESSING_MODE AddrModeU, SWR_ADDRESSING_MODE AddrModeV>
 void SampleSimplePointQuadRGBA(TextureView const& txView, Sampler const& smp, TexCoord const& tc, WideColor& color)
 {
 	// We assume that U,V are related as a quad.
@@ -352,14 +1149,14 @@ void SampleSimplePointQuadRGBA(TextureView const& txView, Sampler const& smp, Te
 	OSALIGN(UINT, 16) mips[4];
 	_mm_store_si128((__m128i*)&mips[0], flg2);
 	WideColor lowClr;
-	SampleSimplePointRGBA<UseFloat, Brolinear, AddrModeU, AddrModeV>(txView, smp, tc, mips, lowClr);
+	SampleSimplePointRGBA<Format, Brolinear, AddrModeU, AddrModeV>(txView, smp, tc, mips, lowClr);
 
 	// Use txView.mMipMax to clamp upper bound.
 	flg2		= _mm_add_epi32(flg2, _mm_set1_epi32(1));
 	flg2		= _mm_min_epi32(flg2, _mm_set1_epi32(txView.mpTexture->mNumMipLevels));
 	_mm_store_si128((__m128i*)&mips[0], flg2);
 	WideColor highClr;
-	SampleSimplePointRGBA<UseFloat, Brolinear, AddrModeU, AddrModeV>(txView, smp, tc, mips, highClr);
+	SampleSimplePointRGBA<Format, Brolinear, AddrModeU, AddrModeV>(txView, smp, tc, mips, highClr);
 
 	color.A	= _mm_add_ps(_mm_mul_ps(low, lowClr.A), _mm_mul_ps(high, highClr.A));
 	color.R	= _mm_add_ps(_mm_mul_ps(low, lowClr.R), _mm_mul_ps(high, highClr.R));
@@ -369,34 +1166,141 @@ void SampleSimplePointQuadRGBA(TextureView const& txView, Sampler const& smp, Te
 
 void SampleSimplePointQuadRGBAU8(TextureView const& txView, Sampler const& smp, TexCoord const& tc, WideColor& color)
 {
-	SampleSimplePointQuadRGBA<false, false, SWR_AM_WRAP, SWR_AM_WRAP>(txView, smp, tc, color);
+	SampleSimplePointQuadRGBA<RGBA8_UNORM, false, SWR_AM_WRAP, SWR_AM_WRAP>(txView, smp, tc, color);
 }
 
-void SampleSimplePointRGBAU8(TextureView const& txView, Sampler const& smp, TexCoord const& tc, UINT (&mips)[4], WideColor& color)
+void SampleSimplePointQuadRGBAF32(TextureView const& txView, Sampler const& smp, TexCoord const& tc, WideColor& color)
 {
-	SampleSimplePointRGBA<false, false, SWR_AM_WRAP, SWR_AM_WRAP>(txView, smp, tc, mips, color);
+	SampleSimplePointQuadRGBA<RGBA32_FLOAT, false, SWR_AM_WRAP, SWR_AM_WRAP>(txView, smp, tc, color);
 }
+#endif
 
-void SampleSimplePointQuadRGBAF32(TextureView const& txView, Sampler const& smp, TexCoord const& tc, WideColor& color)
+void SampleSimplePointRGBAU8(TextureView const &txView, Sampler const &smp, TexCoord const &tc, UINT (&mips)[4], WideColor &color)
 {
-	SampleSimplePointQuadRGBA<true, false, SWR_AM_WRAP, SWR_AM_WRAP>(txView, smp, tc, color);
+    SampleSimplePointRGBA<RGBA8_UNORM, false, SWR_AM_WRAP, SWR_AM_WRAP>(txView, smp, tc, mips, color);
 }
-#endif
 
 void SampleSimplePointRGBAF32(TextureView const &txView, Sampler const &smp, TexCoord const &tc, UINT (&mips)[4], WideColor &color)
 {
-    SampleSimplePointRGBA<true, false, SWR_AM_WRAP, SWR_AM_WRAP>(txView, smp, tc, mips, color);
+    SampleSimplePointRGBA<RGBA32_FLOAT, false, SWR_AM_WRAP, SWR_AM_WRAP>(txView, smp, tc, mips, color);
+}
+
+void SampleSimplePoint(TextureView const &txView, Sampler const &smp, TexCoord const &tc, UINT (&mips)[4], WideColor &color)
+{
+    switch (txView.mFormat)
+    {
+    case RGBA32_FLOAT:
+        SampleSimplePointRGBA<RGBA32_FLOAT, false, SWR_AM_WRAP, SWR_AM_WRAP>(txView, smp, tc, mips, color);
+        break;
+    case RGBA8_UNORM:
+        SampleSimplePointRGBA<RGBA8_UNORM, false, SWR_AM_WRAP, SWR_AM_WRAP>(txView, smp, tc, mips, color);
+        break;
+    case BGRA8_UNORM:
+        SampleSimplePointRGBA<BGRA8_UNORM, false, SWR_AM_WRAP, SWR_AM_WRAP>(txView, smp, tc, mips, color);
+        break;
+    case A8_UNORM:
+        SampleSimplePointRGBA<A8_UNORM, false, SWR_AM_WRAP, SWR_AM_WRAP>(txView, smp, tc, mips, color);
+        break;
+    case L8_UNORM:
+        SampleSimplePointRGBA<L8_UNORM, false, SWR_AM_WRAP, SWR_AM_WRAP>(txView, smp, tc, mips, color);
+        break;
+    case LA8_UNORM:
+        SampleSimplePointRGBA<LA8_UNORM, false, SWR_AM_WRAP, SWR_AM_WRAP>(txView, smp, tc, mips, color);
+        break;
+    case B5G6R5_UNORM:
+        SampleSimplePointRGBA<B5G6R5_UNORM, false, SWR_AM_WRAP, SWR_AM_WRAP>(txView, smp, tc, mips, color);
+        break;
+    case DXT1_UNORM:
+        SampleSimplePointRGBA<DXT1_UNORM, false, SWR_AM_WRAP, SWR_AM_WRAP>(txView, smp, tc, mips, color);
+        break;
+    case DXT1A_UNORM:
+        SampleSimplePointRGBA<DXT1A_UNORM, false, SWR_AM_WRAP, SWR_AM_WRAP>(txView, smp, tc, mips, color);
+        break;
+    case DXT3_UNORM:
+        SampleSimplePointRGBA<DXT3_UNORM, false, SWR_AM_WRAP, SWR_AM_WRAP>(txView, smp, tc, mips, color);
+        break;
+    case DXT5_UNORM:
+        SampleSimplePointRGBA<DXT5_UNORM, false, SWR_AM_WRAP, SWR_AM_WRAP>(txView, smp, tc, mips, color);
+        break;
+    default:
+        SampleDefaultColor(txView, smp, tc, color);
+        break;
+    }
+}
+
+void SampleQuad(TextureView const &txView, Sampler const &smp, TexCoord const &tc, WideColor &color)
+{
+    switch (txView.mFormat)
+    {
+    case RGBA32_FLOAT:
+        SampleQuadRGBA<RGBA32_FLOAT>(txView, smp, tc, color);
+        break;
+    case RGBA8_UNORM:
+        SampleQuadRGBA<RGBA8_UNORM>(txView, smp, tc, color);
+        break;
+    case BGRA8_UNORM:
+        SampleQuadRGBA<BGRA8_UNORM>(txView, smp, tc, color);
+        break;
+    case A8_UNORM:
+        SampleQuadRGBA<A8_UNORM>(txView, smp, tc, color);
+        break;
+    case L8_UNORM:
+        SampleQuadRGBA<L8_UNORM>(txView, smp, tc, color);
+        break;
+    case LA8_UNORM:
+        SampleQuadRGBA<LA8_UNORM>(txView, smp, tc, color);
+        break;
+    case B5G6R5_UNORM:
+        SampleQuadRGBA<B5G6R5_UNORM>(txView, smp, tc, color);
+        break;
+    case DXT1_UNORM:
+        SampleQuadRGBA<DXT1_UNORM>(txView, smp, tc, color);
+        break;
+    case DXT1A_UNORM:
+        SampleQuadRGBA<DXT1A_UNORM>(txView, smp, tc, color);
+        break;
+    case DXT3_UNORM:
+        SampleQuadRGBA<DXT3_UNORM>(txView, smp, tc, color);
+        break;
+    case DXT5_UNORM:
+        SampleQuadRGBA<DXT5_UNORM>(txView, smp, tc, color);
+        break;
+    case R32_FLOAT:
+        // Only depth textures are stored as R32_FLOAT.
+        SampleQuadDepth(txView, smp, tc, color);
+        break;
+    default:
+        SampleDefaultColor(txView, smp, tc, color);
+        break;
+    }
+}
+
+void SampleQuadProj(TextureView const &txView, Sampler const &smp, TexCoord const &tc, simdscalar q, WideColor &color)
+{
+    if (!smp.mCompareEnable)
+    {
+        SampleQuad(txView, smp, tc, color);
+        return;
+    }
+
+    // The compare reference is r / q, and s / q, t / q pick the texels.
+    simdscalar rcpQ = _simd_div_ps(_simd_set1_ps(1.0f), q);
+    TexCoord projTc;
+    projTc.U = _simd_mul_ps(tc.U, rcpQ);
+    projTc.V = _simd_mul_ps(tc.V, rcpQ);
+    projTc.W = _simd_mul_ps(tc.W, rcpQ);
+    SampleQuad(txView, smp, projTc, color);
 }
 
 #if 0
 void SampleSimpleLinearQuadRGBAF32(TextureView const& txView, Sampler const& smp, TexCoord const& tc, WideColor& color)
 {
-	SampleSimplePointQuadRGBA<true, true, SWR_AM_WRAP, SWR_AM_WRAP>(txView, smp, tc, color);
+	SampleSimplePointQuadRGBA<RGBA32_FLOAT, true, SWR_AM_WRAP, SWR_AM_WRAP>(txView, smp, tc, color);
 }
 
 void SampleSimpleLinearRGBAF32(TextureView const& txView, Sampler const& smp, TexCoord const& tc, UINT (&mips)[4], WideColor& color)
 {
-	SampleSimplePointRGBA<true, true, SWR_AM_WRAP, SWR_AM_WRAP>(txView, smp, tc, mips, color);
+	SampleSimplePointRGBA<RGBA32_FLOAT, true, SWR_AM_WRAP, SWR_AM_WRAP>(txView, smp, tc, mips, color);
 }
 
 #endif
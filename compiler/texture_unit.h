@@ -44,12 +44,28 @@ struct Sampler
         mArraySpec = smp.arraySpec;
         mTilingFormat = smp.tilingFormat;
         memcpy(&mDefaultColor[0], &smp.defaultColor[0], sizeof(float) * 4);
+        mMinFilter = smp.minFilter;
+        mMagFilter = smp.magFilter;
+        mMipFilter = smp.mipFilter;
+        mAddressU = smp.addressU;
+        mAddressV = smp.addressV;
+        mCompareEnable = smp.compareEnable;
+        mCompareFunc = smp.compareFunc;
+        mDepthMode = smp.depthMode;
     }
 
     SWR_ADDRESSING_MODE mArrayMode;
     SWR_ARRAY_SPEC mArraySpec;
     SWR_TILING_FORMAT mTilingFormat;
     float mDefaultColor[4];
+    SWR_FILTER mMinFilter;
+    SWR_FILTER mMagFilter;
+    SWR_MIP_FILTER mMipFilter;
+    SWR_ADDRESSING_MODE mAddressU;
+    SWR_ADDRESSING_MODE mAddressV;
+    bool mCompareEnable;
+    SWR_ZFUNCTION mCompareFunc;
+    SWR_DEPTH_MODE mDepthMode;
 };
 
 void SampleDefaultColor(TextureView const &txView, Sampler const &smp, TexCoord const &tc, WideColor &color);
@@ -57,6 +73,11 @@ void SampleSimplePointQuadRGBAU8(TextureView const &txView, Sampler const &smp,
 void SampleSimplePointRGBAU8(TextureView const &txView, Sampler const &smp, TexCoord const &tc, UINT (&mips)[4], WideColor &color);
 void SampleSimplePointQuadRGBAF32(TextureView const &txView, Sampler const &smp, TexCoord const &tc, WideColor &color);
 void SampleSimplePointRGBAF32(TextureView const &txView, Sampler const &smp, TexCoord const &tc, UINT (&mips)[4], WideColor &color);
+void SampleSimplePoint(TextureView const &txView, Sampler const &smp, TexCoord const &tc, UINT (&mips)[4], WideColor &color);
+void SampleQuad(TextureView const &txView, Sampler const &smp, TexCoord const &tc, WideColor &color);
+// SampleQuad of the projected coords (s, t, r) / q for samplers that compare
+// depth; other samplers ignore q.
+void SampleQuadProj(TextureView const &txView, Sampler const &smp, TexCoord const &tc, simdscalar q, WideColor &color);
 void SampleSimpleLinearQuadRGBAF32(TextureView const &txView, Sampler const &smp, TexCoord const &tc, WideColor &color);
 void SampleSimpleLinearRGBAF32(TextureView const &txView, Sampler const &smp, TexCoord const &tc, UINT (&mips)[4], WideColor &color);
 
@@ -315,6 +315,10 @@ HANDLE SwrCreateContext(DRIVER_TYPE driver)
         pContext->dcRing[dc].pTileMgr = new MacroTileMgr();
     }
 
+    // createThreadPool numbers the nodes its workers run on
+    pContext->numNumaNodes = 1;
+    pContext->numaNodeIds[0] = 0;
+
 #if KNOB_SINGLE_THREADED
     pContext->NumWorkerThreads = 1;
 #else
@@ -333,40 +337,6 @@ HANDLE SwrCreateContext(DRIVER_TYPE driver)
     // State setup AFTER context is fully initialized
     SetupDefaultState(pContext);
 
-    pContext->numNumaNodes = 0;
-
-#if !KNOB_SINGLE_THREADED
-// Query NUMA topology
-#if defined(_WIN32)
-    SYSTEM_LOGICAL_PROCESSOR_INFORMATION procInfo[128];
-    DWORD length = sizeof(procInfo);
-    if (GetLogicalProcessorInformation(procInfo, &length))
-    {
-        UINT i = 0;
-        while (length)
-        {
-            if (procInfo[i].Relationship == RelationNumaNode)
-            {
-                pContext->numNumaNodes++;
-            }
-            length -= sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION);
-            i++;
-        }
-    }
-#else
-    pContext->numNumaNodes = numa_max_node() + 1;
-#endif
-#endif
-
-#if !KNOB_ENABLE_NUMA
-    pContext->numNumaNodes = 1;
-#endif
-
-    if (pContext->numNumaNodes == 0)
-    {
-        pContext->numNumaNodes = 1;
-    }
-
     return (HANDLE)pContext;
 }
 
@@ -429,7 +399,7 @@ void QueueDraw(SWR_CONTEXT *pContext)
 
 #if KNOB_SINGLE_THREADED
     WorkOnFifoFE(pContext, 0, pContext->WorkerFE[0], 0);
-    WorkOnFifoBE(pContext, 0, pContext->WorkerFE[0], pContext->WorkerBE[0], std::set<UINT>());
+    WorkOnFifoBE(pContext, 0, pContext->WorkerFE[0], pContext->WorkerBE[0], std::set<UINT>(), 0);
 #else
     RDTSC_START(APIDrawWakeAllThreads);
     WakeAllThreads(pContext);
@@ -627,6 +597,84 @@ void SwrSetLinkageMaskBackFace(
     }
 }
 
+HANDLE SwrCreateVertexCache(
+    HANDLE hContext,
+    UINT firstVertex,
+    UINT numVertices)
+{
+    VERTEX_CACHE *pCache = (VERTEX_CACHE *)_aligned_malloc(sizeof(VERTEX_CACHE), 64);
+    memset(pCache, 0, sizeof(VERTEX_CACHE));
+    pCache->firstVertex = firstVertex;
+    pCache->numVertices = numVertices;
+
+    return (HANDLE)pCache;
+}
+
+void SwrDestroyVertexCache(
+    HANDLE hContext,
+    HANDLE hVertexCache)
+{
+    SWR_CONTEXT *pContext = GetContext(hContext);
+    VERTEX_CACHE *pCache = (VERTEX_CACHE *)hVertexCache;
+
+    // The FE of an in flight draw may still be building or reading a slot.
+    WaitForDependencies(pContext, pCache->lastDrawId);
+
+    for (UINT i = 0; i < pCache->numSlots; ++i)
+    {
+        free(pCache->slots[i].pKey);
+        _aligned_free(pCache->slots[i].pOutputs);
+    }
+    _aligned_free(pCache);
+}
+
+void SwrSetVertexCache(
+    HANDLE hContext,
+    HANDLE hVertexCache,
+    const void *pKey,
+    UINT keySize)
+{
+    API_STATE *pState = GetDrawState(GetContext(hContext));
+    VERTEX_CACHE *pCache = (VERTEX_CACHE *)hVertexCache;
+
+    pState->pVertexCache = NULL;
+    pState->vertexCacheSlot = -1;
+
+    if (pCache == NULL || pCache->numVertices == 0)
+    {
+        return;
+    }
+
+    // Keys are only assigned here on the api thread, so the FE never sees a
+    // slot change key. Once all slots are taken other keys go uncached.
+    UINT slot = 0;
+    while (slot < pCache->numSlots &&
+           (pCache->slots[slot].keySize != keySize || memcmp(pCache->slots[slot].pKey, pKey, keySize) != 0))
+    {
+        ++slot;
+    }
+
+    if (slot == pCache->numSlots)
+    {
+        if (slot == KNOB_NUM_VERTEX_CACHE_SLOTS)
+        {
+            return;
+        }
+
+        UINT numSimds = (pCache->numVertices + KNOB_VS_SIMD_WIDTH - 1) / KNOB_VS_SIMD_WIDTH;
+        VERTEX_CACHE::SLOT &newSlot = pCache->slots[slot];
+        newSlot.pKey = malloc(keySize);
+        memcpy(newSlot.pKey, pKey, keySize);
+        newSlot.keySize = keySize;
+        newSlot.status = VERTEX_CACHE::SLOT_EMPTY;
+        newSlot.pOutputs = (VERTEXOUTPUT *)_aligned_malloc(numSimds * sizeof(VERTEXOUTPUT), 64);
+        pCache->numSlots++;
+    }
+
+    pState->pVertexCache = pCache;
+    pState->vertexCacheSlot = slot;
+}
+
 void SwrGetRastState(
     HANDLE hContext,
     RASTSTATE *pRastState)
@@ -670,14 +718,38 @@ void SwrSetScissorRect(
     pState->scissorRect.bottom = bottom;
 };
 
+void SwrSetRenderMode(
+    HANDLE hContext,
+    SWR_RENDER_MODE mode,
+    SWR_SELECT_HIT *pSelectHit,
+    SWR_FEEDBACK_BUFFER *pFeedback)
+{
+    API_STATE *pState = GetDrawState(GetContext(hContext));
+    pState->renderMode = mode;
+    pState->pSelectHit = pSelectHit;
+    pState->pFeedback = pFeedback;
+}
+
+void SwrWaitForIdle(
+    HANDLE hContext)
+{
+    SWR_CONTEXT *pContext = GetContext(hContext);
+
+    // The current draw context may not be queued yet, so wait on the last one that was.
+    if (pContext->pPrevDrawContext)
+    {
+        WaitForDependencies(pContext, pContext->pPrevDrawContext->drawId);
+    }
+}
+
 void AddDependencies(DRAW_CONTEXT *pDC)
 {
     API_STATE *pState = &pDC->state;
 
-    // render target write
+    // render target write, none in select and feedback modes since nothing is binned
     for (UINT a = 0; a < SWR_NUM_ATTACHMENTS; ++a)
     {
-        if (pState->pRenderTargets[a])
+        if (pState->pRenderTargets[a] && pState->renderMode == SWR_RENDER_MODE_RENDER)
             pState->pRenderTargets[a]->AddWriteDependency(&pDC->dependency, pDC->drawId);
     }
 
@@ -702,8 +774,7 @@ void AddDependencies(DRAW_CONTEXT *pDC)
     if (pState->pPSConstantBuffer)
         pState->pPSConstantBuffer->AddReadDependency(&pDC->dependency, pDC->drawId);
 
-    // add texture dependencies
-    // @todo only handles mip 0.  we really need to pack mips into a single allocation
+    // add texture dependencies, the storage covers every plane and mip level
     for (UINT i = 0; i < NUM_GRAPHICS_SHADER_TYPES; ++i)
     {
         for (UINT j = 0; j < API_STATE::NUM_TEXTURE_VIEWS; ++j)
@@ -712,7 +783,7 @@ void AddDependencies(DRAW_CONTEXT *pDC)
             {
                 SWR_TEXTUREVIEW *pTextureView = (SWR_TEXTUREVIEW *)pState->aTextureViews[i][j];
                 Texture *pTexture = (Texture *)pTextureView->hTexture;
-                Resource *pTextureRes = (Resource *)pTexture->mhSubtextures[0];
+                Resource *pTextureRes = (Resource *)pTexture->mhStorage;
                 pTextureRes->AddReadDependency(&pDC->dependency, pDC->drawId);
             }
         }
@@ -844,6 +915,11 @@ void InitDraw(
 
     pDC->inUse = true; // We are using this one now.
 
+    if (pState->pVertexCache)
+    {
+        pState->pVertexCache->lastDrawId = pDC->drawId;
+    }
+
     // XXX: This is temporary code. Will be deleted.
     UINT linkageMask = pDC->state.linkageMaskBackFace | pDC->state.linkageMaskFrontFace;
     pState->linkageTotalCount = 0;
@@ -855,6 +931,20 @@ void InitDraw(
     }
 }
 
+// Feedback records are appended by the FE, and FE work of different draws
+// runs unordered, so each feedback draw finishes its FE before the next is queued.
+void WaitForFeedback(SWR_CONTEXT *pContext, DRAW_CONTEXT *pDC)
+{
+    if (pDC->state.renderMode == SWR_RENDER_MODE_FEEDBACK)
+    {
+        while (pDC->doneFE == false)
+        {
+            _mm_pause();
+            WakeAllThreads(pContext);
+        }
+    }
+}
+
 void SwrDraw(
     HANDLE hContext,
     PRIMITIVE_TOPOLOGY topology,
@@ -892,11 +982,12 @@ void SwrDraw(
 
         //enqueue DC
         QueueDraw(pContext);
+        WaitForFeedback(pContext, pDC);
 
         remainingVerts -= numVertsForDraw;
         draw++;
     }
-    RDTSC_STOP(APIDraw, (primCount * 3), 0);
+    RDTSC_STOP(APIDraw, (primCount * 3), pContext->nextDrawId - 1);
 }
 
 template <bool UseInstance>
@@ -925,6 +1016,9 @@ void DrawIndexedInstance(
     case SWR_TYPE_UINT16:
         indexSize = sizeof(short);
         break;
+    case SWR_TYPE_UINT8:
+        indexSize = sizeof(BYTE);
+        break;
     default:
         assert(0);
     }
@@ -955,12 +1049,13 @@ void DrawIndexedInstance(
 
         //enqueue DC
         QueueDraw(pContext);
+        WaitForFeedback(pContext, pDC);
 
         pIB += maxIndicesPerDraw * indexSize;
         remainingIndices -= numIndicesForDraw;
         draw++;
     }
-    RDTSC_STOP(APIDrawIndexed, numIndices, 0);
+    RDTSC_STOP(APIDrawIndexed, numIndices, pContext->nextDrawId - 1);
 }
 
 void SwrDrawIndexedUP(
@@ -1108,7 +1203,7 @@ void SwrPresent(HANDLE hContext)
 
 #endif
 
-    RDTSC_ENDFRAME();
+    RDTSC_ENDFRAME(hContext);
 }
 #else
 void SwrPresent(HANDLE hContext)
@@ -1164,7 +1259,7 @@ void SwrPresent2(HANDLE hContext, void *pData, UINT pitch)
 
     RDTSC_STOP(APIPresent, 0, pDC->drawId);
 
-    RDTSC_ENDFRAME();
+    RDTSC_ENDFRAME(hContext);
 }
 
 void SwrSetRenderTargets(
@@ -1362,6 +1457,13 @@ void *SwrLockResource(HANDLE hContext, HANDLE hResource, SWR_LOCK_FLAGS flags)
         return pAlloc->pData;
     }
 
+    if (flags & LOCK_RENAME)
+    {
+        UpdateLastRetiredId((SWR_CONTEXT *)hContext);
+        Allocation *pAlloc = buf->GetRenamedAllocation();
+        return pAlloc->pData;
+    }
+
     if (flags & LOCK_DISCARD)
     {
         if (buf->InUse())
@@ -1413,21 +1515,24 @@ void SwrCopyRenderTarget(HANDLE hContext, SWR_RENDERTARGET_ATTACHMENT rt, HANDLE
     UINT pitch;
     void *pData;
     SWR_FORMAT format;
+    SWR_TILING_FORMAT tilingFormat = TF_Linear;
 
     // either copying to a bound texture resource or to memory
     if (hTexture)
     {
-        // assume mip 0?
-        Resource *pDstResource = (Resource *)pDst->mhSubtextures[0];
+        // assume mip 0, which starts the storage
+        Resource *pDstResource = (Resource *)pDst->mhStorage;
 
-        // Add texture write dependency
+        // Add texture write dependency, after earlier writes too
+        pDC->dependency = std::max<DRAW_T>(pDC->dependency, pDstResource->GetCurrentAllocation()->writeDep);
         pDstResource->AddWriteDependency(&pDC->dependency, pDC->drawId);
 
         pitch = pDst->mPhysicalWidth[0] * pDst->mElementSizeInBytes;
         pData = pDstResource->GetCurrentAllocation()->pData;
 
-        // textures are always RGBA float
-        format = RGBA32_FLOAT;
+        // dstFormat is the texture's storage format
+        format = dstFormat;
+        tilingFormat = pDst->mTilingFormat;
     }
     else
     {
@@ -1452,6 +1557,7 @@ void SwrCopyRenderTarget(HANDLE hContext, SWR_RENDERTARGET_ATTACHMENT rt, HANDLE
     pDC->FeWork.desc.copy.width = width;
     pDC->FeWork.desc.copy.height = height;
     pDC->FeWork.desc.copy.dstFormat = format;
+    pDC->FeWork.desc.copy.tilingFormat = tilingFormat;
 
     //enqueue
     QueueDraw(pContext);
@@ -1462,3 +1568,113 @@ void SwrCopyRenderTarget(HANDLE hContext, SWR_RENDERTARGET_ATTACHMENT rt, HANDLE
         WaitForDependencies(pContext, pDC->drawId);
     }
 }
+
+void CBFreeUploadStaging(void *pDC)
+{
+    _aligned_free(((DRAW_CONTEXT *)pDC)->FeWork.desc.upload.pSrc);
+}
+
+void SwrUpdateSubtexture(HANDLE hContext, HANDLE hTexture, UINT subtextureIndex, SWR_FORMAT srcFormat, SWR_FORMAT dstFormat,
+                         void const *pSrc, UINT srcPitch, UINT x, UINT y, UINT width, UINT height)
+{
+    if ((width == 0) || (height == 0))
+    {
+        return;
+    }
+
+    SWR_CONTEXT *pContext = (SWR_CONTEXT *)hContext;
+    Texture *pTex = (Texture *)hTexture;
+    DRAW_CONTEXT *pDC = GetDrawContext(pContext);
+
+    pDC->inUse = true;
+
+    // Block compressed uploads copy whole blocks; the rect and the source
+    // pitch are in blocks from here on.
+    if (pTex->mBlockDim > 1)
+    {
+        assert(srcFormat == dstFormat);
+        x /= pTex->mBlockDim;
+        y /= pTex->mBlockDim;
+        width = pTex->BlockCount(width);
+        height = pTex->BlockCount(height);
+    }
+
+    // Stage the texels so the caller can reuse its memory right away. The pad
+    // covers ConvertPixel's 16 byte reads past the last texel.
+    UINT rowSize = width * GetFormatInfo(srcFormat).Bpp;
+    BYTE *pStaging = (BYTE *)_aligned_malloc(rowSize * height + 16, 16);
+    for (UINT row = 0; row < height; ++row)
+    {
+        memcpy(pStaging + row * rowSize, (const BYTE *)pSrc + row * srcPitch, rowSize);
+    }
+
+    // Orders the upload after earlier writes and draws still reading the
+    // texture, and draws that sample it afterwards after the upload.
+    Resource *pStorage = (Resource *)pTex->mhStorage;
+    pDC->dependency = std::max<DRAW_T>(pDC->dependency, pStorage->GetCurrentAllocation()->writeDep);
+    pStorage->AddWriteDependency(&pDC->dependency, pDC->drawId);
+
+    UINT mipLevel = subtextureIndex % pTex->mNumMipLevels;
+
+    pDC->FeWork.type = UPLOAD;
+    pDC->FeWork.pfnWork = ProcessUpload;
+    pDC->FeWork.desc.upload.pSrc = pStaging;
+    pDC->FeWork.desc.upload.srcPitch = rowSize;
+    pDC->FeWork.desc.upload.srcFormat = srcFormat;
+    pDC->FeWork.desc.upload.pDst = pTex->mSubtextures[subtextureIndex];
+    pDC->FeWork.desc.upload.dstPhysWidth = pTex->mPhysicalWidth[mipLevel];
+    pDC->FeWork.desc.upload.dstFormat = dstFormat;
+    pDC->FeWork.desc.upload.tilingFormat = pTex->mTilingFormat;
+    pDC->FeWork.desc.upload.x = x;
+    pDC->FeWork.desc.upload.y = y;
+    pDC->FeWork.desc.upload.width = width;
+    pDC->FeWork.desc.upload.height = height;
+
+    pDC->pfnCallbackFunc = CBFreeUploadStaging;
+
+    //enqueue
+    QueueDraw(pContext);
+}
+
+// One draw per level, each reading the level above it; the texture's write
+// dependency orders a level after the draw that wrote its source.
+void SwrGenerateMips(HANDLE hContext, HANDLE hTexture, UINT plane, SWR_FORMAT format)
+{
+    SWR_CONTEXT *pContext = (SWR_CONTEXT *)hContext;
+    Texture *pTex = (Texture *)hTexture;
+    Resource *pStorage = (Resource *)pTex->mhStorage;
+
+    // XXX: compressed levels would have to be re-encoded.
+    if (pTex->mBlockDim > 1)
+    {
+        return;
+    }
+
+    for (UINT level = 1; level < pTex->mNumMipLevels; ++level)
+    {
+        DRAW_CONTEXT *pDC = GetDrawContext(pContext);
+
+        pDC->inUse = true;
+
+        pDC->dependency = std::max<DRAW_T>(pDC->dependency, pStorage->GetCurrentAllocation()->writeDep);
+        pStorage->AddWriteDependency(&pDC->dependency, pDC->drawId);
+
+        UINT srcIndex = plane * pTex->mNumMipLevels + level - 1;
+
+        pDC->FeWork.type = MIPGEN;
+        pDC->FeWork.pfnWork = ProcessMipGen;
+        pDC->FeWork.desc.mipGen.pSrc = pTex->mSubtextures[srcIndex];
+        pDC->FeWork.desc.mipGen.pDst = pTex->mSubtextures[srcIndex + 1];
+        pDC->FeWork.desc.mipGen.srcPhysWidth = pTex->mPhysicalWidth[level - 1];
+        pDC->FeWork.desc.mipGen.dstPhysWidth = pTex->mPhysicalWidth[level];
+        pDC->FeWork.desc.mipGen.srcWidth = pTex->mTexelWidth[level - 1];
+        pDC->FeWork.desc.mipGen.srcHeight = pTex->mTexelHeight[level - 1];
+        pDC->FeWork.desc.mipGen.dstWidth = pTex->mTexelWidth[level];
+        pDC->FeWork.desc.mipGen.dstHeight = pTex->mTexelHeight[level];
+        pDC->FeWork.desc.mipGen.format = format;
+        pDC->FeWork.desc.mipGen.tilingFormat = pTex->mTilingFormat;
+
+        //enqueue
+        QueueDraw(pContext);
+    }
+}
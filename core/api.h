@@ -49,6 +49,7 @@ enum SWR_LOCK_FLAGS
     LOCK_NOOVERWRITE = 1 << 1,
     LOCK_DISCARD = 1 << 2,
     LOCK_DONTLOCK = 1 << 3,
+    LOCK_RENAME = 1 << 4, // copy-on-write into a free alias instead of waiting
 };
 
 enum SWR_SHADER_TYPE
@@ -81,6 +82,27 @@ enum SWR_ADDRESSING_MODE
     SWR_AM_MIRROR,  // u % 2.0f
 };
 
+enum SWR_FILTER
+{
+    SWR_FILTER_POINT,
+    SWR_FILTER_LINEAR,
+};
+
+enum SWR_MIP_FILTER
+{
+    SWR_MIPFILTER_NONE,   // always sample level 0
+    SWR_MIPFILTER_POINT,  // nearest level
+    SWR_MIPFILTER_LINEAR, // blend the two nearest levels
+};
+
+// Channels a depth texel, or its compare result, is returned in.
+enum SWR_DEPTH_MODE
+{
+    SWR_DEPTH_LUMINANCE, // (d, d, d, 1)
+    SWR_DEPTH_INTENSITY, // (d, d, d, d)
+    SWR_DEPTH_ALPHA,     // (0, 0, 0, d)
+};
+
 enum SWR_BLEND_MODE
 {
     BLEND_ONE,
@@ -117,7 +139,7 @@ enum SWR_TILING_FORMAT
     TF_Linear,
     TF_Tile,
     TF_Z,
-    TF_TileZ,
+    TF_TileZ, // square pages of at most 4KB, Morton ordered texels within a page
 };
 
 enum SWR_ARRAY_SPEC
@@ -228,6 +250,15 @@ enum SWR_CULLMODE
     NONE
 };
 
+// Select and feedback modes stop the pipeline after clipping in the FE;
+// nothing is binned and render targets are not touched.
+enum SWR_RENDER_MODE
+{
+    SWR_RENDER_MODE_RENDER,
+    SWR_RENDER_MODE_SELECT,
+    SWR_RENDER_MODE_FEEDBACK
+};
+
 /// STRUCTURE arguments
 
 struct TexCoord
@@ -264,6 +295,8 @@ struct SWR_CREATETEXTURE
     UINT planes;              // depth or number of array elements; =0 means "do the right thing for 2D"
     UINT mipLevels;           // 0 means "add all the mip levels necessary"
     SWR_LOCK_FLAGS lockFlags; // create in lock state
+    SWR_TILING_FORMAT tilingFormat;
+    UINT blockDim;            // texels per element along x and y; 4 for block compressed, 0 means 1
 };
 
 struct SWR_GETSUBTEXTUREINFO
@@ -288,6 +321,7 @@ struct SWR_GETSUBTEXTUREINFO
     UINT texelHeight;
     UINT texelPlanes;
     UINT eltSizeInBytes;
+    SWR_TILING_FORMAT tilingFormat;
     void *pData;
 };
 
@@ -305,6 +339,14 @@ struct SWR_CREATESAMPLER
     SWR_ARRAY_SPEC arraySpec;
     SWR_TILING_FORMAT tilingFormat;
     float defaultColor[4];
+    SWR_FILTER minFilter;
+    SWR_FILTER magFilter;
+    SWR_MIP_FILTER mipFilter;
+    SWR_ADDRESSING_MODE addressU;
+    SWR_ADDRESSING_MODE addressV;
+    bool compareEnable;        // depth textures return compareFunc(ref, texel), filtered
+    SWR_ZFUNCTION compareFunc;
+    SWR_DEPTH_MODE depthMode;
 };
 
 struct SWR_SAMPLERINFO
@@ -340,6 +382,33 @@ struct RASTSTATE
     BOOL scissorEnable;
 };
 
+// Hit record filled by draws in select mode. Depths are window z scaled
+// to [0, 2^32 - 1]; minZ must start at 0xffffffff and maxZ at 0.
+struct SWR_SELECT_HIT
+{
+    volatile UINT hit;
+    volatile UINT minZ;
+    volatile UINT maxZ;
+};
+
+// Feedback output of draws in feedback mode. count keeps advancing past
+// size so the caller can detect overflow. Tokens are supplied by the API.
+struct SWR_FEEDBACK_BUFFER
+{
+    FLOAT *pData;
+    UINT size;
+    UINT count;
+
+    FLOAT pointToken;
+    FLOAT lineToken;
+    FLOAT lineResetToken;
+    FLOAT polygonToken;
+
+    UINT numCoords; // 2: x y, 3: x y z, 4: x y z w
+    BOOL color;     // rgba from COLOR0, or COLOR1 for back faces
+    BOOL texCoord;  // strq from TEXCOORD0
+};
+
 // Input to vertex shader
 struct VERTEXINPUT
 {
@@ -400,6 +469,12 @@ struct Texture
     void Unlock();
     void SubtextureInfo(SWR_GETSUBTEXTUREINFO &info);
 
+    // Elements needed to cover the given number of texels.
+    UINT BlockCount(UINT texels) const
+    {
+        return (texels + mBlockDim - 1) / mBlockDim;
+    }
+
     HANDLE mhContext;
 
     // Geometry.
@@ -410,12 +485,46 @@ struct Texture
     std::vector<UINT> mTexelWidth;
     std::vector<UINT> mPhysicalWidth;
     UINT mElementSizeInBytes;
-
-    // Storage.
-    std::vector<HANDLE> mhSubtextures;
+    UINT mBlockDim; // physical sizes are in elements of mBlockDim x mBlockDim texels
+    SWR_TILING_FORMAT mTilingFormat;
+
+    // Storage. All planes and mip levels are packed into a single
+    // allocation, so one resource tracks dependencies for the whole chain.
+    HANDLE mhStorage;
+    data_t *mpStorage;
+    std::vector<UINT> mSubtextureOffsets;
     std::vector<data_t *> mSubtextures;
 };
 
+// log2 of the TF_TileZ page dimension, the largest square page of at most 4KB.
+INLINE UINT TileZShift(UINT eltSizeInBytes)
+{
+    return (eltSizeInBytes <= 1) ? 6 : ((eltSizeInBytes <= 4) ? 5 : 4);
+}
+
+// Spreads the low 8 bits of v to the even bit positions.
+INLINE UINT MortonSpread(UINT v)
+{
+    v = (v | (v << 4)) & 0x0F0F0F0F;
+    v = (v | (v << 2)) & 0x33333333;
+    v = (v | (v << 1)) & 0x55555555;
+    return v;
+}
+
+// Byte offset of texel (x, y) within a subtexture.
+INLINE UINT TexelOffset(SWR_TILING_FORMAT tiling, UINT physWidth, UINT eltSizeInBytes, UINT x, UINT y)
+{
+    if (tiling != TF_TileZ)
+    {
+        return (y * physWidth + x) * eltSizeInBytes;
+    }
+
+    UINT shift = TileZShift(eltSizeInBytes);
+    UINT mask = (1 << shift) - 1;
+    UINT page = (y >> shift) * (physWidth >> shift) + (x >> shift);
+    return ((page << (2 * shift)) | MortonSpread(x & mask) | (MortonSpread(y & mask) << 1)) * eltSizeInBytes;
+}
+
 struct SWR_TEXCOORD
 {
     simdvector tc;
@@ -578,6 +687,21 @@ void SwrSetLinkageMaskBackFace(
     HANDLE hContext,
     UINT mask);
 
+HANDLE SwrCreateVertexCache(
+    HANDLE hContext,
+    UINT firstVertex,
+    UINT numVertices);
+
+void SwrDestroyVertexCache(
+    HANDLE hContext,
+    HANDLE hVertexCache);
+
+void SwrSetVertexCache(
+    HANDLE hContext,
+    HANDLE hVertexCache,
+    const void *pKey,
+    UINT keySize);
+
 void SwrDraw(
     HANDLE hContext,
     PRIMITIVE_TOPOLOGY topology,
@@ -653,6 +777,15 @@ void SwrSetScissorRect(
     HANDLE hContext,
     UINT left, UINT top, UINT right, UINT bottom);
 
+void SwrSetRenderMode(
+    HANDLE hContext,
+    SWR_RENDER_MODE mode,
+    SWR_SELECT_HIT *pSelectHit,
+    SWR_FEEDBACK_BUFFER *pFeedback);
+
+void SwrWaitForIdle(
+    HANDLE hContext);
+
 HANDLE SwrCreateRenderTarget(
     HANDLE hContext,
     UINT width,
@@ -711,6 +844,34 @@ void SwrGetSubtextureInfo(
     HANDLE hTexture,
     SWR_GETSUBTEXTUREINFO &getSTI);
 
+// Queues an upload of a rect of srcFormat texels into a subtexture stored as
+// dstFormat. The texels are staged before returning. Workers convert and tile
+// them once earlier draws stop reading the texture, and later draws that
+// sample it wait on the upload.
+void SwrUpdateSubtexture(
+    HANDLE hContext,
+    HANDLE hTexture,
+    UINT subtextureIndex,
+    SWR_FORMAT srcFormat,
+    SWR_FORMAT dstFormat,
+    void const *pSrc,
+    UINT srcPitch,
+    UINT x, UINT y,
+    UINT width, UINT height);
+
+// Queues rebuilding levels 1 and up of a plane of the texture from its level
+// 0, stored as format. Block compressed textures are left alone.
+void SwrGenerateMips(
+    HANDLE hContext,
+    HANDLE hTexture,
+    UINT plane,
+    SWR_FORMAT format);
+
+// Returns true while queued draws may still use the texture.
+BOOL SwrTextureInUse(
+    HANDLE hContext,
+    HANDLE hTexture);
+
 HANDLE SwrCreateTextureView(
     HANDLE hContext,
     SWR_TEXTUREVIEW const &args);
@@ -290,6 +290,8 @@ void ProcessCopyBE(DRAW_CONTEXT *pDC, UINT macroTile, void *pData)
 
     const SWR_FORMAT_INFO &dstFormatInfo = GetFormatInfo(pCopy->dstFormat);
 
+    const bool tiled = (pCopy->tilingFormat == TF_TileZ);
+
     for (INT sy = srcTop, dy = dstY; sy < srcBot; ++sy, ++dy)
     {
         BYTE *pDstAddr = (BYTE *)pCopy->pData + dy * pCopy->pitch + dstX * dstFormatInfo.Bpp;
@@ -317,6 +319,11 @@ void ProcessCopyBE(DRAW_CONTEXT *pDC, UINT macroTile, void *pData)
 
             UINT *pSrcAddr = (UINT *)((BYTE *)pRT->pTileData + tileY * tilePitch + tileX * tileSizeInBytes + tileOffsetInBytes);
 
+            if (tiled)
+            {
+                pDstAddr = (BYTE *)pCopy->pData + TexelOffset(TF_TileZ, pCopy->pitch / dstFormatInfo.Bpp, dstFormatInfo.Bpp, dx, dy);
+            }
+
             ConvertPixel(pRT->format, pSrcAddr, pCopy->dstFormat, pDstAddr);
 
             pDstAddr += dstFormatInfo.Bpp;
@@ -325,3 +332,135 @@ void ProcessCopyBE(DRAW_CONTEXT *pDC, UINT macroTile, void *pData)
 
     RDTSC_STOP(BEProcessCopy, (srcBot - srcTop) * (srcRight - srcLeft), 0);
 }
+
+void ProcessUploadBE(DRAW_CONTEXT *pDC, UINT macroTile, void *pData)
+{
+    RDTSC_START(BEProcessUpload);
+
+    UPLOAD_DESC *pUpload = (UPLOAD_DESC *)pData;
+
+    UINT x, y;
+    MacroTileMgr::getTileIndices(macroTile, x, y);
+
+    // intersect macro tile with the destination rect
+    UINT mtWidth = pDC->pTileMgr->getTileWidth();
+    UINT mtHeight = pDC->pTileMgr->getTileHeight();
+    UINT left = std::max(pUpload->x, x * mtWidth);
+    UINT right = std::min(pUpload->x + pUpload->width, (x + 1) * mtWidth);
+    UINT top = std::max(pUpload->y, y * mtHeight);
+    UINT bot = std::min(pUpload->y + pUpload->height, (y + 1) * mtHeight);
+
+    const UINT srcBpp = GetFormatInfo(pUpload->srcFormat).Bpp;
+    const UINT dstBpp = GetFormatInfo(pUpload->dstFormat).Bpp;
+    const bool sameFormat = (pUpload->srcFormat == pUpload->dstFormat);
+
+    for (UINT dy = top; dy < bot; ++dy)
+    {
+        BYTE *pSrc = pUpload->pSrc + (dy - pUpload->y) * pUpload->srcPitch + (left - pUpload->x) * srcBpp;
+
+        if (sameFormat && (pUpload->tilingFormat == TF_Linear))
+        {
+            memcpy(pUpload->pDst + (dy * pUpload->dstPhysWidth + left) * dstBpp, pSrc, (right - left) * srcBpp);
+            continue;
+        }
+
+        for (UINT dx = left; dx < right; ++dx, pSrc += srcBpp)
+        {
+            BYTE *pDst = pUpload->pDst + TexelOffset(pUpload->tilingFormat, pUpload->dstPhysWidth, dstBpp, dx, dy);
+            if (sameFormat)
+            {
+                memcpy(pDst, pSrc, srcBpp);
+            }
+            else
+            {
+                // staging is padded, ConvertPixel reads a full 16 bytes
+                ConvertPixel(pUpload->srcFormat, pSrc, pUpload->dstFormat, pDst);
+            }
+        }
+    }
+
+    RDTSC_STOP(BEProcessUpload, (bot - top) * (right - left), 0);
+}
+
+// Source taps and weights of destination texel d along one axis. Even sizes
+// average texel pairs. Odd sizes use the 3 tap polyphase tent, weights
+// (n - d, n, d + 1) / (2n + 1) for n destination texels, which weights every
+// source texel equally overall.
+INLINE UINT MipTaps(UINT d, UINT srcDim, UINT dstDim, UINT (&taps)[3], float (&weights)[3])
+{
+    if (srcDim == 1)
+    {
+        taps[0] = 0;
+        weights[0] = 1.0f;
+        return 1;
+    }
+
+    taps[0] = 2 * d;
+    taps[1] = 2 * d + 1;
+    if ((srcDim & 1) == 0)
+    {
+        weights[0] = weights[1] = 0.5f;
+        return 2;
+    }
+
+    float scale = 1.0f / (float)(2 * dstDim + 1);
+    taps[2] = 2 * d + 2;
+    weights[0] = (float)(dstDim - d) * scale;
+    weights[1] = (float)dstDim * scale;
+    weights[2] = (float)(d + 1) * scale;
+    return 3;
+}
+
+void ProcessMipGenBE(DRAW_CONTEXT *pDC, UINT macroTile, void *pData)
+{
+    RDTSC_START(BEProcessMipGen);
+
+    MIPGEN_DESC *pMipGen = (MIPGEN_DESC *)pData;
+
+    UINT x, y;
+    MacroTileMgr::getTileIndices(macroTile, x, y);
+
+    UINT mtWidth = pDC->pTileMgr->getTileWidth();
+    UINT mtHeight = pDC->pTileMgr->getTileHeight();
+    UINT left = x * mtWidth;
+    UINT right = std::min(left + mtWidth, pMipGen->dstWidth);
+    UINT top = y * mtHeight;
+    UINT bot = std::min(top + mtHeight, pMipGen->dstHeight);
+
+    const UINT Bpp = GetFormatInfo(pMipGen->format).Bpp;
+
+    // Texels are filtered as RGBA float, all four channels at once.
+    for (UINT dy = top; dy < bot; ++dy)
+    {
+        UINT tapsY[3];
+        float weightsY[3];
+        UINT numTapsY = MipTaps(dy, pMipGen->srcHeight, pMipGen->dstHeight, tapsY, weightsY);
+
+        for (UINT dx = left; dx < right; ++dx)
+        {
+            UINT tapsX[3];
+            float weightsX[3];
+            UINT numTapsX = MipTaps(dx, pMipGen->srcWidth, pMipGen->dstWidth, tapsX, weightsX);
+
+            __m128 sum = _mm_setzero_ps();
+            for (UINT j = 0; j < numTapsY; ++j)
+            {
+                for (UINT i = 0; i < numTapsX; ++i)
+                {
+                    // ConvertPixel reads a full 16 bytes.
+                    OSALIGN(BYTE, 16) texel[16];
+                    OSALIGN(float, 16) rgba[4];
+                    memcpy(texel, pMipGen->pSrc + TexelOffset(pMipGen->tilingFormat, pMipGen->srcPhysWidth, Bpp, tapsX[i], tapsY[j]), Bpp);
+                    ConvertPixel(pMipGen->format, texel, RGBA32_FLOAT, rgba);
+                    sum = _mm_add_ps(sum, _mm_mul_ps(_mm_load_ps(rgba), _mm_set1_ps(weightsX[i] * weightsY[j])));
+                }
+            }
+
+            OSALIGN(float, 16) result[4];
+            _mm_store_ps(result, sum);
+            ConvertPixel(RGBA32_FLOAT, result, pMipGen->format, pMipGen->pDst + TexelOffset(pMipGen->tilingFormat, pMipGen->dstPhysWidth, Bpp, dx, dy));
+        }
+    }
+
+    RDTSC_STOP(BEProcessMipGen, (bot - top) * (right - left), 0);
+}
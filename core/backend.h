@@ -22,9 +22,12 @@
 #include "resource.h"
 
 void ProcessClearBE(DRAW_CONTEXT *pDC, UINT macroTile, void *pUserData);
-void storeTile(UINT x, UINT y, RENDERTARGET *pRenderTarget);
+void storeTile(DRIVER_TYPE driver, UINT tileX, UINT tileY, RENDERTARGET *pRenderTarget, void *pData, UINT pitch);
+void storeTilePartial(DRIVER_TYPE driver, UINT tileX, UINT tileY, UINT sizeX, UINT sizeY, RENDERTARGET *pRT, void *pData, UINT pitch);
 void ProcessStoreTileBE(DRAW_CONTEXT *pDC, UINT macroTile, void *pData);
 void ProcessCopyBE(DRAW_CONTEXT *pDC, UINT macroTile, void *pData);
+void ProcessUploadBE(DRAW_CONTEXT *pDC, UINT macroTile, void *pData);
+void ProcessMipGenBE(DRAW_CONTEXT *pDC, UINT macroTile, void *pData);
 
 struct OS_SWAP_CHAIN
 {
@@ -109,6 +109,32 @@ struct COPY_DESC
     INT dstX, dstY;
     UINT width, height;
     SWR_FORMAT dstFormat;
+    SWR_TILING_FORMAT tilingFormat;
+};
+
+struct UPLOAD_DESC
+{
+    BYTE *pSrc; // staging, freed when the upload completes
+    UINT srcPitch;
+    SWR_FORMAT srcFormat;
+    BYTE *pDst; // subtexture base
+    UINT dstPhysWidth;
+    SWR_FORMAT dstFormat;
+    SWR_TILING_FORMAT tilingFormat;
+    UINT x, y;
+    UINT width, height;
+};
+
+// Downsamples one mip level into the next.
+struct MIPGEN_DESC
+{
+    BYTE const *pSrc; // subtexture bases
+    BYTE *pDst;
+    UINT srcPhysWidth, dstPhysWidth;
+    UINT srcWidth, srcHeight;
+    UINT dstWidth, dstHeight;
+    SWR_FORMAT format;
+    SWR_TILING_FORMAT tilingFormat;
 };
 
 typedef void (*PFN_WORK_FUNC)(DRAW_CONTEXT *, UINT, void *);
@@ -119,7 +145,9 @@ enum WORK_TYPE
     CLEAR,
     STORE,
     FLIP,
-    COPY
+    COPY,
+    UPLOAD,
+    MIPGEN
 };
 
 struct BE_WORK
@@ -135,6 +163,8 @@ struct BE_WORK
         STORE_DESC store;
         FLIP_DESC flip;
         COPY_DESC copy;
+        UPLOAD_DESC upload;
+        MIPGEN_DESC mipGen;
     } desc;
 };
 
@@ -149,6 +179,8 @@ OSALIGNLINE(struct) VERT_BE_WORK
         STORE_DESC store;
         FLIP_DESC flip;
         COPY_DESC copy;
+        UPLOAD_DESC upload;
+        MIPGEN_DESC mipGen;
     } desc;
 };
 
@@ -204,6 +236,8 @@ struct FE_WORK
         STORE_DESC store;
         FLIP_DESC flip;
         COPY_DESC copy;
+        UPLOAD_DESC upload;
+        MIPGEN_DESC mipGen;
     } desc;
 };
 
@@ -236,6 +270,35 @@ struct GUARDBAND
     float left, right, top, bottom;
 };
 
+// Post-transform vertices of a locked vertex range, one slot per vertex
+// pipeline key. The api thread assigns keys to slots. The first FE to claim
+// an empty slot runs fetch and the VS over the whole range, later draws with
+// the same key copy the VS outputs instead.
+struct VERTEX_CACHE
+{
+    enum
+    {
+        SLOT_EMPTY,
+        SLOT_BUILDING,
+        SLOT_READY
+    };
+
+    struct SLOT
+    {
+        void *pKey; // copy of the client's key, compared in full on lookup
+        UINT keySize;
+        volatile LONG status;
+        VERTEXOUTPUT *pOutputs; // one per simd of the range
+    };
+
+    UINT firstVertex;
+    UINT numVertices;
+    UINT numSlots;
+    SLOT slots[KNOB_NUM_VERTEX_CACHE_SLOTS];
+
+    DRAW_T lastDrawId; // last draw that may read or build a slot
+};
+
 OSALIGNLINE(struct) API_STATE
 {
     // Attribute information.
@@ -258,6 +321,10 @@ OSALIGNLINE(struct) API_STATE
     Allocation *pVSConstantBufferAlloc;
     PFN_VERTEX_FUNC pfnVertexFunc;
 
+    // Post-transform cache and the slot for this draw's vertex pipeline.
+    VERTEX_CACHE *pVertexCache;
+    INT vertexCacheSlot;
+
     // Specifies which VS outputs are sent to PS.
     //	The front face mask is used to pick attributes for front facing triangles. Back face otherwise.
     UINT linkageMaskFrontFace;  // Mask of attributes from VS_ATTR_SLOT sent to PS.
@@ -273,6 +340,11 @@ OSALIGNLINE(struct) API_STATE
     RASTSTATE rastState;
     GUARDBAND gbState;
 
+    // Select/feedback output; only one is used, depending on the mode.
+    SWR_RENDER_MODE renderMode;
+    SWR_SELECT_HIT *pSelectHit;
+    SWR_FEEDBACK_BUFFER *pFeedback;
+
     BBOX scissorRect;
     BBOX scissorInFixedPoint;
     BBOX scissorInTiles;
@@ -378,7 +450,10 @@ struct SWR_CONTEXT
 
     DRIVER_TYPE driverType;
 
+    // numa nodes the workers run on; workers, tile rows and allocations use
+    // indices into numaNodeIds, the system node numbers
     UINT numNumaNodes;
+    UINT numaNodeIds[KNOB_MAX_NUM_THREADS];
 
     BOOL dumpFPS;
     BOOL dumpPoolInfo;
@@ -14,6 +14,9 @@
 
 #include "formats.h"
 
+#include <algorithm>
+#include <cstring>
+
 // order must match SWR_FORMAT
 const SWR_FORMAT_INFO gFormatInfo[] = {
     { SWR_TYPE_UNKNOWN, 0, 0, 0, 0, 0, 0, 0, { 0, 0, 0, 0 }, { 0, 0, 0, 0 }, { 0, 0, 0, 0 }, { 0, 0, 0, 0 } }, // NULL
@@ -36,9 +39,22 @@ const SWR_FORMAT_INFO gFormatInfo[] = {
     { SWR_TYPE_UNORM8, 3, 3, 1, 2, 1, 0, 0, { 0x80808002, 0x80808001, 0x80808000, 0x80808003 }, { 0x80000408, 0x80808080, 0x80808080, 0x80808080 }, { 0, 0, 0, 1 }, { 0x00000000, 0x00000000, 0x00000000, 0x80808080 } }, // BGR8_UNORM
     { SWR_TYPE_UNORM8, 4, 4, 1, 2, 1, 0, 3, { 0x80808002, 0x80808001, 0x80808000, 0x80808003 }, { 0x0c000408, 0x80808080, 0x80808080, 0x80808080 }, { 0, 0, 0, 1 }, { 0x00000000, 0x00000000, 0x00000000, 0x00000000 } }, // BGRA8_UNORM
 
+    { SWR_TYPE_UNORM8, 1, 1, 1, 0, 0, 0, 0, { 0x80808080, 0x80808080, 0x80808080, 0x80808000 }, { 0x8080800c, 0x80808080, 0x80808080, 0x80808080 }, { 0xff, 0xff, 0xff, 0 }, { 0x80808080, 0x80808080, 0x80808080, 0x00000000 } }, // A8_UNORM
+    { SWR_TYPE_UNORM8, 1, 1, 1, 0, 0, 0, 0, { 0x80808000, 0x80808000, 0x80808000, 0x80808080 }, { 0x80808000, 0x80808080, 0x80808080, 0x80808080 }, { 0, 0, 0, 0xff }, { 0x00000000, 0x00000000, 0x00000000, 0x80808080 } }, // L8_UNORM
+    { SWR_TYPE_UNORM8, 2, 2, 1, 0, 0, 0, 1, { 0x80808000, 0x80808000, 0x80808000, 0x80808001 }, { 0x80800c00, 0x80808080, 0x80808080, 0x80808080 }, { 0, 0, 0, 0 }, { 0x00000000, 0x00000000, 0x00000000, 0x00000000 } }, // LA8_UNORM
+
+    // Packed below byte granularity, converted through float by ConvertPixel.
+    { SWR_TYPE_UNKNOWN, 3, 2, 0, 0, 0, 0, 0, { 0x80808080, 0x80808080, 0x80808080, 0x80808080 }, { 0x80808080, 0x80808080, 0x80808080, 0x80808080 }, { 0, 0, 0, 0x3f800000 }, { 0x00000000, 0x00000000, 0x00000000, 0x80808080 } }, // B5G6R5_UNORM
+
     { SWR_TYPE_SNORM8, 3, 3, 1, 0, 1, 2, 0, { 0x80808000, 0x80808001, 0x80808002, 0x80808003 }, { 0x80808000, 0x80808080, 0x80808080, 0x80808080 }, { 0, 0, 0, 1 }, { 0x00000000, 0x00000000, 0x00000000, 0x80808080 } }, //RGB8_SNORM
 
     { SWR_TYPE_SINT16, 2, 4, 2, 0, 1, 0, 0, { 0x80800100, 0x80800302, 0x80808080, 0x80808080 }, { 0x07060100, 0x80808080, 0x80808080, 0x80808080 }, { 0, 0, 0, 1 }, { 0x00000000, 0x00000000, 0x80808080, 0x80808080 } }, // RG16_SINT
+
+    // Block compressed, decoded by the sampler. Bpp is the size of a 4x4 block.
+    { SWR_TYPE_UNKNOWN, 3, 8, 0, 0, 0, 0, 0, { 0x80808080, 0x80808080, 0x80808080, 0x80808080 }, { 0x80808080, 0x80808080, 0x80808080, 0x80808080 }, { 0, 0, 0, 0x3f800000 }, { 0x00000000, 0x00000000, 0x00000000, 0x80808080 } }, // DXT1_UNORM
+    { SWR_TYPE_UNKNOWN, 4, 8, 0, 0, 0, 0, 0, { 0x80808080, 0x80808080, 0x80808080, 0x80808080 }, { 0x80808080, 0x80808080, 0x80808080, 0x80808080 }, { 0, 0, 0, 0 }, { 0x00000000, 0x00000000, 0x00000000, 0x00000000 } }, // DXT1A_UNORM
+    { SWR_TYPE_UNKNOWN, 4, 16, 0, 0, 0, 0, 0, { 0x80808080, 0x80808080, 0x80808080, 0x80808080 }, { 0x80808080, 0x80808080, 0x80808080, 0x80808080 }, { 0, 0, 0, 0 }, { 0x00000000, 0x00000000, 0x00000000, 0x00000000 } }, // DXT3_UNORM
+    { SWR_TYPE_UNKNOWN, 4, 16, 0, 0, 0, 0, 0, { 0x80808080, 0x80808080, 0x80808080, 0x80808080 }, { 0x80808080, 0x80808080, 0x80808080, 0x80808080 }, { 0, 0, 0, 0 }, { 0x00000000, 0x00000000, 0x00000000, 0x00000000 } }, // DXT5_UNORM
 };
 
 INT SwrNumBytes(SWR_FORMAT format)
@@ -80,6 +96,37 @@ void ConvertPixel(SWR_FORMAT srcFormat, void *pSrc, SWR_FORMAT dstFormat, void *
     const SWR_FORMAT_INFO &srcFmtInfo = GetFormatInfo(srcFormat);
     const SWR_FORMAT_INFO &dstFmtInfo = GetFormatInfo(dstFormat);
 
+    // 565 can't be swizzled bytewise, go through RGBA float.
+    if ((srcFormat == B5G6R5_UNORM) || (dstFormat == B5G6R5_UNORM))
+    {
+        OSALIGN(float, 16) rgba[4];
+        if (srcFormat == B5G6R5_UNORM)
+        {
+            unsigned short texel = *(const unsigned short *)pSrc;
+            rgba[0] = (float)(texel >> 11) * (1.0f / 31.0f);
+            rgba[1] = (float)((texel >> 5) & 0x3f) * (1.0f / 63.0f);
+            rgba[2] = (float)(texel & 0x1f) * (1.0f / 31.0f);
+            rgba[3] = 1.0f;
+        }
+        else
+        {
+            ConvertPixel(srcFormat, pSrc, RGBA32_FLOAT, rgba);
+        }
+
+        if (dstFormat == B5G6R5_UNORM)
+        {
+            UINT r = (UINT)(std::min(std::max(rgba[0], 0.0f), 1.0f) * 31.0f + 0.5f);
+            UINT g = (UINT)(std::min(std::max(rgba[1], 0.0f), 1.0f) * 63.0f + 0.5f);
+            UINT b = (UINT)(std::min(std::max(rgba[2], 0.0f), 1.0f) * 31.0f + 0.5f);
+            *(unsigned short *)pDst = (unsigned short)((r << 11) | (g << 5) | b);
+        }
+        else
+        {
+            ConvertPixel(RGBA32_FLOAT, rgba, dstFormat, pDst);
+        }
+        return;
+    }
+
 // fast path - src and dst formats are the same, just copy the pixel data
 // @todo this fast path isn't any faster than the code below
 #if 0
@@ -121,7 +168,13 @@ void ConvertPixel(SWR_FORMAT srcFormat, void *pSrc, SWR_FORMAT dstFormat, void *
         // loadu can be very expensive.  Simple fast path to use load1 instead of loadu if destination
         // pixel size is <= 4B
         __m128i vDstOrg;
-        if (dstFmtInfo.Bpp <= 4)
+        if (dstFmtInfo.Bpp < 4)
+        {
+            // Sub-dword pixels are stored exactly, neighbours may belong to another thread.
+            UINT texel = _mm_cvtsi128_si32(vDst);
+            memcpy(pDst, &texel, dstFmtInfo.Bpp);
+        }
+        else if (dstFmtInfo.Bpp <= 4)
         {
             vDstOrg = _mm_castps_si128(_mm_load1_ps((const float *)pDst));
             vDst = _mm_blendv_epi8(vDst, vDstOrg, _mm_load_si128((__m128i *)&dstFmtInfo.packFromRGBA));
@@ -185,7 +238,12 @@ void ConvertPixel(SWR_FORMAT srcFormat, void *pSrc, SWR_FORMAT dstFormat, void *
 
     // store
     //@todo really need packstore!
-    if (dstFmtInfo.Bpp <= 4)
+    if (dstFmtInfo.Bpp < 4)
+    {
+        UINT texel = _mm_cvtsi128_si32(vConvertedI);
+        memcpy(pDst, &texel, dstFmtInfo.Bpp);
+    }
+    else if (dstFmtInfo.Bpp <= 4)
     {
         __m128i vDstOrg = _mm_castps_si128(_mm_load1_ps((const float *)pDst));
         vConvertedI = _mm_blendv_epi8(vConvertedI, vDstOrg, _mm_load_si128((__m128i *)&dstFmtInfo.packFromRGBA));
@@ -51,10 +51,22 @@ enum SWR_FORMAT
     BGR8_UNORM,
     BGRA8_UNORM,
 
+    A8_UNORM,
+    L8_UNORM,
+    LA8_UNORM,
+
+    B5G6R5_UNORM,
+
     RGB8_SNORM,
 
     RG16_SINT,
 
+    // S3TC block compressed, one 4x4 block per element.
+    DXT1_UNORM,
+    DXT1A_UNORM,
+    DXT3_UNORM,
+    DXT5_UNORM,
+
     NUM_SWR_FORMATS
 };
 
@@ -62,7 +74,7 @@ struct SWR_FORMAT_INFO
 {
     SWR_TYPE type;
     UINT numComps;
-    UINT Bpp; // bytes per pixel
+    UINT Bpp; // bytes per pixel, or per block for block compressed formats
     UINT Bpc; // bytes per component
 
     INT rpos, gpos, bpos, apos;
@@ -82,5 +94,18 @@ const SWR_FORMAT_INFO &GetFormatInfo(SWR_FORMAT format)
     return gFormatInfo[format];
 }
 
+INLINE
+bool IsBlockCompressed(SWR_FORMAT format)
+{
+    return (format >= DXT1_UNORM) && (format <= DXT5_UNORM);
+}
+
+// Width and height in texels of one storage element.
+INLINE
+UINT FormatBlockDim(SWR_FORMAT format)
+{
+    return IsBlockCompressed(format) ? 4 : 1;
+}
+
 SWR_FORMAT GetMatchingFormat(SWR_TYPE type, UINT numComps, INT rpos, INT gpos, INT bpos, INT apos);
 void ConvertPixel(SWR_FORMAT srcFormat, void *pSrc, SWR_FORMAT dstFormat, void *pDst);
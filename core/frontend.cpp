@@ -12,6 +12,8 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <climits>
+
 #include "api.h"
 #include "frontend.h"
 #include "backend.h"
@@ -223,6 +225,67 @@ void ProcessCopy(SWR_CONTEXT *pContext, DRAW_CONTEXT *pDC, void *pUserData)
     pDC->doneFE = true;
 }
 
+// Texture uploads are split on the macro tile grid over the destination
+// texels so workers convert and tile them in parallel.
+void ProcessUpload(SWR_CONTEXT *pContext, DRAW_CONTEXT *pDC, void *pUserData)
+{
+    UPLOAD_DESC *pUpload = (UPLOAD_DESC *)pUserData;
+
+    UINT mtWidth = pDC->pTileMgr->getTileWidth();
+    UINT mtHeight = pDC->pTileMgr->getTileHeight();
+    UINT leftMT = pUpload->x / mtWidth;
+    UINT rightMT = (pUpload->x + pUpload->width - 1) / mtWidth;
+    UINT topMT = pUpload->y / mtHeight;
+    UINT botMT = (pUpload->y + pUpload->height - 1) / mtHeight;
+
+#if KNOB_VERTICALIZED_BINNER
+    VERT_BE_WORK work;
+#else
+    BE_WORK work;
+#endif
+    work.pfnWork = ProcessUploadBE;
+    work.desc.upload = *pUpload;
+
+    for (UINT y = topMT; y <= botMT; ++y)
+    {
+        for (UINT x = leftMT; x <= rightMT; ++x)
+        {
+            pDC->pTileMgr->enqueue(x, y, &work);
+        }
+    }
+
+    _ReadWriteBarrier();
+    pDC->doneFE = true;
+}
+
+// Mip levels are split on the macro tile grid over the destination level.
+void ProcessMipGen(SWR_CONTEXT *pContext, DRAW_CONTEXT *pDC, void *pUserData)
+{
+    MIPGEN_DESC *pMipGen = (MIPGEN_DESC *)pUserData;
+
+    UINT rightMT = (pMipGen->dstWidth - 1) / pDC->pTileMgr->getTileWidth();
+    UINT botMT = (pMipGen->dstHeight - 1) / pDC->pTileMgr->getTileHeight();
+
+#if KNOB_VERTICALIZED_BINNER
+    VERT_BE_WORK work;
+#else
+    BE_WORK work;
+#endif
+    work.pfnWork = ProcessMipGenBE;
+    work.desc.mipGen = *pMipGen;
+
+    for (UINT y = 0; y <= botMT; ++y)
+    {
+        for (UINT x = 0; x <= rightMT; ++x)
+        {
+            pDC->pTileMgr->enqueue(x, y, &work);
+        }
+    }
+
+    _ReadWriteBarrier();
+    pDC->doneFE = true;
+}
+
 INLINE
 __m128 fixedPointToFP(const __m128i vIn)
 {
@@ -240,6 +303,121 @@ void BinTriangle(DRAW_CONTEXT *pDC, __m128 &vX, __m128 &vY, __m128 &vZ, __m128 &
 #if KNOB_VERTICALIZED_FE
 void BinTriangles(DRAW_CONTEXT *pDC, PA_STATE &pa, simdvector tri[3], UINT numTris);
 
+template <typename IndexType>
+INLINE void SetCacheBuildIndices(INT *pIndices, UINT start, UINT last)
+{
+    IndexType *pTyped = (IndexType *)pIndices;
+    for (UINT lane = 0; lane < KNOB_VS_SIMD_WIDTH; ++lane)
+    {
+        pTyped[lane] = (IndexType)std::min(start + lane, last);
+    }
+}
+
+// Returns the draw's post-transform cache slot once it holds the VS outputs
+// of the whole locked range, building it first if this draw gets to claim
+// it. The build uses the draw's own fetch shader, so an indexed draw feeds it
+// indices of its type. NULL means the draw runs fetch and the VS itself.
+static const VERTEX_CACHE::SLOT *AcquireVertexCache(DRAW_CONTEXT *pDC, SWR_FETCH_INFO fetchInfo, VERTEXINPUT &vin, bool indexed, SWR_TYPE indexType)
+{
+    VERTEX_CACHE *pCache = pDC->state.pVertexCache;
+    if (pCache == NULL)
+    {
+        return NULL;
+    }
+
+    VERTEX_CACHE::SLOT &slot = pCache->slots[pDC->state.vertexCacheSlot];
+    if (slot.status == VERTEX_CACHE::SLOT_READY)
+    {
+        return &slot;
+    }
+
+    UINT last = pCache->firstVertex + pCache->numVertices - 1;
+    UINT maxIndex = UINT_MAX;
+    if (indexed)
+    {
+        maxIndex = (indexType == SWR_TYPE_UINT8) ? UCHAR_MAX : ((indexType == SWR_TYPE_UINT16) ? USHRT_MAX : UINT_MAX);
+    }
+
+    // Another draw is building it, or this one's indices can't address the
+    // whole range.
+    if (last > maxIndex || InterlockedCompareExchange(&slot.status, (LONG)VERTEX_CACHE::SLOT_BUILDING, (LONG)VERTEX_CACHE::SLOT_EMPTY) != VERTEX_CACHE::SLOT_EMPTY)
+    {
+        return NULL;
+    }
+
+    OSALIGNSIMD(INT) indices[KNOB_VS_SIMD_WIDTH];
+    for (UINT v = 0; v < pCache->numVertices; v += KNOB_VS_SIMD_WIDTH)
+    {
+        INT start = pCache->firstVertex + v;
+        if (indexed)
+        {
+            // clamp the tail so the fetch stays in the locked range
+            switch (indexType)
+            {
+            case SWR_TYPE_UINT8:
+                SetCacheBuildIndices<BYTE>(indices, start, last);
+                break;
+            case SWR_TYPE_UINT16:
+                SetCacheBuildIndices<uint16_t>(indices, start, last);
+                break;
+            default:
+                SetCacheBuildIndices<UINT>(indices, start, last);
+                break;
+            }
+            fetchInfo.pIndices = indices;
+        }
+        else
+        {
+            fetchInfo.pIndices = &start;
+        }
+
+        pDC->state.pfnFetchFunc(fetchInfo, vin);
+        pDC->state.pfnVertexFunc(vin, slot.pOutputs[v / KNOB_VS_SIMD_WIDTH]);
+    }
+
+    _ReadWriteBarrier();
+    slot.status = VERTEX_CACHE::SLOT_READY;
+    return &slot;
+}
+
+// Copies the cached VS outputs of one simd of vertices into vout. Returns
+// false if a lane's vertex is outside the cached range.
+static bool CopyCachedVertices(const VERTEX_CACHE &cache, const VERTEX_CACHE::SLOT &slot, const UINT (&vertices)[KNOB_VS_SIMD_WIDTH], UINT numLanes, VERTEXOUTPUT &vout)
+{
+    UINT offsets[KNOB_VS_SIMD_WIDTH];
+    bool aligned = (numLanes == KNOB_VS_SIMD_WIDTH);
+    for (UINT lane = 0; lane < numLanes; ++lane)
+    {
+        offsets[lane] = vertices[lane] - cache.firstVertex;
+        if (offsets[lane] >= cache.numVertices)
+        {
+            return false;
+        }
+        aligned &= (offsets[lane] == offsets[0] + lane);
+    }
+
+    // a whole cached simd in order
+    if (aligned && (offsets[0] % KNOB_VS_SIMD_WIDTH) == 0)
+    {
+        vout = slot.pOutputs[offsets[0] / KNOB_VS_SIMD_WIDTH];
+        return true;
+    }
+
+    for (UINT lane = 0; lane < numLanes; ++lane)
+    {
+        const VERTEXOUTPUT &src = slot.pOutputs[offsets[lane] / KNOB_VS_SIMD_WIDTH];
+        UINT srcLane = offsets[lane] % KNOB_VS_SIMD_WIDTH;
+        for (UINT attr = 0; attr < VS_SLOT_MAX; ++attr)
+        {
+            for (UINT comp = 0; comp < 4; ++comp)
+            {
+                ((float *)&vout.vertex[attr][comp])[lane] = ((const float *)&src.vertex[attr][comp])[srcLane];
+            }
+        }
+    }
+    return true;
+}
+
 void ProcessDraw(SWR_CONTEXT *pContext, DRAW_CONTEXT *pDC, void *pUserData)
 {
     DRAW_WORK &work = *(DRAW_WORK *)pUserData;
@@ -274,13 +452,26 @@ void ProcessDraw(SWR_CONTEXT *pContext, DRAW_CONTEXT *pDC, void *pUserData)
     BinPacker bp(pDC);
 #endif
 
+    const VERTEX_CACHE::SLOT *pCacheSlot = AcquireVertexCache(pDC, fetchInfo, vin, false, SWR_TYPE_UINT32);
+
     while (PaHasWork(pa))
     {
         // PaGetNextVsOutput currently has the side effect of updating some PA state machine state.
         // So we need to keep this outside of (i < endVertex) check.
         VERTEXOUTPUT &vout = PaGetNextVsOutput(pa);
 
-        if (i < endVertex)
+        bool cached = false;
+        if (pCacheSlot && i < endVertex)
+        {
+            UINT vertices[KNOB_VS_SIMD_WIDTH];
+            for (UINT lane = 0; lane < KNOB_VS_SIMD_WIDTH; ++lane)
+            {
+                vertices[lane] = i + lane;
+            }
+            cached = CopyCachedVertices(*pDC->state.pVertexCache, *pCacheSlot, vertices, std::min<UINT>(KNOB_VS_SIMD_WIDTH, endVertex - i), vout);
+        }
+
+        if (i < endVertex && !cached)
         {
             fetchInfo.pIndices = &i;
 
@@ -360,6 +551,9 @@ void ProcessDrawIndexed(SWR_CONTEXT *pContext, DRAW_CONTEXT *pDC, void *pUserDat
     case SWR_TYPE_UINT16:
         indexSize = sizeof(short);
         break;
+    case SWR_TYPE_UINT8:
+        indexSize = sizeof(BYTE);
+        break;
     default:
         assert(0);
     }
@@ -378,13 +572,37 @@ void ProcessDrawIndexed(SWR_CONTEXT *pContext, DRAW_CONTEXT *pDC, void *pUserDat
 
     fetchInfo.pIndices = work.pIB;
 
+    const VERTEX_CACHE::SLOT *pCacheSlot = AcquireVertexCache(pDC, fetchInfo, vin, true, work.type);
+
     while (PaHasWork(pa))
     {
         // PaGetNextVsOutput currently has the side effect of updating some PA state machine state.
         // So we need to keep this outside of (i < endVertex) check.
         VERTEXOUTPUT &vout = PaGetNextVsOutput(pa);
 
-        if (i < endVertex)
+        bool cached = false;
+        if (pCacheSlot && i < endVertex)
+        {
+            UINT vertices[KNOB_VS_SIMD_WIDTH];
+            for (UINT lane = 0; lane < KNOB_VS_SIMD_WIDTH; ++lane)
+            {
+                switch (work.type)
+                {
+                case SWR_TYPE_UINT8:
+                    vertices[lane] = ((const BYTE *)fetchInfo.pIndices)[lane];
+                    break;
+                case SWR_TYPE_UINT16:
+                    vertices[lane] = ((const uint16_t *)fetchInfo.pIndices)[lane];
+                    break;
+                default:
+                    vertices[lane] = ((const UINT *)fetchInfo.pIndices)[lane];
+                    break;
+                }
+            }
+            cached = CopyCachedVertices(*pDC->state.pVertexCache, *pCacheSlot, vertices, std::min<UINT>(KNOB_VS_SIMD_WIDTH, endVertex - i), vout);
+        }
+
+        if (i < endVertex && !cached)
         {
             // 1. Execute FS/VS for a single SIMD.
             RDTSC_START(FEFetchShader);
@@ -495,12 +713,344 @@ void computeClipCodes(const API_STATE &state, const simdvector &vertex, simdscal
     clipCodes = _simd_or_ps(clipCodes, _simd_and_ps(vRes, _simd_castsi_ps(_simd_set1_epi32(GUARDBAND_BOTTOM))));
 }
 
+// Select and feedback modes. Primitives are gathered one at a time after the
+// VS, clipped in homogeneous space and written out as hit depths or feedback
+// records instead of being binned.
+static const UINT FEEDBACK_NUM_ATTRIBS = 8; // rgba + strq
+
+// Same mapping as transformVertical; w is kept in clip space.
+INLINE void FeedbackWindowCoords(const SWR_VIEWPORT &vp, const float *pClip, float (&win)[4])
+{
+    float rcpW = 1.0f / pClip[3];
+    win[0] = pClip[0] * rcpW * vp.halfWidth + vp.halfWidth + vp.x;
+    win[1] = pClip[1] * rcpW * vp.halfHeight + vp.halfHeight + vp.y;
+    win[2] = (pClip[2] * rcpW + 1.0f) * 0.5f * (vp.maxZ - vp.minZ) + vp.minZ;
+    win[3] = pClip[3];
+}
+
+// Signed distances to the 6 frustum planes; inside where all are >= 0.
+INLINE void FrustumDistances(const float *pClip, float (&dist)[6])
+{
+    dist[0] = pClip[3] + pClip[0];
+    dist[1] = pClip[3] - pClip[0];
+    dist[2] = pClip[3] + pClip[1];
+    dist[3] = pClip[3] - pClip[1];
+    dist[4] = pClip[3] + pClip[2];
+    dist[5] = pClip[3] - pClip[2];
+}
+
+// Parametric clip of a line against the frustum; positions and attribs are
+// interpolated in place. Returns false if the line is outside.
+static bool ClipLine(float *pVerts, float *pAttribs)
+{
+    float dist0[6], dist1[6];
+    FrustumDistances(&pVerts[0], dist0);
+    FrustumDistances(&pVerts[4], dist1);
+
+    float t0 = 0.0f;
+    float t1 = 1.0f;
+    for (UINT plane = 0; plane < 6; ++plane)
+    {
+        if (dist0[plane] < 0.0f && dist1[plane] < 0.0f)
+        {
+            return false;
+        }
+
+        if (dist0[plane] < 0.0f)
+        {
+            t0 = std::max(t0, dist0[plane] / (dist0[plane] - dist1[plane]));
+        }
+        else if (dist1[plane] < 0.0f)
+        {
+            t1 = std::min(t1, dist0[plane] / (dist0[plane] - dist1[plane]));
+        }
+    }
+
+    if (t0 > t1)
+    {
+        return false;
+    }
+
+    float in[2][4 + FEEDBACK_NUM_ATTRIBS];
+    for (UINT v = 0; v < 2; ++v)
+    {
+        memcpy(&in[v][0], &pVerts[v * 4], 4 * sizeof(float));
+        memcpy(&in[v][4], &pAttribs[v * FEEDBACK_NUM_ATTRIBS], FEEDBACK_NUM_ATTRIBS * sizeof(float));
+    }
+
+    const float t[2] = { t0, t1 };
+    for (UINT v = 0; v < 2; ++v)
+    {
+        for (UINT c = 0; c < 4 + FEEDBACK_NUM_ATTRIBS; ++c)
+        {
+            float value = in[0][c] + t[v] * (in[1][c] - in[0][c]);
+            if (c < 4)
+            {
+                pVerts[v * 4 + c] = value;
+            }
+            else
+            {
+                pAttribs[v * FEEDBACK_NUM_ATTRIBS + c - 4] = value;
+            }
+        }
+    }
+    return true;
+}
+
+// Color and texcoord of the 3 prim verts, from the back color when a back face links one.
+static void GatherFeedbackAttribs(const API_STATE &state, PA_STATE &pa, UINT triIndex, bool backFace, float *pAttribs)
+{
+    UINT linkageMask = state.linkageMaskFrontFace | state.linkageMaskBackFace;
+    UINT colorSlot = VS_SLOT_COLOR0;
+    if (backFace && (state.linkageMaskBackFace & VS_ATTR_MASK(VS_SLOT_COLOR1)))
+    {
+        colorSlot = VS_SLOT_COLOR1;
+    }
+
+    __m128 color[3] = { _mm_set1_ps(1.0f), _mm_set1_ps(1.0f), _mm_set1_ps(1.0f) };
+    if (linkageMask & VS_ATTR_MASK(colorSlot))
+    {
+        PaAssembleSingle(pa, colorSlot, triIndex, color);
+    }
+
+    __m128 texCoord[3] = { _mm_set_ps(1.0f, 0, 0, 0), _mm_set_ps(1.0f, 0, 0, 0), _mm_set_ps(1.0f, 0, 0, 0) };
+    if (linkageMask & VS_ATTR_MASK(VS_SLOT_TEXCOORD0))
+    {
+        PaAssembleSingle(pa, VS_SLOT_TEXCOORD0, triIndex, texCoord);
+    }
+
+    for (UINT v = 0; v < 3; ++v)
+    {
+        _mm_storeu_ps(&pAttribs[v * FEEDBACK_NUM_ATTRIBS], color[v]);
+        _mm_storeu_ps(&pAttribs[v * FEEDBACK_NUM_ATTRIBS + 4], texCoord[v]);
+    }
+}
+
+INLINE void FeedbackWrite(SWR_FEEDBACK_BUFFER &feedback, float value)
+{
+    if (feedback.count < feedback.size)
+    {
+        feedback.pData[feedback.count] = value;
+    }
+    feedback.count++;
+}
+
+static void FeedbackVertex(SWR_FEEDBACK_BUFFER &feedback, const float (&win)[4], const float *pAttribs)
+{
+    for (UINT c = 0; c < feedback.numCoords; ++c)
+    {
+        FeedbackWrite(feedback, win[c]);
+    }
+
+    if (feedback.color)
+    {
+        for (UINT c = 0; c < 4; ++c)
+        {
+            FeedbackWrite(feedback, pAttribs[c]);
+        }
+    }
+
+    if (feedback.texCoord)
+    {
+        for (UINT c = 0; c < 4; ++c)
+        {
+            FeedbackWrite(feedback, pAttribs[4 + c]);
+        }
+    }
+}
+
+// Lowers minZ/raises maxZ of the shared hit record; draws of the same name
+// stack entry may run on several FE threads.
+static void UpdateSelectHit(SWR_SELECT_HIT &hit, float minZ, float maxZ)
+{
+    UINT minZi = (UINT)((double)std::max(0.0f, std::min(1.0f, minZ)) * 4294967295.0);
+    UINT maxZi = (UINT)((double)std::max(0.0f, std::min(1.0f, maxZ)) * 4294967295.0);
+
+    UINT cur = hit.minZ;
+    while (minZi < cur)
+    {
+        UINT prev = (UINT)InterlockedCompareExchange((volatile LONG *)&hit.minZ, (LONG)minZi, (LONG)cur);
+        if (prev == cur)
+        {
+            break;
+        }
+        cur = prev;
+    }
+
+    cur = hit.maxZ;
+    while (maxZi > cur)
+    {
+        UINT prev = (UINT)InterlockedCompareExchange((volatile LONG *)&hit.maxZ, (LONG)maxZi, (LONG)cur);
+        if (prev == cur)
+        {
+            break;
+        }
+        cur = prev;
+    }
+
+    hit.hit = 1;
+}
+
+static void FeedbackPrims(DRAW_CONTEXT *pDC, PA_STATE &pa, UINT numTris)
+{
+    const API_STATE &state = pDC->state;
+    const SWR_VIEWPORT &vp = state.rastState.vp;
+    bool select = (state.renderMode == SWR_RENDER_MODE_SELECT);
+
+    // lines and points are assembled as 2 tris each, the even one carries the prim
+    bool lines = (state.topology == TOP_LINE_LIST || state.topology == TOP_LINE_STRIP);
+    bool points = (state.topology == TOP_POINTS);
+    UINT step = (lines || points) ? 2 : 1;
+
+    float minZ = 1.0f;
+    float maxZ = 0.0f;
+    bool hit = false;
+
+    for (UINT triIndex = 0; triIndex < numTris; triIndex += step)
+    {
+        OSALIGN(float, 16) inVerts[3 * 4];
+        OSALIGN(float, 16) outVerts[6 * 4];
+        OSALIGN(float, 16) inAttribs[3 * FEEDBACK_NUM_ATTRIBS];
+        OSALIGN(float, 16) outAttribs[6 * FEEDBACK_NUM_ATTRIBS];
+
+        __m128 verts[3];
+        PaAssembleSingle(pa, VS_SLOT_POSITION, triIndex, verts);
+        _mm_store_ps(&inVerts[0], verts[0]);
+        _mm_store_ps(&inVerts[4], lines ? verts[2] : verts[1]);
+        _mm_store_ps(&inVerts[8], verts[2]);
+
+        int numVerts = 0;
+        bool backFace = false;
+        if (points)
+        {
+            GatherFeedbackAttribs(state, pa, triIndex, false, inAttribs);
+
+            float dist[6];
+            FrustumDistances(&inVerts[0], dist);
+            if (*std::min_element(dist, dist + 6) < 0.0f)
+            {
+                continue;
+            }
+            memcpy(outVerts, inVerts, 4 * sizeof(float));
+            memcpy(outAttribs, inAttribs, FEEDBACK_NUM_ATTRIBS * sizeof(float));
+            numVerts = 1;
+        }
+        else if (lines)
+        {
+            GatherFeedbackAttribs(state, pa, triIndex, false, inAttribs);
+            memcpy(&inAttribs[FEEDBACK_NUM_ATTRIBS], &inAttribs[2 * FEEDBACK_NUM_ATTRIBS], FEEDBACK_NUM_ATTRIBS * sizeof(float));
+
+            if (!ClipLine(inVerts, inAttribs))
+            {
+                continue;
+            }
+            memcpy(outVerts, inVerts, 2 * 4 * sizeof(float));
+            memcpy(outAttribs, inAttribs, 2 * FEEDBACK_NUM_ATTRIBS * sizeof(float));
+            numVerts = 2;
+        }
+        else
+        {
+            // Orientation from the homogeneous determinant of x, y, w; for
+            // w > 0 it has the sign of the window space area, positive for CCW.
+            const float *p0 = &inVerts[0];
+            const float *p1 = &inVerts[4];
+            const float *p2 = &inVerts[8];
+            float area = p0[0] * (p1[1] * p2[3] - p2[1] * p1[3]) -
+                         p0[1] * (p1[0] * p2[3] - p2[0] * p1[3]) +
+                         p0[3] * (p1[0] * p2[1] - p2[0] * p1[1]);
+
+            // same convention as the binner, whose GL det is -area
+            if (area == 0.0f ||
+                (state.rastState.cullMode == CCW && area > 0.0f) ||
+                (state.rastState.cullMode == CW && area < 0.0f))
+            {
+                continue;
+            }
+            backFace = (area < 0.0f);
+
+            GatherFeedbackAttribs(state, pa, triIndex, backFace, inAttribs);
+
+            float dist[3][6];
+            FrustumDistances(p0, dist[0]);
+            FrustumDistances(p1, dist[1]);
+            FrustumDistances(p2, dist[2]);
+            if (std::min(*std::min_element(dist[0], dist[0] + 6),
+                         std::min(*std::min_element(dist[1], dist[1] + 6), *std::min_element(dist[2], dist[2] + 6))) < 0.0f)
+            {
+                Clip(inVerts, inAttribs, FEEDBACK_NUM_ATTRIBS, outVerts, &numVerts, outAttribs);
+                if (numVerts < 3)
+                {
+                    continue;
+                }
+            }
+            else
+            {
+                memcpy(outVerts, inVerts, 3 * 4 * sizeof(float));
+                memcpy(outAttribs, inAttribs, 3 * FEEDBACK_NUM_ATTRIBS * sizeof(float));
+                numVerts = 3;
+            }
+        }
+
+        float win[6][4];
+        for (int v = 0; v < numVerts; ++v)
+        {
+            FeedbackWindowCoords(vp, &outVerts[v * 4], win[v]);
+        }
+
+        if (select)
+        {
+            for (int v = 0; v < numVerts; ++v)
+            {
+                minZ = std::min(minZ, win[v][2]);
+                maxZ = std::max(maxZ, win[v][2]);
+            }
+            hit = true;
+            continue;
+        }
+
+        SWR_FEEDBACK_BUFFER &feedback = *state.pFeedback;
+        if (points)
+        {
+            FeedbackWrite(feedback, feedback.pointToken);
+        }
+        else if (lines)
+        {
+            // a strip only resets the line stipple at its first line
+            bool reset = (state.topology == TOP_LINE_LIST) ||
+                         (triIndex == 0 && pa.numPrimsComplete == KNOB_VS_SIMD_WIDTH);
+            FeedbackWrite(feedback, reset ? feedback.lineResetToken : feedback.lineToken);
+        }
+        else
+        {
+            FeedbackWrite(feedback, feedback.polygonToken);
+            FeedbackWrite(feedback, (float)numVerts);
+        }
+
+        for (int v = 0; v < numVerts; ++v)
+        {
+            FeedbackVertex(feedback, win[v], &outAttribs[v * FEEDBACK_NUM_ATTRIBS]);
+        }
+    }
+
+    if (hit)
+    {
+        UpdateSelectHit(*state.pSelectHit, minZ, maxZ);
+    }
+}
+
 void BinTriangles(DRAW_CONTEXT *pDC, PA_STATE &pa, simdvector tri[3], UINT numTris)
 {
     SWR_CONTEXT *pContext = pDC->pContext;
     const RASTSTATE &state = pDC->state.rastState;
     const API_STATE &apiState = pDC->state;
 
+    // select and feedback modes stop after clipping, nothing is binned
+    if (apiState.renderMode != SWR_RENDER_MODE_RENDER)
+    {
+        FeedbackPrims(pDC, pa, numTris);
+        return;
+    }
+
     // Position vectors from the triangles.
     simdvector &v0 = tri[0];
     simdvector &v1 = tri[1];
@@ -324,3 +324,5 @@ void ProcessDrawIndexed(SWR_CONTEXT *pContext, DRAW_CONTEXT *pDC, void *pUserDat
 void ProcessClear(SWR_CONTEXT *pContext, DRAW_CONTEXT *pDC, void *pUserData);
 void ProcessPresent(SWR_CONTEXT *pContext, DRAW_CONTEXT *pDC, void *pUserData);
 void ProcessCopy(SWR_CONTEXT *pContext, DRAW_CONTEXT *pDC, void *pUserData);
+void ProcessUpload(SWR_CONTEXT *pContext, DRAW_CONTEXT *pDC, void *pUserData);
+void ProcessMipGen(SWR_CONTEXT *pContext, DRAW_CONTEXT *pDC, void *pUserData);
@@ -30,11 +30,16 @@
 #define KNOB_MAX_DRAWS_IN_FLIGHT 160
 #define KNOB_MAX_PRIMS_PER_DRAW 49140
 
+// vertex pipeline keys a locked range keeps post-transform vertices for
+#define KNOB_NUM_VERTEX_CACHE_SLOTS 4
+
 #define KNOB_FLOATS_PER_ATTRIBUTE 4
 #define KNOB_ATTRIBUTES_PER_FETCH 1
 
 #define KNOB_MIN_WORK_THREADS 2
+// physical cores left to the api thread (the core it is running on at context creation)
 #define KNOB_WORKER_THREAD_OFFSET 1
+// place workers on SMT siblings once every physical core has one
 #define KNOB_USE_HYPERTHREAD_AS_WORKER
 
 #define KNOB_ENABLE_ASYNC_FLIP
@@ -74,7 +79,7 @@
 
 #define KNOB_WORKER_SPIN_LOOP_COUNT 5000
 
-#define KNOB_ENABLE_NUMA 0
+#define KNOB_ENABLE_NUMA 1
 
 #define KNOB_MACROTILE_X_DIM 128
 #define KNOB_MACROTILE_Y_DIM 128
@@ -108,9 +113,9 @@
 ///////////////////////////////////////////////////////////////////////////////
 // Debug knobs
 ///////////////////////////////////////////////////////////////////////////////
+// rdtsc probes only record while SWR_RDTSC=<start>:<end> selects a frame
+// range; SWR_BUILD_BENCHMARKS compiles them in
 //#define KNOB_ENABLE_RDTSC
-#define KNOB_BUCKETS_START_FRAME 100
-#define KNOB_BUCKETS_END_FRAME 200
 //#define KNOB_VISUALIZE_MACRO_TILES
 //#define KNOB_TOSS_VERTICES				1
 //#define KNOB_TOSS_DRAW					1
@@ -15,26 +15,32 @@
 #include "rdtsc.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
 
 Bucket g_Buckets[KNOB_MAX_NUM_THREADS + 2][MAX_BUCKETS] = {};
-BucketViz g_BucketViz[KNOB_MAX_NUM_THREADS + 2][THREAD_VIZ_MAX_EVENTS] = {};
-UINT32 g_BucketVizCurEvent[KNOB_MAX_NUM_THREADS + 2] = { 0 };
-
-const char *g_BucketNames[MAX_BUCKETS] = { 0 };
+BucketViz g_BucketViz[KNOB_MAX_NUM_THREADS + 2][TRACE_MAX_EVENTS] = {};
+volatile UINT32 g_BucketVizCurEvent[KNOB_MAX_NUM_THREADS + 2] = { 0 };
 
 BucketDef s_BucketDefs[MAX_BUCKETS] = {};
 
 volatile UINT g_CurrentFrame = 0;
-const UINT g_StartFrame = KNOB_BUCKETS_START_FRAME;
-const UINT g_EndFrame = KNOB_BUCKETS_END_FRAME;
+volatile bool g_RdtscEnabled = false;
+UINT g_StartFrame = 0;
+UINT g_EndFrame = 0;
 const char *g_Filename = "rdtsc.txt";
-const char *g_ThreadVizFilename = "rdtsc_viz.csv";
+const char *g_TraceFilename = "rdtsc_trace.json";
+std::string g_TraceFilenameStorage; // owns g_TraceFilename once set by rdtscSetFrameRange
 
-THREAD int tlsThreadId = -1;
+// reference points used to convert rdtsc cycles to trace microseconds
+UINT64 g_TraceStartTsc = 0;
+std::chrono::steady_clock::time_point g_TraceStartTime;
 
-THREAD UINT g_CurLevel = 0;
-THREAD UINT64 g_LevelStart[MAX_BUCKETS] = { 0 };
+THREAD int tlsThreadId = -1;
 
 void defBucket(UINT level, UINT id, const char *name, bool threadViz)
 {
@@ -70,18 +76,77 @@ const char *arrows[] = {
 
 void rdtscInit(int threadId)
 {
-    if (threadId == 0)
+    static bool bucketsDefined = false;
+    if (threadId == 0 && !bucketsDefined)
     {
 #define DEF_BUCKET(level, bucket, viz) defBucket(level, RDTSC_##bucket, #bucket, viz);
 #include "rdtsc_def.h"
+        bucketsDefined = true;
+
+        if (getenv("SWR_RDTSC"))
+        {
+            unsigned startFrame, endFrame;
+            if (sscanf(getenv("SWR_RDTSC"), "%u:%u", &startFrame, &endFrame) == 2 && startFrame < endFrame)
+                rdtscSetFrameRange(startFrame, endFrame, getenv("SWR_RDTSC_TRACE"));
+            else
+                printf("WARNING: SWR_RDTSC could not be parsed, expected <startFrame>:<endFrame>\n");
+        }
     }
     tlsThreadId = threadId;
 }
 
+// Resets the buckets; only called while the workers are idle.
+void rdtscBegin()
+{
+    memset(g_Buckets, 0, sizeof(g_Buckets));
+    for (UINT t = 0; t < KNOB_MAX_NUM_THREADS + 2; ++t)
+    {
+        g_BucketVizCurEvent[t] = 0;
+    }
+
+    g_TraceStartTsc = __rdtsc();
+    g_TraceStartTime = std::chrono::steady_clock::now();
+
+    _ReadWriteBarrier();
+    g_RdtscEnabled = true;
+}
+
+void rdtscSetFrameRange(UINT startFrame, UINT endFrame, const char *traceFilename)
+{
+    g_StartFrame = startFrame;
+    g_EndFrame = endFrame;
+    if (traceFilename)
+    {
+        // the caller's string may not outlive the call
+        g_TraceFilenameStorage = traceFilename;
+        g_TraceFilename = g_TraceFilenameStorage.c_str();
+    }
+
+    g_RdtscEnabled = false;
+    if (g_CurrentFrame >= g_StartFrame && g_CurrentFrame < g_EndFrame)
+    {
+        // range already started; workers may be busy, so start at the next
+        // frame boundary and keep the frame count
+        g_EndFrame += g_CurrentFrame + 1 - g_StartFrame;
+        g_StartFrame = g_CurrentFrame + 1;
+    }
+}
+
+bool rdtscRangeStartsNextFrame()
+{
+    return (g_CurrentFrame + 1 == g_StartFrame) && (g_StartFrame < g_EndFrame);
+}
+
 void rdtscPrint()
 {
     FILE *f = fopen(g_Filename, "w");
 
+    if (f == NULL)
+    {
+        printf("WARNING: could not open %s\n", g_Filename);
+        return;
+    }
+
     UINT numFrames = g_EndFrame - g_StartFrame;
 
     for (UINT t = 0; t < KNOB_MAX_NUM_THREADS + 2; ++t)
@@ -138,33 +203,98 @@ void rdtscPrint()
     }
 
     fclose(f);
+}
+
+const char *TraceCategory(const char *name)
+{
+    if (strncmp(name, "API", 3) == 0)
+        return "api";
+    if (strncmp(name, "FE", 2) == 0)
+        return "frontend";
+    if (strncmp(name, "BE", 2) == 0)
+        return "backend";
+    return "worker";
+}
 
-#ifdef ENABLE_THREAD_VIZ
-    f = fopen(g_ThreadVizFilename, "w");
-    for (UINT i = 0; i < KNOB_MAX_NUM_THREADS + 2; ++i)
+// Writes all recorded begin/end pairs as Chrome trace-event JSON, loadable
+// with chrome://tracing or ui.perfetto.dev.
+void rdtscPrintTrace()
+{
+    FILE *f = fopen(g_TraceFilename, "w");
+    if (f == NULL)
     {
-        for (UINT j = 0; j < g_BucketVizCurEvent[i]; ++j)
+        printf("WARNING: could not open %s\n", g_TraceFilename);
+        return;
+    }
+
+    UINT64 elapsedTsc = __rdtsc() - g_TraceStartTsc;
+    double elapsedUs = (double)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - g_TraceStartTime).count();
+    double cyclesPerUs = (elapsedUs > 0.0) ? (double)elapsedTsc / elapsedUs : 1.0;
+
+    fprintf(f, "{\"displayTimeUnit\":\"ns\",\"otherData\":{\"startFrame\":%u,\"endFrame\":%u,\"cyclesPerUs\":%.3f},\n", g_StartFrame, g_EndFrame, cyclesPerUs);
+    fprintf(f, "\"traceEvents\":[\n");
+
+    bool first = true;
+    std::vector<BucketViz> events;
+    for (UINT t = 0; t < KNOB_MAX_NUM_THREADS + 2; ++t)
+    {
+        // workers may still be retiring the last frame; copy first, then drop
+        // anything the writer lapped while we were copying
+        UINT32 head = g_BucketVizCurEvent[t];
+        if (head == 0)
+            continue;
+
+        UINT32 begin = (head > TRACE_MAX_EVENTS) ? head - TRACE_MAX_EVENTS : 0;
+        events.clear();
+        for (UINT32 i = begin; i < head; ++i)
         {
-            BucketViz &bucket = g_BucketViz[i][j];
-            fprintf(f, "%u,%u,%lu,%lu,%u,%lu,", bucket.bucketId, bucket.frame, bucket.start, bucket.stop, bucket.count, bucket.drawId);
+            events.push_back(g_BucketViz[t][i & (TRACE_MAX_EVENTS - 1)]);
+        }
+        _ReadWriteBarrier();
+        UINT32 newHead = g_BucketVizCurEvent[t];
+        // slot newHead may be half written over the event TRACE_MAX_EVENTS back
+        UINT32 validBegin = (newHead + 1 > TRACE_MAX_EVENTS) ? newHead + 1 - TRACE_MAX_EVENTS : 0;
+
+        fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":\"%s %u\"}}",
+                first ? "" : ",\n", t, (t == 0) ? "API thread" : "Worker thread", t);
+        first = false;
+
+        for (UINT32 i = std::max(begin, validBegin); i < head; ++i)
+        {
+            const BucketViz &event = events[i - begin];
+            if (event.start < g_TraceStartTsc || event.stop < event.start)
+                continue;
+
+            const char *name = s_BucketDefs[event.bucketId].name;
+            fprintf(f, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%u,\"draw\":%llu,\"count\":%u",
+                    name, TraceCategory(name), t,
+                    (double)(event.start - g_TraceStartTsc) / cyclesPerUs,
+                    (double)(event.stop - event.start) / cyclesPerUs,
+                    event.frame, (unsigned long long)event.drawId, event.count);
+            if (event.tileId != TRACE_NO_TILE)
+            {
+                fprintf(f, ",\"tileX\":%u,\"tileY\":%u", event.tileId >> 16, event.tileId & 0xFFFF);
+            }
+            fprintf(f, "}}");
         }
-        fprintf(f, "\n");
     }
 
+    fprintf(f, "\n]}\n");
     fclose(f);
-#endif
 }
 
 void rdtscEndFrame()
 {
     g_CurrentFrame++;
-    if (g_CurrentFrame == g_StartFrame)
+    if (g_CurrentFrame == g_StartFrame && g_StartFrame < g_EndFrame)
     {
-        memset(g_Buckets, 0, sizeof(g_Buckets));
+        rdtscBegin();
     }
 
-    if (g_CurrentFrame == g_EndFrame)
+    if (g_CurrentFrame == g_EndFrame && g_RdtscEnabled)
     {
+        g_RdtscEnabled = false;
         rdtscPrint();
+        rdtscPrintTrace();
     }
 }
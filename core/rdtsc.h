@@ -21,11 +21,11 @@
 
 #include <assert.h>
 
-//#define ENABLE_THREAD_VIZ
-#define THREAD_VIZ_START_FRAME 10
-#define THREAD_VIZ_STOP_FRAME 12
-#define THREAD_VIZ_MAX_EVENTS (8192 * 3)
-#define MAX_BUCKETS 64
+// Events are only recorded while the current frame lies in the profiled range,
+// which is picked at runtime through SWR_RDTSC="<start>:<end>" or
+// rdtscSetFrameRange(). Outside of that range every probe is a single branch.
+#define TRACE_MAX_EVENTS 16384 // per thread, must be a power of 2
+#define MAX_BUCKETS 128
 
 struct Bucket
 {
@@ -42,6 +42,7 @@ struct BucketViz
     UINT64 stop;
     UINT64 drawId;
     UINT32 count;
+    UINT32 tileId;
 };
 
 struct BucketDef
@@ -54,15 +55,15 @@ struct BucketDef
     bool threadViz;
 };
 
+#define TRACE_NO_TILE 0xFFFFFFFF
+
 extern Bucket g_Buckets[KNOB_MAX_NUM_THREADS + 2][MAX_BUCKETS];
-extern BucketViz g_BucketViz[KNOB_MAX_NUM_THREADS + 2][THREAD_VIZ_MAX_EVENTS];
-extern UINT32 g_BucketVizCurEvent[KNOB_MAX_NUM_THREADS + 2];
+extern BucketViz g_BucketViz[KNOB_MAX_NUM_THREADS + 2][TRACE_MAX_EVENTS];
+extern volatile UINT32 g_BucketVizCurEvent[KNOB_MAX_NUM_THREADS + 2];
 extern volatile UINT g_CurrentFrame;
+extern volatile bool g_RdtscEnabled;
 extern BucketDef s_BucketDefs[MAX_BUCKETS];
 
-extern THREAD UINT g_CurLevel;
-extern THREAD UINT64 g_LevelStart[MAX_BUCKETS];
-
 extern THREAD int tlsThreadId;
 
 #undef DEF_BUCKET
@@ -74,53 +75,56 @@ extern THREAD int tlsThreadId;
 #undef DEF_BUCKET
 
 void rdtscInit(int threadId);
+void rdtscSetFrameRange(UINT startFrame, UINT endFrame, const char *traceFilename);
 void rdtscStart(UINT bucketId);
-void rdtscStop(UINT bucketId, UINT count, DRAW_T drawId);
+void rdtscStop(UINT bucketId, UINT count, DRAW_T drawId, UINT tileId);
 void rdtscEvent(UINT bucketId, UINT count1, UINT count2);
 void rdtscEndFrame();
 
+// True if ending the current frame starts the profiled range, which resets
+// the buckets; the caller must wait for the workers to go idle first.
+bool rdtscRangeStartsNextFrame();
+
 #ifdef KNOB_ENABLE_RDTSC
 #define RDTSC_INIT(threadId) rdtscInit(threadId)
 #define RDTSC_START(bucket) rdtscStart(RDTSC_##bucket)
-#define RDTSC_STOP(bucket, count, draw) rdtscStop(RDTSC_##bucket, count, draw)
+#define RDTSC_STOP(bucket, count, draw) rdtscStop(RDTSC_##bucket, count, draw, TRACE_NO_TILE)
+#define RDTSC_STOP_TILE(bucket, count, draw, tile) rdtscStop(RDTSC_##bucket, count, draw, tile)
 #define RDTSC_EVENT(bucket, count1, count2) rdtscEvent(RDTSC_##bucket, count1, count2)
-#define RDTSC_ENDFRAME() rdtscEndFrame()
+#define RDTSC_ENDFRAME(hContext)          \
+    {                                     \
+        if (rdtscRangeStartsNextFrame())  \
+        {                                 \
+            SwrWaitForIdle(hContext);     \
+        }                                 \
+        rdtscEndFrame();                  \
+    }
 #else
 #define RDTSC_INIT(threadId)
 #define RDTSC_START(bucket)
 #define RDTSC_STOP(bucket, count, draw)
+#define RDTSC_STOP_TILE(bucket, count, draw, tile)
 #define RDTSC_EVENT(bucket, count1, count2)
-#define RDTSC_ENDFRAME()
+#define RDTSC_ENDFRAME(hContext)
 #endif
 
 INLINE
 void rdtscStart(UINT bucketId)
 {
+    if (!g_RdtscEnabled)
+        return;
+
     assert(tlsThreadId != -1);
     Bucket &bucket = g_Buckets[tlsThreadId][bucketId];
     bucket.start = __rdtsc();
-
-#ifdef ENABLE_THREAD_VIZ
-    if (g_CurrentFrame < THREAD_VIZ_START_FRAME)
-        return;
-    if (g_CurrentFrame > THREAD_VIZ_STOP_FRAME)
-        return;
-    if (g_BucketVizCurEvent[tlsThreadId] >= THREAD_VIZ_MAX_EVENTS)
-        return;
-    if (!s_BucketDefs[bucketId].threadViz)
-        return;
-
-    // record off start time
-    g_LevelStart[g_CurLevel] = __rdtsc();
-
-    // increment level
-    g_CurLevel++;
-#endif
 }
 
 INLINE
-void rdtscStop(UINT bucketId, UINT count, DRAW_T drawId)
+void rdtscStop(UINT bucketId, UINT count, DRAW_T drawId, UINT tileId)
 {
+    if (!g_RdtscEnabled)
+        return;
+
     assert(tlsThreadId != -1);
     Bucket &bucket = g_Buckets[tlsThreadId][bucketId];
     if (bucket.start == 0)
@@ -130,36 +134,36 @@ void rdtscStop(UINT bucketId, UINT count, DRAW_T drawId)
     bucket.count++;
     bucket.count2 += count;
 
-#ifdef ENABLE_THREAD_VIZ
-    if (g_CurrentFrame < THREAD_VIZ_START_FRAME)
-        return;
-    if (g_CurrentFrame > THREAD_VIZ_STOP_FRAME)
-        return;
-    if (g_BucketVizCurEvent[tlsThreadId] >= THREAD_VIZ_MAX_EVENTS)
-        return;
-    if (g_CurLevel == 0)
-        return;
-    if (!s_BucketDefs[bucketId].threadViz)
-        return;
-
-    BucketViz &bucketViz = g_BucketViz[tlsThreadId][g_BucketVizCurEvent[tlsThreadId]];
-
-    // decrement level
-    g_CurLevel--;
-    bucketViz.start = g_LevelStart[g_CurLevel];
-    bucketViz.stop = __rdtsc();
-    bucketViz.frame = g_CurrentFrame;
-    bucketViz.bucketId = bucketId;
-    bucketViz.count = count;
-    bucketViz.drawId = drawId;
-
-    g_BucketVizCurEvent[tlsThreadId]++;
-#endif
+    if (s_BucketDefs[bucketId].threadViz)
+    {
+        // Each thread owns its ring, so only the head needs to be published.
+        // The exporter reads the head first and discards slots that were
+        // overwritten while it was copying.
+        UINT32 head = g_BucketVizCurEvent[tlsThreadId];
+        BucketViz &bucketViz = g_BucketViz[tlsThreadId][head & (TRACE_MAX_EVENTS - 1)];
+
+        bucketViz.bucketId = bucketId;
+        bucketViz.frame = g_CurrentFrame;
+        bucketViz.start = bucket.start;
+        bucketViz.stop = stop;
+        bucketViz.drawId = drawId;
+        bucketViz.count = count;
+        bucketViz.tileId = tileId;
+
+        _ReadWriteBarrier();
+        g_BucketVizCurEvent[tlsThreadId] = head + 1;
+    }
+
+    // unmatched stops (e.g. profiling switched on mid-interval) are ignored
+    bucket.start = 0;
 }
 
 INLINE
 void rdtscEvent(UINT bucketId, UINT count1, UINT count2)
 {
+    if (!g_RdtscEnabled)
+        return;
+
     assert(tlsThreadId != -1);
     Bucket &bucket = g_Buckets[tlsThreadId][bucketId];
     bucket.count += count1;
@@ -18,6 +18,7 @@ DEF_BUCKET(1, APIDrawWakeAllThreads, 0);
 DEF_BUCKET(0, APIDrawIndexed, 1);
 DEF_BUCKET(0, APIExecuteDisplayList, 0);
 DEF_BUCKET(0, APIOptimizeDisplayList, 0);
+DEF_BUCKET(0, APICompileDisplayList, 0);
 DEF_BUCKET(0, APIPresent, 1);
 DEF_BUCKET(0, APIFlip, 1);
 DEF_BUCKET(0, APIGetDrawContext, 0);
@@ -45,7 +46,7 @@ DEF_BUCKET(2, FEEarlyRast, 0);
 DEF_BUCKET(0, FEProcessPresent, 1);
 DEF_BUCKET(0, WorkerWorkOnFifoBE, 0);
 DEF_BUCKET(1, WorkerFoundWork, 1);
-DEF_BUCKET(2, BEClear, 0);
+DEF_BUCKET(2, BEClear, 1);
 DEF_BUCKET(2, BERasterizeOneTileTri, 0);
 DEF_BUCKET(2, BERasterizeSmallTri, 0);
 DEF_BUCKET(2, BERasterizeLargeTri, 0);
@@ -60,5 +61,7 @@ DEF_BUCKET(3, BEPixelShader, 0);
 DEF_BUCKET(4, BEPixelShaderFunc, 0);
 DEF_BUCKET(4, BilinearSample, 0);
 DEF_BUCKET(2, BEStoreTiles, 1);
-DEF_BUCKET(2, BEProcessCopy, 0);
+DEF_BUCKET(2, BEProcessCopy, 1);
+DEF_BUCKET(2, BEProcessUpload, 1);
+DEF_BUCKET(2, BEProcessMipGen, 1);
 DEF_BUCKET(0, WorkerWaitForThreadEvent, 0);
@@ -43,18 +43,11 @@ void *Allocate(SWR_CONTEXT *pContext, UINT size, UINT align, UINT numaNode)
             size,
             MEM_RESERVE | MEM_COMMIT,
             PAGE_READWRITE,
-            numaNode);
+            pContext->numaNodeIds[numaNode]);
 #else
-        static struct bitmask *nodemask = NULL;
-
-        if (nodemask == NULL)
-            nodemask = numa_bitmask_alloc(sizeof(unsigned long) * 8);
-
-        numa_bitmask_clearall(nodemask);
-        numa_bitmask_setbit(nodemask, numaNode);
-        numa_set_membind(nodemask);
-
-        void *result = numa_alloc_onnode(size, numaNode);
+        // numa_alloc_onnode binds just this range, unlike numa_set_membind which
+        // would also bind every later allocation of the calling thread
+        void *result = numa_alloc_onnode(size, pContext->numaNodeIds[numaNode]);
         assert(result);
 
         return result;
@@ -150,6 +143,53 @@ bool Resource::InUse()
     return (dep > mpContext->LastRetiredId);
 }
 
+// Allocates render target tile data with macro tile rows interleaved across
+// numa nodes, row y on node y % numNumaNodes. Each row is a whole number of
+// pages since the width is padded to KNOB_MACROTILE_X_DIM and a row is
+// KNOB_MACROTILE_Y_DIM lines. The BE schedules tiles on the node that owns
+// them, see MacroTileMgr::getTileNumaNode.
+static BYTE *AllocateTileData(SWR_CONTEXT *pContext, UINT rowSize, UINT numRows)
+{
+    UINT size = rowSize * numRows;
+    if (pContext->numNumaNodes == 1)
+    {
+        return (BYTE *)_aligned_malloc(size, KNOB_VS_SIMD_WIDTH * 4);
+    }
+
+#if defined(_WIN32)
+    BYTE *pData = (BYTE *)VirtualAlloc(NULL, size, MEM_RESERVE, PAGE_READWRITE);
+    for (UINT row = 0; row < numRows; ++row)
+    {
+        VirtualAllocExNuma(GetCurrentProcess(), pData + row * rowSize, rowSize,
+                           MEM_COMMIT, PAGE_READWRITE, pContext->numaNodeIds[row % pContext->numNumaNodes]);
+    }
+#else
+    // pages are only reserved here and get faulted in on the node set per row
+    BYTE *pData = (BYTE *)numa_alloc(size);
+    for (UINT row = 0; row < numRows; ++row)
+    {
+        numa_tonode_memory(pData + row * rowSize, rowSize, pContext->numaNodeIds[row % pContext->numNumaNodes]);
+    }
+#endif
+    assert(pData);
+    return pData;
+}
+
+static void FreeTileData(SWR_CONTEXT *pContext, BYTE *pData, UINT size)
+{
+    if (pContext->numNumaNodes == 1)
+    {
+        _aligned_free(pData);
+        return;
+    }
+
+#if defined(_WIN32)
+    VirtualFree(pData, 0, MEM_RELEASE);
+#else
+    numa_free(pData, size);
+#endif
+}
+
 RENDERTARGET *CreateRenderTarget(SWR_CONTEXT *pContext, UINT width, UINT height, SWR_FORMAT format)
 {
     RENDERTARGET *pRT = (RENDERTARGET *)_aligned_malloc(sizeof(RENDERTARGET), KNOB_VS_SIMD_WIDTH * 4);
@@ -170,7 +210,7 @@ RENDERTARGET *CreateRenderTarget(SWR_CONTEXT *pContext, UINT width, UINT height,
     pRT->height = alignedHeight;
     pRT->widthInBytes = alignedWidth * Bpp;
     pRT->widthInTiles = alignedWidth >> KNOB_TILE_X_DIM_SHIFT;
-    pRT->pTileData = (BYTE *)_aligned_malloc(alignedWidth * alignedHeight * Bpp, KNOB_VS_SIMD_WIDTH * 4);
+    pRT->pTileData = AllocateTileData(pContext, pRT->widthInBytes * macroHeight, alignedHeight / macroHeight);
     pRT->macroWidth = macroWidth << FIXED_POINT_WIDTH;
     pRT->macroHeight = macroHeight << FIXED_POINT_WIDTH;
 
@@ -183,7 +223,7 @@ void DestroyRenderTarget(SWR_CONTEXT *pContext, RENDERTARGET *pRT)
 {
     pRT->Destroy();
 
-    _aligned_free(pRT->pTileData);
+    FreeTileData(pContext, pRT->pTileData, pRT->widthInBytes * pRT->height);
     _aligned_free(pRT);
 }
 
@@ -193,6 +233,10 @@ Texture::Texture()
     mNumPlanes = 0;
     mNumMipLevels = 0;
     mElementSizeInBytes = 0;
+    mBlockDim = 1;
+    mTilingFormat = TF_Linear;
+    mhStorage = 0;
+    mpStorage = NULL;
 }
 
 Texture::Texture(HANDLE hContext, SWR_CREATETEXTURE const &args)
@@ -202,10 +246,10 @@ Texture::Texture(HANDLE hContext, SWR_CREATETEXTURE const &args)
 
 Texture::~Texture()
 {
-    for (std::size_t i = 0, N = mhSubtextures.size(); i != N; ++i)
+    if (mhStorage)
     {
-        SwrDestroyBuffer(mhContext, mhSubtextures[i]);
-        _aligned_free(mSubtextures[i]);
+        SwrDestroyBuffer(mhContext, mhStorage);
+        _aligned_free(mpStorage);
     }
 }
 
@@ -215,11 +259,16 @@ void Texture::Create(HANDLE hContext, SWR_CREATETEXTURE const &args)
     mNumPlanes = std::max(1U, args.planes);
     mNumMipLevels = std::max(1U, args.mipLevels);
     mElementSizeInBytes = args.eltSizeInBytes;
+    mBlockDim = std::max(1U, args.blockDim);
+    mTilingFormat = args.tilingFormat;
+
+    // Tiled subtextures are padded out to whole pages.
+    UINT align = (mTilingFormat == TF_TileZ) ? (1 << TileZShift(mElementSizeInBytes)) : TILE_ALIGN;
 
     mTexelHeight.push_back(args.height);
     mTexelWidth.push_back(args.width);
-    mPhysicalHeight.push_back(ALIGN_UP(mTexelHeight[0] + 1, 8));
-    mPhysicalWidth.push_back(ALIGN_UP(mTexelWidth[0] + 1, 8));
+    mPhysicalHeight.push_back(ALIGN_UP(BlockCount(mTexelHeight[0]) + 1, align));
+    mPhysicalWidth.push_back(ALIGN_UP(BlockCount(mTexelWidth[0]) + 1, align));
 
     UINT actualMipLevels = 1;
     for (UINT i = 1; i < mNumMipLevels; ++i, ++actualMipLevels)
@@ -243,40 +292,42 @@ void Texture::Create(HANDLE hContext, SWR_CREATETEXTURE const &args)
 
         mTexelHeight.push_back(texHeight);
         mTexelWidth.push_back(texWidth);
-        mPhysicalHeight.push_back(ALIGN_UP(mTexelHeight[i] + 1, TILE_ALIGN));
-        mPhysicalWidth.push_back(ALIGN_UP(mTexelWidth[i] + 1, TILE_ALIGN));
+        mPhysicalHeight.push_back(ALIGN_UP(BlockCount(mTexelHeight[i]) + 1, align));
+        mPhysicalWidth.push_back(ALIGN_UP(BlockCount(mTexelWidth[i]) + 1, align));
     }
 
     mNumMipLevels = actualMipLevels;
 
     // There are mNumMipLevels * mNumPlanes Subtextures.
+    UINT size = 0;
     for (UINT p = 0; p < mNumPlanes; ++p)
     {
         for (UINT m = 0; m < mNumMipLevels; ++m)
         {
-            UINT size = mPhysicalWidth[m] * mPhysicalHeight[m] * mElementSizeInBytes;
-            mSubtextures.push_back((data_t *)_aligned_malloc(size, DATA_ALIGN));
-            mhSubtextures.push_back(SwrCreateBufferUP(mhContext, mSubtextures.back()));
+            mSubtextureOffsets.push_back(size);
+            size += ALIGN_UP(mPhysicalWidth[m] * mPhysicalHeight[m] * mElementSizeInBytes, DATA_ALIGN);
         }
     }
+
+    mpStorage = (data_t *)_aligned_malloc(size, DATA_ALIGN);
+    mhStorage = SwrCreateBufferUP(mhContext, mpStorage);
+
+    for (std::size_t i = 0, N = mSubtextureOffsets.size(); i != N; ++i)
+    {
+        mSubtextures.push_back(mpStorage + mSubtextureOffsets[i]);
+    }
 }
 
 void Texture::Lock(SWR_LOCK_FLAGS lockFlags)
 {
     if (lockFlags == LOCK_DONTLOCK)
         return;
-    for (std::size_t i = 0, N = mhSubtextures.size(); i != N; ++i)
-    {
-        SwrLockResource(mhContext, mhSubtextures[i], lockFlags);
-    }
+    SwrLockResource(mhContext, mhStorage, lockFlags);
 }
 
 void Texture::Unlock()
 {
-    for (std::size_t i = 0, N = mhSubtextures.size(); i != N; ++i)
-    {
-        ::SwrUnlock(mhContext, mhSubtextures[i]);
-    }
+    ::SwrUnlock(mhContext, mhStorage);
 }
 
 void Texture::SubtextureInfo(SWR_GETSUBTEXTUREINFO &info)
@@ -298,6 +349,7 @@ void Texture::SubtextureInfo(SWR_GETSUBTEXTUREINFO &info)
     info.texelHeight = mTexelHeight[info.mipLevel];
     info.texelWidth = mTexelWidth[info.mipLevel];
     info.eltSizeInBytes = mElementSizeInBytes;
+    info.tilingFormat = mTilingFormat;
 
     Lock(info.lockFlags);
     if (info.lockFlags != LOCK_DONTLOCK)
@@ -335,6 +387,14 @@ void SwrUnlockTexture(
     reinterpret_cast<Texture *>(hTexture)->Unlock();
 }
 
+BOOL SwrTextureInUse(
+    HANDLE hContext,
+    HANDLE hTexture)
+{
+    UpdateLastRetiredId((SWR_CONTEXT *)hContext);
+    return ((Resource *)reinterpret_cast<Texture *>(hTexture)->mhStorage)->InUse();
+}
+
 void SwrGetSubtextureInfo(
     HANDLE hTexture,
     SWR_GETSUBTEXTUREINFO &getSTI)
@@ -76,6 +76,7 @@ struct Resource
         memset(mAllocRingBuffer, 0, sizeof(mAllocRingBuffer));
         mCurAlloc = 0;
         mIsUP = false;
+        mNumaNode = 0;
 
         if (pUP)
         {
@@ -136,6 +137,45 @@ struct Resource
         return GetCurrentAllocation();
     }
 
+    // Copy-on-write for partial updates: if draws still read the current
+    // alias, move to a free one that starts with its contents. Only waits if
+    // every alias is busy.
+    Allocation *GetRenamedAllocation()
+    {
+        Allocation *pCurAlloc = GetCurrentAllocation();
+        if (!InUse())
+        {
+            return pCurAlloc;
+        }
+
+        if (mIsUP)
+        {
+            WaitForDependencies(pCurAlloc);
+            return pCurAlloc;
+        }
+
+        UINT curAlloc = mCurAlloc;
+        for (UINT i = 0; i < MAX_ALIASES; ++i)
+        {
+            if (i == curAlloc)
+            {
+                continue;
+            }
+
+            mCurAlloc = i;
+            Allocation *pAlloc = GetCurrentAllocation();
+            if (!InUse())
+            {
+                memcpy(pAlloc->pData, pCurAlloc->pData, mSize);
+                return pAlloc;
+            }
+        }
+
+        mCurAlloc = curAlloc;
+        WaitForDependencies(pCurAlloc);
+        return pCurAlloc;
+    }
+
     // @todo keep track of last retired draw id
     bool InUse();
 
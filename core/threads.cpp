@@ -13,9 +13,13 @@
 // limitations under the License.
 
 #include <stdio.h>
+#include <string.h>
 #include <assert.h>
+#include <algorithm>
 #include <bitset>
+#include <map>
 #include <thread>
+#include <vector>
 
 #if defined(__linux__) || defined(__gnu_linux__)
 #include <numa.h>
@@ -31,16 +35,16 @@
 #include "rdtsc.h"
 #include "tilemgr.h"
 
-void bindThread(UINT threadId)
+void bindThread(UINT procId)
 {
 #if defined(_WIN32)
-    DWORD_PTR mask = 1 << threadId;
+    DWORD_PTR mask = (DWORD_PTR)1 << procId;
     DWORD_PTR result = SetThreadAffinityMask(GetCurrentThread(), mask);
 #else
     cpu_set_t cpuset;
     pthread_t thread = pthread_self();
     CPU_ZERO(&cpuset);
-    CPU_SET(threadId, &cpuset);
+    CPU_SET(procId, &cpuset);
 
     pthread_setaffinity_np(thread, sizeof(cpu_set_t), &cpuset);
 #endif
@@ -78,7 +82,7 @@ bool CheckDependency(SWR_CONTEXT *pContext, DRAW_CONTEXT *pDC, DRAW_T lastRetire
 #endif
 }
 
-void WorkOnFifoBE(SWR_CONTEXT *pContext, UINT workerId, DRAW_T curDrawFE, volatile DRAW_T &curDrawBE, std::set<UINT> &usedTiles)
+void WorkOnFifoBE(SWR_CONTEXT *pContext, UINT workerId, DRAW_T curDrawFE, volatile DRAW_T &curDrawBE, std::set<UINT> &usedTiles, UCHAR numaNode)
 {
     // increment our current draw id to the first incomplete draw
     DRAW_T drawEnqueued = GetEnqueuedDraw(pContext);
@@ -110,111 +114,128 @@ void WorkOnFifoBE(SWR_CONTEXT *pContext, UINT workerId, DRAW_T curDrawFE, volati
     // 2. if we're trying to work on draws after curDrawBE, we are restricted to
     //    working on those macro tiles that are known to be complete in the prior draw to
     //    maintain order
-    BBOX prevScissorInTiles(0, 0, 0, 0);
-    usedTiles.clear();
-    for (DRAW_T i = curDrawBE; i < GetEnqueuedDraw(pContext); ++i)
+    // 3. on multi node systems the first pass only takes macro tiles whose render
+    //    target rows live on this worker's node; tiles of other nodes are stolen in a
+    //    second pass only if the first one found nothing to do
+    UINT numPasses = pContext->numNumaNodes > 1 ? 2 : 1;
+    bool foundWork = false;
+    for (UINT pass = 0; pass < numPasses && !foundWork; ++pass)
     {
-        DRAW_CONTEXT *pDC = &pContext->dcRing[i % KNOB_MAX_DRAWS_IN_FLIGHT];
-        if (!pDC->doneFE)
-            break;
-
-        // check dependencies
-        if (CheckDependency(pContext, pDC, lastRetiredDraw))
-        {
-            return;
-        }
-
-        // can't move on to this draw if scissor/viewport rectangle has changed
-        if (prevScissorInTiles != BBOX(0, 0, 0, 0) && prevScissorInTiles != pDC->state.scissorInTiles)
-        {
-            return;
-        }
-
-        // loop across all used macro tiles
-        std::vector<UINT> &macroTiles = pDC->pTileMgr->getUsedTiles();
-
-        for (UINT idx = 0; idx < macroTiles.size(); ++idx)
+        bool stealing = (pass == 1);
+        BBOX prevScissorInTiles(0, 0, 0, 0);
+        usedTiles.clear();
+        for (DRAW_T i = curDrawBE; i < GetEnqueuedDraw(pContext); ++i)
         {
-            UINT tileID = macroTiles[idx];
-            MacroTile &tile = pDC->pTileMgr->getMacroTile(tileID);
+            DRAW_CONTEXT *pDC = &pContext->dcRing[i % KNOB_MAX_DRAWS_IN_FLIGHT];
+            if (!pDC->doneFE)
+                break;
 
-            // is macro tile complete?
-            if (tile.m_WorkItemsBE == tile.m_WorkItemsFE)
+            // check dependencies
+            if (CheckDependency(pContext, pDC, lastRetiredDraw))
             {
-                usedTiles.insert(tileID);
-                continue;
+                return;
             }
 
-            // has this thread completed this tile in previous draws?
-            if ((i != curDrawBE) && (usedTiles.find(tileID) == usedTiles.end()))
+            // can't move on to this draw if scissor/viewport rectangle has changed
+            if (prevScissorInTiles != BBOX(0, 0, 0, 0) && prevScissorInTiles != pDC->state.scissorInTiles)
             {
-                continue;
+                break;
             }
 
-            if (tile.m_Fifo.getNumQueued() && tile.m_Fifo.tryLock())
-            {
+            // loop across all used macro tiles
+            std::vector<UINT> &macroTiles = pDC->pTileMgr->getUsedTiles();
 
-#if KNOB_VERTICALIZED_BINNER
-                VERT_BE_WORK *pWork;
-#else
-                BE_WORK *pWork;
-#endif
-
-                usedTiles.insert(tileID);
+            for (UINT idx = 0; idx < macroTiles.size(); ++idx)
+            {
+                UINT tileID = macroTiles[idx];
+                MacroTile &tile = pDC->pTileMgr->getMacroTile(tileID);
 
-                // this solves a race condition where a worker thread 'clears' a macrotile
-                // which resets the lock, and another thread now sees a cleared lock and
-                // is able to lock it again.  Once locked, check if there is any actual
-                // work and if not, free the lock and move on.
-                if (tile.m_Fifo.getNumQueued() == 0)
+                // is macro tile complete?
+                if (tile.m_WorkItemsBE == tile.m_WorkItemsFE)
                 {
-                    tile.m_Fifo.mLock = 0;
+                    usedTiles.insert(tileID);
                     continue;
                 }
 
-                RDTSC_START(WorkerFoundWork);
-
-                UINT numWorkItems = tile.m_Fifo.getNumQueued();
-                while ((pWork = tile.m_Fifo.peek()) != NULL)
+                // has this thread completed this tile in previous draws?
+                if ((i != curDrawBE) && (usedTiles.find(tileID) == usedTiles.end()))
                 {
-                    pWork->pfnWork(pDC, tileID, &pWork->desc);
-                    tile.m_Fifo.dequeue_noinc();
+                    continue;
                 }
-                RDTSC_STOP(WorkerFoundWork, numWorkItems, pDC->drawId);
 
-                _ReadWriteBarrier();
+                // leave tiles owned by other nodes to their workers unless stealing
+                if (!stealing && numPasses > 1 &&
+                    MacroTileMgr::getTileNumaNode(tileID, pContext->numNumaNodes) != numaNode)
+                {
+                    continue;
+                }
 
-                // is the draw complete?
-                if (pDC->pTileMgr->markTileComplete(tileID))
+                if (tile.m_Fifo.getNumQueued() && tile.m_Fifo.tryLock())
                 {
-                    // we completed the draw, call end of draw callback
-                    if (pDC->pfnCallbackFunc)
+
+#if KNOB_VERTICALIZED_BINNER
+                    VERT_BE_WORK *pWork;
+#else
+                    BE_WORK *pWork;
+#endif
+
+                    usedTiles.insert(tileID);
+
+                    // this solves a race condition where a worker thread 'clears' a macrotile
+                    // which resets the lock, and another thread now sees a cleared lock and
+                    // is able to lock it again.  Once locked, check if there is any actual
+                    // work and if not, free the lock and move on.
+                    if (tile.m_Fifo.getNumQueued() == 0)
                     {
-                        pDC->pfnCallbackFunc(pDC);
+                        tile.m_Fifo.mLock = 0;
+                        continue;
                     }
 
-                    _ReadWriteBarrier();
+                    foundWork = true;
+                    RDTSC_START(WorkerFoundWork);
 
-                    // increment current BE if we're the oldest draw
-                    // we can also safely move on to the next draw
-                    if (curDrawBE == i)
+                    UINT numWorkItems = tile.m_Fifo.getNumQueued();
+                    while ((pWork = tile.m_Fifo.peek()) != NULL)
                     {
-                        curDrawBE++;
-                        lastRetiredDraw++;
+                        pWork->pfnWork(pDC, tileID, &pWork->desc);
+                        tile.m_Fifo.dequeue_noinc();
+                    }
+                    RDTSC_STOP_TILE(WorkerFoundWork, numWorkItems, pDC->drawId, tileID);
+
+                    _ReadWriteBarrier();
 
-                        usedTiles.clear();
-                        break;
+                    // is the draw complete?
+                    if (pDC->pTileMgr->markTileComplete(tileID))
+                    {
+                        // we completed the draw, call end of draw callback
+                        if (pDC->pfnCallbackFunc)
+                        {
+                            pDC->pfnCallbackFunc(pDC);
+                        }
+
+                        _ReadWriteBarrier();
+
+                        // increment current BE if we're the oldest draw
+                        // we can also safely move on to the next draw
+                        if (curDrawBE == i)
+                        {
+                            curDrawBE++;
+                            lastRetiredDraw++;
+
+                            usedTiles.clear();
+                            break;
+                        }
                     }
                 }
+                else
+                {
+                    // tried to lock a tile we previously worked on, but it's already taken.
+                    // remove from our used tiles set
+                    usedTiles.erase(tileID);
+                }
             }
-            else
-            {
-                // tried to lock a tile we previously worked on, but it's already taken.
-                // remove from our used tiles set
-                usedTiles.erase(tileID);
-            }
+            prevScissorInTiles = pDC->state.scissorInTiles;
         }
-        prevScissorInTiles = pDC->state.scissorInTiles;
     }
 }
 
@@ -323,7 +344,7 @@ THREAD UINT tls_FeWorkBackoffCounter = 0;
 
 UINT GetPreferredNumaNode(DRAW_CONTEXT *pDC, UINT numaNode)
 {
-    if (pDC->FeWork.type == DRAW)
+    if (pDC->FeWork.type == DRAW && pDC->state.ppVertexBuffer[0])
     {
         if (tls_FeWorkBackoffCounter <= KNOB_FE_BACKOFF_COUNT)
         {
@@ -382,32 +403,18 @@ void WorkOnFifoFE(SWR_CONTEXT *pContext, UINT workerId, volatile DRAW_T &curDraw
 #endif
 }
 
-#if defined(__linux__) || defined(__gnu_linux__)
-void GetNumaProcessorNode(int threadId, UCHAR *numaNode)
-{
-    *numaNode = numa_node_of_cpu(threadId);
-}
-#endif
-
 DWORD workerThread(LPVOID pData)
 {
     THREAD_DATA *pThreadData = (THREAD_DATA *)pData;
     SWR_CONTEXT *pContext = pThreadData->pContext;
-    UINT threadId = pThreadData->threadId;
     UINT workerId = pThreadData->workerId;
 
-    bindThread(threadId);
+    bindThread(pThreadData->procId);
 
-    RDTSC_INIT(threadId);
+    RDTSC_INIT(pThreadData->threadId);
 
-#if KNOB_ENABLE_NUMA && (defined(__linux__) || defined(__gnu_linux__))
-    int numaNode = threadId % pContext->numNumaNodes;
-    numa_run_on_node(numaNode);
-#else
-    // query NUMA node for this thread
-    UCHAR numaNode;
-    GetNumaProcessorNode(threadId, &numaNode);
-#endif
+    // the worker is already bound to a processor on this node
+    UCHAR numaNode = (UCHAR)pThreadData->numaNode;
 
     std::set<UINT> usedTiles;
 
@@ -461,7 +468,7 @@ DWORD workerThread(LPVOID pData)
         }
 
         RDTSC_START(WorkerWorkOnFifoBE);
-        WorkOnFifoBE(pContext, workerId, pContext->WorkerFE[workerId], pContext->WorkerBE[workerId], usedTiles);
+        WorkOnFifoBE(pContext, workerId, pContext->WorkerFE[workerId], pContext->WorkerBE[workerId], usedTiles, numaNode);
         RDTSC_STOP(WorkerWorkOnFifoBE, 0, 0);
 
         WorkOnFifoFE(pContext, workerId, pContext->WorkerFE[workerId], numaNode);
@@ -469,26 +476,356 @@ DWORD workerThread(LPVOID pData)
     return 0;
 }
 
-void createThreadPool(SWR_CONTEXT *pContext, THREAD_POOL *pPool)
+// A physical core available to this process and the logical processors
+// (SMT siblings) on it.
+struct CORE_INFO
+{
+    UINT numaNode;
+    std::vector<UINT> procIds;
+};
+
+static bool CoreNodeLess(const CORE_INFO &a, const CORE_INFO &b)
+{
+    return a.numaNode < b.numaNode;
+}
+
+#if defined(__linux__) || defined(__gnu_linux__)
+static bool ReadSysfsTopology(UINT procId, const char *name, UINT &value)
+{
+    char path[128];
+    sprintf(path, "/sys/devices/system/cpu/cpu%u/topology/%s", procId, name);
+    FILE *pFile = fopen(path, "r");
+    if (pFile == NULL)
+    {
+        return false;
+    }
+    bool result = fscanf(pFile, "%u", &value) == 1;
+    fclose(pFile);
+    return result;
+}
+
+// Looks up this process's cgroup path in /proc/self/cgroup, for the given v1
+// controller or, when controller is NULL, for the unified v2 hierarchy.
+static bool GetCgroupPath(const char *controller, char *path, size_t size)
+{
+    FILE *pFile = fopen("/proc/self/cgroup", "r");
+    if (pFile == NULL)
+    {
+        return false;
+    }
+
+    // each line is "hierarchy-id:controller-list:path"
+    char line[512];
+    bool found = false;
+    while (!found && fgets(line, sizeof(line), pFile))
+    {
+        char *controllers = strchr(line, ':');
+        char *cgroup = controllers ? strchr(controllers + 1, ':') : NULL;
+        if (cgroup == NULL)
+        {
+            continue;
+        }
+        *controllers++ = 0;
+        *cgroup++ = 0;
+        cgroup[strcspn(cgroup, "\r\n")] = 0;
+
+        if (controller == NULL)
+        {
+            found = strcmp(line, "0") == 0 && *controllers == 0;
+        }
+        else
+        {
+            char *save;
+            for (char *name = strtok_r(controllers, ",", &save); name && !found; name = strtok_r(NULL, ",", &save))
+            {
+                found = strcmp(name, controller) == 0;
+            }
+        }
+
+        if (found)
+        {
+            snprintf(path, size, "%s", strcmp(cgroup, "/") == 0 ? "" : cgroup);
+        }
+    }
+    fclose(pFile);
+    return found;
+}
+
+static bool ReadCgroupCpuMax(const char *dir, long long &quota, long long &period)
+{
+    char path[640];
+    snprintf(path, sizeof(path), "%s/cpu.max", dir);
+    FILE *pFile = fopen(path, "r");
+    if (pFile == NULL)
+    {
+        return false;
+    }
+    char max[32];
+    if (fscanf(pFile, "%31s %lld", max, &period) == 2 && strcmp(max, "max") != 0)
+    {
+        quota = atoll(max);
+    }
+    fclose(pFile);
+    return true;
+}
+
+static bool ReadCgroupCfsQuota(const char *dir, long long &quota, long long &period)
+{
+    char path[640];
+    snprintf(path, sizeof(path), "%s/cpu.cfs_quota_us", dir);
+    FILE *pFile = fopen(path, "r");
+    if (pFile == NULL)
+    {
+        return false;
+    }
+    if (fscanf(pFile, "%lld", &quota) != 1)
+    {
+        quota = -1;
+    }
+    fclose(pFile);
+
+    snprintf(path, sizeof(path), "%s/cpu.cfs_period_us", dir);
+    if ((pFile = fopen(path, "r")) != NULL)
+    {
+        if (fscanf(pFile, "%lld", &period) != 1)
+        {
+            period = 0;
+        }
+        fclose(pFile);
+    }
+    return true;
+}
+
+// Returns the number of cpus allowed by the cgroup cpu bandwidth quota
+// (cgroup v2 cpu.max or v1 cpu.cfs_quota_us) of the cgroup this process
+// belongs to, or 0 if unlimited.
+static UINT GetCgroupCpuQuota()
+{
+    long long quota = -1, period = 0;
+    char cgroup[512];
+    char dir[600];
+    bool found = false;
+
+    if (GetCgroupPath(NULL, cgroup, sizeof(cgroup)))
+    {
+        snprintf(dir, sizeof(dir), "/sys/fs/cgroup%s", cgroup);
+        found = ReadCgroupCpuMax(dir, quota, period);
+    }
+    if (!found && GetCgroupPath("cpu", cgroup, sizeof(cgroup)))
+    {
+        snprintf(dir, sizeof(dir), "/sys/fs/cgroup/cpu%s", cgroup);
+        found = ReadCgroupCfsQuota(dir, quota, period);
+    }
+
+    // cgroup namespaces mount the process's own cgroup at the root
+    if (!found)
+    {
+        found = ReadCgroupCpuMax("/sys/fs/cgroup", quota, period) ||
+                ReadCgroupCfsQuota("/sys/fs/cgroup/cpu", quota, period);
+    }
+
+    if (quota <= 0 || period <= 0)
+    {
+        return 0;
+    }
+    return (UINT)((quota + period - 1) / period);
+}
+#endif
+
+// Builds the list of physical cores the process may run on, sorted by numa
+// node. Only processors in the process affinity mask are included, so a
+// cpuset restricted container never gets workers pinned outside of it.
+static void CalculateProcessorTopology(std::vector<CORE_INFO> &cores)
 {
-    // main api thread affinitized to core 0 always
-    bindThread(0);
+    cores.clear();
 
-    // This returns zero on Centos 6.5
-    UINT numThreads = std::thread::hardware_concurrency();
-    if (numThreads == 0)
+#if defined(_WIN32)
+    DWORD_PTR processMask, systemMask;
+    if (!GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask))
     {
-#ifdef _WIN32
-        SYSTEM_INFO sysinfo;
-        GetSystemInfo(&sysinfo);
-        numThreads = sysinfo.dwNumberOfProcessors;
+        processMask = (DWORD_PTR)-1;
+    }
+
+    SYSTEM_LOGICAL_PROCESSOR_INFORMATION procInfo[128];
+    DWORD length = sizeof(procInfo);
+    if (GetLogicalProcessorInformation(procInfo, &length))
+    {
+        UINT numEntries = length / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION);
+        for (UINT i = 0; i < numEntries; ++i)
+        {
+            if (procInfo[i].Relationship != RelationProcessorCore)
+            {
+                continue;
+            }
+
+            CORE_INFO core;
+            core.numaNode = 0;
+            for (UINT p = 0; p < sizeof(DWORD_PTR) * 8; ++p)
+            {
+                DWORD_PTR bit = (DWORD_PTR)1 << p;
+                if ((procInfo[i].ProcessorMask & processMask & bit) == 0)
+                {
+                    continue;
+                }
+                core.procIds.push_back(p);
+
+                for (UINT n = 0; n < numEntries; ++n)
+                {
+                    if (procInfo[n].Relationship == RelationNumaNode && (procInfo[n].ProcessorMask & bit))
+                    {
+                        core.numaNode = procInfo[n].NumaNode.NodeNumber;
+                    }
+                }
+            }
+            if (!core.procIds.empty())
+            {
+                cores.push_back(core);
+            }
+        }
+    }
 #else
-        numThreads = sysconf(_SC_NPROCESSORS_ONLN);
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    if (sched_getaffinity(getpid(), sizeof(cpuset), &cpuset) != 0)
+    {
+        UINT numProcs = sysconf(_SC_NPROCESSORS_ONLN);
+        for (UINT p = 0; p < numProcs && p < CPU_SETSIZE; ++p)
+        {
+            CPU_SET(p, &cpuset);
+        }
+    }
+
+    bool haveNuma = numa_available() >= 0;
+    std::map<UINT64, UINT> coreIndex;
+    for (UINT p = 0; p < CPU_SETSIZE; ++p)
+    {
+        if (!CPU_ISSET(p, &cpuset))
+        {
+            continue;
+        }
+
+        // without sysfs every logical processor is treated as its own core
+        UINT package, coreId;
+        if (!ReadSysfsTopology(p, "physical_package_id", package) || !ReadSysfsTopology(p, "core_id", coreId))
+        {
+            package = 0xFFFFFFFF;
+            coreId = p;
+        }
+
+        UINT64 key = ((UINT64)package << 32) | coreId;
+        std::map<UINT64, UINT>::iterator it = coreIndex.find(key);
+        if (it == coreIndex.end())
+        {
+            CORE_INFO core;
+            int node = haveNuma ? numa_node_of_cpu(p) : 0;
+            core.numaNode = node < 0 ? 0 : node;
+            it = coreIndex.insert(std::make_pair(key, (UINT)cores.size())).first;
+            cores.push_back(core);
+        }
+        cores[it->second].procIds.push_back(p);
+    }
 #endif
+
+    if (cores.empty())
+    {
+        UINT numProcs = std::thread::hardware_concurrency();
+        for (UINT p = 0; p < std::max(numProcs, 1U); ++p)
+        {
+            CORE_INFO core;
+            core.numaNode = 0;
+            core.procIds.push_back(p);
+            cores.push_back(core);
+        }
     }
 
+    std::stable_sort(cores.begin(), cores.end(), CoreNodeLess);
+}
+
+static UINT GetCurrentProcessorId()
+{
+#if defined(_WIN32)
+    return GetCurrentProcessorNumber();
+#else
+    int procId = sched_getcpu();
+    return procId < 0 ? 0 : procId;
+#endif
+}
+
+void createThreadPool(SWR_CONTEXT *pContext, THREAD_POOL *pPool)
+{
+    std::vector<CORE_INFO> cores;
+    CalculateProcessorTopology(cores);
+
+    // The api thread is pinned to the processor it is running on and the
+    // workers are kept off that core.
+    UINT apiProcId = GetCurrentProcessorId();
+    UINT apiCore = 0xFFFFFFFF;
+    if (KNOB_WORKER_THREAD_OFFSET > 0 && cores.size() > 1)
+    {
+        for (UINT c = 0; c < cores.size(); ++c)
+        {
+            if (std::find(cores[c].procIds.begin(), cores[c].procIds.end(), apiProcId) != cores[c].procIds.end())
+            {
+                apiCore = c;
+            }
+        }
+        if (apiCore != 0xFFFFFFFF)
+        {
+            bindThread(apiProcId);
+        }
+    }
+
+    // One worker per physical core first, then SMT siblings, then regrouped so
+    // workers on the same numa node have contiguous worker ids. Within each SMT
+    // level the slots alternate between numa nodes, so a pool truncated to fewer
+    // workers than slots still spreads over every node.
+    struct WORKER_SLOT
+    {
+        UINT procId;
+        UINT numaNode;
+        UINT rank;
+        bool operator<(const WORKER_SLOT &rhs) const
+        {
+            return numaNode < rhs.numaNode;
+        }
+        static bool RankLess(const WORKER_SLOT &a, const WORKER_SLOT &b)
+        {
+            return a.rank < b.rank;
+        }
+    };
+    std::vector<WORKER_SLOT> slots;
+    for (UINT smt = 0;; ++smt)
+    {
+        UINT added = 0;
+        std::map<UINT, UINT> nodeRank;
+        for (UINT c = 0; c < cores.size(); ++c)
+        {
+            if (c != apiCore && smt < cores[c].procIds.size())
+            {
+                WORKER_SLOT slot = { cores[c].procIds[smt], cores[c].numaNode, nodeRank[cores[c].numaNode]++ };
+                slots.push_back(slot);
+                added++;
+            }
+        }
+        std::stable_sort(slots.end() - added, slots.end(), WORKER_SLOT::RankLess);
+        if (added == 0)
+        {
+            break;
+        }
 #ifndef KNOB_USE_HYPERTHREAD_AS_WORKER
-    pPool->numThreads /= 2;
+        // one worker per physical core only
+        break;
+#endif
+    }
+
+    UINT numThreads = (UINT)slots.size();
+
+#if defined(__linux__) || defined(__gnu_linux__)
+    UINT quota = GetCgroupCpuQuota();
+    if (quota > 0 && quota < numThreads + KNOB_WORKER_THREAD_OFFSET)
+    {
+        numThreads = quota > KNOB_WORKER_THREAD_OFFSET ? quota - KNOB_WORKER_THREAD_OFFSET : 0;
+    }
 #endif
 
     if (numThreads > KNOB_MAX_NUM_THREADS)
@@ -499,37 +836,63 @@ void createThreadPool(SWR_CONTEXT *pContext, THREAD_POOL *pPool)
     }
 
     pPool->numThreads = std::max((UINT)KNOB_MIN_WORK_THREADS,
-                                 std::min(numThreads - KNOB_WORKER_THREAD_OFFSET,
-                                          (UINT)KNOB_MAX_NUM_THREADS));
+                                 std::min(numThreads, (UINT)KNOB_MAX_NUM_THREADS));
 
     if (getenv("SWR_WORKER_THREADS"))
     {
         unsigned swrThreads;
         if (sscanf(getenv("SWR_WORKER_THREADS"), "%u", &swrThreads) == 1)
             pPool->numThreads = std::max((UINT)KNOB_MIN_WORK_THREADS,
-                                         swrThreads);
+                                         std::min(swrThreads, (UINT)KNOB_MAX_NUM_THREADS));
         else
             printf("WARNING: SWR_WORKER_THREADS could not be parsed\n");
     }
 
+    // oversubscribed pools wrap around the available processors
+    if (slots.empty())
+    {
+        WORKER_SLOT slot = { apiProcId, 0, 0 };
+        slots.push_back(slot);
+    }
+    if (pPool->numThreads < slots.size())
+    {
+        slots.resize(pPool->numThreads);
+    }
+    std::stable_sort(slots.begin(), slots.end());
+
     pContext->NumWorkerThreads = pPool->numThreads;
 
+    // Number the nodes of the slots in use; the slots are sorted by node.
+    std::vector<UINT> nodeIndex(slots.size());
+    pContext->numNumaNodes = 0;
+    for (UINT i = 0; i < std::min((UINT)slots.size(), pPool->numThreads); ++i)
+    {
+        if (pContext->numNumaNodes == 0 || pContext->numaNodeIds[pContext->numNumaNodes - 1] != slots[i].numaNode)
+        {
+            pContext->numaNodeIds[pContext->numNumaNodes++] = slots[i].numaNode;
+        }
+        nodeIndex[i] = KNOB_ENABLE_NUMA ? pContext->numNumaNodes - 1 : 0;
+    }
+#if !KNOB_ENABLE_NUMA
+    pContext->numNumaNodes = 1;
+#endif
+
     pPool->inThreadShutdown = false;
     pPool->pThreadData = (THREAD_DATA *)malloc(pPool->numThreads * sizeof(THREAD_DATA));
     for (UINT i = 0; i < pPool->numThreads; ++i)
     {
+        UINT slotIndex = i % slots.size();
+        const WORKER_SLOT &slot = slots[slotIndex];
         pPool->pThreadData[i].workerId = i;
-#ifdef KNOB_USE_HYPERTHREAD_AS_WORKER
-        pPool->pThreadData[i].threadId = i + KNOB_WORKER_THREAD_OFFSET;
-#else
-        pPool->pThreadData[i].threadId = i * 2 + KNOB_WORKER_THREAD_OFFSET;
-#endif
+        pPool->pThreadData[i].threadId = i + 1;
+        pPool->pThreadData[i].procId = slot.procId;
+        pPool->pThreadData[i].numaNode = nodeIndex[slotIndex];
         pPool->pThreadData[i].pContext = pContext;
         pPool->threads[i] = new std::thread(workerThread, &pPool->pThreadData[i]);
 
         if (pContext->dumpPoolInfo)
         {
-            printf("Created worker thread %u\n", pPool->pThreadData[i].threadId);
+            printf("Created worker thread %u on processor %u, numa node %u\n", i, slot.procId, slot.numaNode);
         }
     }
 }
@@ -23,8 +23,10 @@ struct SWR_CONTEXT;
 
 struct THREAD_DATA
 {
-    UINT threadId;
+    UINT threadId; // rdtsc slot, 0 is the api thread
     UINT workerId;
+    UINT procId;   // logical processor the worker is bound to
+    UINT numaNode;
     SWR_CONTEXT *pContext;
 };
 
@@ -42,5 +44,5 @@ void destroyThreadPool(SWR_CONTEXT *pContext, THREAD_POOL *pPool);
 // Expose FE and BE worker functions to the API thread if single threaded
 #if KNOB_SINGLE_THREADED
 void WorkOnFifoFE(SWR_CONTEXT *pContext, UINT workerId, volatile DRAW_T &curDrawFE, UCHAR numaNode);
-void WorkOnFifoBE(SWR_CONTEXT *pContext, UINT workerId, DRAW_T curDrawFE, volatile DRAW_T &curDrawBE, std::set<UINT> &usedTiles);
+void WorkOnFifoBE(SWR_CONTEXT *pContext, UINT workerId, DRAW_T curDrawFE, volatile DRAW_T &curDrawBE, std::set<UINT> &usedTiles, UCHAR numaNode);
 #endif
@@ -85,6 +85,15 @@ public:
         x = (tileID >> 16) & 0xffff;
     }
 
+    // render target memory is interleaved across numa nodes by macro tile row,
+    // see CreateRenderTarget
+    static INLINE UINT getTileNumaNode(UINT tileID, UINT numNodes)
+    {
+        UINT x, y;
+        getTileIndices(tileID, x, y);
+        return y % numNodes;
+    }
+
 private:
     SWR_FORMAT m_Format;
     UINT m_TileWidth;
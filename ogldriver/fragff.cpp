@@ -110,11 +110,11 @@ struct FragFF
     enum
     {
         NUM_INTERPOLANTS = 1 + NUM_TEXTURES,   // 1 color, NUM_TEXTURES textures
-        NUM_ATTRIBUTES = 4 + 2 * NUM_TEXTURES, // 4 color, 2 * NUM_TEXTURES textures
+        NUM_ATTRIBUTES = 4 + 4 * NUM_TEXTURES, // 4 color, 4 * NUM_TEXTURES textures (s, t, r for cube maps, q for compare)
         DO_PERSPECTIVE = 1,
     };
 
-    typedef WideVector<FragFF<NUM_TEXTURES>::NUM_ATTRIBUTES, simdscalar> WV;
+    typedef WideVector<FragFF<NUM_TEXTURES>::NUM_ATTRIBUTES, simdscalar_t> WV;
 
     static const UINT SIGNATURE[NUM_INTERPOLANTS];
 
@@ -126,21 +126,21 @@ struct FragFF
 template <>
 const UINT FragFF<0>::SIGNATURE[1] = { 4 };
 template <>
-const UINT FragFF<1>::SIGNATURE[2] = { 4, 2 };
+const UINT FragFF<1>::SIGNATURE[2] = { 4, 4 };
 template <>
-const UINT FragFF<2>::SIGNATURE[3] = { 4, 2, 2 };
+const UINT FragFF<2>::SIGNATURE[3] = { 4, 4, 4 };
 template <>
-const UINT FragFF<3>::SIGNATURE[4] = { 4, 2, 2, 2 };
+const UINT FragFF<3>::SIGNATURE[4] = { 4, 4, 4, 4 };
 template <>
-const UINT FragFF<4>::SIGNATURE[5] = { 4, 2, 2, 2, 2 };
+const UINT FragFF<4>::SIGNATURE[5] = { 4, 4, 4, 4, 4 };
 template <>
-const UINT FragFF<5>::SIGNATURE[6] = { 4, 2, 2, 2, 2, 2 };
+const UINT FragFF<5>::SIGNATURE[6] = { 4, 4, 4, 4, 4, 4 };
 template <>
-const UINT FragFF<6>::SIGNATURE[7] = { 4, 2, 2, 2, 2, 2, 2 };
+const UINT FragFF<6>::SIGNATURE[7] = { 4, 4, 4, 4, 4, 4, 4 };
 template <>
-const UINT FragFF<7>::SIGNATURE[8] = { 4, 2, 2, 2, 2, 2, 2, 2 };
+const UINT FragFF<7>::SIGNATURE[8] = { 4, 4, 4, 4, 4, 4, 4, 4 };
 template <>
-const UINT FragFF<8>::SIGNATURE[9] = { 4, 2, 2, 2, 2, 2, 2, 2, 2 };
+const UINT FragFF<8>::SIGNATURE[9] = { 4, 4, 4, 4, 4, 4, 4, 4, 4 };
 
 // assumptions
 // textures are RGBA
@@ -148,27 +148,206 @@ const UINT FragFF<8>::SIGNATURE[9] = { 4, 2, 2, 2, 2, 2, 2, 2, 2 };
 //
 //
 
+// Samples every bound slot up front, the combiner crossbar lets any unit source any other unit's texel.
 template <UINT NUM_TEXTURES, UINT INDEX = NUM_TEXTURES>
 struct MySample
 {
-    typedef WideVector<FragFF<NUM_TEXTURES>::NUM_ATTRIBUTES, simdscalar> WV;
+    typedef WideVector<FragFF<NUM_TEXTURES>::NUM_ATTRIBUTES, simdscalar_t> WV;
 
-    static INLINE WideColor sample(const SWR_TRIANGLE_DESC &work, const OGL::SaveableState &state, WV const &pAttrs, WideColor &fragColor)
+    static INLINE void sample(const SWR_TRIANGLE_DESC &work, WV const &pAttrs, WideColor *texColors)
     {
-        fragColor = MySample<NUM_TEXTURES, INDEX - 1>::sample(work, state, pAttrs, fragColor);
+        MySample<NUM_TEXTURES, INDEX - 1>::sample(work, pAttrs, texColors);
 
         TexCoord tcidx;
         const TextureView &tv = *(const TextureView *)work.pTextureViews[INDEX - 1];
         const Sampler &samp = *(const Sampler *)work.pSamplers[INDEX - 1];
 
-        const OGL::TextureUnit &texUnit = state.mTexUnit[INDEX - 1];
-        tcidx.U = get<4 + (INDEX - 1) * 2>(pAttrs);
-        tcidx.V = get<5 + (INDEX - 1) * 2>(pAttrs);
-        UINT mips[] = { 0, 0, 0, 0 };
-        WideColor texColor;
-        SampleSimplePointRGBAF32(tv, samp, tcidx, mips, texColor);
+        tcidx.U = get<4 + (INDEX - 1) * 4>(pAttrs);
+        tcidx.V = get<5 + (INDEX - 1) * 4>(pAttrs);
+        tcidx.W = get<6 + (INDEX - 1) * 4>(pAttrs);
+        SampleQuadProj(tv, samp, tcidx, get<7 + (INDEX - 1) * 4>(pAttrs), texColors[INDEX - 1]);
+    }
+};
+
+template <UINT NUM_TEXTURES>
+struct MySample<NUM_TEXTURES, 0>
+{
+    typedef WideVector<FragFF<NUM_TEXTURES>::NUM_ATTRIBUTES, simdscalar_t> WV;
+
+    static INLINE void sample(const SWR_TRIANGLE_DESC &work, WV const &pAttrs, WideColor *texColors)
+    {
+    }
+};
+
+// Inputs visible to a unit's combiner.
+struct CombineInputs
+{
+    const WideColor *pTexColors;
+    const UINT *pUnitSlot;
+    WideColor primary;
+    WideColor constant;
+    WideColor previous;
+    UINT slot;
+};
+
+INLINE const WideColor &CombineSource(GLenum source, const CombineInputs &in)
+{
+    switch (source)
+    {
+    case GL_TEXTURE:
+        return in.pTexColors[in.slot];
+    case GL_CONSTANT:
+        return in.constant;
+    case GL_PRIMARY_COLOR:
+        return in.primary;
+    case GL_PREVIOUS:
+        return in.previous;
+    default:
+    {
+        // XXX: sourcing a disabled unit is undefined, pass previous through.
+        UINT slot = in.pUnitSlot[source - GL_TEXTURE0];
+        return (slot == ~0U) ? in.previous : in.pTexColors[slot];
+    }
+    }
+}
+
+INLINE simdscalar CombineOperand(GLenum operand, const WideColor &color, simdscalar channel)
+{
+    switch (operand)
+    {
+    case GL_SRC_COLOR:
+        return channel;
+    case GL_ONE_MINUS_SRC_COLOR:
+        return _simd_sub_ps(_simd_set1_ps(1.0), channel);
+    case GL_SRC_ALPHA:
+        return color.A;
+    case GL_ONE_MINUS_SRC_ALPHA:
+        return _simd_sub_ps(_simd_set1_ps(1.0), color.A);
+    default:
+        assert(0);
+        return channel;
+    }
+}
+
+INLINE UINT CombineArgCount(GLenum func)
+{
+    switch (func)
+    {
+    case GL_REPLACE:
+        return 1;
+    case GL_INTERPOLATE:
+        return 3;
+    default:
+        return 2;
+    }
+}
+
+// Gathers the RGB (alpha = 0) or alpha (alpha = 1) arguments of a combiner for one channel.
+INLINE void CombineArgs(const OGL::TexEnvParameters &env, UINT alpha, const CombineInputs &in, simdscalar WideColor::*channel, simdscalar *args)
+{
+    for (UINT i = 0, N = CombineArgCount(env.mCombine[alpha]); i < N; ++i)
+    {
+        const WideColor &color = CombineSource(env.mSource[alpha][i], in);
+        args[i] = CombineOperand(env.mOperand[alpha][i], color, color.*channel);
+    }
+}
+
+INLINE simdscalar CombineFunc(GLenum func, const simdscalar *args)
+{
+    switch (func)
+    {
+    case GL_REPLACE:
+        return args[0];
+    case GL_MODULATE:
+        return _simd_mul_ps(args[0], args[1]);
+    case GL_ADD:
+        return _simd_add_ps(args[0], args[1]);
+    case GL_ADD_SIGNED:
+        return _simd_sub_ps(_simd_add_ps(args[0], args[1]), _simd_set1_ps(0.5));
+    case GL_INTERPOLATE:
+        // a0 * a2 + a1 * (1 - a2) = a2 * (a0 - a1) + a1
+        return _simd_fmadd_ps(args[2], _simd_sub_ps(args[0], args[1]), args[1]);
+    case GL_SUBTRACT:
+        return _simd_sub_ps(args[0], args[1]);
+    default:
+        assert(0);
+        return args[0];
+    }
+}
+
+INLINE simdscalar CombineScale(simdscalar value, GLfloat scale)
+{
+    if (scale != 1.0f)
+    {
+        value = _simd_mul_ps(value, _simd_set1_ps(scale));
+    }
+    return _simd_min_ps(_simd_max_ps(value, _simd_setzero_ps()), _simd_set1_ps(1.0));
+}
+
+INLINE WideColor Combine(const OGL::TexEnvParameters &env, const CombineInputs &in)
+{
+    WideColor result;
+    simdscalar r[3], g[3], b[3], a[3];
+    CombineArgs(env, 0, in, &WideColor::R, r);
+    CombineArgs(env, 0, in, &WideColor::G, g);
+    CombineArgs(env, 0, in, &WideColor::B, b);
+
+    GLenum funcRGB = env.mCombine[0];
+    if ((funcRGB == GL_DOT3_RGB) || (funcRGB == GL_DOT3_RGBA))
+    {
+        // 4 * ((r0 - .5) * (r1 - .5) + (g0 - .5) * (g1 - .5) + (b0 - .5) * (b1 - .5))
+        simdscalar half = _simd_set1_ps(0.5);
+        simdscalar dot = _simd_mul_ps(_simd_sub_ps(r[0], half), _simd_sub_ps(r[1], half));
+        dot = _simd_fmadd_ps(_simd_sub_ps(g[0], half), _simd_sub_ps(g[1], half), dot);
+        dot = _simd_fmadd_ps(_simd_sub_ps(b[0], half), _simd_sub_ps(b[1], half), dot);
+        dot = CombineScale(_simd_mul_ps(dot, _simd_set1_ps(4.0)), env.mScale[0]);
+        result.R = dot;
+        result.G = dot;
+        result.B = dot;
+        if (funcRGB == GL_DOT3_RGBA)
+        {
+            result.A = dot;
+            return result;
+        }
+    }
+    else
+    {
+        result.R = CombineScale(CombineFunc(funcRGB, r), env.mScale[0]);
+        result.G = CombineScale(CombineFunc(funcRGB, g), env.mScale[0]);
+        result.B = CombineScale(CombineFunc(funcRGB, b), env.mScale[0]);
+    }
+
+    CombineArgs(env, 1, in, &WideColor::A, a);
+    result.A = CombineScale(CombineFunc(env.mCombine[1], a), env.mScale[1]);
+    return result;
+}
+
+// Applies the texture environment of each enabled unit in order, slots are compacted over enabled units.
+template <UINT NUM_TEXTURES>
+INLINE void TexEnv(const OGL::SaveableState &state, const WideColor *texColors, WideColor &fragColor)
+{
+    UINT unitSlot[OGL::NUM_TEXTURES];
+    GLuint enabled = OGL::EnabledTextures(state);
+    for (UINT unit = 0, slot = 0; unit < OGL::NUM_TEXTURES; ++unit)
+    {
+        unitSlot[unit] = (enabled & (1 << unit)) ? slot++ : ~0U;
+    }
 
-        switch (texUnit.mTexEnv.mMode)
+    CombineInputs in;
+    in.pTexColors = texColors;
+    in.pUnitSlot = unitSlot;
+    in.primary = fragColor;
+
+    for (UINT unit = 0; unit < OGL::NUM_TEXTURES; ++unit)
+    {
+        if ((unitSlot[unit] == ~0U) || (unitSlot[unit] >= NUM_TEXTURES))
+        {
+            continue;
+        }
+
+        const OGL::TexEnvParameters &env = state.mTexUnit[unit].mTexEnv;
+        const WideColor &texColor = texColors[unitSlot[unit]];
+        switch (env.mMode)
         {
         case GL_REPLACE:
             fragColor = texColor;
@@ -194,27 +373,39 @@ struct MySample
         }
         /* fragColor.A = fragColor.A; */
         break;
+        case GL_BLEND:
+        {
+            // Cf * (1 - Cs) + Cc * Cs = Cs * (Cc - Cf) + Cf
+            const GLfloat *pColor = env.mColor;
+            fragColor.R = _simd_fmadd_ps(texColor.R, _simd_sub_ps(_simd_set1_ps(pColor[0]), fragColor.R), fragColor.R);
+            fragColor.G = _simd_fmadd_ps(texColor.G, _simd_sub_ps(_simd_set1_ps(pColor[1]), fragColor.G), fragColor.G);
+            fragColor.B = _simd_fmadd_ps(texColor.B, _simd_sub_ps(_simd_set1_ps(pColor[2]), fragColor.B), fragColor.B);
+            fragColor.A = _simd_mul_ps(fragColor.A, texColor.A);
+        }
+        break;
+        case GL_ADD:
+            fragColor.R = _simd_min_ps(_simd_add_ps(fragColor.R, texColor.R), _simd_set1_ps(1.0));
+            fragColor.G = _simd_min_ps(_simd_add_ps(fragColor.G, texColor.G), _simd_set1_ps(1.0));
+            fragColor.B = _simd_min_ps(_simd_add_ps(fragColor.B, texColor.B), _simd_set1_ps(1.0));
+            fragColor.A = _simd_mul_ps(fragColor.A, texColor.A);
+            break;
+        case GL_COMBINE:
+            in.constant.R = _simd_set1_ps(env.mColor[0]);
+            in.constant.G = _simd_set1_ps(env.mColor[1]);
+            in.constant.B = _simd_set1_ps(env.mColor[2]);
+            in.constant.A = _simd_set1_ps(env.mColor[3]);
+            in.previous = fragColor;
+            in.slot = unitSlot[unit];
+            fragColor = Combine(env, in);
+            break;
         default:
             assert(0);
         }
-
-        return fragColor;
-    }
-};
-
-template <UINT NUM_TEXTURES>
-struct MySample<NUM_TEXTURES, 0>
-{
-    typedef WideVector<FragFF<NUM_TEXTURES>::NUM_ATTRIBUTES, simdscalar> WV;
-
-    static INLINE WideColor sample(const SWR_TRIANGLE_DESC &work, const OGL::SaveableState &state, WV const &pAttrs, WideColor &fragColor)
-    {
-        return fragColor;
     }
-};
+}
 
 template <UINT NUM_TEXTURES>
-INLINE simdscalar shade(FragFF<NUM_TEXTURES> const &fragFF, const SWR_TRIANGLE_DESC &work, WideVector<FragFF<NUM_TEXTURES>::NUM_ATTRIBUTES, simdscalar> const &pAttrs, BYTE *pBuffer, BYTE *, UINT *outMask)
+INLINE simdscalar shade(FragFF<NUM_TEXTURES> const &fragFF, const SWR_TRIANGLE_DESC &work, WideVector<FragFF<NUM_TEXTURES>::NUM_ATTRIBUTES, simdscalar_t> const &pAttrs, BYTE *pBuffer, BYTE *, UINT *outMask)
 {
 #if KNOB_VS_SIMD_WIDTH == 4
     const __m128i SHUF_ALPHA = _mm_set_epi32(0x8080800f, 0x8080800b, 0x80808007, 0x80808003);
@@ -237,8 +428,10 @@ INLINE simdscalar shade(FragFF<NUM_TEXTURES> const &fragFF, const SWR_TRIANGLE_D
     fragColor.B = get<2>(pAttrs);
     fragColor.A = get<3>(pAttrs);
 
-    // Sample
-    fragColor = MySample<NUM_TEXTURES>::sample(work, state, pAttrs, fragColor);
+    // Sample and apply the texture environments
+    WideColor texColors[NUM_TEXTURES ? NUM_TEXTURES : 1];
+    MySample<NUM_TEXTURES>::sample(work, pAttrs, texColors);
+    TexEnv<NUM_TEXTURES>(state, texColors, fragColor);
 
     simdscalar vCoverage = _simd_set1_ps(-1.0);
 
@@ -418,7 +611,7 @@ struct SplatFF
     enum
     {
         NUM_INTERPOLANTS = 2,
-        NUM_ATTRIBUTES = 6,
+        NUM_ATTRIBUTES = 7, // 4 color, 3 for the texture (s, t, r), as FragFF<1>
         DO_PERSPECTIVE = 1,
     };
 
@@ -429,9 +622,9 @@ struct SplatFF
     }
 };
 
-const UINT SplatFF::SIGNATURE[2] = { 4, 2 };
+const UINT SplatFF::SIGNATURE[2] = { 4, 3 };
 
-INLINE simdscalar shade(SplatFF const &splatFF, const SWR_TRIANGLE_DESC &work, WideVector<SplatFF::NUM_ATTRIBUTES, simdscalar> const &pAttrs, BYTE *pBuffer, BYTE *, UINT *outMask)
+INLINE simdscalar shade(SplatFF const &splatFF, const SWR_TRIANGLE_DESC &work, WideVector<SplatFF::NUM_ATTRIBUTES, simdscalar_t> const &pAttrs, BYTE *pBuffer, BYTE *, UINT *outMask)
 {
 #if KNOB_VS_SIMD_WIDTH == 4
     const __m128i SHUF_ALPHA = _mm_set_epi32(0x8080800f, 0x8080800b, 0x80808007, 0x80808003);
@@ -461,9 +654,10 @@ INLINE simdscalar shade(SplatFF const &splatFF, const SWR_TRIANGLE_DESC &work, W
     const OGL::TextureUnit &texUnit = state.mTexUnit[0];
     tcidx.U = get<4>(pAttrs);
     tcidx.V = get<5>(pAttrs);
+    tcidx.W = get<6>(pAttrs);
     UINT mips[] = { 0, 0, 0, 0 };
     WideColor texColor;
-    SampleSimplePointRGBAF32(tv, samp, tcidx, mips, texColor);
+    SampleSimplePoint(tv, samp, tcidx, mips, texColor);
     fragColor.A = _simd_mul_ps(fragColor.A, texColor.A);
 
     *outMask = _simd_movemask_ps(_simd_set1_ps(-1.0));
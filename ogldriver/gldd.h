@@ -41,6 +41,7 @@ typedef void (*DD_PFN_DESTROY_CONTEXT)(DDHANDLE);
 typedef void (*DD_PFN_PRESENT)(DDHANDLE);
 typedef void (*DD_PFN_PRESENT2)(DDHANDLE, void *, UINT);
 typedef void (*DD_PFN_SWAP_BUFFER)(DDHANDLE);
+typedef void (*DD_PFN_FINISH)(DDHANDLE);
 typedef void (*DD_PFN_SET_VIEWPORT)(DDHANDLE, INT32 x, INT32 y, UINT32 width, UINT32 height, float minZ, float maxZ, bool scissorEnable);
 typedef void (*DD_PFN_SET_CULLMODE)(DDHANDLE, GLenum cullMode);
 typedef void (*DD_PFN_CLEAR)(DDHANDLE, GLbitfield, FLOAT (&clr)[4], FLOAT, bool useScissor);
@@ -59,15 +60,26 @@ typedef void (*DD_PFN_SET_CONSTANT_BUFFER)(DDHANDLE, DDHBUFFER hcBuf);
 typedef void (*DD_PFN_SET_INDEX_BUFFER)(DDHANDLE, DDHBUFFER);
 typedef void (*DD_PFN_SET_RENDER_TARGET)(DDHANDLE, DDHANDLE, DDHANDLE);
 
-typedef DDHTEXTURE (*DD_PFN_CREATE_TEXTURE)(DDHANDLE, GLuint (&size)[3]);
+typedef DDHTEXTURE (*DD_PFN_CREATE_TEXTURE)(DDHANDLE, GLuint (&size)[3], GLint internalFormat, GLenum format, GLenum type);
 typedef void (*DD_PFN_LOCK_TEXTURE)(DDHANDLE, DDHTEXTURE hTex);
 typedef void (*DD_PFN_UNLOCK_TEXTURE)(DDHANDLE, DDHTEXTURE hTex);
 typedef GLuint (*DD_PFN_GET_SUBTEXTURE_INDEX)(DDHANDLE, DDHTEXTURE hTex, GLuint plane, GLuint mipLevel);
 typedef void (*DD_PFN_UPDATE_SUBTEXTURE)(DDHANDLE, DDHTEXTURE hTex, GLuint subtexIdx, GLenum format, GLenum type, GLuint xoffset, GLuint yoffset, GLuint width, GLuint height, const GLvoid *pData);
+typedef void (*DD_PFN_GENERATE_MIPS)(DDHANDLE, DDHTEXTURE hTex, GLuint plane);
 typedef void (*DD_PFN_DESTROY_TEXTURE)(DDHANDLE, DDHTEXTURE hTex);
 
 typedef void (*DD_PFN_GEN_SHADERS)(DDHANDLE, OGL::State &, bool, GLenum);
 
+typedef DDHANDLE (*DD_PFN_CREATE_VERTEX_CACHE)(DDHANDLE, GLuint first, GLuint count);
+typedef void (*DD_PFN_DESTROY_VERTEX_CACHE)(DDHANDLE, DDHANDLE hCache);
+typedef void (*DD_PFN_USE_VERTEX_CACHE)(DDHANDLE, DDHANDLE hCache);
+
+typedef void (*DD_PFN_SET_RENDER_MODE)(DDHANDLE, GLenum mode, GLfloat *pFeedback, GLsizei size, GLenum feedbackType);
+typedef void (*DD_PFN_NEW_SELECT_HIT)(DDHANDLE);
+typedef bool (*DD_PFN_GET_SELECT_HIT)(DDHANDLE, GLuint index, GLuint &minZ, GLuint &maxZ);
+typedef void (*DD_PFN_PASS_THROUGH)(DDHANDLE, GLfloat token);
+typedef GLsizei (*DD_PFN_GET_FEEDBACK_COUNT)(DDHANDLE);
+
 typedef DDHANDLE (*DD_PFN_NEW_DRAW)(DDHANDLE);
 typedef void (*DD_PFN_DRAW)(DDHANDLE, GLenum topology, GLuint startVertex, GLuint numVertices);
 typedef void (*DD_PFN_DRAW_INDEXED)(DDHANDLE, GLenum topology, GLenum type, GLuint numVertices, GLuint indexOffset);
@@ -87,6 +99,7 @@ struct DDProcTable
     DD_PFN_PRESENT pfnPresent;
     DD_PFN_PRESENT2 pfnPresent2;
     DD_PFN_SWAP_BUFFER pfnSwapBuffer;
+    DD_PFN_FINISH pfnFinish;
     DD_PFN_SET_VIEWPORT pfnSetViewport;
     DD_PFN_SET_CULLMODE pfnSetCullMode;
     DD_PFN_CLEAR pfnClear;
@@ -101,6 +114,7 @@ struct DDProcTable
     DD_PFN_LOCK_BUFFER pfnLockBuffer;
     DD_PFN_LOCK_BUFFER pfnLockBufferNoOverwrite;
     DD_PFN_LOCK_BUFFER pfnLockBufferDiscard;
+    DD_PFN_LOCK_BUFFER pfnLockBufferRename;
     DD_PFN_UNLOCK_BUFFER pfnUnlockBuffer;
     DD_PFN_DESTROY_BUFFER pfnDestroyBuffer;
     DD_PFN_SET_RENDER_TARGET pfnSetRenderTarget;
@@ -110,6 +124,7 @@ struct DDProcTable
     DD_PFN_UNLOCK_TEXTURE pfnUnlockTexture;
     DD_PFN_GET_SUBTEXTURE_INDEX pfnGetSubtextureIndex;
     DD_PFN_UPDATE_SUBTEXTURE pfnUpdateSubtexture;
+    DD_PFN_GENERATE_MIPS pfnGenerateMips;
     DD_PFN_DESTROY_TEXTURE pfnDestroyTexture;
 
     DD_PFN_SET_CONSTANT_BUFFER pfnSetPsBuffer;
@@ -119,6 +134,16 @@ struct DDProcTable
 
     DD_PFN_GEN_SHADERS pfnGenShaders;
 
+    DD_PFN_CREATE_VERTEX_CACHE pfnCreateVertexCache;
+    DD_PFN_DESTROY_VERTEX_CACHE pfnDestroyVertexCache;
+    DD_PFN_USE_VERTEX_CACHE pfnUseVertexCache;
+
+    DD_PFN_SET_RENDER_MODE pfnSetRenderMode;
+    DD_PFN_NEW_SELECT_HIT pfnNewSelectHit;
+    DD_PFN_GET_SELECT_HIT pfnGetSelectHit;
+    DD_PFN_PASS_THROUGH pfnPassThrough;
+    DD_PFN_GET_FEEDBACK_COUNT pfnGetFeedbackCount;
+
     DD_PFN_DRAW pfnDraw;
     DD_PFN_DRAW_INDEXED pfnDrawIndexed;
 
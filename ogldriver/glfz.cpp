@@ -17,21 +17,360 @@
 #include "glfz.hpp"
 #include "oglglobals.h"
 #include "gldd.h"
+#include "serdeser.hpp"
 
+#include <algorithm>
+#include <cassert>
 #include <cmath>
+#include <cstring>
 
 namespace OGL
 {
 
 // XXX: all the push/pop matrix calls need to be in here.
 
+GLuint _glimFormatToNumComponents(unsigned long long fmt);
+
+GeometryBatch::GeometryBatch()
+{
+    mVB = -1;
+    mTopology = GL_NONE;
+    mBaking = false;
+    mPrimTopology = GL_NONE;
+    mAttributes.mask = 0;
+    mAttrFormats.mask = 0;
+    mCapacity = 0;
+    memset(&mWidths[0], 0, sizeof(mWidths));
+}
+
+// Returns the list topology a glBegin/glEnd topology is baked into, or
+// GL_NONE if its primitives can't be expressed as an indexed list.
+static GLenum _glfzBakedTopology(GLenum topology)
+{
+    switch (topology)
+    {
+    case GL_TRIANGLES:
+    case GL_TRIANGLE_STRIP:
+    case GL_TRIANGLE_FAN:
+    case GL_QUADS:
+    case GL_QUAD_STRIP:
+    case GL_POLYGON:
+        return GL_TRIANGLES;
+    case GL_LINES:
+    case GL_LINE_STRIP:
+    case GL_LINE_LOOP:
+        return GL_LINES;
+    default:
+        return GL_NONE;
+    }
+}
+
+// Appends the list indices for one glBegin/glEnd pair. The triangle order
+// matches what the SWR primitive assembler produces for the original
+// topology, so culling is unchanged, and polygons keep their first vertex
+// provoking for flat shading.
+static void _glfzAppendListIndices(GLenum topology, std::vector<GLuint> const &prim, std::vector<GLuint> &out)
+{
+    GLuint n = (GLuint)prim.size();
+    switch (topology)
+    {
+    case GL_TRIANGLES:
+        for (GLuint i = 0; i + 2 < n; i += 3)
+        {
+            out.push_back(prim[i]);
+            out.push_back(prim[i + 1]);
+            out.push_back(prim[i + 2]);
+        }
+        break;
+    case GL_QUAD_STRIP:
+        n &= ~1;
+    // fall through
+    case GL_TRIANGLE_STRIP:
+        for (GLuint i = 0; i + 2 < n; ++i)
+        {
+            out.push_back(prim[(i & 1) ? i + 1 : i]);
+            out.push_back(prim[(i & 1) ? i : i + 1]);
+            out.push_back(prim[i + 2]);
+        }
+        break;
+    case GL_TRIANGLE_FAN:
+        for (GLuint i = 1; i + 1 < n; ++i)
+        {
+            out.push_back(prim[0]);
+            out.push_back(prim[i]);
+            out.push_back(prim[i + 1]);
+        }
+        break;
+    case GL_POLYGON:
+        // rotated so the polygon's first vertex is each triangle's last,
+        // provoking vertex
+        for (GLuint i = 1; i + 1 < n; ++i)
+        {
+            out.push_back(prim[i]);
+            out.push_back(prim[i + 1]);
+            out.push_back(prim[0]);
+        }
+        break;
+    case GL_QUADS:
+        for (GLuint i = 0; i + 3 < n; i += 4)
+        {
+            out.push_back(prim[i]);
+            out.push_back(prim[i + 1]);
+            out.push_back(prim[i + 2]);
+            out.push_back(prim[i]);
+            out.push_back(prim[i + 2]);
+            out.push_back(prim[i + 3]);
+        }
+        break;
+    case GL_LINES:
+        for (GLuint i = 0; i + 1 < n; i += 2)
+        {
+            out.push_back(prim[i]);
+            out.push_back(prim[i + 1]);
+        }
+        break;
+    case GL_LINE_STRIP:
+    case GL_LINE_LOOP:
+        for (GLuint i = 0; i + 1 < n; ++i)
+        {
+            out.push_back(prim[i]);
+            out.push_back(prim[i + 1]);
+        }
+        if ((topology == GL_LINE_LOOP) && (n > 2))
+        {
+            out.push_back(prim[n - 1]);
+            out.push_back(prim[0]);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static void _glfzResetBatch(GeometryBatch &batch)
+{
+    batch.mVB = -1;
+    batch.mBaking = false;
+    batch.mCapacity = 0;
+    batch.mIndices.clear();
+    batch.mPrimIndices.clear();
+    batch.mWeld.clear();
+}
+
+static void _glfzOpenBatch(OptState &os, GLenum bakedTopology)
+{
+    State &s = *os.mpState;
+    GeometryBatch &batch = *os.mpBatch;
+
+    GLuint idx = os.mpDL->AddVB();
+    glimSubstituteVBSWR(s, idx);
+
+    _glfzResetBatch(batch);
+    batch.mVB = idx;
+    batch.mTopology = bakedTopology;
+}
+
+static void _glfzBeginBakedPrim(OptState &os, GLenum topology)
+{
+    State &s = *os.mpState;
+    GeometryBatch &batch = *os.mpBatch;
+
+    glimSetTopologySWR(s, topology);
+    AnalyzeVertexAttributes(s);
+    batch.mBaking = true;
+    batch.mPrimTopology = topology;
+    batch.mPrimIndices.clear();
+}
+
+// Grows the batch VB so it holds at least numVerts vertices, keeping the
+// vertices already added.
+static void _glfzReserveBatch(State &s, GeometryBatch &batch, GLuint numVerts)
+{
+    if (numVerts <= batch.mCapacity)
+    {
+        return;
+    }
+
+    GLuint capacity = std::max(numVerts, batch.mCapacity * 2);
+    // XXX: adding padding to help in SWR.
+    UINT size = (capacity + KNOB_VS_SIMD_WIDTH * 2) * sizeof(GLfloat) * 4;
+    UINT used = batch.mCapacity * sizeof(GLfloat) * 4;
+
+    VertexBuffer &vb = GetVB(s);
+    for (GLuint i = 0; i < vb.mNumAttributes; ++i)
+    {
+        DDHANDLE hBuffer = GetDDProcTable().pfnCreateBuffer(GetDDHandle(), size, NULL);
+        GLfloat *pfBuffer = (GLfloat *)GetDDProcTable().pfnLockBufferDiscard(GetDDHandle(), hBuffer);
+        if (vb.mhBuffers[i] != NULL)
+        {
+            memcpy(pfBuffer, vb.mpfBuffers[i], used);
+            GetDDProcTable().pfnUnlockBuffer(GetDDHandle(), vb.mhBuffers[i]);
+            GetDDProcTable().pfnDestroyBuffer(GetDDHandle(), vb.mhBuffers[i]);
+        }
+        vb.mhBuffers[i] = hBuffer;
+        vb.mpfBuffers[i] = pfBuffer;
+        vb.mCurrentSize[i] = size;
+    }
+    for (GLuint i = 0; i < vb.mNumSideAttributes; ++i)
+    {
+        DDHANDLE hBuffer = GetDDProcTable().pfnCreateBuffer(GetDDHandle(), size, NULL);
+        GLfloat *pfBuffer = (GLfloat *)GetDDProcTable().pfnLockBufferDiscard(GetDDHandle(), hBuffer);
+        if (vb.mhSideBuffers[i] != NULL)
+        {
+            memcpy(pfBuffer, vb.mpfSideBuffers[i], used);
+            GetDDProcTable().pfnUnlockBuffer(GetDDHandle(), vb.mhSideBuffers[i]);
+            GetDDProcTable().pfnDestroyBuffer(GetDDHandle(), vb.mhSideBuffers[i]);
+        }
+        vb.mhSideBuffers[i] = hBuffer;
+        vb.mpfSideBuffers[i] = pfBuffer;
+    }
+
+    batch.mCapacity = capacity;
+}
+
+// Records the widths of the attributes glimAddVertexSWR writes, in the
+// order it writes them.
+static void _glfzSetBatchWidths(VertexBuffer const &vb, GeometryBatch &batch)
+{
+    GLuint attr = 0;
+    batch.mWidths[attr++] = _glimFormatToNumComponents(vb.mAttrFormats.position);
+    if (vb.mAttributes.normal)
+    {
+        batch.mWidths[attr++] = _glimFormatToNumComponents(vb.mAttrFormats.normal);
+    }
+    if (vb.mAttributes.fog)
+    {
+        batch.mWidths[attr++] = _glimFormatToNumComponents(vb.mAttrFormats.fog);
+    }
+    for (GLuint i = 0; i < NUM_COLORS; ++i)
+    {
+        if ((vb.mAttributes.color & (0x1 << i)) != 0)
+        {
+            batch.mWidths[attr++] = _glimFormatToNumComponents((vb.mAttrFormats.color >> (AttrFmtShift * i)) & AttrFmtMask);
+        }
+    }
+    for (GLuint i = 0; i < NUM_TEXTURES; ++i)
+    {
+        if ((vb.mAttributes.texCoord & (0x1 << i)) != 0)
+        {
+            batch.mWidths[attr++] = _glimFormatToNumComponents((vb.mAttrFormats.texCoord >> (AttrFmtShift * i)) & AttrFmtMask);
+        }
+    }
+    assert(attr == vb.mNumAttributes);
+
+    batch.mAttributes = vb.mAttributes;
+    batch.mAttrFormats = vb.mAttrFormats;
+}
+
+static bool _glfzSameVertex(VertexBuffer const &vb, GeometryBatch const &batch, GLuint a, GLuint b)
+{
+    for (GLuint i = 0; i < vb.mNumAttributes; ++i)
+    {
+        GLuint width = batch.mWidths[i];
+        if (memcmp(vb.mpfBuffers[i] + a * width, vb.mpfBuffers[i] + b * width, width * sizeof(GLfloat)) != 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Welds the vertex just added to the batch VB with an identical earlier one,
+// and appends its index to the open primitive.
+static void _glfzWeldVertex(OptState &os)
+{
+    VertexBuffer &vb = GetVB(*os.mpState);
+    GeometryBatch &batch = *os.mpBatch;
+    GLuint v = vb.mNumVertices - 1;
+
+    // FNV-1a over the attribute bits.
+    GLuint hash = 2166136261U;
+    for (GLuint i = 0; i < vb.mNumAttributes; ++i)
+    {
+        GLuint const *pBits = (GLuint const *)(vb.mpfBuffers[i] + v * batch.mWidths[i]);
+        for (GLuint c = 0; c < batch.mWidths[i]; ++c)
+        {
+            hash = (hash ^ pBits[c]) * 16777619U;
+        }
+    }
+
+    auto range = batch.mWeld.equal_range(hash);
+    for (auto itr = range.first; itr != range.second; ++itr)
+    {
+        if (_glfzSameVertex(vb, batch, itr->second, v))
+        {
+            --vb.mNumVertices;
+            batch.mPrimIndices.push_back(itr->second);
+            return;
+        }
+    }
+
+    batch.mWeld.insert(std::make_pair(hash, v));
+    batch.mPrimIndices.push_back(v);
+}
+
+void FlushGeometryBatch(OptState &os)
+{
+    GeometryBatch &batch = *os.mpBatch;
+    if ((batch.mVB < 0) || batch.mBaking)
+    {
+        return;
+    }
+
+    State &s = *os.mpState;
+    VertexBuffer &vb = GetVB(s);
+    if (!batch.mIndices.empty())
+    {
+        GLuint numIndices = (GLuint)batch.mIndices.size();
+        vb.mhIndexBuffer = GetDDProcTable().pfnCreateBuffer(GetDDHandle(), (numIndices + KNOB_VS_SIMD_WIDTH) * sizeof(GLuint), NULL);
+        vb.mpIndexBuffer = (GLuint *)GetDDProcTable().pfnLockBufferDiscard(GetDDHandle(), vb.mhIndexBuffer);
+        memcpy(vb.mpIndexBuffer, &batch.mIndices[0], numIndices * sizeof(GLuint));
+        GetDDProcTable().pfnUnlockBuffer(GetDDHandle(), vb.mhIndexBuffer);
+        vb.mpIndexBuffer = NULL;
+        vb.mNumIndices = numIndices;
+
+        glclSubstituteVBSWR(os, batch.mVB);
+        glclSetTopologySWR(os, batch.mTopology);
+        glclDrawIndexedSWR(os, numIndices);
+        glclResetMainVBSWR(os);
+    }
+
+    glimResetMainVBSWR(s);
+    _glfzResetBatch(batch);
+}
+
 void glfzArrayElement(OptState &os, GLint index)
 {
     glimAddVertexSWR(*os.mpState, 0, 0, 0, 0, index, false, (GLenum)OGL_NO_INDEX_BUFFER_GENERATION);
+    if (os.mpBatch->mBaking)
+    {
+        _glfzWeldVertex(os);
+    }
 }
 
 void glfzBegin(OptState &os, GLenum topology)
 {
+    GeometryBatch &batch = *os.mpBatch;
+
+    // Triangles and lines are baked into the batch; everything else keeps its
+    // own VB and draw. The polygon mode is applied when the batch is drawn.
+    GLenum bakedTopology = _glfzBakedTopology(topology);
+    bool bake = bakedTopology != GL_NONE;
+    if ((batch.mVB >= 0) && (!bake || (batch.mTopology != bakedTopology)))
+    {
+        FlushGeometryBatch(os);
+    }
+
+    if (bake)
+    {
+        if (batch.mVB < 0)
+        {
+            _glfzOpenBatch(os, bakedTopology);
+        }
+        _glfzBeginBakedPrim(os, topology);
+        return;
+    }
+
     // create new VB for this glBegin/glEnd pair
     GLuint idx = os.mpDL->AddVB();
     glimSubstituteVBSWR(*os.mpState, idx);
@@ -57,6 +396,22 @@ void glfzColor(OptState &os, GLfloat red, GLfloat green, GLfloat blue, GLfloat a
     glimColor(*os.mpState, red, green, blue, alpha);
 }
 
+void glfzDrawArrays(OptState &os, GLenum mode, GLint first, GLsizei count)
+{
+    // The arrays were copied into a VB of the list when it was recorded and
+    // carried over by glfzSubstituteVBSWR; only the draw is re-recorded.
+    FlushGeometryBatch(os);
+
+    os.mpDL->mHasDrawArray = 1;
+    GLubyte *mybuffer = os.mpDL->RequestBuffer(sizeof(CMD_DRAWARRAYS) + sizeof(mode) + sizeof(first) + sizeof(count));
+    insertCommand(CMD_DRAWARRAYS, mybuffer, mode, first, count);
+}
+
+void glfzDrawIndexedSWR(OptState &os, GLsizei numIndices)
+{
+    glclDrawIndexedSWR(os, numIndices);
+}
+
 void glfzDrawSWR(OptState &os)
 {
     glclDrawSWR(os);
@@ -64,6 +419,16 @@ void glfzDrawSWR(OptState &os)
 
 void glfzEnd(OptState &os)
 {
+    GeometryBatch &batch = *os.mpBatch;
+    if (batch.mBaking)
+    {
+        // The batch stays open for the next glBegin/glEnd that shares state.
+        _glfzAppendListIndices(batch.mPrimTopology, batch.mPrimIndices, batch.mIndices);
+        batch.mPrimIndices.clear();
+        batch.mBaking = false;
+        return;
+    }
+
     glfzDrawSWR(os);
 
     // reset to main VB
@@ -81,6 +446,31 @@ void glfzNumVerticesSWR(OptState &os, GLuint num, VertexAttributeFormats vAttrFm
     State &s = *os.mpState;
     AnalyzeVertexAttributes(s);
 
+    GeometryBatch &batch = *os.mpBatch;
+    if (batch.mBaking)
+    {
+        // Vertices in a batch share one layout; start a new batch if this
+        // pair's doesn't match.
+        if ((GetVB(s).mNumVertices > 0) &&
+            ((batch.mAttrFormats.mask != vAttrFmts.mask) || !(batch.mAttributes == GetVB(s).mAttributes)))
+        {
+            GLenum topology = batch.mPrimTopology;
+            batch.mBaking = false;
+            FlushGeometryBatch(os);
+            _glfzOpenBatch(os, _glfzBakedTopology(topology));
+            _glfzBeginBakedPrim(os, topology);
+        }
+
+        VertexBuffer &vb = GetVB(s);
+        if (vb.mNumVertices == 0)
+        {
+            vb.mAttrFormats = vAttrFmts;
+            _glfzSetBatchWidths(vb, batch);
+        }
+        _glfzReserveBatch(s, batch, vb.mNumVertices + num);
+        return;
+    }
+
     if (num > 0)
     {
         // XXX: adding padding to help in SWR.
@@ -103,6 +493,17 @@ void glfzNumVerticesSWR(OptState &os, GLuint num, VertexAttributeFormats vAttrFm
     GetVB(s).mAttrFormats = vAttrFmts;
 }
 
+void glfzSubstituteVBSWR(OptState &os, GLsizei which)
+{
+    // Carry the recorded VB over to the optimized list.
+    FlushGeometryBatch(os);
+
+    os.mpDL->mVertexBuffers.push_back(os.mpSrcDL->mVertexBuffers[which]);
+    GLuint idx = (GLuint)(os.mpDL->mVertexBuffers.size() - 1);
+    glimSubstituteVBSWR(*os.mpState, idx);
+    glclSubstituteVBSWR(os, idx);
+}
+
 void glfzTexCoord(OptState &os, GLenum target, GLfloat x, GLfloat y, GLfloat z, GLfloat w)
 {
     glimTexCoord(*os.mpState, target, x, y, z, w);
@@ -111,6 +512,10 @@ void glfzTexCoord(OptState &os, GLenum target, GLfloat x, GLfloat y, GLfloat z,
 void glfzVertex(OptState &os, GLfloat x, GLfloat y, GLfloat z, GLfloat w, GLuint count)
 {
     glimAddVertexSWR(*os.mpState, x, y, z, w, -1, false, (GLenum)OGL_NO_INDEX_BUFFER_GENERATION);
+    if (os.mpBatch->mBaking)
+    {
+        _glfzWeldVertex(os);
+    }
 }
 
 #include "glfz.inl"
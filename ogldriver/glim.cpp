@@ -24,6 +24,7 @@
 #include <cassert>
 #include <cmath>
 #include <climits>
+#include <vector>
 
 namespace OGL
 {
@@ -103,25 +104,8 @@ void _glimPacketStore(GLfloat *stream, GLfloat x, GLfloat y, GLfloat z, GLfloat
     }
 }
 
-void _glimUpdateRedundancyKey(SWRL::UncheckedFixedVector<GLfloat, 64> &key, GLfloat x, GLfloat y, GLfloat z, GLfloat w, GLuint numCom)
+void _glimUpdateRedundancyMap(State &s, __m128 const *pAttr, GLuint numAttr, GLuint hash, GLuint currentIndex, IndexBufferKind IBK)
 {
-    switch (numCom)
-    {
-    case 4:
-        key[key.size() + 3] = w;
-    case 3:
-        key[key.size() + 2] = z;
-    case 2:
-        key[key.size() + 1] = y;
-    case 1:
-        key[key.size() + 0] = x;
-    }
-    key.resize(key.size() + numCom);
-}
-
-void _glimUpdateRedundancyMap(State &s, SWRL::UncheckedFixedVector<GLfloat, 64> const &key, GLuint currentIndex, IndexBufferKind IBK)
-{
-    // XXX: Too slow.
     switch (IBK)
     {
     case OGL_GENERATE_INDEX_BUFFER:
@@ -129,7 +113,7 @@ void _glimUpdateRedundancyMap(State &s, SWRL::UncheckedFixedVector<GLfloat, 64>
     case OGL_GENERATE_NEGATIVE_INDEX_BUFFER_8:
     {
         GLubyte *pNIB8 = GetVB(s).mpNIB8;
-        GLuint oldIndex = s.mRedundancyMap.GetEarliestIndex(key, currentIndex);
+        GLuint oldIndex = s.mRedundancyMap.GetRecentIndex(hash, pAttr, numAttr, currentIndex);
         GLubyte relOffset = currentIndex - oldIndex;
         pNIB8[currentIndex] = relOffset;
     }
@@ -139,6 +123,109 @@ void _glimUpdateRedundancyMap(State &s, SWRL::UncheckedFixedVector<GLfloat, 64>
     }
 }
 
+// Reloads the current attributes flagged in mChanged, or all of them if the
+// VB layout changed since the cache was built.
+void _glimUpdateCurrentAttrCache(State &s, VertexBuffer const &vb)
+{
+    CurrentAttributeCache &cache = s.mCurrentAttrCache;
+    auto const &vAttrFmts = vb.mAttrFormats;
+
+    VertexActiveAttributes reload = cache.mChanged;
+    if (!(cache.mAttributes == vb.mAttributes) || (cache.mAttrFormats.mask != vAttrFmts.mask) || (cache.mNormalize != s.mCaps.normalize))
+    {
+        reload.mask = 0xFFFFFFFF;
+        cache.mAttributes = vb.mAttributes;
+        cache.mAttrFormats = vAttrFmts;
+        cache.mNormalize = s.mCaps.normalize;
+    }
+
+    GLuint iedx = 0;
+    cache.mWidths[iedx++] = _glimFormatToNumComponents(vAttrFmts.position);
+
+    if (vb.mAttributes.normal)
+    {
+        if (reload.normal)
+        {
+            __m128 attribute = _mm_set_ps(s.mNormal[3], s.mNormal[2], s.mNormal[1], s.mNormal[0]);
+            cache.mAttr[iedx] = attribute;
+            cache.mSideNormal = s.mCaps.normalize ? _mm_mul_ps(attribute, _mm_rsqrt_ps(_mm_dp_ps(attribute, attribute, 0xFF))) : attribute;
+        }
+        cache.mWidths[iedx++] = _glimFormatToNumComponents(vAttrFmts.normal);
+    }
+
+    if (vb.mAttributes.fog)
+    {
+        if (reload.fog)
+        {
+            cache.mAttr[iedx] = _mm_loadu_ps(&s.mFog.mColor[0]);
+        }
+        cache.mWidths[iedx++] = _glimFormatToNumComponents(vAttrFmts.fog);
+    }
+
+    for (int i = 0; i < NUM_COLORS; ++i)
+    {
+        if ((vb.mAttributes.color & (0x1ULL << i)) != 0)
+        {
+            if ((reload.color & (0x1ULL << i)) != 0)
+            {
+                cache.mAttr[iedx] = _mm_set_ps(s.mColor[i][3], s.mColor[i][2], s.mColor[i][1], s.mColor[i][0]);
+            }
+            cache.mWidths[iedx++] = _glimFormatToNumComponents((vAttrFmts.color >> (AttrFmtShift * i)) & AttrFmtMask);
+        }
+    }
+
+    for (int i = 0; i < NUM_TEXTURES; ++i)
+    {
+        if ((vb.mAttributes.texCoord & (0x1ULL << i)) != 0)
+        {
+            if ((reload.texCoord & (0x1ULL << i)) != 0)
+            {
+                cache.mAttr[iedx] = _mm_set_ps(s.mTexCoord[i][3], s.mTexCoord[i][2], s.mTexCoord[i][1], s.mTexCoord[i][0]);
+            }
+            cache.mWidths[iedx++] = _glimFormatToNumComponents((vAttrFmts.texCoord >> (AttrFmtShift * i)) & AttrFmtMask);
+        }
+    }
+
+    cache.mNumAttributes = iedx;
+    cache.mHash = RedundancyMap<NUM_ATTRIBUTES>::Hash(&cache.mAttr[1], iedx - 1, RedundancyMap<NUM_ATTRIBUTES>::OFFSET);
+    cache.mChanged.mask = 0;
+}
+
+// glVertex path: only the position varies per vertex, everything else is
+// written from the current attribute cache.
+void _glimAddCurrentVertexSWR(State &s, GLfloat x, GLfloat y, GLfloat z, GLfloat w, GLenum genIBKind)
+{
+    auto &vb = GetVB(s);
+    CurrentAttributeCache &cache = s.mCurrentAttrCache;
+
+    if ((cache.mChanged.mask != 0) ||
+        !(cache.mAttributes == vb.mAttributes) ||
+        (cache.mAttrFormats.mask != vb.mAttrFormats.mask) ||
+        (cache.mNormalize != s.mCaps.normalize))
+    {
+        _glimUpdateCurrentAttrCache(s, vb);
+    }
+
+    GLuint numVerts = vb.mNumVertices;
+    cache.mAttr[0] = _mm_set_ps(w, z, y, x);
+    for (GLuint i = 0; i < cache.mNumAttributes; ++i)
+    {
+        _mm_storeu_ps(vb.mpfBuffers[i] + numVerts * cache.mWidths[i], cache.mAttr[i]);
+    }
+    if (vb.mAttributes.normal)
+    {
+        _mm_storeu_ps(vb.mpfSideBuffers[0] + numVerts * cache.mWidths[1], cache.mSideNormal);
+    }
+
+    if (genIBKind == OGL_GENERATE_NEGATIVE_INDEX_BUFFER_8)
+    {
+        GLuint hash = RedundancyMap<NUM_ATTRIBUTES>::Hash(&cache.mAttr[0], 1, cache.mHash);
+        _glimUpdateRedundancyMap(s, &cache.mAttr[0], cache.mNumAttributes, hash, numVerts, (OGL::IndexBufferKind)genIBKind);
+    }
+
+    ++vb.mNumVertices;
+}
+
 void _glimSetupVertexLayoutSWR(State &s, VBIEDLayout &L)
 {
     // Builds an array that gives an index into the array of buffers
@@ -200,8 +287,18 @@ void glimActiveTexture(State &s, GLenum which)
 
 void glimAddVertexSWR(State &s, GLdouble x, GLdouble y, GLdouble z, GLdouble w, GLint index, GLboolean permutedVBs, GLenum genIBKind)
 {
+#ifdef KNOB_TOSS_VERTICES
+    return;
+#endif
+
+    if ((index < 0) && !permutedVBs)
+    {
+        _glimAddCurrentVertexSWR(s, (GLfloat)x, (GLfloat)y, (GLfloat)z, (GLfloat)w, genIBKind);
+        return;
+    }
+
     // XXX: use the VBIEDLayout rather than computing iedx/sbiedx on the fly, each time.
-    SWRL::UncheckedFixedVector<GLfloat, 64> key;
+    __m128 key[NUM_ATTRIBUTES];
     auto &vb = GetVB(s);
     GLuint numVerts = vb.mNumVertices;
     auto const &vAttrFmts = vb.mAttrFormats;
@@ -212,10 +309,6 @@ void glimAddVertexSWR(State &s, GLdouble x, GLdouble y, GLdouble z, GLdouble w,
     GLuint aosPacket = numVerts >> s.mVBLayoutInfo.permuteShift;
     GLuint aosIndex = numVerts & s.mVBLayoutInfo.permuteMask;
 
-#ifdef KNOB_TOSS_VERTICES
-    return;
-#endif
-
     // Add the vertex.
     if ((index >= 0) && s.mCaps.vertexArray && (s.mArrayPointers.mVertex.mpElements != 0))
     {
@@ -233,7 +326,7 @@ void glimAddVertexSWR(State &s, GLdouble x, GLdouble y, GLdouble z, GLdouble w,
     {
         _glimPacketStore(vb.mpfBuffers[iedx], (GLfloat)x, (GLfloat)y, (GLfloat)z, (GLfloat)w, permWidth, aosPacket, aosIndex, _glimFormatToNumComponents(vAttrFmts.position));
     }
-    _glimUpdateRedundancyKey(key, (GLfloat)x, (GLfloat)y, (GLfloat)z, (GLfloat)w, _glimFormatToNumComponents(vAttrFmts.position));
+    key[iedx] = attribute;
     ++iedx;
 
     if (vb.mAttributes.normal)
@@ -259,7 +352,7 @@ void glimAddVertexSWR(State &s, GLdouble x, GLdouble y, GLdouble z, GLdouble w,
             _glimPacketStore(vb.mpfBuffers[iedx], s.mNormal[0], s.mNormal[1], s.mNormal[2], 0.0f, permWidth, aosPacket, aosIndex, _glimFormatToNumComponents(vAttrFmts.normal));
             _glimPacketStore(vb.mpfSideBuffers[sbiedx], fnattr[0], fnattr[1], fnattr[2], 0.0f, permWidth, aosPacket, aosIndex, _glimFormatToNumComponents(vAttrFmts.normal));
         }
-        _glimUpdateRedundancyKey(key, s.mNormal[0], s.mNormal[1], s.mNormal[2], 0.0f, _glimFormatToNumComponents(vAttrFmts.normal));
+        key[iedx] = attribute;
         ++iedx;
         ++sbiedx;
     }
@@ -269,7 +362,7 @@ void glimAddVertexSWR(State &s, GLdouble x, GLdouble y, GLdouble z, GLdouble w,
     {
         attribute = _mm_load_ps(&s.mFog.mColor[0]);
         _mm_storeu_ps(vb.mpfBuffers[iedx] + numVerts * _glimFormatToNumComponents(vAttrFmts.fog), attribute);
-        _glimUpdateRedundancyKey(key, s.mFog.mColor[0], s.mFog.mColor[1], s.mFog.mColor[2], s.mFog.mColor[3], _glimFormatToNumComponents(vAttrFmts.fog));
+        key[iedx] = attribute;
         ++iedx;
     }
 
@@ -289,7 +382,7 @@ void glimAddVertexSWR(State &s, GLdouble x, GLdouble y, GLdouble z, GLdouble w,
                 }
                 unsigned long long fmt = (vAttrFmts.color >> (AttrFmtShift * i)) & AttrFmtMask;
                 _mm_storeu_ps(vb.mpfBuffers[iedx] + numVerts * _glimFormatToNumComponents(fmt), attribute);
-                _glimUpdateRedundancyKey(key, s.mColor[i][0], s.mColor[i][1], s.mColor[i][2], s.mColor[i][3], _glimFormatToNumComponents(fmt));
+                key[iedx] = attribute;
                 ++iedx;
             }
         }
@@ -311,13 +404,18 @@ void glimAddVertexSWR(State &s, GLdouble x, GLdouble y, GLdouble z, GLdouble w,
                 }
                 unsigned long long fmt = (vAttrFmts.texCoord >> (AttrFmtShift * i)) & AttrFmtMask;
                 _mm_storeu_ps(vb.mpfBuffers[iedx] + numVerts * _glimFormatToNumComponents(fmt), attribute);
-                _glimUpdateRedundancyKey(key, s.mTexCoord[i][0], s.mTexCoord[i][1], s.mTexCoord[i][2], s.mTexCoord[i][3], _glimFormatToNumComponents(fmt));
+                key[iedx] = attribute;
                 ++iedx;
             }
         }
     }
 
-    _glimUpdateRedundancyMap(s, key, numVerts, (OGL::IndexBufferKind)genIBKind);
+    if (genIBKind == OGL_GENERATE_NEGATIVE_INDEX_BUFFER_8)
+    {
+        GLuint hash = RedundancyMap<NUM_ATTRIBUTES>::Hash(&key[1], iedx - 1, RedundancyMap<NUM_ATTRIBUTES>::OFFSET);
+        hash = RedundancyMap<NUM_ATTRIBUTES>::Hash(&key[0], 1, hash);
+        _glimUpdateRedundancyMap(s, &key[0], iedx, hash, numVerts, (OGL::IndexBufferKind)genIBKind);
+    }
 
     ++GetVB(s).mNumVertices;
 }
@@ -526,6 +624,84 @@ void glimColorPointer(State &s, GLint size, GLenum type, GLsizei stride, const G
     glstColorPointer(s, size, type, stride, pointer);
 }
 
+// Bytes per 4x4 block of an S3TC format, 0 for uncompressed formats.
+static GLsizei _glimS3TCBlockBytes(GLenum format)
+{
+    switch (format)
+    {
+    case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+        return 8;
+    case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+    case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+        return 16;
+    default:
+        return 0;
+    }
+}
+
+static GLsizei _glimS3TCImageSize(GLenum format, GLsizei width, GLsizei height)
+{
+    return ((width + 3) / 4) * ((height + 3) / 4) * _glimS3TCBlockBytes(format);
+}
+
+// With GL_GENERATE_MIPMAP set, a change to level 0 of a plane rebuilds the
+// rest of its mip chain on the workers, queued behind the change.
+static void _glimGenerateMips(TexParameters &texParams, GLuint plane, GLint level)
+{
+    if (!texParams.mGenMIPs || (level != 0) || !texParams.mhTexture || _glimS3TCBlockBytes(texParams.mInternalFormat))
+    {
+        return;
+    }
+
+    GetDDProcTable().pfnGenerateMips(GetDDHandle(), texParams.mhTexture, plane);
+    texParams.mLevelMask = ~0U;
+}
+
+static void _glimDefineTexImage(TexParameters &texParams, GLint mipLevel, GLuint planes, GLint internalFormat, GLsizei width, GLsizei height, GLenum format, GLenum type);
+
+// Copies from the color buffer, or the depth buffer into depth textures, on
+// the workers; nothing is read back.
+static void _glimCopyToTexture(State &s, TexParameters &texParams, GLint x, GLint y, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height)
+{
+    GLenum format = IsDepthTextureFormat(texParams.mInternalFormat) ? GL_DEPTH_COMPONENT : 0;
+    GetDDProcTable().pfnCopyRenderTarget(GetDDHandle(), s, texParams.mhTexture, NULL, format, 0, x, y, xoffset, yoffset, width, height, false);
+}
+
+void glimCopyTexImage2D(State &s, GLenum target, GLint level, GLenum internalFormat, GLint x, GLint y, GLsizei width, GLsizei height, GLint border)
+{
+    if (target != GL_TEXTURE_2D)
+    {
+        s.mLastError = GL_INVALID_ENUM;
+        return;
+    }
+
+    if ((border != 0) || (width < 0) || (height < 0) || (level < 0) || (level >= MAX_TEXTURE_LEVELS))
+    {
+        s.mLastError = GL_INVALID_VALUE;
+        return;
+    }
+
+    if (_glimS3TCBlockBytes(internalFormat))
+    {
+        s.mLastError = GL_INVALID_OPERATION;
+        return;
+    }
+
+    TextureUnit &texUnit = s.mTexUnit[s.mActiveTexture - GL_TEXTURE0];
+    TexParameters &texParams = s.mTexParameters[texUnit.mNamedTexture2d];
+
+    bool isDepth = IsDepthTextureFormat(internalFormat);
+    _glimDefineTexImage(texParams, level, 1, internalFormat, width, height, isDepth ? GL_DEPTH_COMPONENT : GL_RGBA, isDepth ? GL_FLOAT : GL_UNSIGNED_BYTE);
+
+    // XXX: render targets are only copied to level 0.
+    if (level == 0)
+    {
+        _glimCopyToTexture(s, texParams, x, y, 0, 0, width, height);
+        _glimGenerateMips(texParams, 0, level);
+    }
+}
+
 void glimCopyTexSubImage2D(State &s, GLenum target, GLint level, GLint xoffset, GLint yoffset, GLint x, GLint y, GLsizei width, GLsizei height)
 {
     assert(target == GL_TEXTURE_2D);
@@ -533,7 +709,14 @@ void glimCopyTexSubImage2D(State &s, GLenum target, GLint level, GLint xoffset,
     TextureUnit &texUnit = s.mTexUnit[s.mActiveTexture - GL_TEXTURE0];
     TexParameters &texParams = s.mTexParameters[texUnit.mNamedTexture2d];
 
-    GetDDProcTable().pfnCopyRenderTarget(GetDDHandle(), s, texParams.mhTexture, NULL, 0, 0, x, y, xoffset, yoffset, width, height, false);
+    if (_glimS3TCBlockBytes(texParams.mInternalFormat))
+    {
+        s.mLastError = GL_INVALID_OPERATION;
+        return;
+    }
+
+    _glimCopyToTexture(s, texParams, x, y, xoffset, yoffset, width, height);
+    _glimGenerateMips(texParams, 0, level);
 }
 
 void glimCullFace(State &s, GLenum cullFace)
@@ -581,11 +764,7 @@ void glimDepthRange(State &s, GLclampd zNear, GLclampd zFar)
 
 void glimDisable(State &s, GLenum cap)
 {
-    if (s.mNoExecute)
-    {
-        return;
-    }
-
+    // Still tracked under mNoExecute, OptimizeDL bakes VB layouts from it.
     glstDisable(s, cap);
 }
 
@@ -613,9 +792,11 @@ void glimDrawSWR(State &s)
     {
     case GL_POINT:
         s.mTopology = GL_POINTS;
+        MarkDirty(s, DIRTY_L0);
         break;
     case GL_LINE:
         s.mTopology = GL_LINE_STRIP;
+        MarkDirty(s, DIRTY_L0);
         break;
     default:
         break;
@@ -624,6 +805,71 @@ void glimDrawSWR(State &s)
     GetDDProcTable().pfnDraw(GetDDHandle(), s.mTopology, 0, GetVB(s).mNumVertices);
 }
 
+static void _glimSetUpDrawSWR(State &s, GLenum drawType, bool isIndexed);
+
+// Expands a baked triangle list into the line list of its edges.
+static void _glimBuildLineIndices(VertexBuffer &vb, GLsizei numIndices)
+{
+    GLuint numLines = (GLuint)numIndices * 2;
+    vb.mhLineIndexBuffer = GetDDProcTable().pfnCreateBuffer(GetDDHandle(), (numLines + KNOB_VS_SIMD_WIDTH) * sizeof(GLuint), NULL);
+    GLuint const *pTris = (GLuint const *)GetDDProcTable().pfnLockBuffer(GetDDHandle(), vb.mhIndexBuffer);
+    GLuint *pLines = (GLuint *)GetDDProcTable().pfnLockBufferDiscard(GetDDHandle(), vb.mhLineIndexBuffer);
+    for (GLsizei i = 0; i + 2 < numIndices; i += 3)
+    {
+        for (GLuint e = 0; e < 3; ++e)
+        {
+            *pLines++ = pTris[i + e];
+            *pLines++ = pTris[i + (e + 1) % 3];
+        }
+    }
+    // The fetch shader reads a full simd of indices, pad with index 0.
+    memset(pLines, 0, KNOB_VS_SIMD_WIDTH * sizeof(GLuint));
+    GetDDProcTable().pfnUnlockBuffer(GetDDHandle(), vb.mhLineIndexBuffer);
+    GetDDProcTable().pfnUnlockBuffer(GetDDHandle(), vb.mhIndexBuffer);
+}
+
+// Draws the 32-bit index buffer of the current VB, as baked by OptimizeDL.
+void glimDrawIndexedSWR(State &s, GLsizei numIndices)
+{
+    // If the context is undefined, then exit early.
+    if (s.mNoExecute)
+    {
+        return;
+    }
+
+    VertexBuffer &vb = GetVB(s);
+    if ((vb.mNumVertices == 0) || (numIndices <= 0))
+    {
+        return;
+    }
+
+    // Baked lists hold filled triangles; apply the polygon mode at draw time.
+    DDHANDLE hIndexBuffer = vb.mhIndexBuffer;
+    if ((s.mTopology == GL_TRIANGLES) && (s.mPolygonMode[0] != GL_FILL))
+    {
+        if (s.mPolygonMode[0] == GL_POINT)
+        {
+            s.mTopology = GL_POINTS;
+        }
+        else
+        {
+            if (!vb.mhLineIndexBuffer)
+            {
+                _glimBuildLineIndices(vb, numIndices);
+            }
+            hIndexBuffer = vb.mhLineIndexBuffer;
+            numIndices *= 2;
+            s.mTopology = GL_LINES;
+        }
+        MarkDirty(s, DIRTY_L0);
+    }
+
+    _glimSetUpDrawSWR(s, GL_NONE, true);
+
+    GetDDProcTable().pfnSetIndexBuffer(GetDDHandle(), hIndexBuffer);
+    GetDDProcTable().pfnDrawIndexed(GetDDHandle(), s.mTopology, GL_UNSIGNED_INT, numIndices, 0);
+}
+
 GLboolean _isActiveVBO(State &s, GLuint index)
 {
     switch (index)
@@ -719,6 +965,82 @@ HANDLE _getActiveVBO(State &s, GLuint index)
     return vbo.mHWBuffer;
 }
 
+// The fetch shader loads 4 components per attribute per simd lane, so it
+// can read this far past the last vertex of a stream.
+static const UINT FETCH_PADDING = 4 * 4 * KNOB_VS_SIMD_WIDTH;
+
+// Buffer of an array captured by glLockArraysEXT, in place or copied.
+static DDHANDLE _glimLockedArrayBuffer(VertexBuffer const &vb, GLuint vbIndex)
+{
+    return vb.mhBuffersUP[vbIndex] ? vb.mhBuffersUP[vbIndex] : vb.mhBuffers[vbIndex];
+}
+
+// True if no active array is read from the start of a VBO or locked buffer,
+// in which case streamed client arrays can start at the first vertex drawn.
+static bool _glimCanRebaseClientArrays(State &s, VertexBuffer const &vb)
+{
+    if ((s.mArraysLocked & 1) || s.mActiveVBOs.vertex)
+    {
+        return false;
+    }
+
+    UINT activeAttribs = (UINT)vb.mAttributes.mask & s.mCaps.attribArrayMask;
+    DWORD index;
+    while (_BitScanForward(&index, activeAttribs))
+    {
+        if ((s.mArraysLocked & (1 << (index + 1))) || _isActiveVBO(s, index))
+        {
+            return false;
+        }
+        activeAttribs &= ~(1 << index);
+    }
+    return true;
+}
+
+// True if every active array is fetched from the arrays locked in the main
+// VB, so the draw can take its VS outputs from the locked range's cache.
+static bool _glimCanUseVertexCache(State &s, VertexBuffer const &vb)
+{
+    if (!s.mhVertexCache || (&vb != &s._mVertexBuffer) || !(s.mArraysLocked & 1))
+    {
+        return false;
+    }
+
+    UINT activeAttribs = (UINT)vb.mAttributes.mask & s.mCaps.attribArrayMask;
+    DWORD index;
+    while (_BitScanForward(&index, activeAttribs))
+    {
+        if (!(s.mArraysLocked & (1 << (index + 1))))
+        {
+            return false;
+        }
+        activeAttribs &= ~(1 << index);
+    }
+    return true;
+}
+
+// Copies elements [first, first + count) of a client array into the stream
+// ring. Falls back to the VB's own buffer if the ring can't hold them.
+static DDHANDLE _glimStreamClientArray(State &s, VertexBuffer &vb, GLuint vbIndex, ArrayPointerParameters const &app, GLuint first, GLuint count)
+{
+    UINT size = count * app.mStride;
+    GLubyte const *pSrc = (GLubyte const *)app.mpElements + first * app.mStride;
+
+    GLvoid *pDst = NULL;
+    DDHANDLE hBuffer = s.mStreamRing.Alloc(size + FETCH_PADDING, pDst);
+    if (hBuffer)
+    {
+        memcpy(pDst, pSrc, size);
+        return hBuffer;
+    }
+
+    vb.getBuffer(vbIndex, size + FETCH_PADDING);
+    pDst = GetDDProcTable().pfnLockBufferDiscard(GetDDHandle(), vb.mhBuffers[vbIndex]);
+    memcpy(pDst, pSrc, size);
+    GetDDProcTable().pfnUnlockBuffer(GetDDHandle(), vb.mhBuffers[vbIndex]);
+    return vb.mhBuffers[vbIndex];
+}
+
 void glimDrawArrays(State &s, GLenum mode, GLint offset, GLsizei count)
 {
     // If the context is undfined, exit early.
@@ -727,7 +1049,16 @@ void glimDrawArrays(State &s, GLenum mode, GLint offset, GLsizei count)
         return;
     }
 
+    // Line loops are closed through an index buffer, polygons expanded to
+    // keep their first vertex provoking.
+    if ((mode == GL_LINE_LOOP) || (mode == GL_POLYGON))
+    {
+        glimMultiDrawArrays(s, mode, &offset, &count, 1);
+        return;
+    }
+
     GetDDProcTable().pfnNewDraw(GetDDHandle());
+    s.mStreamRing.NewDraw();
 
     VertexBuffer &vb = GetVB(s);
 
@@ -742,16 +1073,27 @@ void glimDrawArrays(State &s, GLenum mode, GLint offset, GLsizei count)
     // underlying attribute can be active or unactive.
     //
     // - if array is locked, assume active and pass locked buffer directly
-    // - if array is not locked and active and attrib is active, copy the active buffer contents
-    // - if array is not locked and active and attrib is not active, copy the underyling state value
-    //   into the buffer
+    // - if array is not locked and active and attrib is active, stream the client array
+    //   through the ring
+    // - if array is not locked and active and attrib is not active, GenShaders pulls the
+    //   underlying state value from the constant buffer
+
+    // Streamed arrays start at the first vertex drawn unless another stream
+    // is indexed from its start.
+    GLuint first = 0;
+    GLuint numStreamed = offset + count;
+    if (_glimCanRebaseClientArrays(s, vb))
+    {
+        first = offset;
+        numStreamed = count;
+    }
 
     // vertex buffers are sparse, and indexed by their attribute type, we pack them into a packed array before
     // sending to SWR
     DWORD index = 0;
     if (s.mArraysLocked & 1)
     {
-        vBuffers[idx] = vb.mhBuffers[index];
+        vBuffers[idx] = _glimLockedArrayBuffer(vb, index);
     }
     else if (s.mActiveVBOs.vertex)
     {
@@ -760,13 +1102,7 @@ void glimDrawArrays(State &s, GLenum mode, GLint offset, GLsizei count)
     }
     else
     {
-        int size = count * s.mArrayPointers.mVertex.mStride;
-        vb.getBuffer(index, size);
-        vb.mpfBuffers[index] = (GLfloat *)GetDDProcTable().pfnLockBufferDiscard(GetDDHandle(), vb.mhBuffers[index]);
-        memcpy(vb.mpfBuffers[index], (GLvoid *)s.mArrayPointers.mVertex.mpElements, size);
-        GetDDProcTable().pfnUnlockBuffer(GetDDHandle(), vb.mhBuffers[index]);
-        vb.mpfBuffers[index] = NULL;
-        vBuffers[idx] = vb.mhBuffers[index];
+        vBuffers[idx] = _glimStreamClientArray(s, vb, index, s.mArrayPointers.mVertex, first, numStreamed);
     }
     ++idx;
 
@@ -781,7 +1117,7 @@ void glimDrawArrays(State &s, GLenum mode, GLint offset, GLsizei count)
         int vbIndex = index + 1;
         if (s.mArraysLocked & (1 << vbIndex))
         {
-            vBuffers[idx] = vb.mhBuffers[vbIndex];
+            vBuffers[idx] = _glimLockedArrayBuffer(vb, vbIndex);
         }
         else if (_isActiveVBO(s, index))
         {
@@ -792,13 +1128,7 @@ void glimDrawArrays(State &s, GLenum mode, GLint offset, GLsizei count)
             // if attribute is active, but array is not, GenShaders will pull the attribute from the constant buffer instead
             if (activeArrays & (1 << index))
             {
-                int size = count * s.mArrayPointers.mArrays[index].mStride;
-                vb.getBuffer(vbIndex, size);
-                vb.mpfBuffers[vbIndex] = (GLfloat *)GetDDProcTable().pfnLockBufferDiscard(GetDDHandle(), vb.mhBuffers[vbIndex]);
-                memcpy(vb.mpfBuffers[vbIndex], (GLvoid *)s.mArrayPointers.mArrays[index].mpElements, size);
-                GetDDProcTable().pfnUnlockBuffer(GetDDHandle(), vb.mhBuffers[vbIndex]);
-                vb.mpfBuffers[vbIndex] = NULL;
-                vBuffers[idx] = vb.mhBuffers[vbIndex];
+                vBuffers[idx] = _glimStreamClientArray(s, vb, vbIndex, s.mArrayPointers.mArrays[index], first, numStreamed);
             }
             else
             {
@@ -833,142 +1163,410 @@ void glimDrawArrays(State &s, GLenum mode, GLint offset, GLsizei count)
 
     GetDDProcTable().pfnSetupSparseVertices(GetDDHandle(), s, vb.mAttributes, vb.mNumAttributes, &vBuffers[0], 0);
 
+    if (_glimCanUseVertexCache(s, vb))
+    {
+        GetDDProcTable().pfnUseVertexCache(GetDDHandle(), s.mhVertexCache);
+    }
+
     // Tell the DD to generate shaders based on the current state.
     GetDDProcTable().pfnGenShaders(GetDDHandle(), s, false, GL_UNSIGNED_INT);
 
     // draw it!
-    GetDDProcTable().pfnDraw(GetDDHandle(), mode, offset, count);
+    GetDDProcTable().pfnDraw(GetDDHandle(), mode, offset - first, count);
 }
 
 #if defined(WIN32)
 #pragma warning(disable : 4244)
 #endif
 
-void glimDrawElements(State &s, GLenum mode, GLsizei count, GLenum type, const GLvoid *indices)
+template <typename IndexType>
+static void _glimIndexRange(IndexType const *pIndices, GLsizei count, GLuint &minIndex, GLuint &maxIndex)
 {
-    // If the context is undfined, exit early.
-    if (s.mNoExecute)
+    for (GLsizei i = 0; i < count; ++i)
     {
-        return;
+        minIndex = std::min<GLuint>(minIndex, pIndices[i]);
+        maxIndex = std::max<GLuint>(maxIndex, pIndices[i]);
     }
+}
 
-    GetDDProcTable().pfnNewDraw(GetDDHandle());
-
-    // only support GL_TRIANGLES for now
-    assert(mode == GL_TRIANGLES);
-
-    VertexBuffer &vb = GetVB(s);
-
-    glimSetTopologySWR(s, mode);
-
-    UINT idx = 0;
-    DDHANDLE vBuffers[NUM_ATTRIBUTES];
-
-    idx = 0;
-
-    HANDLE savedIdxBuffer = vb.mhIndexBuffer;
-    UINT indexOffset = 0;
-
-    if (s.mActiveElementVBO)
+template <typename IndexType>
+static void _glimCopyIndices(IndexType *pDst, IndexType const *pSrc, GLsizei count, GLuint first)
+{
+    if (first == 0)
     {
-        indexOffset = reinterpret_cast<uintptr_t>(indices);
-        VertexBufferObject &vbo = s.mVBOs[s.mActiveElementVBO];
-        vb.mhIndexBuffer = vbo.mHWBuffer;
-        assert(vb.mhIndexBuffer != NULL);
+        memcpy(pDst, pSrc, count * sizeof(IndexType));
+        return;
     }
-    else
-    {
-        // setup index buffer
-        if (count > vb.mNumIndices)
-        {
-            GetDDProcTable().pfnDestroyBuffer(GetDDHandle(), vb.mhIndexBuffer);
-            vb.mhIndexBuffer = GetDDProcTable().pfnCreateBuffer(GetDDHandle(), count * sizeof(UINT) + KNOB_VS_SIMD_WIDTH * sizeof(UINT), NULL);
-            vb.mNumIndices = count;
-            savedIdxBuffer = vb.mhIndexBuffer;
-        }
-
-        vb.mpIndexBuffer = (GLuint *)GetDDProcTable().pfnLockBufferDiscard(GetDDHandle(), vb.mhIndexBuffer);
-        memset(vb.mpIndexBuffer, 0x0, count * sizeof(UINT) + KNOB_VS_SIMD_WIDTH * sizeof(UINT));
 
-        // assume index buffer type is unsigned int or short
-        assert(type == GL_UNSIGNED_INT || type == GL_UNSIGNED_SHORT);
-
-        UINT size = type == GL_UNSIGNED_INT ? count * sizeof(UINT) : count * sizeof(short);
-        memcpy(vb.mpIndexBuffer, indices, size);
-        GetDDProcTable().pfnUnlockBuffer(GetDDHandle(), vb.mpIndexBuffer);
+    for (GLsizei i = 0; i < count; ++i)
+    {
+        pDst[i] = (IndexType)(pSrc[i] - first);
     }
+}
 
-    GetDDProcTable().pfnSetIndexBuffer(GetDDHandle(), vb.mhIndexBuffer);
-
-    // 4 scenarios for the vertex arrays:
-    // 1- array is locked - pass the locked buffer directly
-    // 2- array is not locked but pos array is - lock discard and copy the contents
-    // 3- array is not locked and pos array is not locked - pass the UP pointer directly
-    // 4- VBOs are in use, pass the VBO handle directly
-
-    bool upArrayExists = false;
-
-    if (s.mArraysLocked & 1)
+// Number of list indices one draw expands to when it is batched with others.
+static GLsizei _glimListIndexCount(GLenum mode, GLsizei count)
+{
+    switch (mode)
     {
-        vBuffers[idx] = vb.mhBuffers[idx];
+    case GL_POINTS:
+        return count;
+    case GL_LINES:
+        return count & ~1;
+    case GL_TRIANGLES:
+        return count - count % 3;
+    case GL_QUADS:
+        return count & ~3;
+    case GL_LINE_STRIP:
+        return (count > 1) ? 2 * (count - 1) : 0;
+    case GL_LINE_LOOP:
+        return (count > 2) ? 2 * count : ((count == 2) ? 2 : 0);
+    case GL_QUAD_STRIP:
+        count &= ~1;
+    // fall through
+    case GL_TRIANGLE_STRIP:
+    case GL_TRIANGLE_FAN:
+    case GL_POLYGON:
+        return (count > 2) ? 3 * (count - 2) : 0;
+    default:
+        return 0;
     }
-    else if (s.mActiveVBOs.vertex)
+}
+
+// Topology a batch of draws is submitted with.
+static GLenum _glimListTopology(GLenum mode)
+{
+    switch (mode)
     {
-        VertexBufferObject &vbo = s.mVBOs[s.mActiveVBOs.vertex];
-        vBuffers[idx] = vbo.mHWBuffer;
+    case GL_LINE_STRIP:
+    case GL_LINE_LOOP:
+        return GL_LINES;
+    case GL_TRIANGLE_STRIP:
+    case GL_TRIANGLE_FAN:
+    case GL_QUAD_STRIP:
+    case GL_POLYGON:
+        return GL_TRIANGLES;
+    default:
+        return mode;
     }
-    else
+}
+
+// True if a draw is expanded to list indices: batches, and polygons, which
+// a triangle fan would give the wrong provoking vertex.
+static bool _glimExpandsToList(GLenum mode, GLsizei drawCount)
+{
+    return (drawCount > 1) || (mode == GL_POLYGON);
+}
+
+// Appends the rebased list indices for one draw of a batch. Triangles come
+// out in the order the SWR primitive assembler produces for the original
+// topology, so culling is unchanged.
+template <typename IndexType>
+static IndexType *_glimAppendListIndices(IndexType *pDst, GLenum mode, IndexType const *pSrc, GLsizei count, GLuint first)
+{
+    GLsizei n = count;
+    switch (mode)
     {
-        // destroy and recreate buffer
-        if (vb.mhBuffersUP[idx])
+    case GL_POINTS:
+    case GL_LINES:
+    case GL_TRIANGLES:
+    case GL_QUADS:
+        n = _glimListIndexCount(mode, count);
+        _glimCopyIndices(pDst, pSrc, n, first);
+        return pDst + n;
+    case GL_LINE_STRIP:
+    case GL_LINE_LOOP:
+        for (GLsizei i = 0; i + 1 < n; ++i)
         {
-            GetDDProcTable().pfnDestroyBuffer(GetDDHandle(), vb.mhBuffersUP[idx]);
+            *pDst++ = (IndexType)(pSrc[i] - first);
+            *pDst++ = (IndexType)(pSrc[i + 1] - first);
         }
-        vb.mhBuffersUP[idx] = GetDDProcTable().pfnCreateBuffer(GetDDHandle(), 0, (GLvoid *)s.mArrayPointers.mVertex.mpElements);
-        vBuffers[idx] = vb.mhBuffersUP[idx];
-        upArrayExists = true;
+        if ((mode == GL_LINE_LOOP) && (n > 2))
+        {
+            *pDst++ = (IndexType)(pSrc[n - 1] - first);
+            *pDst++ = (IndexType)(pSrc[0] - first);
+        }
+        return pDst;
+    case GL_QUAD_STRIP:
+        n &= ~1;
+    // fall through
+    case GL_TRIANGLE_STRIP:
+        for (GLsizei i = 0; i + 2 < n; ++i)
+        {
+            *pDst++ = (IndexType)(pSrc[(i & 1) ? i + 1 : i] - first);
+            *pDst++ = (IndexType)(pSrc[(i & 1) ? i : i + 1] - first);
+            *pDst++ = (IndexType)(pSrc[i + 2] - first);
+        }
+        return pDst;
+    case GL_TRIANGLE_FAN:
+        for (GLsizei i = 1; i + 1 < n; ++i)
+        {
+            *pDst++ = (IndexType)(pSrc[0] - first);
+            *pDst++ = (IndexType)(pSrc[i] - first);
+            *pDst++ = (IndexType)(pSrc[i + 1] - first);
+        }
+        return pDst;
+    case GL_POLYGON:
+        // rotated so the polygon's first vertex is each triangle's last,
+        // provoking vertex
+        for (GLsizei i = 1; i + 1 < n; ++i)
+        {
+            *pDst++ = (IndexType)(pSrc[i] - first);
+            *pDst++ = (IndexType)(pSrc[i + 1] - first);
+            *pDst++ = (IndexType)(pSrc[0] - first);
+        }
+        return pDst;
+    default:
+        return pDst;
     }
-    ++idx;
+}
 
-    // attributes next
-    UINT64 lockedAttribs = s.mArraysLocked >> 1;
+// Indices of one draw, either client memory or an offset into the mapped
+// element buffer at pBase.
+static GLubyte const *_glimIndexSource(GLubyte const *pBase, GLvoid const *indices)
+{
+    return pBase ? pBase + reinterpret_cast<uintptr_t>(indices) : (GLubyte const *)indices;
+}
+
+template <typename IndexType>
+static void _glimDrawsIndexRange(GLubyte const *pBase, GLvoid const *const *indices, GLsizei const *counts, GLsizei drawCount, GLuint &minIndex, GLuint &maxIndex)
+{
+    for (GLsizei i = 0; i < drawCount; ++i)
+    {
+        _glimIndexRange((IndexType const *)_glimIndexSource(pBase, indices[i]), counts[i], minIndex, maxIndex);
+    }
+}
+
+// Writes the indices of all draws. A batch or polygon is expanded to list
+// indices, a single line loop is closed by repeating its first index.
+template <typename IndexType>
+static void _glimWriteIndices(IndexType *pDst, GLenum mode, GLubyte const *pBase, GLvoid const *const *indices, GLsizei const *counts, GLsizei drawCount, GLuint first)
+{
+    if (_glimExpandsToList(mode, drawCount))
+    {
+        for (GLsizei i = 0; i < drawCount; ++i)
+        {
+            pDst = _glimAppendListIndices(pDst, mode, (IndexType const *)_glimIndexSource(pBase, indices[i]), counts[i], first);
+        }
+        return;
+    }
+
+    IndexType const *pSrc = (IndexType const *)_glimIndexSource(pBase, indices[0]);
+    _glimCopyIndices(pDst, pSrc, counts[0], first);
+    if (mode == GL_LINE_LOOP)
+    {
+        pDst[counts[0]] = (IndexType)(pSrc[0] - first);
+    }
+}
+
+// Common path of the glDrawElements family and glMultiDrawArrays. A single
+// draw keeps its topology, several draws are expanded to list indices and
+// submitted as one indexed draw. Indices are fetched in their native width.
+// pRange, if set, is the [start, end] vertex range promised by the caller.
+static void _glimDrawIndexed(State &s, GLenum mode, GLsizei const *counts, GLenum type, GLvoid const *const *indices, GLsizei drawCount, bool clientIndices, GLuint const *pRange)
+{
+    UINT indexSize = 0;
+    switch (type)
+    {
+    case GL_UNSIGNED_BYTE:
+        indexSize = sizeof(GLubyte);
+        break;
+    case GL_UNSIGNED_SHORT:
+        indexSize = sizeof(GLushort);
+        break;
+    case GL_UNSIGNED_INT:
+        indexSize = sizeof(GLuint);
+        break;
+    default:
+        s.mLastError = GL_INVALID_ENUM;
+        return;
+    }
+
+    if (mode > GL_POLYGON)
+    {
+        s.mLastError = GL_INVALID_ENUM;
+        return;
+    }
+
+    bool batched = _glimExpandsToList(mode, drawCount);
+    GLenum drawMode = batched ? _glimListTopology(mode) : ((mode == GL_LINE_LOOP) ? GL_LINE_STRIP : mode);
+
+    GLsizei numIndices = 0;
+    for (GLsizei i = 0; i < drawCount; ++i)
+    {
+        if (counts[i] < 0)
+        {
+            s.mLastError = GL_INVALID_VALUE;
+            return;
+        }
+        numIndices += batched ? _glimListIndexCount(mode, counts[i]) : counts[i];
+    }
+    if ((mode == GL_LINE_LOOP) && !batched && numIndices)
+    {
+        ++numIndices;
+    }
+    if (numIndices == 0)
+    {
+        return;
+    }
+
+    GetDDProcTable().pfnNewDraw(GetDDHandle());
+    s.mStreamRing.NewDraw();
+
+    VertexBuffer &vb = GetVB(s);
+
+    glimSetTopologySWR(s, drawMode);
+
+    UINT idx = 0;
+    DDHANDLE vBuffers[NUM_ATTRIBUTES];
+
+    // Client arrays only need the range of vertices the indices reference.
+    bool clientArrays = !(s.mArraysLocked & 1) && !s.mActiveVBOs.vertex;
     UINT activeAttribs = vb.mAttributes.mask;
     UINT activeArrays = s.mCaps.attribArrayMask;
     DWORD index;
+    for (UINT attribs = activeAttribs & activeArrays; _BitScanForward(&index, attribs); attribs &= ~(1 << index))
+    {
+        clientArrays |= !(s.mArraysLocked & (1 << (index + 1))) && !_isActiveVBO(s, index);
+    }
+
+    // Element VBO indices are drawn in place unless they have to be rewritten.
+    bool rewrite = clientIndices || batched || (mode == GL_LINE_LOOP);
+
+    DDHANDLE hIndexBuffer = NULL;
+    UINT indexOffset = 0;
+    GLubyte const *pBase = NULL;
+    if (!clientIndices)
+    {
+        VertexBufferObject &vbo = s.mVBOs[s.mActiveElementVBO];
+        hIndexBuffer = vbo.mHWBuffer;
+        assert(hIndexBuffer != NULL);
+
+        if (!rewrite)
+        {
+            indexOffset = reinterpret_cast<uintptr_t>(indices[0]);
+        }
+
+        // Read only, to rewrite the indices or find the vertex range.
+        if (rewrite || (clientArrays && !pRange))
+        {
+            pBase = (GLubyte const *)GetDDProcTable().pfnLockBufferNoOverwrite(GetDDHandle(), hIndexBuffer);
+        }
+    }
+
+    GLuint minIndex = UINT_MAX;
+    GLuint maxIndex = 0;
+    if (clientArrays && pRange)
+    {
+        minIndex = pRange[0];
+        maxIndex = pRange[1];
+    }
+    else if (clientArrays)
+    {
+        switch (type)
+        {
+        case GL_UNSIGNED_BYTE:
+            _glimDrawsIndexRange<GLubyte>(pBase, indices, counts, drawCount, minIndex, maxIndex);
+            break;
+        case GL_UNSIGNED_SHORT:
+            _glimDrawsIndexRange<GLushort>(pBase, indices, counts, drawCount, minIndex, maxIndex);
+            break;
+        default:
+            _glimDrawsIndexRange<GLuint>(pBase, indices, counts, drawCount, minIndex, maxIndex);
+            break;
+        }
+    }
+
+    // Rebasing rewrites the indices, so it can't use the element VBO in place.
+    GLuint first = 0;
+    if (clientArrays && rewrite && _glimCanRebaseClientArrays(s, vb))
+    {
+        first = minIndex;
+    }
+    GLuint numStreamed = clientArrays ? (maxIndex + 1 - first) : 0;
+
+    if (rewrite)
+    {
+        // The fetch shader reads a full simd of indices, pad with index 0.
+        UINT size = numIndices * indexSize + KNOB_VS_SIMD_WIDTH * sizeof(UINT);
+        GLvoid *pDst = NULL;
+        hIndexBuffer = s.mStreamRing.Alloc(size, pDst);
+        if (hIndexBuffer == NULL)
+        {
+            if (numIndices > vb.mNumIndices)
+            {
+                GetDDProcTable().pfnDestroyBuffer(GetDDHandle(), vb.mhIndexBuffer);
+                vb.mhIndexBuffer = GetDDProcTable().pfnCreateBuffer(GetDDHandle(), numIndices * sizeof(UINT) + KNOB_VS_SIMD_WIDTH * sizeof(UINT), NULL);
+                vb.mNumIndices = numIndices;
+            }
+            hIndexBuffer = vb.mhIndexBuffer;
+            pDst = GetDDProcTable().pfnLockBufferDiscard(GetDDHandle(), hIndexBuffer);
+        }
+
+        switch (type)
+        {
+        case GL_UNSIGNED_BYTE:
+            _glimWriteIndices((GLubyte *)pDst, mode, pBase, indices, counts, drawCount, first);
+            break;
+        case GL_UNSIGNED_SHORT:
+            _glimWriteIndices((GLushort *)pDst, mode, pBase, indices, counts, drawCount, first);
+            break;
+        default:
+            _glimWriteIndices((GLuint *)pDst, mode, pBase, indices, counts, drawCount, first);
+            break;
+        }
+        memset((GLubyte *)pDst + numIndices * indexSize, 0, KNOB_VS_SIMD_WIDTH * sizeof(UINT));
+        GetDDProcTable().pfnUnlockBuffer(GetDDHandle(), hIndexBuffer);
+    }
+
+    if (pBase)
+    {
+        GetDDProcTable().pfnUnlockBuffer(GetDDHandle(), s.mVBOs[s.mActiveElementVBO].mHWBuffer);
+    }
+
+    GetDDProcTable().pfnSetIndexBuffer(GetDDHandle(), hIndexBuffer);
+
+    // 3 scenarios for the vertex arrays:
+    // 1- array is locked - pass the locked buffer directly
+    // 2- VBOs are in use, pass the VBO handle directly
+    // 3- client array - stream the referenced vertices through the ring
+
+    if (s.mArraysLocked & 1)
+    {
+        vBuffers[idx] = _glimLockedArrayBuffer(vb, idx);
+    }
+    else if (s.mActiveVBOs.vertex)
+    {
+        VertexBufferObject &vbo = s.mVBOs[s.mActiveVBOs.vertex];
+        vBuffers[idx] = vbo.mHWBuffer;
+    }
+    else
+    {
+        vBuffers[idx] = _glimStreamClientArray(s, vb, idx, s.mArrayPointers.mVertex, first, numStreamed);
+    }
+    ++idx;
 
+    // attributes next
     while (_BitScanForward(&index, activeAttribs))
     {
+        int vbIndex = index + 1;
+
         // if client array is not active, no VB for this slot
         if (!(activeArrays & (1 << index)))
         {
             vBuffers[idx] = NULL;
         }
-        else if (s.mArraysLocked & (1 << index))
+        else if (s.mArraysLocked & (1 << vbIndex))
         {
-            vBuffers[idx] = vb.mhBuffers[idx];
+            vBuffers[idx] = _glimLockedArrayBuffer(vb, vbIndex);
         }
         else if (_isActiveVBO(s, index))
         {
             vBuffers[idx] = _getActiveVBO(s, index);
         }
-        else if (s.mArraysLocked & 1)
-        {
-            UINT size = (s.mLockedCount) * s.mArrayPointers.mArrays[index].mStride;
-
-            void *pBuffer = GetDDProcTable().pfnLockBufferDiscard(GetDDHandle(), vb.mhBuffers[idx]);
-            memcpy(pBuffer, (GLubyte *)s.mArrayPointers.mArrays[index].mpElements, size);
-            GetDDProcTable().pfnUnlockBuffer(GetDDHandle(), vb.mhBuffers[idx]);
-            vBuffers[idx] = vb.mhBuffers[idx];
-        }
         else
         {
-            if (vb.mhBuffersUP[idx])
-            {
-                GetDDProcTable().pfnDestroyBuffer(GetDDHandle(), vb.mhBuffersUP[idx]);
-            }
-            vb.mhBuffersUP[idx] = GetDDProcTable().pfnCreateBuffer(GetDDHandle(), 0, (GLvoid *)s.mArrayPointers.mArrays[index].mpElements);
-            vBuffers[idx] = vb.mhBuffersUP[idx];
-            upArrayExists = true;
+            vBuffers[idx] = _glimStreamClientArray(s, vb, vbIndex, s.mArrayPointers.mArrays[index], first, numStreamed);
         }
         ++idx;
         activeAttribs &= ~(1 << index);
@@ -998,27 +1596,115 @@ void glimDrawElements(State &s, GLenum mode, GLsizei count, GLenum type, const G
 
     GetDDProcTable().pfnSetupSparseVertices(GetDDHandle(), s, vb.mAttributes, vb.mNumAttributes, &vBuffers[0], 0);
 
+    if (_glimCanUseVertexCache(s, vb))
+    {
+        GetDDProcTable().pfnUseVertexCache(GetDDHandle(), s.mhVertexCache);
+    }
+
     // Tell the DD to generate shaders based on the current state.
     GetDDProcTable().pfnGenShaders(GetDDHandle(), s, true, type);
 
     // draw it!
-    GetDDProcTable().pfnDrawIndexed(GetDDHandle(), mode, type, count, indexOffset);
+    GetDDProcTable().pfnDrawIndexed(GetDDHandle(), drawMode, type, numIndices, indexOffset);
+}
 
-    // Synchronize if we created any UP buffer
-    if (upArrayExists)
+void glimDrawElements(State &s, GLenum mode, GLsizei count, GLenum type, const GLvoid *indices)
+{
+    // If the context is undfined, exit early.
+    if (s.mNoExecute)
     {
-        for (UINT i = 0; i < idx; ++i)
+        return;
+    }
+
+    _glimDrawIndexed(s, mode, &count, type, &indices, 1, !s.mActiveElementVBO, NULL);
+}
+
+void glimDrawRangeElements(State &s, GLenum mode, GLuint start, GLuint end, GLsizei count, GLenum type, const GLvoid *indices)
+{
+    if (s.mNoExecute)
+    {
+        return;
+    }
+
+    if (end < start)
+    {
+        s.mLastError = GL_INVALID_VALUE;
+        return;
+    }
+
+    // The promised range saves scanning the indices for client arrays.
+    GLuint range[2] = { start, end };
+    _glimDrawIndexed(s, mode, &count, type, &indices, 1, !s.mActiveElementVBO, range);
+}
+
+void glimMultiDrawElements(State &s, GLenum mode, const GLsizei *count, GLenum type, const GLvoid *const *indices, GLsizei drawcount)
+{
+    if (s.mNoExecute)
+    {
+        return;
+    }
+
+    if (drawcount < 0)
+    {
+        s.mLastError = GL_INVALID_VALUE;
+        return;
+    }
+
+    if (drawcount > 0)
+    {
+        _glimDrawIndexed(s, mode, count, type, indices, drawcount, !s.mActiveElementVBO, NULL);
+    }
+}
+
+void glimMultiDrawArrays(State &s, GLenum mode, const GLint *first, const GLsizei *count, GLsizei drawcount)
+{
+    if (s.mNoExecute)
+    {
+        return;
+    }
+
+    if (drawcount < 0)
+    {
+        s.mLastError = GL_INVALID_VALUE;
+        return;
+    }
+
+    GLuint range[2] = { UINT_MAX, 0 };
+    GLsizei total = 0;
+    for (GLsizei i = 0; i < drawcount; ++i)
+    {
+        if ((first[i] < 0) || (count[i] < 0))
         {
-            if (vb.mhBuffersUP[i])
-            {
-                GetDDProcTable().pfnDestroyBuffer(GetDDHandle(), vb.mhBuffersUP[i]);
-                vb.mhBuffersUP[i] = NULL;
-            }
+            s.mLastError = GL_INVALID_VALUE;
+            return;
+        }
+        if (count[i] > 0)
+        {
+            range[0] = std::min<GLuint>(range[0], first[i]);
+            range[1] = std::max<GLuint>(range[1], first[i] + count[i] - 1);
+            total += count[i];
         }
     }
 
-    // restore main index buffer
-    vb.mhIndexBuffer = savedIdxBuffer;
+    if (total == 0)
+    {
+        return;
+    }
+
+    // Generate sequential indices so the whole batch is one indexed draw.
+    std::vector<GLuint> sequential(total);
+    std::vector<GLvoid const *> indices(drawcount);
+    GLuint *pIndex = &sequential[0];
+    for (GLsizei i = 0; i < drawcount; ++i)
+    {
+        indices[i] = pIndex;
+        for (GLsizei j = 0; j < count[i]; ++j)
+        {
+            *pIndex++ = first[i] + j;
+        }
+    }
+
+    _glimDrawIndexed(s, mode, count, GL_UNSIGNED_INT, &indices[0], drawcount, true, range);
 }
 
 #if defined(WIN32)
@@ -1027,11 +1713,7 @@ void glimDrawElements(State &s, GLenum mode, GLsizei count, GLenum type, const G
 
 void glimEnable(State &s, GLenum cap)
 {
-    if (s.mNoExecute)
-    {
-        return;
-    }
-
+    // Still tracked under mNoExecute, OptimizeDL bakes VB layouts from it.
     glstEnable(s, cap);
 }
 
@@ -1049,10 +1731,53 @@ void glimEndList(State &s)
 {
 
     OptimizeDL(s, CompilingDL());
+    CompileDL(CompilingDL());
     s.mDisplayListMode = GL_NONE;
     s.mCompilingDL = 0;
 }
 
+void glimFeedbackBuffer(State &s, GLsizei size, GLenum type, GLfloat *buffer)
+{
+    if (s.mRenderMode == GL_FEEDBACK)
+    {
+        s.mLastError = GL_INVALID_OPERATION;
+        return;
+    }
+
+    if (size < 0)
+    {
+        s.mLastError = GL_INVALID_VALUE;
+        return;
+    }
+
+    switch (type)
+    {
+    case GL_2D:
+    case GL_3D:
+    case GL_3D_COLOR:
+    case GL_3D_COLOR_TEXTURE:
+    case GL_4D_COLOR_TEXTURE:
+        break;
+    default:
+        s.mLastError = GL_INVALID_ENUM;
+        return;
+    }
+
+    s.mpFeedbackBuffer = buffer;
+    s.mFeedbackBufferSize = size;
+    s.mFeedbackType = type;
+}
+
+void glimFinish(State &s)
+{
+    GetDDProcTable().pfnFinish(GetDDHandle());
+}
+
+void glimFlush(State &s)
+{
+    // Draws are queued to the workers as they are issued.
+}
+
 void glimFogfv(State &s, GLenum pname, const GLfloat *params)
 {
     glstFogfv(s, pname, params);
@@ -1157,6 +1882,24 @@ void glimHint(State &, GLenum, GLenum)
     // We ignore this.
 }
 
+// Draws after a name stack change go to a new hit record of the current names.
+static void _glimNewSelectHit(State &s)
+{
+    GetDDProcTable().pfnNewSelectHit(GetDDHandle());
+    s.mSelectNames.push_back(s.mNameStack);
+}
+
+void glimInitNames(State &s)
+{
+    if (s.mRenderMode != GL_SELECT)
+    {
+        return;
+    }
+
+    s.mNameStack.clear();
+    _glimNewSelectHit(s);
+}
+
 GLboolean glimIsEnabled(State &s, GLenum cap)
 {
     return glstIsEnabled(s, cap);
@@ -1174,56 +1917,104 @@ void glimLightModel(State &s, GLenum pname, std::array<GLfloat, 4> const &params
 
 void glimLoadIdentity(State &s)
 {
-    glstLoadIdentity(s);
+    glstLoadIdentity(s);
+}
+
+void glimLoadMatrix(State &s, SWRL::m44f const &m)
+{
+    glstLoadMatrix(s, m);
+}
+
+// XXX: assumes 4KB pages.
+// True if the fetch shader's over-read past the end of an array can't leave
+// the page the array ends in.
+static bool _glimCanFetchInPlace(GLvoid const *pElements, UINT size)
+{
+    uintptr_t last = reinterpret_cast<uintptr_t>(pElements) + size - 1;
+    return (last >> 12) == ((last + FETCH_PADDING) >> 12);
+}
+
+// Captures the arrays for [0, first + count). Until glUnlockArraysEXT the
+// application guarantees the arrays don't change, so arrays of the main VB
+// are read in place where the fetch allows it. Display list VBs take a copy.
+static void _glimLockArray(State &s, VertexBuffer &vb, GLuint vbIndex, ArrayPointerParameters const &app, UINT size)
+{
+    if ((&vb == &s._mVertexBuffer) && _glimCanFetchInPlace(app.mpElements, size))
+    {
+        vb.mhBuffersUP[vbIndex] = GetDDProcTable().pfnCreateBuffer(GetDDHandle(), 0, (GLvoid *)app.mpElements);
+        return;
+    }
+
+    vb.getBuffer(vbIndex, size + FETCH_PADDING);
+    void *pBuffer = GetDDProcTable().pfnLockBufferDiscard(GetDDHandle(), vb.mhBuffers[vbIndex]);
+    memcpy(pBuffer, app.mpElements, size);
+    GetDDProcTable().pfnUnlockBuffer(GetDDHandle(), vb.mhBuffers[vbIndex]);
+}
+
+// Drops in-place arrays of a previous lock. Destroying the UP buffers waits
+// for the draws still reading the application's arrays.
+static void _glimReleaseLockedArrays(VertexBuffer &vb)
+{
+    for (GLuint i = 0; i < NUM_ATTRIBUTES; ++i)
+    {
+        if (vb.mhBuffersUP[i])
+        {
+            GetDDProcTable().pfnDestroyBuffer(GetDDHandle(), vb.mhBuffersUP[i]);
+            vb.mhBuffersUP[i] = NULL;
+        }
+    }
 }
 
-void glimLoadMatrix(State &s, SWRL::m44f const &m)
+// The cache outlives neither the locked arrays nor the lock range.
+static void _glimReleaseVertexCache(State &s)
 {
-    glstLoadMatrix(s, m);
+    if (s.mhVertexCache)
+    {
+        GetDDProcTable().pfnDestroyVertexCache(GetDDHandle(), s.mhVertexCache);
+        s.mhVertexCache = NULL;
+    }
 }
 
 void glimLockArraysEXT(State &s, GLint first, GLsizei count)
 {
-    // copy active arrays directly into the active VBs
     VertexBuffer &vb = GetVB(s);
-
-    UINT idx = 0;
+    _glimReleaseLockedArrays(vb);
+    _glimReleaseVertexCache(s);
 
     // set up pos
     assert(s.mCaps.vertexArray);
 
-    // fetch shader always tries to load 4 components per attribute per simd width, so pad out allocation to this
-    UINT padding = 4 * 4 * KNOB_VS_SIMD_WIDTH;
-    UINT offset = 0;
-    UINT size = (count + first) * s.mArrayPointers.mVertex.mStride;
-
-    vb.getBuffer(0, size + padding);
-    void *pBuffer = GetDDProcTable().pfnLockBufferDiscard(GetDDHandle(), vb.mhBuffers[idx]);
-    memcpy(pBuffer, (GLubyte *)s.mArrayPointers.mVertex.mpElements + offset, size);
-    GetDDProcTable().pfnUnlockBuffer(GetDDHandle(), vb.mhBuffers[idx]);
-    ++idx;
-    s.mArraysLocked = 1;
+    // Arrays sourced from VBOs are already in buffers and aren't locked.
+    s.mArraysLocked = 0;
+    if (!s.mActiveVBOs.vertex)
+    {
+        _glimLockArray(s, vb, 0, s.mArrayPointers.mVertex, (count + first) * s.mArrayPointers.mVertex.mStride);
+        s.mArraysLocked = 1;
+    }
 
     // set up attribute arrays
     UINT enabledArrays = s.mCaps.attribArrayMask;
-    s.mArraysLocked = 1 | (enabledArrays << 1);
 
     DWORD index;
     while (_BitScanForward(&index, enabledArrays))
     {
-        int vbIndex = index + 1;
-        UINT offset = 0;
-        UINT size = (count + first) * s.mArrayPointers.mArrays[index].mStride;
-
-        vb.getBuffer(vbIndex, size + padding);
-        void *pBuffer = GetDDProcTable().pfnLockBufferDiscard(GetDDHandle(), vb.mhBuffers[vbIndex]);
-        memcpy(pBuffer, (GLubyte *)s.mArrayPointers.mArrays[index].mpElements + offset, size);
-        GetDDProcTable().pfnUnlockBuffer(GetDDHandle(), vb.mhBuffers[vbIndex]);
-        ++idx;
+        if (!_isActiveVBO(s, index))
+        {
+            int vbIndex = index + 1;
+            _glimLockArray(s, vb, vbIndex, s.mArrayPointers.mArrays[index], (count + first) * s.mArrayPointers.mArrays[index].mStride);
+            s.mArraysLocked |= (1 << vbIndex);
+        }
         enabledArrays &= ~(1 << index);
     }
 
     s.mLockedCount = (first + count);
+
+    // Draws from the locked range run fetch and the VS on it once per
+    // pipeline and reuse the outputs.
+    if ((&vb == &s._mVertexBuffer) && (s.mArraysLocked & 1) && (count > 0))
+    {
+        s.mhVertexCache = GetDDProcTable().pfnCreateVertexCache(GetDDHandle(), first, count);
+    }
 }
 
 void glimSetLockedArraysSWR(State &s, GLint lockedArrays)
@@ -1286,6 +2077,23 @@ void glimNormalPointer(State &s, GLenum type, GLsizei stride, const GLvoid *poin
     glstNormalPointer(s, type, stride, pointer);
 }
 
+void glimLoadName(State &s, GLuint name)
+{
+    if (s.mRenderMode != GL_SELECT)
+    {
+        return;
+    }
+
+    if (s.mNameStack.empty())
+    {
+        s.mLastError = GL_INVALID_OPERATION;
+        return;
+    }
+
+    s.mNameStack.back() = name;
+    _glimNewSelectHit(s);
+}
+
 void glimNumVerticesSWR(State &s, GLuint num, VertexAttributeFormats vAttrFmts)
 {
     // Ignore hint.
@@ -1296,6 +2104,14 @@ void glimOrtho(State &s, GLdouble left, GLdouble right, GLdouble bottom, GLdoubl
     glstOrtho(s, left, right, bottom, top, zNear, zFar);
 }
 
+void glimPassThrough(State &s, GLfloat token)
+{
+    if (s.mRenderMode == GL_FEEDBACK)
+    {
+        GetDDProcTable().pfnPassThrough(GetDDHandle(), token);
+    }
+}
+
 void glimPixelStoref(State &s, GLenum pname, GLfloat param)
 {
     glstPixelStorei(s, pname, (GLint)param);
@@ -1321,6 +2137,23 @@ void glimPopMatrix(State &s)
     glstPopMatrix(s);
 }
 
+void glimPopName(State &s)
+{
+    if (s.mRenderMode != GL_SELECT)
+    {
+        return;
+    }
+
+    if (s.mNameStack.empty())
+    {
+        s.mLastError = GL_STACK_UNDERFLOW;
+        return;
+    }
+
+    s.mNameStack.pop_back();
+    _glimNewSelectHit(s);
+}
+
 void glimPushAttrib(State &s, GLbitfield mask)
 {
     glstPushAttrib(s, mask);
@@ -1331,6 +2164,23 @@ void glimPushMatrix(State &s)
     glstPushMatrix(s);
 }
 
+void glimPushName(State &s, GLuint name)
+{
+    if (s.mRenderMode != GL_SELECT)
+    {
+        return;
+    }
+
+    if (s.mNameStack.size() >= MAX_NAME_STACK_DEPTH)
+    {
+        s.mLastError = GL_STACK_OVERFLOW;
+        return;
+    }
+
+    s.mNameStack.push_back(name);
+    _glimNewSelectHit(s);
+}
+
 void glimReadPixels(State &s, GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, GLvoid *pixels)
 {
     RDTSC_START(APIReadPixels);
@@ -1355,6 +2205,77 @@ void glimReadPixels(State &s, GLint x, GLint y, GLsizei width, GLsizei height, G
     RDTSC_STOP(APIReadPixels, 0, 0);
 }
 
+// Writes the hit records that saw a primitive; -1 if the buffer overflowed.
+static GLint _glimWriteSelectHits(State &s)
+{
+    GLint numHits = 0;
+    GLsizei pos = 0;
+    for (GLuint i = 0; i < s.mSelectNames.size(); ++i)
+    {
+        GLuint minZ, maxZ;
+        if (!GetDDProcTable().pfnGetSelectHit(GetDDHandle(), i, minZ, maxZ))
+        {
+            continue;
+        }
+
+        std::vector<GLuint> const &names = s.mSelectNames[i];
+        GLuint header[3] = { (GLuint)names.size(), minZ, maxZ };
+        for (GLuint j = 0; j < 3 + names.size(); ++j, ++pos)
+        {
+            if (pos == s.mSelectBufferSize)
+            {
+                return -1;
+            }
+            s.mpSelectBuffer[pos] = (j < 3) ? header[j] : names[j - 3];
+        }
+        ++numHits;
+    }
+    return numHits;
+}
+
+GLint glimRenderMode(State &s, GLenum mode)
+{
+    if (mode != GL_RENDER && mode != GL_SELECT && mode != GL_FEEDBACK)
+    {
+        s.mLastError = GL_INVALID_ENUM;
+        return 0;
+    }
+
+    if ((mode == GL_SELECT && !s.mpSelectBuffer) || (mode == GL_FEEDBACK && !s.mpFeedbackBuffer))
+    {
+        s.mLastError = GL_INVALID_OPERATION;
+        return 0;
+    }
+
+    // Waits for the draws of the current mode before its results are read.
+    GetDDProcTable().pfnSetRenderMode(GetDDHandle(), GL_RENDER, NULL, 0, GL_NONE);
+
+    GLint result = 0;
+    if (s.mRenderMode == GL_SELECT)
+    {
+        result = _glimWriteSelectHits(s);
+    }
+    else if (s.mRenderMode == GL_FEEDBACK)
+    {
+        GLsizei count = GetDDProcTable().pfnGetFeedbackCount(GetDDHandle());
+        result = (count > s.mFeedbackBufferSize) ? -1 : count;
+    }
+
+    s.mRenderMode = mode;
+    s.mSelectNames.clear();
+    if (mode != GL_RENDER)
+    {
+        // Select mode starts with a hit record for the current names.
+        GetDDProcTable().pfnSetRenderMode(GetDDHandle(), mode, s.mpFeedbackBuffer, s.mFeedbackBufferSize, s.mFeedbackType);
+        if (mode == GL_SELECT)
+        {
+            s.mSelectNames.push_back(s.mNameStack);
+        }
+    }
+
+    return result;
+}
+
 void glimResetMainVBSWR(State &s)
 {
     glstResetMainVBSWR(s);
@@ -1375,6 +2296,24 @@ void glimScissor(State &s, GLint x, GLint y, GLsizei width, GLsizei height)
     glstScissor(s, x, y, width, height);
 }
 
+void glimSelectBuffer(State &s, GLsizei size, GLuint *buffer)
+{
+    if (s.mRenderMode == GL_SELECT)
+    {
+        s.mLastError = GL_INVALID_OPERATION;
+        return;
+    }
+
+    if (size < 0)
+    {
+        s.mLastError = GL_INVALID_VALUE;
+        return;
+    }
+
+    s.mpSelectBuffer = buffer;
+    s.mSelectBufferSize = size;
+}
+
 void glimSetClearMaskSWR(State &s, GLbitfield mask)
 {
     glstSetClearMaskSWR(s, mask);
@@ -1387,14 +2326,8 @@ void glimSetTopologySWR(State &s, GLenum topology)
     _glimSetupVertexLayoutSWR(s, GetVB(s).mVBIEDLayout);
 }
 
-void glimSetUpDrawSWR(State &s, GLenum drawType)
+static void _glimSetUpDrawSWR(State &s, GLenum drawType, bool isIndexed)
 {
-    // If the context is undefined, then exit early.
-    if (s.mNoExecute)
-    {
-        return;
-    }
-
     GetDDProcTable().pfnNewDraw(GetDDHandle());
 
     if (s.mCaps.cullFace)
@@ -1471,6 +2404,7 @@ void glimSetUpDrawSWR(State &s, GLenum drawType)
         {
             resetNormalize = true;
             s.mCaps.normalize = 0;
+            MarkDirty(s, DIRTY_L0);
             auto &vb = GetVB(s);
             auto &vbIEDlayout = vb.mVBIEDLayout;
             auto niedx = vbIEDlayout.position.normal;
@@ -1483,12 +2417,24 @@ void glimSetUpDrawSWR(State &s, GLenum drawType)
     GetDDProcTable().pfnSetupVertices(GetDDHandle(), GetVB(s).mAttributes, vtxAttrFmts, GetVB(s).mNumAttributes, vBuffers, GetVB(s).mhNIB8);
 
     // Tell the DD to generate shaders based on the current state.
-    GetDDProcTable().pfnGenShaders(GetDDHandle(), s, false, GL_UNSIGNED_INT);
+    GetDDProcTable().pfnGenShaders(GetDDHandle(), s, isIndexed, GL_UNSIGNED_INT);
 
     if (resetNormalize)
     {
         s.mCaps.normalize = 1;
+        MarkDirty(s, DIRTY_L0);
+    }
+}
+
+void glimSetUpDrawSWR(State &s, GLenum drawType)
+{
+    // If the context is undefined, then exit early.
+    if (s.mNoExecute)
+    {
+        return;
     }
+
+    _glimSetUpDrawSWR(s, drawType, false);
 }
 
 void glimShadeModel(State &s, GLenum mode)
@@ -1516,33 +2462,95 @@ void glimTexEnv(State &s, GLenum target, GLenum pname, SWRL::v4f const &params)
     glstTexEnv(s, target, pname, params);
 }
 
+void glimTexGen(State &s, GLenum coord, GLenum pname, SWRL::v4f const &params)
+{
+    glstTexGen(s, coord, pname, params);
+}
+
+// Creates the texture backing texParams, recreating it when a level 0
+// image changes its size or format, and marks mipLevel as defined. Cube
+// maps keep their six faces as planes of one texture.
+static void _glimDefineTexImage(TexParameters &texParams, GLint mipLevel, GLuint planes, GLint internalFormat, GLsizei width, GLsizei height, GLenum format, GLenum type)
+{
+    UINT size[3] = { UINT(width), UINT(height), planes };
+
+    if (texParams.mhTexture == 0)
+    {
+        // Levels may be defined before level 0; size the storage for the
+        // level 0 this one implies, a later level 0 image recreates it if not.
+        size[0] = UINT(width) << mipLevel;
+        size[1] = UINT(height) << mipLevel;
+        texParams.mhTexture = GetDDProcTable().pfnCreateTexture(GetDDHandle(), size, internalFormat, format, type);
+        texParams.mWidth = size[0];
+        texParams.mHeight = size[1];
+        texParams.mInternalFormat = internalFormat;
+        texParams.mFormat = format;
+        texParams.mType = type;
+    }
+    else
+    {
+        // If the texture is rebound, destroy and recreate a new texture object
+        // Draws still sampling the old one keep it alive until they retire
+        // The storage format follows the level 0 image, so a format change recreates it too.
+        if (mipLevel == 0 && (texParams.mWidth != width || texParams.mHeight != height ||
+                              texParams.mInternalFormat != internalFormat || texParams.mFormat != format || texParams.mType != type))
+        {
+            GetDDProcTable().pfnDestroyTexture(GetDDHandle(), texParams.mhTexture);
+            texParams.mhTexture = GetDDProcTable().pfnCreateTexture(GetDDHandle(), size, internalFormat, format, type);
+            texParams.mWidth = width;
+            texParams.mHeight = height;
+            texParams.mInternalFormat = internalFormat;
+            texParams.mFormat = format;
+            texParams.mType = type;
+            texParams.mLevelMask = 0;
+        }
+    }
+
+    if (mipLevel < 32)
+    {
+        texParams.mLevelMask |= 1U << mipLevel;
+    }
+}
+
+// Plane of the texture storage a TexImage target writes.
+static GLuint _glimTargetPlane(GLenum target)
+{
+    return IsCubeMapFace(target) ? (target - GL_TEXTURE_CUBE_MAP_POSITIVE_X) : 0;
+}
+
 void glimTexImage2D(State &s, GLenum target, GLint mipLevel, GLint internalFormat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const GLvoid *data)
 {
-    TextureUnit &texUnit = s.mTexUnit[s.mActiveTexture - GL_TEXTURE0];
-    TexParameters &texParams = s.mTexParameters[texUnit.mNamedTexture2d];
+    TexParameters &texParams = s.mTexParameters[BoundTextureName(s, target)];
 
     GLenum errorReturn = GL_INVALID_ENUM;
+    bool isProxy = (target == GL_PROXY_TEXTURE_2D) || (target == GL_PROXY_TEXTURE_CUBE_MAP);
+    bool isCube = IsCubeMapFace(target) || (target == GL_PROXY_TEXTURE_CUBE_MAP);
 
     // According to 1.5 spec 3.8.11: If request isn't supported, set proxy texture params to 0, but don't set error.
-    if (target == GL_PROXY_TEXTURE_2D)
+    if (isProxy)
     {
         texParams.mWidth = 0;
         texParams.mHeight = 0;
         errorReturn = GL_NO_ERROR;
     }
 
-    if (data == NULL)
+    if (isProxy && (data == NULL))
     {
         return;
     }
 
-    if ((target != GL_TEXTURE_2D) && (target != GL_PROXY_TEXTURE_2D))
+    if ((target != GL_TEXTURE_2D) && (target != GL_PROXY_TEXTURE_2D) && !isCube)
     {
-        // XXX: we might need to support CUBE_MAP*
         s.mLastError = errorReturn;
         return;
     }
 
+    if ((isCube && (width != height)) || (mipLevel < 0) || (mipLevel >= MAX_TEXTURE_LEVELS))
+    {
+        s.mLastError = GL_INVALID_VALUE;
+        return;
+    }
+
     if (0) //internalFormat > 4)
     {
         // XXX: forget all the exotic crap.
@@ -1550,60 +2558,68 @@ void glimTexImage2D(State &s, GLenum target, GLint mipLevel, GLint internalForma
         return;
     }
 
-    if ((format != GL_RGBA) && (format != GL_BGRA) && (format != GL_RGB) && (format != GL_BGR) && (format != GL_ALPHA))
+    // Depth images go with depth internal formats only, and not in cube maps.
+    if ((format == GL_DEPTH_COMPONENT) != IsDepthTextureFormat(internalFormat) ||
+        (isCube && IsDepthTextureFormat(internalFormat)))
+    {
+        s.mLastError = GL_INVALID_OPERATION;
+        return;
+    }
+
+    if ((format == GL_DEPTH_COMPONENT) && (type != GL_FLOAT))
+    {
+        // XXX: integer depth could be normalized to float on upload.
+        s.mLastError = errorReturn;
+        return;
+    }
+
+    if ((format != GL_RGBA) && (format != GL_BGRA) && (format != GL_RGB) && (format != GL_BGR) && (format != GL_ALPHA) &&
+        (format != GL_LUMINANCE) && (format != GL_LUMINANCE_ALPHA) && (format != GL_DEPTH_COMPONENT))
     {
         // XXX: we can support other formats through manual swizzling.
         s.mLastError = errorReturn;
         return;
     }
 
-    if ((type != GL_UNSIGNED_BYTE) && (type != GL_FLOAT) && (type != GL_UNSIGNED_INT_8_8_8_8_REV))
+    if ((type != GL_UNSIGNED_BYTE) && (type != GL_FLOAT) && (type != GL_UNSIGNED_INT_8_8_8_8_REV) && (type != GL_UNSIGNED_SHORT_5_6_5))
     {
         // XXX: we can support other type through up-conversion to BYTE or FLOAT.
         s.mLastError = errorReturn;
         return;
     }
 
-    RDTSC_START(APITexImage);
-
-    UINT size[3] = { UINT(width), UINT(height), 1 };
-
-    if (texParams.mhTexture == 0)
+    if (((format == GL_LUMINANCE) || (format == GL_LUMINANCE_ALPHA)) && (type != GL_UNSIGNED_BYTE))
     {
-        assert(mipLevel == 0);
-        texParams.mhTexture = GetDDProcTable().pfnCreateTexture(GetDDHandle(), size);
-        texParams.mWidth = width;
-        texParams.mHeight = height;
+        s.mLastError = errorReturn;
+        return;
     }
-    else
+
+    if ((type == GL_UNSIGNED_SHORT_5_6_5) && (format != GL_RGB))
     {
-        // If the texture is rebound, destroy and recreate a new texture object
-        // Destroy will stall until the resource is no longer in use
-        if (mipLevel == 0 && (texParams.mWidth != width || texParams.mHeight != height))
-        {
-            GetDDProcTable().pfnDestroyTexture(GetDDHandle(), texParams.mhTexture);
-            texParams.mhTexture = GetDDProcTable().pfnCreateTexture(GetDDHandle(), size);
-            texParams.mWidth = width;
-            texParams.mHeight = height;
-        }
+        s.mLastError = GL_INVALID_OPERATION;
+        return;
     }
 
-    if (target != GL_PROXY_TEXTURE_2D)
-    {
-        GetDDProcTable().pfnLockTexture(GetDDHandle(), texParams.mhTexture);
+    RDTSC_START(APITexImage);
 
-        UINT subtexIdx = GetDDProcTable().pfnGetSubtextureIndex(GetDDHandle(), texParams.mhTexture, 0, mipLevel);
+    _glimDefineTexImage(texParams, mipLevel, isCube ? 6 : 1, internalFormat, width, height, format, type);
 
-        GetDDProcTable().pfnUpdateSubtexture(GetDDHandle(), texParams.mhTexture, subtexIdx, format, type, 0, 0, width, height, data);
+    // Without data the level is defined but left for TexSubImage or
+    // CopyTexSubImage to fill, as for render to texture.
+    if (!isProxy && (data != NULL))
+    {
+        // The update is queued behind draws still using the texture.
+        UINT subtexIdx = GetDDProcTable().pfnGetSubtextureIndex(GetDDHandle(), texParams.mhTexture, _glimTargetPlane(target), mipLevel);
 
-        GetDDProcTable().pfnUnlockTexture(GetDDHandle(), texParams.mhTexture);
+        GetDDProcTable().pfnUpdateSubtexture(GetDDHandle(), texParams.mhTexture, subtexIdx, format, type, 0, 0, width, height, data);
+        _glimGenerateMips(texParams, _glimTargetPlane(target), mipLevel);
 
         RDTSC_STOP(APITexImage, 0, 0);
 
 #if 0
 		char filename[256];
 		static int idx = 0;
-		sprintf(filename, "texture_%d_%dx%d.rgba", texUnit.mNamedTexture2d, width, height);
+		sprintf(filename, "texture_%d_%dx%d.rgba", BoundTextureName(s, target), width, height);
 		FILE *f = fopen(filename, "wb");
 		if (format == GL_RGBA)
 		{
@@ -1634,8 +2650,7 @@ void glimTexImage2D(State &s, GLenum target, GLint mipLevel, GLint internalForma
 
 void glimTexSubImage2D(State &s, GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLenum type, const GLvoid *pixels)
 {
-    TextureUnit &texUnit = s.mTexUnit[s.mActiveTexture - GL_TEXTURE0];
-    TexParameters &params = s.mTexParameters[texUnit.mNamedTexture2d];
+    TexParameters &params = s.mTexParameters[BoundTextureName(s, target)];
 
     assert(params.mhTexture != NULL);
     if (!params.mhTexture)
@@ -1643,13 +2658,89 @@ void glimTexSubImage2D(State &s, GLenum target, GLint level, GLint xoffset, GLin
         return;
     }
 
-    GetDDProcTable().pfnLockTexture(GetDDHandle(), params.mhTexture);
+    if (_glimS3TCBlockBytes(params.mInternalFormat))
+    {
+        s.mLastError = GL_INVALID_OPERATION;
+        return;
+    }
 
-    UINT subtexIdx = GetDDProcTable().pfnGetSubtextureIndex(GetDDHandle(), params.mhTexture, 0, level);
+    UINT subtexIdx = GetDDProcTable().pfnGetSubtextureIndex(GetDDHandle(), params.mhTexture, _glimTargetPlane(target), level);
 
     GetDDProcTable().pfnUpdateSubtexture(GetDDHandle(), params.mhTexture, subtexIdx, format, type, xoffset, yoffset, width, height, pixels);
+    _glimGenerateMips(params, _glimTargetPlane(target), level);
+}
+
+// S3TC images stay compressed in the texture; the sampler decodes blocks as
+// it fetches them. The compressed format is passed down as the client format.
+void glimCompressedTexImage2D(State &s, GLenum target, GLint level, GLenum internalFormat, GLsizei width, GLsizei height, GLint border, GLsizei imageSize, const GLvoid *data)
+{
+    TexParameters &texParams = s.mTexParameters[BoundTextureName(s, target)];
+    bool isCube = IsCubeMapFace(target);
+
+    if (((target != GL_TEXTURE_2D) && !isCube) || !_glimS3TCBlockBytes(internalFormat))
+    {
+        s.mLastError = GL_INVALID_ENUM;
+        return;
+    }
+
+    if ((border != 0) || (width < 0) || (height < 0) || (isCube && (width != height)) ||
+        (level < 0) || (level >= MAX_TEXTURE_LEVELS) || (imageSize != _glimS3TCImageSize(internalFormat, width, height)))
+    {
+        s.mLastError = GL_INVALID_VALUE;
+        return;
+    }
+
+    if (data == NULL)
+    {
+        return;
+    }
+
+    RDTSC_START(APITexImage);
+
+    _glimDefineTexImage(texParams, level, isCube ? 6 : 1, internalFormat, width, height, internalFormat, GL_UNSIGNED_BYTE);
+
+    UINT subtexIdx = GetDDProcTable().pfnGetSubtextureIndex(GetDDHandle(), texParams.mhTexture, _glimTargetPlane(target), level);
+    GetDDProcTable().pfnUpdateSubtexture(GetDDHandle(), texParams.mhTexture, subtexIdx, internalFormat, GL_UNSIGNED_BYTE, 0, 0, width, height, data);
+
+    RDTSC_STOP(APITexImage, 0, 0);
+}
+
+void glimCompressedTexSubImage2D(State &s, GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLsizei imageSize, const GLvoid *data)
+{
+    TexParameters &params = s.mTexParameters[BoundTextureName(s, target)];
+
+    if (((target != GL_TEXTURE_2D) && !IsCubeMapFace(target)) || !_glimS3TCBlockBytes(format))
+    {
+        s.mLastError = GL_INVALID_ENUM;
+        return;
+    }
+
+    if (!params.mhTexture || (format != (GLenum)params.mInternalFormat))
+    {
+        s.mLastError = GL_INVALID_OPERATION;
+        return;
+    }
+
+    if (imageSize != _glimS3TCImageSize(format, width, height))
+    {
+        s.mLastError = GL_INVALID_VALUE;
+        return;
+    }
+
+    // Updates replace whole blocks; only the edge blocks of a level may be partial.
+    GLsizei levelWidth = (GLsizei)std::max(1U, params.mWidth >> level);
+    GLsizei levelHeight = (GLsizei)std::max(1U, params.mHeight >> level);
+    if ((xoffset & 3) || (yoffset & 3) ||
+        ((width & 3) && (xoffset + width != levelWidth)) ||
+        ((height & 3) && (yoffset + height != levelHeight)))
+    {
+        s.mLastError = GL_INVALID_OPERATION;
+        return;
+    }
 
-    GetDDProcTable().pfnUnlockTexture(GetDDHandle(), params.mhTexture);
+    UINT subtexIdx = GetDDProcTable().pfnGetSubtextureIndex(GetDDHandle(), params.mhTexture, _glimTargetPlane(target), level);
+
+    GetDDProcTable().pfnUpdateSubtexture(GetDDHandle(), params.mhTexture, subtexIdx, format, GL_UNSIGNED_BYTE, xoffset, yoffset, width, height, data);
 }
 
 void glimTexParameter(State &s, GLenum target, GLenum pname, SWRL::v4f const &params)
@@ -1664,6 +2755,10 @@ void glimTranslate(State &s, GLdouble x, GLdouble y, GLdouble z)
 
 void glimUnlockArraysEXT(State &s)
 {
+    // The application may change the arrays after this.
+    _glimReleaseLockedArrays(GetVB(s));
+    _glimReleaseVertexCache(s);
+
     glstUnlockArraysEXT(s);
 }
 
@@ -1840,7 +2935,19 @@ void glimBufferSubDataARB(State &s, GLenum target, GLintptrARB offset, GLsizeipt
 
     VertexBufferObject &vbo = s.mVBOs[boundBuffer];
 
-    void *pData = GetDDProcTable().pfnLockBuffer(GetDDHandle(), vbo.mHWBuffer);
+    // Draws in flight keep reading the old contents. A full update can
+    // discard them, a partial one renames the buffer to a copy.
+    UINT size32 = (UINT)size;
+    void *pData;
+    if (offset == 0 && size32 + sizeof(float) * 32 >= vbo.mSize)
+    {
+        pData = GetDDProcTable().pfnLockBufferDiscard(GetDDHandle(), vbo.mHWBuffer);
+        memset((BYTE *)pData + size32, 0x0, vbo.mSize - size32);
+    }
+    else
+    {
+        pData = GetDDProcTable().pfnLockBufferRename(GetDDHandle(), vbo.mHWBuffer);
+    }
     memcpy((BYTE *)pData + offset, data, size);
     GetDDProcTable().pfnUnlockBuffer(GetDDHandle(), vbo.mHWBuffer);
 }
@@ -1872,7 +2979,17 @@ GLvoid *glimMapBufferARB(State &s, GLenum target, GLenum access)
 
     vbo.mAccess = access;
     vbo.mMapped = GL_TRUE;
-    vbo.mMappedPointer = GetDDProcTable().pfnLockBuffer(GetDDHandle(), vbo.mHWBuffer);
+
+    // Draws never write VBOs, so reading needs no wait. Writes go to a
+    // renamed copy so draws in flight keep the old contents.
+    if (access == GL_READ_ONLY_ARB)
+    {
+        vbo.mMappedPointer = GetDDProcTable().pfnLockBufferNoOverwrite(GetDDHandle(), vbo.mHWBuffer);
+    }
+    else
+    {
+        vbo.mMappedPointer = GetDDProcTable().pfnLockBufferRename(GetDDHandle(), vbo.mHWBuffer);
+    }
 
     return vbo.mMappedPointer;
 }
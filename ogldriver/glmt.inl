@@ -0,0 +1,359 @@
+// Copyright 2014 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Marshalling of the calls that read client arrays. The elements a call
+// reads are copied into the batch ahead of it in a CMD_MARSHALARRAYS, which
+// points the arrays at the copies on the driver thread until the
+// CMD_MARSHALRESTORE behind the call. Calls whose copies don't fit in a batch
+// sync and run on the application thread.
+
+// Requests a CMD_MARSHALARRAYS copying elements [first, first + count) of
+// the client arrays, extraLength bytes at pExtra (16 byte aligned) for the
+// caller to fill, and cmdLength bytes for the command, which is returned.
+// NULL if it doesn't fit in a batch.
+static GLubyte *_glmtRequestArrays(OGL::State &s, GLuint arrays, size_t first, size_t count, size_t extraLength, GLubyte *&pExtra, GLuint cmdLength)
+{
+    OGL::Marshal &m = *s.mpMarshal;
+    const size_t header = 3 * sizeof(GLuint);
+
+    // Whole strides are reserved for the copies, as glim may read the last
+    // element's full stride.
+    size_t length = header + 15 + extraLength;
+    DWORD index;
+    for (GLuint mask = arrays; _BitScanForward(&index, mask); mask &= ~(1 << index))
+    {
+        length += sizeof(const GLvoid *) + count * m.mClient.GetArray(index).mStride + 15;
+    }
+    length = (length + 3) & ~3;
+
+    if ((extraLength > OGL::MARSHAL_BATCH_SIZE) || (count > OGL::MARSHAL_BATCH_SIZE) ||
+        (length + cmdLength + 2 * sizeof(OGL::COMMAND) > OGL::MARSHAL_BATCH_SIZE))
+    {
+        return NULL;
+    }
+
+    GLubyte *pCmd = m.Request((GLuint)length + cmdLength + sizeof(OGL::COMMAND));
+    ((GLuint *)pCmd)[0] = OGL::CMD_MARSHALARRAYS;
+    ((GLuint *)pCmd)[1] = arrays;
+    ((GLuint *)pCmd)[2] = (GLuint)(length - header);
+
+    GLubyte *pEntry = pCmd + header;
+    GLubyte *pData = pEntry;
+    for (GLuint mask = arrays; _BitScanForward(&index, mask); mask &= ~(1 << index))
+    {
+        pData += sizeof(const GLvoid *);
+    }
+
+    pExtra = (GLubyte *)(((uintptr_t)pData + 15) & ~(uintptr_t)15);
+    pData = pExtra + extraLength;
+
+    for (GLuint mask = arrays; _BitScanForward(&index, mask); mask &= ~(1 << index))
+    {
+        OGL::MarshalClientState::Array const &array = m.mClient.GetArray(index);
+        const GLubyte *pSrc = (const GLubyte *)array.mpPointer + first * array.mStride;
+
+        // keep the alignment of the client data for the fetch
+        pData += ((uintptr_t)pSrc - (uintptr_t)pData) & 15;
+        if (count)
+        {
+            memcpy(pData, pSrc, (count - 1) * array.mStride + OGL::MarshalClientState::ElementSize(array));
+        }
+
+        const GLvoid *pCopy = pData - first * array.mStride;
+        memcpy(pEntry, &pCopy, sizeof(pCopy));
+        pEntry += sizeof(pCopy);
+        pData += count * array.mStride;
+    }
+
+    GLubyte *pDraw = pCmd + length;
+    *(GLuint *)(pDraw + cmdLength) = OGL::CMD_MARSHALRESTORE;
+    return pDraw;
+}
+
+// Requests cmdLength bytes for a call reading elements [first, first + count)
+// of the client arrays. NULL if the caller has to sync.
+static GLubyte *_glmtRequestDraw(OGL::State &s, GLint first, GLsizei count, GLuint cmdLength)
+{
+    GLuint arrays = s.mpMarshal->mClient.ClientArrays();
+    if (!arrays || (count == 0))
+    {
+        return s.mpMarshal->Request(cmdLength);
+    }
+
+    if ((first < 0) || (count < 0))
+    {
+        return NULL;
+    }
+
+    GLubyte *pExtra;
+    return _glmtRequestArrays(s, arrays, first, count, 0, pExtra, cmdLength);
+}
+
+static GLuint _glmtIndexSize(GLenum type)
+{
+    switch (type)
+    {
+    case GL_UNSIGNED_BYTE:
+        return sizeof(GLubyte);
+    case GL_UNSIGNED_SHORT:
+        return sizeof(GLushort);
+    case GL_UNSIGNED_INT:
+        return sizeof(GLuint);
+    default:
+        return 0;
+    }
+}
+
+template <typename T>
+static void _glmtScanIndices(const T *pIndices, GLsizei count, GLuint &min, GLuint &max)
+{
+    for (GLsizei i = 0; i < count; ++i)
+    {
+        min = std::min<GLuint>(min, pIndices[i]);
+        max = std::max<GLuint>(max, pIndices[i]);
+    }
+}
+
+// Widens [min, max] to the indices of a client index array.
+static void _glmtIndexRange(GLenum type, const GLvoid *pIndices, GLsizei count, GLuint &min, GLuint &max)
+{
+    switch (type)
+    {
+    case GL_UNSIGNED_BYTE:
+        _glmtScanIndices((const GLubyte *)pIndices, count, min, max);
+        break;
+    case GL_UNSIGNED_SHORT:
+        _glmtScanIndices((const GLushort *)pIndices, count, min, max);
+        break;
+    case GL_UNSIGNED_INT:
+        _glmtScanIndices((const GLuint *)pIndices, count, min, max);
+        break;
+    }
+}
+
+static INLINE void glmtArrayElement(OGL::State &s, GLint index)
+{
+    GLubyte *mybuffer = _glmtRequestDraw(s, index, 1, sizeof(OGL::CMD_ARRAYELEMENT) + sizeof(index));
+    if (!mybuffer)
+    {
+        s.mpMarshal->Sync();
+        return gldpArrayElement(s, index);
+    }
+    insertCommand(OGL::CMD_ARRAYELEMENT, mybuffer, index);
+}
+
+static INLINE void glmtDrawArrays(OGL::State &s, GLenum mode, GLint first, GLsizei count)
+{
+    GLubyte *mybuffer = _glmtRequestDraw(s, first, count, sizeof(OGL::CMD_DRAWARRAYS) + sizeof(mode) + sizeof(first) + sizeof(count));
+    if (!mybuffer)
+    {
+        s.mpMarshal->Sync();
+        return gldpDrawArrays(s, mode, first, count);
+    }
+    insertCommand(OGL::CMD_DRAWARRAYS, mybuffer, mode, first, count);
+}
+
+static INLINE void glmtDrawRangeElements(OGL::State &s, GLenum mode, GLuint start, GLuint end, GLsizei count, GLenum type, const GLvoid *indices)
+{
+    OGL::MarshalClientState &c = s.mpMarshal->mClient;
+    GLuint arrays = c.ClientArrays();
+    GLuint cmdLength = sizeof(OGL::CMD_DRAWRANGEELEMENTS) + sizeof(mode) + sizeof(start) + sizeof(end) + sizeof(count) + sizeof(type) + sizeof(indices);
+    GLuint indexSize = _glmtIndexSize(type);
+
+    // Indices in a VBO need only the promised range of the arrays.
+    GLubyte *mybuffer = NULL;
+    const GLvoid *pCopy = indices;
+    if (!arrays && c.mElementVBO)
+    {
+        mybuffer = s.mpMarshal->Request(cmdLength);
+    }
+    else if ((count > 0) && indexSize && (start <= end) && (indices || c.mElementVBO))
+    {
+        size_t extraLength = c.mElementVBO ? 0 : (size_t)count * indexSize;
+        GLubyte *pExtra;
+        mybuffer = _glmtRequestArrays(s, arrays, start, (size_t)end - start + 1, extraLength, pExtra, cmdLength);
+        if (mybuffer && extraLength)
+        {
+            memcpy(pExtra, indices, extraLength);
+            pCopy = pExtra;
+        }
+    }
+
+    if (!mybuffer)
+    {
+        s.mpMarshal->Sync();
+        return gldpDrawRangeElements(s, mode, start, end, count, type, indices);
+    }
+    insertCommand(OGL::CMD_DRAWRANGEELEMENTS, mybuffer, mode, start, end, count, type, pCopy);
+}
+
+static INLINE void glmtDrawElements(OGL::State &s, GLenum mode, GLsizei count, GLenum type, const GLvoid *indices)
+{
+    OGL::MarshalClientState &c = s.mpMarshal->mClient;
+    GLuint arrays = c.ClientArrays();
+
+    // Client indices are scanned for the range of the arrays to copy, and the
+    // draw becomes a DrawRangeElements.
+    if (arrays && !c.mElementVBO && (count > 0) && _glmtIndexSize(type) && indices)
+    {
+        GLuint min = UINT_MAX;
+        GLuint max = 0;
+        _glmtIndexRange(type, indices, count, min, max);
+        return glmtDrawRangeElements(s, mode, min, max, count, type, indices);
+    }
+
+    GLubyte *mybuffer = NULL;
+    GLuint cmdLength = sizeof(OGL::CMD_DRAWELEMENTS) + sizeof(mode) + sizeof(count) + sizeof(type) + sizeof(indices);
+    const GLvoid *pCopy = indices;
+    if (!arrays && c.mElementVBO)
+    {
+        mybuffer = s.mpMarshal->Request(cmdLength);
+    }
+    else if (!arrays && (count > 0) && _glmtIndexSize(type) && indices)
+    {
+        mybuffer = s.mpMarshal->RequestData(cmdLength, indices, (size_t)count * _glmtIndexSize(type), pCopy);
+    }
+
+    if (!mybuffer)
+    {
+        s.mpMarshal->Sync();
+        return gldpDrawElements(s, mode, count, type, indices);
+    }
+    insertCommand(OGL::CMD_DRAWELEMENTS, mybuffer, mode, count, type, pCopy);
+}
+
+static INLINE void glmtMultiDrawArrays(OGL::State &s, GLenum mode, const GLint *first, const GLsizei *count, GLsizei drawcount)
+{
+    GLuint arrays = s.mpMarshal->mClient.ClientArrays();
+    GLubyte *mybuffer = NULL;
+    GLubyte *pExtra = NULL;
+
+    bool valid = first && count && (drawcount >= 0);
+    size_t min = SIZE_MAX;
+    size_t max = 0;
+    for (GLsizei i = 0; valid && (i < drawcount); ++i)
+    {
+        valid = (first[i] >= 0) && (count[i] >= 0);
+        if (valid && count[i])
+        {
+            min = std::min<size_t>(min, first[i]);
+            max = std::max<size_t>(max, (size_t)first[i] + count[i]);
+        }
+    }
+
+    if (valid)
+    {
+        if (min >= max)
+        {
+            arrays = 0;
+            min = max = 0;
+        }
+        size_t extraLength = 2 * drawcount * sizeof(GLint);
+        mybuffer = _glmtRequestArrays(s, arrays, min, max - min, extraLength, pExtra, sizeof(OGL::CMD_MULTIDRAWARRAYS) + sizeof(mode) + sizeof(first) + sizeof(count) + sizeof(drawcount));
+    }
+
+    if (!mybuffer)
+    {
+        s.mpMarshal->Sync();
+        return gldpMultiDrawArrays(s, mode, first, count, drawcount);
+    }
+
+    GLint *pFirst = (GLint *)pExtra;
+    GLsizei *pCount = (GLsizei *)(pFirst + drawcount);
+    memcpy(pFirst, first, drawcount * sizeof(GLint));
+    memcpy(pCount, count, drawcount * sizeof(GLsizei));
+    insertCommand(OGL::CMD_MULTIDRAWARRAYS, mybuffer, mode, (const GLint *)pFirst, (const GLsizei *)pCount, drawcount);
+}
+
+static INLINE void glmtMultiDrawElements(OGL::State &s, GLenum mode, const GLsizei *count, GLenum type, const GLvoid *const *indices, GLsizei drawcount)
+{
+    OGL::MarshalClientState &c = s.mpMarshal->mClient;
+    GLuint arrays = c.ClientArrays();
+    GLuint indexSize = _glmtIndexSize(type);
+    GLubyte *mybuffer = NULL;
+    GLubyte *pExtra = NULL;
+
+    // Client indices are copied after the count and pointer arrays; indices
+    // in a VBO are offsets and only work without client arrays.
+    bool valid = count && indices && (drawcount >= 0) && indexSize && (!arrays || !c.mElementVBO);
+    size_t indexLength = 0;
+    GLuint min = UINT_MAX;
+    GLuint max = 0;
+    for (GLsizei i = 0; valid && (i < drawcount); ++i)
+    {
+        valid = (count[i] >= 0) && (indices[i] || c.mElementVBO || !count[i]);
+        if (valid && !c.mElementVBO)
+        {
+            indexLength += (size_t)count[i] * indexSize;
+            if (arrays)
+            {
+                _glmtIndexRange(type, indices[i], count[i], min, max);
+            }
+        }
+    }
+
+    if (valid)
+    {
+        if (min > max)
+        {
+            arrays = 0;
+            min = max = 0;
+        }
+        size_t extraLength = drawcount * (sizeof(const GLvoid *) + sizeof(GLsizei)) + indexLength;
+        mybuffer = _glmtRequestArrays(s, arrays, min, (size_t)max - min + 1, extraLength, pExtra, sizeof(OGL::CMD_MULTIDRAWELEMENTS) + sizeof(mode) + sizeof(count) + sizeof(type) + sizeof(indices) + sizeof(drawcount));
+    }
+
+    if (!mybuffer)
+    {
+        s.mpMarshal->Sync();
+        return gldpMultiDrawElements(s, mode, count, type, indices, drawcount);
+    }
+
+    const GLvoid **ppIndices = (const GLvoid **)pExtra;
+    GLsizei *pCount = (GLsizei *)(ppIndices + drawcount);
+    GLubyte *pIndexData = (GLubyte *)(pCount + drawcount);
+    memcpy(pCount, count, drawcount * sizeof(GLsizei));
+    for (GLsizei i = 0; i < drawcount; ++i)
+    {
+        ppIndices[i] = indices[i];
+        if (!c.mElementVBO && count[i])
+        {
+            memcpy(pIndexData, indices[i], count[i] * indexSize);
+            ppIndices[i] = pIndexData;
+            pIndexData += count[i] * indexSize;
+        }
+    }
+    insertCommand(OGL::CMD_MULTIDRAWELEMENTS, mybuffer, mode, (const GLsizei *)pCount, type, (const GLvoid *const *)ppIndices, drawcount);
+}
+
+static INLINE void glmtLockArraysEXT(OGL::State &s, GLint first, GLsizei count)
+{
+    // The locked range starts at 0.
+    GLubyte *mybuffer = NULL;
+    if ((first >= 0) && (count >= 0))
+    {
+        mybuffer = _glmtRequestDraw(s, 0, first + count, sizeof(OGL::CMD_LOCKARRAYSEXT) + sizeof(first) + sizeof(count));
+    }
+
+    if (!mybuffer)
+    {
+        s.mpMarshal->Sync();
+        gldpLockArraysEXT(s, first, count);
+    }
+    else
+    {
+        insertCommand(OGL::CMD_LOCKARRAYSEXT, mybuffer, first, count);
+    }
+    s.mpMarshal->mClient.LockArraysEXT(first, count);
+}
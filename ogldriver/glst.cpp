@@ -172,6 +172,12 @@ void _glstGetGLTyv(State &s, GLenum pname, GLTy *params)
         params[0] = (GLTy)s.mPolygonMode[0];
         params[1] = (GLTy)s.mPolygonMode[1];
         break;
+    case GL_MAX_NAME_STACK_DEPTH:
+        params[0] = MAX_NAME_STACK_DEPTH;
+        break;
+    case GL_NAME_STACK_DEPTH:
+        params[0] = (GLTy)s.mNameStack.size();
+        break;
     case GL_MAX_PROJECTION_STACK_DEPTH:
     case GL_MAX_MODELVIEW_STACK_DEPTH:
     case GL_MAX_TEXTURE_STACK_DEPTH:
@@ -193,13 +199,27 @@ void _glstGetGLTyv(State &s, GLenum pname, GLTy *params)
         params[0] = (GLTy)GL_BACK;
         break;
     case GL_MAX_TEXTURE_SIZE:
+    case GL_MAX_CUBE_MAP_TEXTURE_SIZE:
         params[0] = (GLTy)4096; //?
         break;
+    case GL_TEXTURE_BINDING_CUBE_MAP:
+        params[0] = (GLTy)s.mTexUnit[s.mActiveTexture - GL_TEXTURE0].mNamedTextureCube;
+        break;
 
     case GL_MAX_TEXTURE_UNITS:
         params[0] = 8;
         break;
 
+    case GL_NUM_COMPRESSED_TEXTURE_FORMATS:
+        params[0] = (GLTy)4;
+        break;
+    case GL_COMPRESSED_TEXTURE_FORMATS:
+        params[0] = (GLTy)GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+        params[1] = (GLTy)GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+        params[2] = (GLTy)GL_COMPRESSED_RGBA_S3TC_DXT3_EXT;
+        params[3] = (GLTy)GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        break;
+
     case GL_MAX_VIEWPORT_DIMS:
         params[0] = (GLTy)(int) KNOB_GUARDBAND_WIDTH;
         params[1] = (GLTy)(int) KNOB_GUARDBAND_HEIGHT;
@@ -430,7 +450,7 @@ void _glstGetGLTyv(State &s, GLenum pname, GLTy *params)
         break;
 
     case GL_RENDER_MODE:
-        params[0] = (GLTy)GL_RENDER; //BMCTODO: add full support.  glRenderMode is a stub, and don't currently support anything other than GL_RENDER.  ParaView checks this state A LOT!
+        params[0] = (GLTy)s.mRenderMode;
         break;
 
     case GL_PACK_ROW_LENGTH:
@@ -463,8 +483,7 @@ void _glstGetGLTyv(State &s, GLenum pname, GLTy *params)
 template <typename GLTy>
 void _glstGetTexLevelParameterTyv(State &s, GLenum target, GLint level, GLenum pname, GLTy *params)
 {
-    TextureUnit &texUnit = s.mTexUnit[s.mActiveTexture - GL_TEXTURE0];
-    TexParameters &texParams = s.mTexParameters[texUnit.mNamedTexture2d];
+    TexParameters &texParams = s.mTexParameters[BoundTextureName(s, target)];
 
     // level < 0 is always an error.
     // SWR doesn't currently support mip levels, so anthing != 0 is an error.
@@ -474,17 +493,11 @@ void _glstGetTexLevelParameterTyv(State &s, GLenum target, GLint level, GLenum p
         return;
     }
 
-    // SWR currently only supports 2D and Proxy 2D targets
+    // SWR currently only supports 2D and cube map targets
     switch (target)
     {
     case GL_TEXTURE_2D:
     case GL_PROXY_TEXTURE_2D:
-        // Initialized above texParams	= s.mTexParameters[texUnit.mNamedTexture2d];
-        break;
-    case GL_TEXTURE_1D:
-    case GL_PROXY_TEXTURE_1D:
-    case GL_TEXTURE_3D:
-    case GL_PROXY_TEXTURE_3D:
     case GL_TEXTURE_CUBE_MAP_POSITIVE_X:
     case GL_TEXTURE_CUBE_MAP_NEGATIVE_X:
     case GL_TEXTURE_CUBE_MAP_POSITIVE_Y:
@@ -492,6 +505,12 @@ void _glstGetTexLevelParameterTyv(State &s, GLenum target, GLint level, GLenum p
     case GL_TEXTURE_CUBE_MAP_POSITIVE_Z:
     case GL_TEXTURE_CUBE_MAP_NEGATIVE_Z:
     case GL_PROXY_TEXTURE_CUBE_MAP:
+        // Initialized above texParams	= s.mTexParameters[BoundTextureName(s, target)];
+        break;
+    case GL_TEXTURE_1D:
+    case GL_PROXY_TEXTURE_1D:
+    case GL_TEXTURE_3D:
+    case GL_PROXY_TEXTURE_3D:
     default:
         s.mLastError = GL_INVALID_VALUE;
         return;
@@ -509,6 +528,11 @@ void _glstGetTexLevelParameterTyv(State &s, GLenum target, GLint level, GLenum p
         params[0] = 0;
         break;
     case GL_TEXTURE_INTERNAL_FORMAT: // params returns a single value, the internal format of the texture image.
+        params[0] = (GLTy)texParams.mInternalFormat;
+        break;
+    case GL_TEXTURE_DEPTH_SIZE: // Depth textures are stored as 32-bit float.
+        params[0] = (GLTy)(IsDepthTextureFormat(texParams.mInternalFormat) ? 32 : 0);
+        break;
     case GL_TEXTURE_BORDER:          // params returns a single value, the width in pixels of the border of the texture image. The initial value is 0.
     case GL_TEXTURE_RED_SIZE:        // The internal storage resolution of an individual component.  The resolution chosen by the GL will be a close match for the resolution requested by the user with the component argument of glTexImage1D, glTexImage2D, glTexImage3D, glCopyTexImage1D, and glCopyTexImage2D. The initial value is 0.
     case GL_TEXTURE_GREEN_SIZE:
@@ -516,7 +540,6 @@ void _glstGetTexLevelParameterTyv(State &s, GLenum target, GLint level, GLenum p
     case GL_TEXTURE_ALPHA_SIZE:
     case GL_TEXTURE_LUMINANCE_SIZE:
     case GL_TEXTURE_INTENSITY_SIZE:
-    case GL_TEXTURE_DEPTH_SIZE:
     case GL_TEXTURE_COMPRESSED:            // params returns a single boolean value indicating if the texture image is stored in a compressed internal format.  The initiali value is GL_FALSE.
     case GL_TEXTURE_COMPRESSED_IMAGE_SIZE: // params returns a single integer value, the number of unsigned bytes of the compressed texture image that would be returned from glGetCompressedTexImage.
     default:
@@ -536,6 +559,7 @@ void glstAddVertexSWR(State &s, GLdouble x, GLdouble y, GLdouble z, GLdouble w,
 
 void glstAlphaFunc(State &s, GLenum func, GLclampf ref)
 {
+    MarkDirty(s, DIRTY_L0);
     s.mAlphaFunc = func;
     s.mAlphaRef = SWRL::clamp(ref, 0.0f, 1.0f);
 }
@@ -550,6 +574,7 @@ void glstBegin(State &, GLenum topology)
 
 void glstBindTexture(State &s, GLenum target, GLuint texture)
 {
+    MarkDirty(s, DIRTY_L2);
     if (texture >= s.mLastUsedTextureName)
     {
         s.mLastUsedTextureName = texture + 1;
@@ -576,6 +601,7 @@ void glstBindTexture(State &s, GLenum target, GLuint texture)
 
 void glstBlendFunc(State &s, GLenum sfactor, GLenum dfactor)
 {
+    MarkDirty(s, DIRTY_L0);
     s.mBlendFuncSFactor = sfactor;
     s.mBlendFuncDFactor = dfactor;
 }
@@ -590,6 +616,7 @@ void glstClear(State &, GLbitfield mask)
 
 void glstClearColor(State &s, GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha)
 {
+    MarkDirty(s, DIRTY_L2);
     s.mClearColor[0] = SWRL::clamp(red, 0.0f, 1.0f);
     s.mClearColor[1] = SWRL::clamp(green, 0.0f, 1.0f);
     s.mClearColor[2] = SWRL::clamp(blue, 0.0f, 1.0f);
@@ -598,6 +625,7 @@ void glstClearColor(State &s, GLfloat red, GLfloat green, GLfloat blue, GLfloat
 
 void glstClearDepth(State &s, GLclampd depth)
 {
+    MarkDirty(s, DIRTY_L2);
     s.mClearDepth = SWRL::clamp(depth, 0.0, 1.0);
 }
 
@@ -608,6 +636,8 @@ void glstClientActiveTexture(State &s, GLenum texture)
 
 void glstColor(State &s, GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha)
 {
+    MarkDirty(s, DIRTY_UNCACHEABLE);
+    s.mCurrentAttrCache.mChanged.color |= 0x1;
     s.mColor[0][0] = (GLfloat)red;
     s.mColor[0][1] = (GLfloat)green;
     s.mColor[0][2] = (GLfloat)blue;
@@ -616,6 +646,7 @@ void glstColor(State &s, GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha
 
 void glstColorMask(State &s, GLboolean red, GLboolean green, GLboolean blue, GLboolean alpha)
 {
+    MarkDirty(s, DIRTY_L0);
     s.mColorMask.red = red;
     s.mColorMask.green = green;
     s.mColorMask.blue = blue;
@@ -632,8 +663,17 @@ void glstColorPointer(State &s, GLint size, GLenum type, GLsizei stride, const G
     s.mActiveVBOs.color[0] = s.mActiveArrayVBO;
 }
 
+void glstCompressedTexImage2D(State &s, GLenum target, GLint level, GLenum internalFormat, GLsizei width, GLsizei height, GLint border, GLsizei imageSize, const GLvoid *data)
+{
+}
+
+void glstCompressedTexSubImage2D(State &s, GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLsizei imageSize, const GLvoid *data)
+{
+}
+
 void glstCullFace(State &s, GLenum cullFace)
 {
+    MarkDirty(s, DIRTY_L2);
     s.mCullFace = cullFace;
 }
 
@@ -651,22 +691,26 @@ void glstDeleteLists(State &s, GLuint list, GLsizei range)
 
 void glstDepthFunc(State &s, GLenum func)
 {
+    MarkDirty(s, DIRTY_L0);
     s.mDepthFunc = func;
 }
 
 void glstDepthMask(State &s, GLboolean flag)
 {
+    MarkDirty(s, DIRTY_L0);
     s.mDepthMask = flag;
 }
 
 void glstDepthRange(State &s, GLclampd zNear, GLclampd zFar)
 {
+    MarkDirty(s, DIRTY_L2);
     s.mViewport.zNear = (GLfloat)SWRL::clamp(zNear, 0.0, 1.0);
     s.mViewport.zFar = (GLfloat)SWRL::clamp(zFar, 0.0, 1.0);
 }
 
 void glstDisable(State &s, GLenum cap)
 {
+    MarkDirty(s, DIRTY_L0);
     switch (cap)
     {
     case GL_ALPHA_TEST:
@@ -727,6 +771,21 @@ void glstDisable(State &s, GLenum cap)
     case GL_TEXTURE_2D:
         s.mCaps.textures &= ~(0x1 << (s.mActiveTexture - GL_TEXTURE0));
         break;
+    case GL_TEXTURE_CUBE_MAP:
+        s.mCaps.texturesCube &= ~(0x1 << (s.mActiveTexture - GL_TEXTURE0));
+        break;
+    case GL_TEXTURE_GEN_S:
+        s.mCaps.texGenS &= ~(0x1 << (s.mActiveTexture - GL_TEXTURE0));
+        break;
+    case GL_TEXTURE_GEN_T:
+        s.mCaps.texGenT &= ~(0x1 << (s.mActiveTexture - GL_TEXTURE0));
+        break;
+    case GL_TEXTURE_GEN_R:
+        s.mCaps.texGenR &= ~(0x1 << (s.mActiveTexture - GL_TEXTURE0));
+        break;
+    case GL_TEXTURE_GEN_Q:
+        s.mCaps.texGenQ &= ~(0x1 << (s.mActiveTexture - GL_TEXTURE0));
+        break;
 
 #ifdef GL_VERSION_1_4
     case GL_SECONDARY_COLOR_ARRAY:
@@ -752,12 +811,17 @@ void glstDrawElements(State &, GLenum mode, GLsizei count, GLenum type, const GL
 {
 }
 
+void glstDrawRangeElements(State &, GLenum mode, GLuint start, GLuint end, GLsizei count, GLenum type, const GLvoid *indices)
+{
+}
+
 void glstDrawSWR(State &)
 {
 }
 
 void glstEnable(State &s, GLenum cap)
 {
+    MarkDirty(s, DIRTY_L0);
     switch (cap)
     {
     case GL_ALPHA_TEST:
@@ -812,6 +876,21 @@ void glstEnable(State &s, GLenum cap)
     case GL_TEXTURE_2D:
         s.mCaps.textures |= (0x1 << (s.mActiveTexture - GL_TEXTURE0));
         break;
+    case GL_TEXTURE_CUBE_MAP:
+        s.mCaps.texturesCube |= (0x1 << (s.mActiveTexture - GL_TEXTURE0));
+        break;
+    case GL_TEXTURE_GEN_S:
+        s.mCaps.texGenS |= (0x1 << (s.mActiveTexture - GL_TEXTURE0));
+        break;
+    case GL_TEXTURE_GEN_T:
+        s.mCaps.texGenT |= (0x1 << (s.mActiveTexture - GL_TEXTURE0));
+        break;
+    case GL_TEXTURE_GEN_R:
+        s.mCaps.texGenR |= (0x1 << (s.mActiveTexture - GL_TEXTURE0));
+        break;
+    case GL_TEXTURE_GEN_Q:
+        s.mCaps.texGenQ |= (0x1 << (s.mActiveTexture - GL_TEXTURE0));
+        break;
     case GL_TEXTURE_COORD_ARRAY:
         s.mCaps.texCoordArray |= (0x1 << (s.mClientActiveTexture - GL_TEXTURE0));
         break;
@@ -845,9 +924,11 @@ void glstEndList(State &)
 
 void glstFogfv(State &s, GLenum pname, const GLfloat *params)
 {
+    MarkDirty(s, DIRTY_UNCACHEABLE);
     switch (pname)
     {
     case GL_FOG_COLOR:
+        s.mCurrentAttrCache.mChanged.fog = 1;
         s.mFog.mColor[0] = params[0];
         s.mFog.mColor[1] = params[1];
         s.mFog.mColor[2] = params[2];
@@ -858,6 +939,7 @@ void glstFogfv(State &s, GLenum pname, const GLfloat *params)
 
 void glstFogf(State &s, GLenum pname, GLfloat param)
 {
+    MarkDirty(s, DIRTY_UNCACHEABLE);
     switch (pname)
     {
     case GL_FOG_START:
@@ -871,6 +953,7 @@ void glstFogf(State &s, GLenum pname, GLfloat param)
 
 void glstFogi(State &s, GLenum pname, GLint param)
 {
+    MarkDirty(s, DIRTY_UNCACHEABLE);
     switch (pname)
     {
     case GL_FOG_MODE:
@@ -881,6 +964,7 @@ void glstFogi(State &s, GLenum pname, GLint param)
 
 void glstFrontFace(State &s, GLenum frontFace)
 {
+    MarkDirty(s, DIRTY_L2);
     s.mFrontFace = frontFace;
 }
 
@@ -1150,7 +1234,7 @@ const GLubyte *glstGetString(State &, GLenum name)
         return gVersionString;
     }
     case GL_EXTENSIONS:
-        return (const GLubyte *)"GL_EXT_compiled_vertex_array GL_ARB_vertex_buffer_object";
+        return (const GLubyte *)"GL_EXT_compiled_vertex_array GL_ARB_vertex_buffer_object GL_EXT_texture_compression_s3tc GL_ARB_texture_cube_map GL_ARB_depth_texture GL_ARB_shadow GL_ARB_texture_env_add GL_ARB_texture_env_combine GL_ARB_texture_env_crossbar GL_ARB_texture_env_dot3";
     default:
         assert(0);
     }
@@ -1211,6 +1295,8 @@ GLboolean glstIsEnabled(State &s, GLenum cap)
         return (s.mCaps.rescaleNormal & 0x1) != 0;
     case GL_TEXTURE_2D:
         return (s.mCaps.textures & (0x1 << (s.mActiveTexture - GL_TEXTURE0))) != 0;
+    case GL_TEXTURE_CUBE_MAP:
+        return (s.mCaps.texturesCube & (0x1 << (s.mActiveTexture - GL_TEXTURE0))) != 0;
     case GL_TEXTURE_GEN_S:
         return (s.mCaps.texGenS & (0x1 << (s.mActiveTexture - GL_TEXTURE0))) != 0;
     case GL_TEXTURE_GEN_T:
@@ -1229,6 +1315,7 @@ GLboolean glstIsEnabled(State &s, GLenum cap)
 
 void glstLight(State &s, GLenum light, GLenum pname, std::array<GLfloat, 4> const &params, bool isScalar)
 {
+    MarkDirty(s, DIRTY_L2);
     LightSourceParameters &rLight = s.mLightSource[light - GL_LIGHT0];
 
     switch (pname)
@@ -1295,6 +1382,7 @@ void glstLight(State &s, GLenum light, GLenum pname, std::array<GLfloat, 4> cons
 
 void glstLightModel(State &s, GLenum pname, std::array<GLfloat, 4> const &params, bool isScalar)
 {
+    MarkDirty(s, DIRTY_L0 | DIRTY_L1);
     switch (pname)
     {
     case GL_LIGHT_MODEL_AMBIENT:
@@ -1331,6 +1419,7 @@ void glstLockArraysEXT(State &s, GLint first, GLsizei count)
 
 void glstMaterial(State &s, GLenum face, GLenum pname, std::array<GLfloat, 4> const &params, bool isScalar)
 {
+    MarkDirty(s, DIRTY_L1);
     OGL::MaterialParameters *pMPs = 0;
     switch (face)
     {
@@ -1404,6 +1493,8 @@ void glstNewList(State &, GLuint list, GLenum mode)
 
 void glstNormal(State &s, GLfloat nx, GLfloat ny, GLfloat nz)
 {
+    MarkDirty(s, DIRTY_UNCACHEABLE);
+    s.mCurrentAttrCache.mChanged.normal = 1;
     s.mNormal[0] = (GLfloat)nx;
     s.mNormal[1] = (GLfloat)ny;
     s.mNormal[2] = (GLfloat)nz;
@@ -1493,6 +1584,7 @@ void glstPixelStorei(State &s, GLenum pname, GLint param)
 
 void glstPolygonMode(State &s, GLenum face, GLenum mode)
 {
+    MarkDirty(s, DIRTY_L2);
     switch (face)
     {
     case GL_FRONT:
@@ -1520,6 +1612,8 @@ void glstPopAttrib(State &s)
 
     auto ss = s.mAttribStack.top(); // Get pushed attribute state.
     s.mAttribStack.pop();
+    MarkDirty(s, DIRTY_ALL);
+    s.mCurrentAttrCache.mChanged.mask = 0xFFFFFFFF;
 
     GLbitfield mask = ss.first; // Mask that attribs were pushed with.
 
@@ -1572,6 +1666,7 @@ void glstPopAttrib(State &s)
         GPACPY(mCaps.texGenR);
         GPACPY(mCaps.texGenQ);
         GPACPY(mCaps.textures);
+        GPACPY(mCaps.texturesCube);
     }
     if (mask & GL_LIGHTING_BIT)
     {
@@ -1657,6 +1752,9 @@ void glstPopAttrib(State &s)
         GPACPY(mCaps.texGenT);
         GPACPY(mCaps.texGenR);
         GPACPY(mCaps.texGenQ);
+        GPACPYX(mTexGenMode);
+        GPACPYX(mTexGenObjectPlane);
+        GPACPYX(mTexGenEyePlane);
         GPACPYX(mTexUnit);
     }
     if (mask & GL_TRANSFORM_BIT)
@@ -1748,6 +1846,7 @@ void glstScale(State &s, GLdouble x, GLdouble y, GLdouble z)
 
 void glstScissor(State &s, GLint x, GLint y, GLsizei width, GLsizei height)
 {
+    MarkDirty(s, DIRTY_L2);
     GLint maxVP[2];
     glstGetIntegerv(s, GL_MAX_VIEWPORT_DIMS, maxVP);
 
@@ -1759,12 +1858,18 @@ void glstScissor(State &s, GLint x, GLint y, GLsizei width, GLsizei height)
 
 void glstSetClearMaskSWR(State &s, GLbitfield mask)
 {
+    MarkDirty(s, DIRTY_L2);
     s.mClearMask = mask;
 }
 
 void glstSetTopologySWR(State &s, GLenum topology)
 {
-    s.mTopology = topology;
+    // set on every draw, only rehash L0 when it actually changes
+    if (s.mTopology != topology)
+    {
+        s.mTopology = topology;
+        MarkDirty(s, DIRTY_L0);
+    }
 }
 
 void glstSetUpDrawSWR(State &s, GLenum drawType)
@@ -1773,6 +1878,7 @@ void glstSetUpDrawSWR(State &s, GLenum drawType)
 
 void glstShadeModel(State &s, GLenum mode)
 {
+    MarkDirty(s, DIRTY_L0);
     s.mShadeModel = mode;
 }
 
@@ -1783,6 +1889,8 @@ void glstSubstituteVBSWR(State &s, GLsizei which)
 
 void glstTexCoord(State &state, GLenum texCoord, GLfloat s, GLfloat t, GLfloat r, GLfloat q)
 {
+    MarkDirty(state, DIRTY_UNCACHEABLE);
+    state.mCurrentAttrCache.mChanged.texCoord |= 0x1 << (texCoord - GL_TEXTURE0);
     state.mTexCoord[texCoord - GL_TEXTURE0][0] = (GLfloat)s;
     state.mTexCoord[texCoord - GL_TEXTURE0][1] = (GLfloat)t;
     state.mTexCoord[texCoord - GL_TEXTURE0][2] = (GLfloat)r;
@@ -1799,34 +1907,205 @@ void glstTexCoordPointer(State &s, GLint size, GLenum type, GLsizei stride, cons
     s.mActiveVBOs.texcoord[0] = s.mActiveArrayVBO;
 }
 
+static bool _glstIsCombineFunc(GLenum func, bool alpha)
+{
+    switch (func)
+    {
+    case GL_REPLACE:
+    case GL_MODULATE:
+    case GL_ADD:
+    case GL_ADD_SIGNED:
+    case GL_INTERPOLATE:
+    case GL_SUBTRACT:
+        return true;
+    case GL_DOT3_RGB:
+    case GL_DOT3_RGBA:
+        return !alpha;
+    default:
+        return false;
+    }
+}
+
+static bool _glstIsCombineSource(GLenum source)
+{
+    switch (source)
+    {
+    case GL_TEXTURE:
+    case GL_CONSTANT:
+    case GL_PRIMARY_COLOR:
+    case GL_PREVIOUS:
+        return true;
+    default:
+        return (source >= GL_TEXTURE0) && (source < GL_TEXTURE0 + NUM_TEXTURES);
+    }
+}
+
+static bool _glstIsCombineOperand(GLenum operand, bool alpha)
+{
+    switch (operand)
+    {
+    case GL_SRC_ALPHA:
+    case GL_ONE_MINUS_SRC_ALPHA:
+        return true;
+    case GL_SRC_COLOR:
+    case GL_ONE_MINUS_SRC_COLOR:
+        return !alpha;
+    default:
+        return false;
+    }
+}
+
 void glstTexEnv(State &s, GLenum target, GLenum pname, std::array<GLfloat, 4> const &params)
 {
+    MarkDirty(s, DIRTY_L2);
     assert(target == GL_TEXTURE_ENV);
 
     TextureUnit &texUnit = s.mTexUnit[s.mActiveTexture - GL_TEXTURE0];
+    GLenum value = (GLenum)params[0];
     switch (pname)
     {
     case GL_TEXTURE_ENV_MODE:
-        texUnit.mTexEnv.mMode = (GLenum)params[0];
+        if ((value != GL_REPLACE) && (value != GL_MODULATE) && (value != GL_DECAL) &&
+            (value != GL_BLEND) && (value != GL_ADD) && (value != GL_COMBINE))
+        {
+            s.mLastError = GL_INVALID_ENUM;
+            break;
+        }
+        texUnit.mTexEnv.mMode = value;
         break;
     case GL_TEXTURE_ENV_COLOR:
         memcpy(&texUnit.mTexEnv.mColor[0], &params[0], sizeof(GLfloat) * 4);
         break;
+    case GL_COMBINE_RGB:
+    case GL_COMBINE_ALPHA:
+    {
+        bool alpha = pname == GL_COMBINE_ALPHA;
+        if (!_glstIsCombineFunc(value, alpha))
+        {
+            s.mLastError = GL_INVALID_ENUM;
+            break;
+        }
+        texUnit.mTexEnv.mCombine[alpha] = value;
+    }
+    break;
+    case GL_SOURCE0_RGB:
+    case GL_SOURCE1_RGB:
+    case GL_SOURCE2_RGB:
+    case GL_SOURCE0_ALPHA:
+    case GL_SOURCE1_ALPHA:
+    case GL_SOURCE2_ALPHA:
+    {
+        bool alpha = pname >= GL_SOURCE0_ALPHA;
+        if (!_glstIsCombineSource(value))
+        {
+            s.mLastError = GL_INVALID_ENUM;
+            break;
+        }
+        texUnit.mTexEnv.mSource[alpha][pname - (alpha ? GL_SOURCE0_ALPHA : GL_SOURCE0_RGB)] = value;
+    }
+    break;
+    case GL_OPERAND0_RGB:
+    case GL_OPERAND1_RGB:
+    case GL_OPERAND2_RGB:
+    case GL_OPERAND0_ALPHA:
+    case GL_OPERAND1_ALPHA:
+    case GL_OPERAND2_ALPHA:
+    {
+        bool alpha = pname >= GL_OPERAND0_ALPHA;
+        if (!_glstIsCombineOperand(value, alpha))
+        {
+            s.mLastError = GL_INVALID_ENUM;
+            break;
+        }
+        texUnit.mTexEnv.mOperand[alpha][pname - (alpha ? GL_OPERAND0_ALPHA : GL_OPERAND0_RGB)] = value;
+    }
+    break;
+    case GL_RGB_SCALE:
+    case GL_ALPHA_SCALE:
+        if ((params[0] != 1.0f) && (params[0] != 2.0f) && (params[0] != 4.0f))
+        {
+            s.mLastError = GL_INVALID_VALUE;
+            break;
+        }
+        texUnit.mTexEnv.mScale[pname == GL_ALPHA_SCALE] = params[0];
+        break;
     default:
         assert(0 && "Unknown TexEnv pname");
     }
 }
 
+void glstTexGen(State &s, GLenum coord, GLenum pname, std::array<GLfloat, 4> const &params)
+{
+    if ((coord < GL_S) || (coord > GL_Q))
+    {
+        s.mLastError = GL_INVALID_ENUM;
+        return;
+    }
+
+    switch (pname)
+    {
+    case GL_TEXTURE_GEN_MODE:
+    {
+        GLenum mode = (GLenum)params[0];
+        switch (mode)
+        {
+        case GL_OBJECT_LINEAR:
+        case GL_EYE_LINEAR:
+            break;
+        case GL_SPHERE_MAP:
+            if (coord > GL_T)
+            {
+                s.mLastError = GL_INVALID_ENUM;
+                return;
+            }
+            break;
+        case GL_REFLECTION_MAP:
+        case GL_NORMAL_MAP:
+            if (coord == GL_Q)
+            {
+                s.mLastError = GL_INVALID_ENUM;
+                return;
+            }
+            break;
+        default:
+            s.mLastError = GL_INVALID_ENUM;
+            return;
+        }
+        MarkDirty(s, DIRTY_L0);
+        s.mTexGenMode[s.mActiveTexture - GL_TEXTURE0][coord - GL_S] = mode;
+    }
+    break;
+    case GL_OBJECT_PLANE:
+        MarkDirty(s, DIRTY_UNCACHEABLE);
+        memcpy(&s.mTexGenObjectPlane[s.mActiveTexture - GL_TEXTURE0][coord - GL_S][0], &params[0], sizeof(GLfloat) * 4);
+        break;
+    case GL_EYE_PLANE:
+    {
+        // p' = p M^-1, M the modelview when the plane is specified.
+        auto invMV = SWRL::minvert(s.mMatrices[OGL::MODELVIEW].top());
+        SWRL::v4f &rPlane = s.mTexGenEyePlane[s.mActiveTexture - GL_TEXTURE0][coord - GL_S];
+        for (GLuint j = 0; j < 4; ++j)
+        {
+            rPlane[j] = params[0] * invMV[0][j] + params[1] * invMV[1][j] + params[2] * invMV[2][j] + params[3] * invMV[3][j];
+        }
+        MarkDirty(s, DIRTY_UNCACHEABLE);
+    }
+    break;
+    default:
+        s.mLastError = GL_INVALID_ENUM;
+        break;
+    }
+}
+
 void glstTexImage2D(State &s, GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const GLvoid *data)
 {
 }
 
 void glstTexParameter(State &s, GLenum target, GLenum pname, std::array<GLfloat, 4> const &params)
 {
-    assert(target == GL_TEXTURE_2D);
+    assert((target == GL_TEXTURE_2D) || (target == GL_TEXTURE_CUBE_MAP));
 
-    TextureUnit &texUnit = s.mTexUnit[s.mActiveTexture - GL_TEXTURE0];
-    TexParameters &txpm = s.mTexParameters[texUnit.mNamedTexture2d];
+    TexParameters &txpm = s.mTexParameters[BoundTextureName(s, target)];
     switch (pname)
     {
     case GL_TEXTURE_MIN_FILTER:
@@ -1864,12 +2143,27 @@ void glstTexParameter(State &s, GLenum target, GLenum pname, std::array<GLfloat,
         break;
 #ifdef GL_VERSION_1_4
     case GL_TEXTURE_COMPARE_MODE:
+        if (((GLenum)params[0] != GL_NONE) && ((GLenum)params[0] != GL_COMPARE_R_TO_TEXTURE))
+        {
+            s.mLastError = GL_INVALID_ENUM;
+            break;
+        }
         txpm.mCompareMode = (GLenum)params[0];
         break;
     case GL_TEXTURE_COMPARE_FUNC:
+        if (((GLenum)params[0] != GL_LEQUAL) && ((GLenum)params[0] != GL_GEQUAL))
+        {
+            s.mLastError = GL_INVALID_ENUM;
+            break;
+        }
         txpm.mCompareFunc = (GLenum)params[0];
         break;
     case GL_DEPTH_TEXTURE_MODE:
+        if (((GLenum)params[0] != GL_LUMINANCE) && ((GLenum)params[0] != GL_INTENSITY) && ((GLenum)params[0] != GL_ALPHA))
+        {
+            s.mLastError = GL_INVALID_ENUM;
+            break;
+        }
         txpm.mDepthMode = (GLenum)params[0];
         break;
     case GL_GENERATE_MIPMAP:
@@ -1919,6 +2213,7 @@ void glstVertexPointer(State &s, GLint size, GLenum type, GLsizei stride, const
 
 void glstViewport(State &s, GLint x, GLint y, GLsizei width, GLsizei height)
 {
+    MarkDirty(s, DIRTY_L2);
     GLint maxVP[2];
     glstGetIntegerv(s, GL_MAX_VIEWPORT_DIMS, maxVP);
 
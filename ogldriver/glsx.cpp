@@ -128,6 +128,23 @@ void glsxDrawElements(OptState &os, GLenum mode, GLsizei count, GLenum type, con
 {
 }
 
+// glMultiDraw* compile into the sequence of single draws they stand for.
+void glsxMultiDrawArrays(OptState &os, GLenum mode, const GLint *first, const GLsizei *count, GLsizei drawcount)
+{
+    for (GLsizei i = 0; i < drawcount; ++i)
+    {
+        glclDrawArrays(os, mode, first[i], count[i]);
+    }
+}
+
+void glsxMultiDrawElements(OptState &os, GLenum mode, const GLsizei *count, GLenum type, const GLvoid *const *indices, GLsizei drawcount)
+{
+    for (GLsizei i = 0; i < drawcount; ++i)
+    {
+        glclDrawElements(os, mode, count[i], type, indices[i]);
+    }
+}
+
 void glsxEnd(OptState &os)
 {
     os.mpDL->mpNumVertices = 0;
@@ -829,6 +829,7 @@ void glXSwapBuffers(Display *pDisplay, GLXDrawable drawable)
     assert(gDrawableBuffers.find(drawable) != gDrawableBuffers.end());
 
     OGL_TRACE(SwapBuffers, GetOGL());
+    OGL::MarshalSync(GetOGL());
     FrameBuffer *fb = gDrawableBuffers[drawable];
     fb->Flip();
     OGL::GetDDProcTable().pfnSetRenderTarget(OGL::GetDDHandle(), fb->GetBackBuffer(), fb->GetDepthBuffer());
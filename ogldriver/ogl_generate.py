@@ -51,6 +51,8 @@ tyPFloat    = "GLfloat*"
 tyCPDouble  = "const GLdouble*"
 tyCPFloat   = "const GLfloat*"
 tyCPShort   = "const GLshort*"
+tyCPSizei   = "const GLsizei*"
+tyCPCPVoid  = "const GLvoid* const*"
 tyArrD4     = "std::array<GLdouble, 4> const&"
 tyArrF4     = "std::array<GLfloat, 4> const&"
 tyM44       = "SWRL::m44f"
@@ -120,6 +122,31 @@ functions = [
                                                                                                                                                                                  (tyBoolean, "green", None, None, None),
                                                                                                                                                                                  (tyBoolean, "blue", None, None, None),
                                                                                                                                                                                  (tyBoolean, "alpha", None, None, None)]),
+("CompressedTexImage2D", None,      True,       "Always",       True,       tyVoid,     [(tyEnum, "target", None, None, None),
+                                                                                                                                                                                 (tyInt, "level", None, None, None),
+                                                                                                                                                                                 (tyEnum, "internalFormat", None, None, None),
+                                                                                                                                                                                 (tySizei, "width", None, None, None),
+                                                                                                                                                                                 (tySizei, "height", None, None, None),
+                                                                                                                                                                                 (tyInt, "border", None, None, None),
+                                                                                                                                                                                 (tySizei, "imageSize", None, None, None),
+                                                                                                                                                                                 (tyCPVoid, "data", None, None, None)]),
+("CompressedTexSubImage2D", None,   True,       "Always",       True,       tyVoid,     [(tyEnum, "target", None, None, None),
+                                                                                                                                                                                 (tyInt, "level", None, None, None),
+                                                                                                                                                                                 (tyInt, "xoffset", None, None, None),
+                                                                                                                                                                                 (tyInt, "yoffset", None, None, None),
+                                                                                                                                                                                 (tySizei, "width", None, None, None),
+                                                                                                                                                                                 (tySizei, "height", None, None, None),
+                                                                                                                                                                                 (tyEnum, "format", None, None, None),
+                                                                                                                                                                                 (tySizei, "imageSize", None, None, None),
+                                                                                                                                                                                 (tyCPVoid, "data", None, None, None)]),
+("CopyTexImage2D",      None,           True,           "NOCL",                 True,           tyVoid,         [(tyEnum, "target", None, None, None),
+                                                                                                                                                                                 (tyInt, "level", None, None, None),
+                                                                                                                                                                                 (tyEnum, "internalFormat", None, None, None),
+                                                                                                                                                                                 (tyInt, "x", None, None, None),
+                                                                                                                                                                                 (tyInt, "y", None, None, None),
+                                                                                                                                                                                 (tySizei, "width", None, None, None),
+                                                                                                                                                                                 (tySizei, "height", None, None, None),
+                                                                                                                                                                                 (tyInt, "border", None, None, None)]),
 ("CopyTexSubImage2D",   None,           True,           "NOCL",                 True,           tyVoid,         [(tyEnum, "target", None, None, None),
                                                                                                                                                                                  (tyInt, "level", None, None, None),
                                                                                                                                                                                  (tyInt, "xoffset", None, None, None),
@@ -139,19 +166,31 @@ functions = [
                                                                                                                                                                                  (tyClampd, "zFar", None, None, None)]),
 ("Disable",             None,       True,       "Always",       True,       tyVoid,     [(tyEnum, "cap", None, None, None)]),
 ("DisableClientState",  None,       True,       "SpecialCL",     True,       tyVoid,     [(tyEnum, "cap", None, None, None)]),
-("DrawArrays",          None,       True,       "InsteadCL",    True,       tyVoid,     [(tyEnum, "mode", None, None, None),
+("DrawArrays",          None,       True,       "InsteadCL",    False,       tyVoid,     [(tyEnum, "mode", None, None, None),
                                                                                                                                                                                  (tyInt, "first", None, None, None),
                                                                                                                                                                                  (tySizei, "count", None, None, None)]),
 ("DrawElements",        None,       True,       "Always",       True,       tyVoid,     [(tyEnum, "mode", None, None, None),
                                                                                                                                                                                  (tySizei, "count", None, None, None),
                                                                                                                                                                                  (tyEnum, "type", None, None, None),
                                                                                                                                                                                  (tyCPVoid, "indices", None, None, None)]),
+("DrawRangeElements",   None,       True,       "Always",       True,       tyVoid,     [(tyEnum, "mode", None, None, None),
+                                                                                                                                                                                 (tyUint, "start", None, None, None),
+                                                                                                                                                                                 (tyUint, "end", None, None, None),
+                                                                                                                                                                                 (tySizei, "count", None, None, None),
+                                                                                                                                                                                 (tyEnum, "type", None, None, None),
+                                                                                                                                                                                 (tyCPVoid, "indices", None, None, None)]),
 ("SetUpDrawSWR",        None,       False,      "Always",               True,       tyVoid,     [(tyEnum, "drawType", None, None, None)]),
 ("DrawSWR",             None,       False,      "Always",       False,      tyVoid,     []),
+("DrawIndexedSWR",      None,       False,      "Always",       False,      tyVoid,     [(tySizei, "numIndices", None, None, None)]),
 ("Enable",              None,       True,       "Always",       True,       tyVoid,     [(tyEnum, "cap", None, None, None)]),
 ("EnableClientState",   None,       True,       "SpecialCL",    True,       tyVoid,     [(tyEnum, "cap", None, None, None)]),
 ("End",                 None,       True,       "SpecialCL",    False,      tyVoid,     []),
 ("EndList",             None,       True,       "IgnoreCL",     True,       tyVoid,     []),
+("FeedbackBuffer",      None,       True,       "IgnoreCL",     True,       tyVoid,     [(tySizei, "size", None, None, None),
+                                                                                                                                                                                 (tyEnum, "type", None, None, None),
+                                                                                                                                                                                 (tyPFloat, "buffer", None, None, None)]),
+("Finish",              None,       True,       "IgnoreCL",     True,       tyVoid,     []),
+("Flush",               None,       True,       "IgnoreCL",     True,       tyVoid,     []),
 ("Fogf",                None,       True,       "Always",       True,       tyVoid,     [(tyEnum, "pname", None, None, None),
                                                                                          (tyFloat, "param", None, None,None)]),
 ("Fogi",                None,       True,       "Always",       True,       tyVoid,     [(tyEnum, "pname", None, None, None),
@@ -201,10 +240,12 @@ functions = [
                                                                                                                                                                                 (tyPInt, "params", None,  None,  None),]),
 ("Hint",                None,       True,       "Always",       True,       tyVoid,     [(tyEnum, "target", None, None, None),
                                                                                                                                                                                  (tyEnum, "mode", None, None, None)]),
+("InitNames",           None,       True,       "Always",       True,       tyVoid,     []),
 ("IsEnabled",           None,       True,       "IgnoreCL",     True,       tyBoolean,  [(tyEnum, "cap", None, None, None)]),
 # LightModel is handled below
 # Light is handled below
 ("LoadIdentity",        None,       True,       "Always",       True,       tyVoid,     []),
+("LoadName",            None,       True,       "Always",       True,       tyVoid,     [(tyUint, "name", None, None, None)]),
 # LoadMatrix is handled below
 # Material is handled below
 ("LockArraysEXT",       None,       True,       "Always",       True,       tyVoid,     [(tyInt, "first", None, None, None),
@@ -212,6 +253,15 @@ functions = [
 ("SetLockedArraysSWR",  None,       False,      "Always",       True,       tyVoid,     [(tyInt, "lockedArrays", None, None, None)]),
 ("MatrixMode",          None,       True,       "Always",       True,       tyVoid,     [(tyEnum, "mode", None, None, None)]),
 # MultMatrix is handled below
+("MultiDrawArrays",     None,       True,       "InsteadCL",    True,       tyVoid,     [(tyEnum, "mode", None, None, None),
+                                                                                                                                                                                 (tyCPInt, "first", None, None, None),
+                                                                                                                                                                                 (tyCPSizei, "count", None, None, None),
+                                                                                                                                                                                 (tySizei, "drawcount", None, None, None)]),
+("MultiDrawElements",   None,       True,       "InsteadCL",    True,       tyVoid,     [(tyEnum, "mode", None, None, None),
+                                                                                                                                                                                 (tyCPSizei, "count", None, None, None),
+                                                                                                                                                                                 (tyEnum, "type", None, None, None),
+                                                                                                                                                                                 (tyCPCPVoid, "indices", None, None, None),
+                                                                                                                                                                                 (tySizei, "drawcount", None, None, None)]),
 ("NewList",             None,       True,       "NOCL",         True,       tyVoid,     [(tyUint, "list", None, None, None),
                                                                                                                                                                                  (tyEnum, "mode", None, None, None)]),
 # Normal is handled belowbb
@@ -226,6 +276,7 @@ functions = [
                                                                                                                                                                                  (tyDouble, "top", None, None, None),
                                                                                                                                                                                  (tyDouble, "zNear", None, None, None),
                                                                                                                                                                                  (tyDouble, "zFar", None, None, None)]),
+("PassThrough",         None,       True,       "Always",       True,       tyVoid,     [(tyFloat, "token", None, None, None)]),
 ("PixelStoref",                 None,           True,           "IgnoreCL",             True,           tyVoid,         [(tyEnum, "pname", None, None, None),
                                                                                                                                                                                  (tyFloat, "param", None, None, None)]),
 ("PixelStorei",                 None,           True,           "IgnoreCL",             True,           tyVoid,         [(tyEnum, "pname", None, None, None),
@@ -233,8 +284,10 @@ functions = [
 ("PolygonMode",                 None,           True,           "Always",               True,           tyVoid,         [(tyEnum, "face", None, None, None),
                                                                                                                                                                                  (tyEnum, "mode", None, None, None)]),
 ("PopAttrib",           None,       True,       "Always",       True,       tyVoid,     []),
+("PopName",             None,       True,       "Always",       True,       tyVoid,     []),
 ("PopMatrix",           None,       True,       "Always",       True,       tyVoid,     []),
 ("PushAttrib",          None,       True,       "Always",       True,       tyVoid,     [(tyBitfield, "mask", None, None, None)]),
+("PushName",            None,       True,       "Always",       True,       tyVoid,     [(tyUint, "name", None, None, None)]),
 ("PushMatrix",          None,       True,       "Always",       True,       tyVoid,     []),
 ("ReadPixels",                  None,           True,           "NOCL",                 True,           tyVoid,         [(tyInt, "x", None, None, None),
                                                                                                                                                                                  (tyInt, "y", None, None, None),
@@ -243,6 +296,7 @@ functions = [
                                                                                                                                                                                  (tyEnum, "format", None, None, None),
                                                                                                                                                                                  (tyEnum, "type", None, None, None),
                                                                                                                                                                                  (tyPVoid, "pixels", None, None, None)]),
+("RenderMode",          None,       True,       "IgnoreCL",     True,       tyInt,      [(tyEnum, "mode", None, None, None)]),
 ("ResetMainVBSWR",      None,       True,       "Always",       True,       tyVoid,     []),
 # Rotate is handled below
 # Scale is handled below
@@ -250,10 +304,12 @@ functions = [
                                                                                                                                                                                 (tyInt, "y", None, None, None),
                                                                                                                                                                                 (tySizei, "width", None, None, None),
                                                                                                                                                                                 (tySizei, "height", None, None, None)]),
+("SelectBuffer",        None,       True,       "IgnoreCL",     True,       tyVoid,     [(tySizei, "size", None, None, None),
+                                                                                                                                                                                 (tyPUint, "buffer", None, None, None)]),
 ("SetClearMaskSWR",     None,       False,      "Always",       True,       tyVoid,     [(tyBitfield, "mask", None, None, None)]),
 ("SetTopologySWR",      None,       False,      "Always",       True,       tyVoid,     [(tyEnum, "topology", None, None, None)]),
 ("ShadeModel",          None,       True,       "Always",       True,       tyVoid,     [(tyEnum, "mode", None, None, None)]),
-("SubstituteVBSWR",     None,       True,       "Always",       True,       tyVoid,     [(tySizei, "which", None, None, None)]),
+("SubstituteVBSWR",     None,       True,       "Always",       False,       tyVoid,     [(tySizei, "which", None, None, None)]),
 # TexCoord is handled below
 # TexEnv is handled below
 ("TexImage2D",          None,       True,       "Always",       True,       tyVoid,     [(tyEnum, "target", None, None, None),
@@ -464,6 +520,14 @@ functions.extend(
                  (ty, "param", tyArrF4, "param", "ConvertTexEnvArgs(pname, param)")])
         for suf,ty in [("f", tyFloat), ("i", tyInt), ("fv", tyCPFloat), ("iv", tyCPInt)]])
 
+# TexGen
+functions.extend(
+        [("TexGen%s"%suf, "TexGen", True, "Always", True, tyVoid,
+                [(tyEnum, "coord", None, None, None),
+                 (tyEnum, "pname", None, None, None),
+                 (ty, "param", tyArrF4, "param", "ConvertTexGenArgs(pname, param)")])
+        for suf,ty in [("d", tyDouble), ("f", tyFloat), ("i", tyInt), ("dv", tyCPDouble), ("fv", tyCPFloat), ("iv", tyCPInt)]])
+
 # TexParameter
 functions.extend(
         [("TexParameter%s"%suf, "TexParameter", True, "Always", True, tyVoid,
@@ -1303,6 +1367,56 @@ def get_intern_param_arg(param):
         if param[fpCallArg] is None: return get_intern_param_name(param)
         return param[fpCallArg]
 
+# Commands that return data to the caller wait for the marshalling thread
+# and run on the application thread, as do Get* and any command taking a
+# pointer not covered below.
+marshalSyncFns = ["Finish", "GenBuffers", "GenBuffersARB", "GenTextures", "ReadPixels"]
+
+# Commands whose pointer arguments are only stored, never read by the call.
+marshalPointerFns = ["ColorPointer", "FeedbackBuffer", "NormalPointer", "SelectBuffer", "TexCoordPointer", "VertexPointer"]
+
+# Commands that read client memory during the call: the pointer argument
+# and the number of bytes copied into the batch for it.
+marshalCopyFns = {
+        "BufferData"              : ("data", "size"),
+        "BufferDataARB"           : ("data", "size"),
+        "BufferSubData"           : ("data", "size"),
+        "BufferSubDataARB"        : ("data", "size"),
+        "CallLists"               : ("lists", "OGL::MarshalCallListsSize(n, type)"),
+        "CompressedTexImage2D"    : ("data", "imageSize"),
+        "CompressedTexSubImage2D" : ("data", "imageSize"),
+        "DeleteBuffers"           : ("buffers", "n * sizeof(GLuint)"),
+        "DeleteBuffersARB"        : ("buffers", "n * sizeof(GLuint)"),
+        "DeleteTextures"          : ("textures", "n * sizeof(GLuint)"),
+        "Fogfv"                   : ("params", "OGL::MarshalFogSize(pname)"),
+        "TexImage2D"              : ("data", "OGL::MarshalPixelsSize(width, height, format, type)"),
+        "TexSubImage2D"           : ("pixels", "OGL::MarshalPixelsSize(width, height, format, type)"),
+}
+
+# Commands that read client arrays; their marshalling is written by hand in
+# glmt.inl.
+marshalArrayFns = ["ArrayElement", "DrawArrays", "DrawElements", "DrawRangeElements", "LockArraysEXT",
+                   "MultiDrawArrays", "MultiDrawElements"]
+
+# Commands that change the client array state the application thread
+# mirrors in MarshalClientState.
+marshalTrackFns = ["BindBuffer", "BindBufferARB", "ClientActiveTexture", "ColorPointer", "Disable",
+                   "DisableClientState", "Enable", "EnableClientState", "EndList", "NewList",
+                   "NormalPointer", "TexCoordPointer", "UnlockArraysEXT", "VertexPointer"]
+
+# Commands that hand the batch being filled to the marshalling thread
+# without waiting for it.
+marshalFlushFns = ["Flush"]
+
+def is_marshal_sync(fn):
+        key = get_intern_name(fn)
+        if fn[rType] != tyVoid: return True
+        if key in marshalSyncFns or key.startswith("Get"): return True
+        if key in marshalPointerFns or key in marshalCopyFns or key in marshalArrayFns: return False
+        for param in fn[fParams]:
+                if "*" in get_intern_param_type(param): return True
+        return False
+
 def extract_internal_functions(fns, output_dir=os.path.dirname(__file__)):
         if not os.path.exists(output_dir):
                 os.makedirs(output_dir)
@@ -1319,6 +1433,7 @@ def extract_internal_functions(fns, output_dir=os.path.dirname(__file__)):
         glCmds  = []
         glCBs   = []
         glOPs   = []
+        glSzs   = []
         glfzH   = []
         glfzCpp = []
         glsxH   = []
@@ -1334,6 +1449,7 @@ def extract_internal_functions(fns, output_dir=os.path.dirname(__file__)):
                 numTabStops = int((finalTabStop * 4 - 9 - len(key) + 3)/4)
                 glCBs.append("\t\t\tcase CMD_"+key.upper()+"\t"*numTabStops + ": pCursor = executeCommand({1}, pCursor, &{0}"+key+"); break;")
                 glOPs.append("\t\t\tcase CMD_"+key.upper()+" : pCursor = executeCommand({1}, pCursor, &{0}"+key+"); break;")
+                glSzs.append("\tsizeof(COMMAND)" + "".join([" + sizeof(" + get_intern_param_type(param) + ")" for param in fn[fParams]]) + ", // CMD_" + key.upper())
 
                 params  = ["{1}"]
                 params.extend([get_intern_param_type(param) + " " + get_intern_param_name(param) for param in fn[fParams]])
@@ -1399,6 +1515,12 @@ def extract_internal_functions(fns, output_dir=os.path.dirname(__file__)):
                 print("\n".join(glCBs).format("glcl", "s"), file=fn)
                 gen_files.append(of)
 
+        of = "%s/dlcmdsize.inl" % output_dir
+        with open(of, "w") as fn:
+                print(autogenmsg, file=fn)
+                print("\n".join(glSzs), file=fn)
+                gen_files.append(of)
+
         of = "%s/optimizedl.inl" % output_dir
         with open(of, "w") as fn:
                 print(autogenmsg, file=fn)
@@ -1515,6 +1637,7 @@ def extract_external_functions(fns, output_dir=os.path.dirname(__file__)):
 
         glH     = []
         glCpp   = []
+        dispatchFns = {}
 
         glEntryPoints = []
         for key in keys:
@@ -1536,44 +1659,105 @@ def extract_external_functions(fns, output_dir=os.path.dirname(__file__)):
                         elif "GLbitfield" in get_intern_param_type(fparams[idx]):
                                 bdArgs[idx+1] = "(OGL::BitfieldTy)"+bdArg
 
-                glBody  = "\n{{\n\t{0}(" + ", ".join(bdArgs) + ");\n{1}}}"
-
-                rVal    = ""
-                if fn[rType] != tyVoid:
-                        rVal    = "\treturn 0;\n"
-
                 glBody          = "\n"
                 glBody         += "{\n"
                 glBody         += "    auto& s = GetOGL();\n"
                 glBody         += "    OGL_TRACE(" + get_intern_name(fn) + ", " + (", ".join(bdArgs)).format("s") + ");\n"
-                # Don't generate display list switch for functions that ignore display list state.
+                glBody         += "    if (s.mpMarshal) return glmt" + get_intern_name(fn) + "(" + (", ".join(bdArgs)).format("s") + ");\n"
+                glBody         += "    return gldp" + get_intern_name(fn) + "(" + (", ".join(bdArgs)).format("s") + ");\n"
+                glBody         += "}\n"
+
+                if get_intern_name(fn) not in dispatchFns:
+                        dispatchFns[get_intern_name(fn)] = fn
+
+                glH.append(fstr.format(";"))
+                glCpp.append(fstr.format(glBody))
+
+        # Per command dispatch, run on the application thread or, when the
+        # context marshals, on its driver thread.
+        glDP    = []
+        glMT    = []
+        glMTs   = []
+        for key in sorted(dispatchFns.keys()):
+                fn      = dispatchFns[key]
+                fparams = fn[fParams]
+                params  = ["OGL::State& s"]
+                params.extend([get_intern_param_type(param) + " " + get_intern_param_name(param) for param in fparams])
+                args    = [get_intern_param_name(param) for param in fparams]
+                fstr    = "static INLINE " + fn[rType] + " {0}" + key + "(" + ", ".join(params) + ")\n"
+
+                dpBody  = "{\n"
                 if fn[legality] in ["IgnoreCL"]:
-                        glBody     += "    return glim" + get_intern_name(fn) + "(" + (", ".join(bdArgs)).format("s") + ");\n"
+                        dpBody += "    return glim" + key + "(" + ", ".join(["s"] + args) + ");\n"
                 else:
-                        glBody     += "    auto& d = CompilingDL();\n"
-                        glBody     += "    OGL::OptState os = { &s, &d };\n"
-                        glBody     += "    switch (s.mDisplayListMode)\n"
-                        glBody     += "    {\n"
+                        dpBody += "    auto& d = CompilingDL();\n"
+                        dpBody += "    OGL::OptState os = { &s, &d };\n"
+                        dpBody += "    switch (s.mDisplayListMode)\n"
+                        dpBody += "    {\n"
                         if fn[legality] in ["Always", "InsteadCL", "SpecialCL"]:
-                                glBody += "    case GL_COMPILE             : return glcl" + get_intern_name(fn) + "(" + (", ".join(bdArgs)).format("os") + ");\n"
-                                glBody += "    case GL_COMPILE_AND_EXECUTE : glcl" + get_intern_name(fn) + "(" + (", ".join(bdArgs)).format("os") + ");\n"
-                        elif fn[legality] in ["IgnoreCL"]:
-                                glBody += "    case GL_COMPILE             :\n"
-                                glBody += "    case GL_COMPILE_AND_EXECUTE :\n"
+                                dpBody += "    case GL_COMPILE             : return glcl" + key + "(" + ", ".join(["os"] + args) + ");\n"
+                                dpBody += "    case GL_COMPILE_AND_EXECUTE : glcl" + key + "(" + ", ".join(["os"] + args) + ");\n"
                         elif fn[legality] in ["NOCL"]:
-                                glBody += "    case GL_COMPILE             :\n"
-                                glBody += "    case GL_COMPILE_AND_EXECUTE : s.mLastError = GL_INVALID_OPERATION; break;\n"
+                                dpBody += "    case GL_COMPILE             :\n"
+                                dpBody += "    case GL_COMPILE_AND_EXECUTE : s.mLastError = GL_INVALID_OPERATION; break;\n"
                         else:
                                 raise "No legality determinable!"
-                        glBody     += "    case GL_NONE                : return glim" + get_intern_name(fn) + "(" + (", ".join(bdArgs)).format("s") + ");\n"
-                        glBody     += "    default                     : s.mLastError = GL_INVALID_OPERATION;\n"
-                        glBody     += "    }\n"
+                        dpBody += "    case GL_NONE                : return glim" + key + "(" + ", ".join(["s"] + args) + ");\n"
+                        dpBody += "    default                     : s.mLastError = GL_INVALID_OPERATION;\n"
+                        dpBody += "    }\n"
                         if fn[rType] != 'void':
-                                glBody += "    return (" + fn[rType] + ")0;\n"
-                glBody         += "}\n"
+                                dpBody += "    return (" + fn[rType] + ")0;\n"
+                dpBody += "}"
+                glDP.append(fstr.format("gldp") + dpBody)
+
+                # Calls that return data wait for the driver thread and then
+                # run on the application thread. Client memory other calls
+                # read is copied into the batch with the command.
+                syncBody  = "    s.mpMarshal->Sync();\n"
+                syncBody += "    return gldp" + key + "(" + ", ".join(["s"] + args) + ");\n"
+                mtBody  = "{\n"
+                if is_marshal_sync(fn):
+                        mtBody += syncBody
+                else:
+                        glMTs.append("\t\t\tcase CMD_" + key.upper() + " : pCursor = executeCommand(s, pCursor, &gldp" + key + "); break;")
+                        if key in marshalArrayFns:
+                                continue
+                        szArgs  = ["sizeof(OGL::CMD_" + key.upper() + ")"]
+                        szArgs.extend(["sizeof(" + arg + ")" for arg in args])
+                        insArgs = list(args)
+                        if key in marshalTrackFns:
+                                mtBody += "    s.mpMarshal->mClient." + key + "(" + ", ".join(args) + ");\n"
+                        if key in marshalCopyFns:
+                                ptr, size = marshalCopyFns[key]
+                                mtBody += "    const GLvoid* " + ptr + "Copy = " + ptr + ";\n"
+                                mtBody += "    GLubyte* mybuffer = " + ptr + " ? s.mpMarshal->RequestData(" + " + ".join(szArgs) + ", " + ptr + ", " + size + ", " + ptr + "Copy) : s.mpMarshal->Request(" + " + ".join(szArgs) + ");\n"
+                                mtBody += "    if (!mybuffer)\n"
+                                mtBody += "    {\n"
+                                mtBody += "".join(["    " + line + "\n" for line in syncBody.splitlines()])
+                                mtBody += "    }\n"
+                                insArgs[args.index(ptr)] = "(" + get_intern_param_type(fparams[args.index(ptr)]) + ")" + ptr + "Copy"
+                        else:
+                                mtBody += "    GLubyte* mybuffer = s.mpMarshal->Request(" + " + ".join(szArgs) + ");\n"
+                        mtBody += "    insertCommand(" + ", ".join(["OGL::CMD_" + key.upper(), "mybuffer"] + insArgs) + ");\n"
+                        if key in marshalFlushFns:
+                                mtBody += "    s.mpMarshal->Flush();\n"
+                mtBody += "}"
+                glMT.append(fstr.format("glmt") + mtBody)
+
+        of = "%s/gldp.inl" % output_dir
+        with open(of, "w") as fn:
+                print(autogenmsg, file=fn)
+                print("", file=fn)
+                print("\n\n".join(glDP), file=fn)
+                print("", file=fn)
+                print("\n\n".join(glMT), file=fn)
+                gen_files.append(of)
 
-                glH.append(fstr.format(";"))
-                glCpp.append(fstr.format(glBody))
+        of = "%s/executemt.inl" % output_dir
+        with open(of, "w") as fn:
+                print(autogenmsg, file=fn)
+                print("\n".join(glMTs), file=fn)
+                gen_files.append(of)
 
         of = "%s/gl.inl" % output_dir
         with open(of, "w") as fn:
@@ -1829,6 +2013,7 @@ def list_generated_files(output_dir):
                 '%s/executedl.inl' % output_dir,
                 '%s/generatedl.inl' % output_dir,
                 '%s/optimizedl.inl' % output_dir,
+                '%s/dlcmdsize.inl' % output_dir,
                 '%s/glfz.hpp' % output_dir,
                 '%s/glfz.inl' % output_dir,
                 '%s/glsx.hpp' % output_dir,
@@ -1837,6 +2022,8 @@ def list_generated_files(output_dir):
                 '%s/glcl.cpp' % output_dir,
                 '%s/glcl.hpp' % output_dir,
                 '%s/gl.inl' % output_dir,
+                '%s/gldp.inl' % output_dir,
+                '%s/executemt.inl' % output_dir,
                 '%s/stubs.cpp' % output_dir,
         ]
         if sys.platform == 'win32':
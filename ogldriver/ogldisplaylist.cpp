@@ -19,9 +19,146 @@
 #include "ogldisplaylist.hpp"
 #include "rdtsc.h"
 
+#include <unordered_map>
+
 namespace OGL
 {
 
+// Serialized size of each command, including the COMMAND token.
+static const GLuint sCommandSize[CMD_NUM_COMMANDS] =
+    {
+      sizeof(COMMAND), // CMD_ENDOFCHUNK
+      sizeof(COMMAND), // CMD_ENDOFSTREAM
+#include "dlcmdsize.inl"
+    };
+
+// How CompileDL treats a command when looking for redundant state.
+enum DL_COMMAND_CLASS
+{
+    DL_BARRIER,       // may read or modify any state, forget everything known
+    DL_NEUTRAL,       // reads state but leaves the tracked setter state alone
+    DL_NEUTRAL_COLOR, // as DL_NEUTRAL, but may change material through GL_COLOR_MATERIAL
+    DL_SETTER,        // overwrites the state named by its key with its arguments
+};
+
+struct DLCommandInfo
+{
+    DL_COMMAND_CLASS cls;
+    COMMAND group;      // setters sharing state share a group, e.g. glEnable/glDisable
+    GLuint numKeyArgs;  // leading GLenum arguments that name the state being set
+    bool faceKey;       // first key argument is GL_FRONT/GL_BACK/GL_FRONT_AND_BACK
+};
+
+static DLCommandInfo ClassifyCommand(COMMAND cmd)
+{
+    DLCommandInfo info = { DL_BARRIER, cmd, 0, false };
+    switch (cmd)
+    {
+    case CMD_BEGIN:
+    case CMD_CLEAR:
+    case CMD_DRAWINDEXEDSWR:
+    case CMD_DRAWSWR:
+    case CMD_END:
+    case CMD_LOCKARRAYSEXT:
+    case CMD_NORMAL:
+    case CMD_NUMVERTICESSWR:
+    case CMD_RESETMAINVBSWR:
+    case CMD_SETCLEARMASKSWR:
+    case CMD_SETLOCKEDARRAYSSWR:
+    case CMD_SETTOPOLOGYSWR:
+    case CMD_SETUPDRAWSWR:
+    case CMD_SUBSTITUTEVBSWR:
+    case CMD_TEXCOORD:
+    case CMD_UNLOCKARRAYSEXT:
+    case CMD_VERTEX:
+        info.cls = DL_NEUTRAL;
+        break;
+
+    case CMD_ADDVERTEXSWR:
+    case CMD_ARRAYELEMENT:
+    case CMD_COLOR:
+    case CMD_DRAWARRAYS:
+    case CMD_DRAWELEMENTS:
+    case CMD_DRAWRANGEELEMENTS:
+        info.cls = DL_NEUTRAL_COLOR;
+        break;
+
+    case CMD_ALPHAFUNC:
+    case CMD_BLENDFUNC:
+    case CMD_CLEARCOLOR:
+    case CMD_CLEARDEPTH:
+    case CMD_COLORMASK:
+    case CMD_CULLFACE:
+    case CMD_DEPTHFUNC:
+    case CMD_DEPTHMASK:
+    case CMD_DEPTHRANGE:
+    case CMD_FRONTFACE:
+    case CMD_SCISSOR:
+    case CMD_SHADEMODEL:
+    case CMD_VIEWPORT:
+        info.cls = DL_SETTER;
+        break;
+
+    case CMD_BINDTEXTURE:
+    case CMD_HINT:
+    case CMD_LIGHTMODEL:
+        info.cls = DL_SETTER;
+        info.numKeyArgs = 1;
+        break;
+
+    case CMD_ENABLE:
+    case CMD_DISABLE:
+    case CMD_ENABLECLIENTSTATE:
+    case CMD_DISABLECLIENTSTATE:
+        info.cls = DL_SETTER;
+        info.group = CMD_ENABLE;
+        info.numKeyArgs = 1;
+        break;
+
+    case CMD_FOGF:
+    case CMD_FOGI:
+        info.cls = DL_SETTER;
+        info.group = CMD_FOGF;
+        info.numKeyArgs = 1;
+        break;
+
+    case CMD_LIGHT:
+    case CMD_TEXENV:
+        info.cls = DL_SETTER;
+        info.numKeyArgs = 2;
+        break;
+
+    case CMD_POLYGONMODE:
+        info.cls = DL_SETTER;
+        info.numKeyArgs = 1;
+        info.faceKey = true;
+        break;
+
+    case CMD_MATERIAL:
+        info.cls = DL_SETTER;
+        info.numKeyArgs = 2;
+        info.faceKey = true;
+        break;
+
+    default:
+        break;
+    }
+    return info;
+}
+
+static UINT64 MakeStateKey(COMMAND group, GLuint arg0, GLuint arg1)
+{
+    return ((UINT64)group << 48) | ((UINT64)(arg0 & 0xFFFFFF) << 24) | (UINT64)(arg1 & 0xFFFFFF);
+}
+
+static UINT64 GetStateKey(DLCommandInfo const &info, GLubyte const *pCmd)
+{
+    GLuint const *pArgs = (GLuint const *)(pCmd + sizeof(COMMAND));
+    return MakeStateKey(info.group,
+                        (info.numKeyArgs > 0) ? pArgs[0] : 0,
+                        (info.numKeyArgs > 1) ? pArgs[1] : 0);
+}
+
 DisplayList::DisplayList()
     : mHasDrawArray(0)
 {
@@ -49,24 +186,40 @@ GLuint DisplayList::AddVB()
 // true - use unoptimized display list
 bool PickDLPredicate(State &s, DisplayList const &in)
 {
-    // XXX: this is a terrible predicate. We should be observing the
-    // state of the GL and the DL and determining what to do. Not
-    // hacks based on size.
-    // don't optimize display lists with glDrawArrays
-    if (in.mHasDrawArray)
-    {
-        return true;
-    }
-
-    // don't optimize 'small' display lists
-    // FIXME: std::list::size() is freakin slow, especially on big display lists.
-    // replace with vector or something else
-    if (in.mChunks.size() < 16)
+    // Only lists that draw are worth optimizing, and only if the optimizer
+    // understands everything they do.
+    bool draws = false;
+    for (auto itr = in.mChunks.begin(), end = in.mChunks.end(); itr != end; ++itr)
     {
-        return true;
+        GLubyte const *pCursor = &*itr->begin();
+        COMMAND cmd;
+        while ((cmd = (COMMAND)((GLuint *)pCursor)[0]) != CMD_ENDOFCHUNK)
+        {
+            switch (cmd)
+            {
+            case CMD_BEGIN:
+            case CMD_DRAWARRAYS:
+                draws = true;
+                break;
+            case CMD_CALLLIST:
+            case CMD_CALLLISTS:
+            case CMD_COPYTEXSUBIMAGE2D:
+            case CMD_DRAWELEMENTS:
+            case CMD_DRAWRANGEELEMENTS:
+            case CMD_READPIXELS:
+                return true;
+            default:
+                if (cmd >= CMD_NUM_COMMANDS)
+                {
+                    return true;
+                }
+                break;
+            }
+            pCursor += sCommandSize[cmd];
+        }
     }
 
-    return false;
+    return !draws;
 }
 
 bool ExecuteDL(State &s, GLuint list)
@@ -78,6 +231,21 @@ bool ExecuteDL(State &s, GLuint list)
     s.mExecutingDL.push(list);
 
     DisplayList const &exec = *DisplayLists()[list];
+    if (!exec.mStream.empty())
+    {
+        // Compiled list, one flat stream ending in CMD_ENDOFSTREAM.
+        GLubyte const *pCursor = &exec.mStream[0];
+        for (;;)
+        {
+            switch (((GLuint *)pCursor)[0])
+            {
+#include "executedl.inl"
+            default:
+                goto exit;
+            }
+        }
+    }
+
     for (auto itr = exec.mChunks.begin(), end = exec.mChunks.end(); itr != end; ++itr)
     {
         GLubyte const *pCursor = &*itr->begin();
@@ -112,12 +280,17 @@ bool OptimizeDL(State &s, DisplayList &in)
 
     RDTSC_START(APIOptimizeDisplayList);
 
-    // Save off saveable state
-    SaveableState state = static_cast<OGL::SaveableState>(s);
+    // Save off saveable state and the matrix stacks; the list is replayed
+    // through the live state but must not leave any of it behind.
+    SaveableState state = static_cast<OGL::SaveableState &>(s);
+    std::vector<SWRL::FixedStack<SWRL::m44f, MAX_MATRIX_STACK_DEPTH> > matrices(&s.mMatrices[0], &s.mMatrices[0] + NUM_MATRIX_TYPES);
+    bool noExecute = s.mNoExecute;
+    s.mNoExecute = true;
 
     GLuint tempDL = glimGenLists(s, 1);
     DisplayLists()[tempDL] = new OGL::DisplayList();
-    OptState os = { &s, DisplayLists()[tempDL] };
+    GeometryBatch batch;
+    OptState os = { &s, DisplayLists()[tempDL], &in, &batch };
 
     s.mExecutingDL.push(tempDL);
 
@@ -130,12 +303,31 @@ bool OptimizeDL(State &s, DisplayList &in)
             COMMAND cmd = (COMMAND)((GLuint *)pCursor)[0];
             switch (cmd)
             {
+            case CMD_ADDVERTEXSWR:
+            case CMD_ARRAYELEMENT:
+            case CMD_BEGIN:
+            case CMD_COLOR:
+            case CMD_END:
+            case CMD_NORMAL:
+            case CMD_NUMVERTICESSWR:
+            case CMD_TEXCOORD:
+            case CMD_VERTEX:
+                break;
+            default:
+                // Anything else may change state the batched geometry is drawn with.
+                FlushGeometryBatch(os);
+                break;
+            }
+
+            switch (cmd)
+            {
 #include "optimizedl.inl"
             default:
                 goto exit;
             }
         }
     }
+    FlushGeometryBatch(os);
 
     // Upon successfully creating optimized list, swap contents with original list.
     // XXX Move this into a DisplayList method "swapList", or "copyList" or something.
@@ -149,6 +341,8 @@ bool OptimizeDL(State &s, DisplayList &in)
         in.mHasDrawArray = tempList.mHasDrawArray;
         in.mChunks.swap(tempList.mChunks);
         in.mVertexBuffers.swap(tempList.mVertexBuffers);
+        // Array draws still reference the VBs recorded with the original list.
+        tempList.mVertexBuffersStore.splice(tempList.mVertexBuffersStore.end(), in.mVertexBuffersStore);
         in.mVertexBuffersStore.swap(tempList.mVertexBuffersStore);
     }
 
@@ -158,9 +352,169 @@ exit:
 
     s.mExecutingDL.pop();
     // restore state
-    static_cast<OGL::SaveableState>(s) = state;
+    static_cast<OGL::SaveableState &>(s) = state;
+    std::copy(matrices.begin(), matrices.end(), &s.mMatrices[0]);
+    s.mNoExecute = noExecute;
+    MarkDirty(s, DIRTY_ALL);
+    s.mCurrentAttrCache.mChanged.mask = 0xFFFFFFFF;
 
     RDTSC_STOP(APIOptimizeDisplayList, 1, 0);
     return true;
 }
+
+struct DLPendingSetter
+{
+    UINT64 key;
+    DLCommandInfo info;
+    GLubyte const *pCmd;
+    GLuint size;
+};
+
+// Append the pending setters to the stream, skipping the ones that would set
+// a value the stream has already set with nothing but neutral commands since.
+static void FlushPendingSetters(std::vector<DLPendingSetter> &pending,
+                                std::unordered_map<UINT64, size_t> &known,
+                                std::vector<GLubyte> &stream)
+{
+    static const GLuint faces[] = { GL_FRONT, GL_BACK, GL_FRONT_AND_BACK };
+
+    for (auto itr = pending.begin(), end = pending.end(); itr != end; ++itr)
+    {
+        auto knownItr = known.find(itr->key);
+        if (knownItr != known.end() &&
+            memcmp(&stream[knownItr->second], itr->pCmd, itr->size) == 0)
+        {
+            continue;
+        }
+
+        // Setting one face invalidates what we know about the faces it overlaps,
+        // and GL_AMBIENT_AND_DIFFUSE overlaps GL_AMBIENT and GL_DIFFUSE.
+        if (itr->info.faceKey)
+        {
+            GLuint const *pArgs = (GLuint const *)(itr->pCmd + sizeof(COMMAND));
+            GLuint pname = (itr->info.numKeyArgs > 1) ? pArgs[1] : 0;
+
+            GLuint overlaps[2];
+            GLuint numOverlaps = 0;
+            if (itr->info.group == CMD_MATERIAL)
+            {
+                if (pname == GL_AMBIENT_AND_DIFFUSE)
+                {
+                    overlaps[numOverlaps++] = GL_AMBIENT;
+                    overlaps[numOverlaps++] = GL_DIFFUSE;
+                }
+                else if ((pname == GL_AMBIENT) || (pname == GL_DIFFUSE))
+                {
+                    overlaps[numOverlaps++] = GL_AMBIENT_AND_DIFFUSE;
+                }
+            }
+
+            for (GLuint f = 0; f < sizeof(faces) / sizeof(faces[0]); ++f)
+            {
+                if (faces[f] != pArgs[0])
+                {
+                    known.erase(MakeStateKey(itr->info.group, faces[f], pname));
+                }
+                for (GLuint o = 0; o < numOverlaps; ++o)
+                {
+                    known.erase(MakeStateKey(itr->info.group, faces[f], overlaps[o]));
+                }
+            }
+        }
+
+        known[itr->key] = stream.size();
+        stream.insert(stream.end(), itr->pCmd, itr->pCmd + itr->size);
+    }
+    pending.clear();
+}
+
+// Flatten the chunked list into a single contiguous stream for replay. Runs of
+// consecutive state setters collapse to the last value written per state, and
+// setters that repeat a value already in effect from earlier in the list are
+// dropped.
+void CompileDL(DisplayList &in)
+{
+    RDTSC_START(APICompileDisplayList);
+
+    std::vector<GLubyte> stream;
+    std::vector<DLPendingSetter> pending;
+    std::unordered_map<UINT64, size_t> known;
+    bool knownMaterial = false;
+
+    for (auto itr = in.mChunks.begin(), end = in.mChunks.end(); itr != end; ++itr)
+    {
+        GLubyte const *pCursor = &*itr->begin();
+        COMMAND cmd;
+        while ((cmd = (COMMAND)((GLuint *)pCursor)[0]) != CMD_ENDOFCHUNK)
+        {
+            if (cmd >= CMD_NUM_COMMANDS)
+            {
+                // Unknown command, leave the list uncompiled.
+                RDTSC_STOP(APICompileDisplayList, 1, 0);
+                return;
+            }
+
+            GLuint size = sCommandSize[cmd];
+            DLCommandInfo info = ClassifyCommand(cmd);
+
+            if (info.cls == DL_SETTER)
+            {
+                // Later writes to the same state within a run replace earlier ones.
+                DLPendingSetter setter = { GetStateKey(info, pCursor), info, pCursor, size };
+                for (auto p = pending.begin(); p != pending.end(); ++p)
+                {
+                    if (p->key == setter.key)
+                    {
+                        pending.erase(p);
+                        break;
+                    }
+                }
+                pending.push_back(setter);
+                knownMaterial |= (info.group == CMD_MATERIAL);
+            }
+            else
+            {
+                FlushPendingSetters(pending, known, stream);
+
+                if (info.cls == DL_BARRIER)
+                {
+                    known.clear();
+                    knownMaterial = false;
+                }
+                else if (info.cls == DL_NEUTRAL_COLOR && knownMaterial)
+                {
+                    for (auto k = known.begin(); k != known.end();)
+                    {
+                        if ((COMMAND)(k->first >> 48) == CMD_MATERIAL)
+                        {
+                            k = known.erase(k);
+                        }
+                        else
+                        {
+                            ++k;
+                        }
+                    }
+                    knownMaterial = false;
+                }
+
+                stream.insert(stream.end(), pCursor, pCursor + size);
+            }
+
+            pCursor += size;
+        }
+    }
+    FlushPendingSetters(pending, known, stream);
+
+    COMMAND endOfStream = CMD_ENDOFSTREAM;
+    stream.insert(stream.end(), (GLubyte const *)&endOfStream, (GLubyte const *)&endOfStream + sizeof(COMMAND));
+
+    in.mStream.swap(stream);
+
+    // The chunks are only needed while recording.
+    std::list<DLChunk>().swap(in.mChunks);
+    in.mCursor = DLChunk::iterator();
+    in.mEnd = DLChunk::iterator();
+
+    RDTSC_STOP(APICompileDisplayList, 1, 0);
+}
 }
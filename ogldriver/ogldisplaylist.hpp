@@ -17,6 +17,7 @@
 
 #include "oglstate.hpp"
 #include <list>
+#include <unordered_map>
 #include <vector>
 
 namespace OGL
@@ -32,6 +33,11 @@ enum COMMAND
 #include "glcmds.inl"
 
     CMD_NUM_COMMANDS,
+
+    // Only found in marshal batches, never in display lists.
+    CMD_MARSHALDATA = CMD_NUM_COMMANDS, // client memory copied for the next command
+    CMD_MARSHALARRAYS,                  // client arrays copied for the next draw
+    CMD_MARSHALRESTORE,                 // restores the arrays after the draw
 };
 
 typedef std::array<GLubyte, 6 * 4 * 1024> DLChunk;
@@ -65,21 +71,49 @@ struct DisplayList
     std::list<VertexBuffer> mVertexBuffersStore;
     GLuint mHasDrawArray;
 
+    // Flat command stream built by CompileDL at glEndList, terminated by
+    // CMD_ENDOFSTREAM. When present it replaces mChunks for execution.
+    std::vector<GLubyte> mStream;
+
     DisplayList();
     GLubyte *RequestBuffer(GLsizei length);
     void RequestBufferAlloc();
     GLuint AddVB();
 };
 
+// Geometry collected by OptimizeDL from consecutive glBegin/glEnd pairs that
+// draw with the same state. Vertices are welded into one VB and the
+// primitives are converted to an indexed list drawn with DrawIndexedSWR.
+struct GeometryBatch
+{
+    GeometryBatch();
+
+    GLint mVB;             // VB in the optimized list, -1 when no batch is open
+    GLenum mTopology;      // GL_TRIANGLES or GL_LINES
+    bool mBaking;          // the open glBegin/glEnd is being added to the batch
+    GLenum mPrimTopology;  // topology of the open glBegin/glEnd
+    VertexActiveAttributes mAttributes;
+    VertexAttributeFormats mAttrFormats;
+    GLuint mCapacity;      // vertices the VB buffers can hold
+    GLuint mWidths[NUM_ATTRIBUTES]; // components per vertex of each attribute
+    std::vector<GLuint> mIndices;
+    std::vector<GLuint> mPrimIndices;
+    std::unordered_multimap<GLuint, GLuint> mWeld; // vertex hash -> VB index
+};
+
 struct OptState
 {
     State *mpState;
     DisplayList *mpDL;
+    DisplayList *mpSrcDL;   // list being optimized, only set by OptimizeDL
+    GeometryBatch *mpBatch; // only set by OptimizeDL
 };
 
 bool ExecuteDL(State &, GLuint list);
 bool OptimizeDL(State &, DisplayList &in);
+void CompileDL(DisplayList &in);
 void RecordState(OptState &s, DisplayList &DL);
+void FlushGeometryBatch(OptState &os);
 
 inline GLubyte *DisplayList::RequestBuffer(GLsizei length)
 {
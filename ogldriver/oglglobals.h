@@ -39,8 +39,13 @@ enum
     NUM_SIDE_ATTRIBUTES = 1, // 1 normalized norm
     MAX_DL_STACK_DEPTH = 64,
     MAX_MATRIX_STACK_DEPTH = 32,
+    MAX_NAME_STACK_DEPTH = 64,
+    MAX_TEXTURE_LEVELS = 13, // 4096 (GL_MAX_TEXTURE_SIZE) down to 1
     VERTEX_BUFFER_COUNT = 1024 * 6,
     INDEX_BUFFER_COUNT = 1024 * 6,
+    STREAM_RING_SIZE = 16 * 1024 * 1024, // bytes of client array/index data in flight
+    MARSHAL_BATCH_SIZE = 64 * 1024,        // bytes of marshalled commands per batch
+    MARSHAL_NUM_BATCHES = 8,
     NUM_LIGHTS = 8,
     NUM_COLORS = 2,
     NUM_TEXCOORDS = 8,
@@ -19,10 +19,13 @@
 #include "ogldisplaylist.hpp"
 #include "glcl.hpp"
 #include "glim.hpp"
+#include "serdeser.hpp"
 #include "oglglobals.h"
 #include "gldd.h"
+#include "rdtsc.h"
 
 #include <climits>
+#include <cstdlib>
 #include <cmath>
 #include <cstdio>
 #include <limits>
@@ -34,6 +37,8 @@
 #include <unistd.h>
 #endif
 
+static OGL::State *gpOglState = 0;
+
 namespace OGL
 {
 
@@ -55,6 +60,7 @@ VertexBuffer::VertexBuffer()
     mhIndexBuffer = 0;
     mpIndexBuffer = 0;
     mNumIndices = 0;
+    mhLineIndexBuffer = 0;
 
     mhNIB8 = 0;
     mpNIB8 = 0;
@@ -85,6 +91,12 @@ VertexBuffer::~VertexBuffer()
         mhIndexBuffer = 0;
     }
 
+    if (mhLineIndexBuffer)
+    {
+        GetDDProcTable().pfnDestroyBuffer(GetDDHandle(), mhLineIndexBuffer);
+        mhLineIndexBuffer = 0;
+    }
+
     if (mhNIB8)
     {
         GetDDProcTable().pfnDestroyBuffer(GetDDHandle(), mhNIB8);
@@ -115,6 +127,467 @@ void VertexBuffer::getBuffer(int index, int size)
     return;
 }
 
+void StreamRing::Initialize(GLuint size)
+{
+    mpBase = NULL;
+    mSize = size;
+    mHead = 0;
+    mGeneration = 0;
+    mLive.clear();
+}
+
+void StreamRing::Destroy()
+{
+    while (!mLive.empty())
+    {
+        Retire();
+    }
+
+    if (mpBase)
+    {
+        _aligned_free(mpBase);
+        mpBase = NULL;
+    }
+}
+
+void StreamRing::Retire()
+{
+    GetDDProcTable().pfnDestroyBuffer(GetDDHandle(), mLive.front().hBuffer);
+    mLive.pop_front();
+}
+
+DDHANDLE StreamRing::Alloc(GLuint size, GLvoid *&pData)
+{
+    size = (size + 63) & ~63;
+    if (size > mSize)
+    {
+        return NULL;
+    }
+
+    if (mpBase == NULL)
+    {
+        mpBase = (GLubyte *)_aligned_malloc(mSize, 64);
+    }
+
+    if (mHead + size > mSize)
+    {
+        // Everything between the head and the end is from the previous lap.
+        while (!mLive.empty() && (mLive.front().offset >= mHead))
+        {
+            if (mLive.front().generation == mGeneration)
+            {
+                return NULL;
+            }
+            Retire();
+        }
+        mHead = 0;
+    }
+
+    // Reclaim the oldest ranges the new one overlaps.
+    while (!mLive.empty() && (mLive.front().offset >= mHead) && (mLive.front().offset < mHead + size))
+    {
+        if (mLive.front().generation == mGeneration)
+        {
+            return NULL;
+        }
+        Retire();
+    }
+
+    pData = mpBase + mHead;
+    Range range = { mHead, size, GetDDProcTable().pfnCreateBuffer(GetDDHandle(), 0, pData), mGeneration };
+    mLive.push_back(range);
+    mHead += size;
+
+    return range.hBuffer;
+}
+
+void ExecuteMarshal(State &s, GLubyte const *pCursor);
+GLuint _glstEnumTypeToSize(GLenum eType);
+
+void MarshalClientState::Initialize()
+{
+    memset(&mVertex, 0, sizeof(mVertex));
+    memset(mArrays, 0, sizeof(mArrays));
+    mEnabled = 0;
+    mLocked = 0;
+    mClientActiveTexture = GL_TEXTURE0;
+    mArrayVBO = 0;
+    mElementVBO = 0;
+    mListMode = GL_NONE;
+}
+
+GLuint MarshalClientState::ElementSize(Array const &array)
+{
+    return array.mSize * _glstEnumTypeToSize(array.mType);
+}
+
+GLuint MarshalClientState::ClientArrays() const
+{
+    GLuint mask = 0;
+    for (GLuint i = 0; i <= NUM_ATTRIBUTES; ++i)
+    {
+        Array const &array = i ? mArrays[i - 1] : mVertex;
+        if ((mEnabled & (1 << i)) && !array.mVBO && array.mpPointer)
+        {
+            mask |= 1 << i;
+        }
+    }
+    return mask & ~mLocked;
+}
+
+// Bit in mEnabled of an array cap, 0 if cap isn't an array.
+static GLuint _MarshalArrayBit(MarshalClientState const &c, GLenum cap)
+{
+    switch (cap)
+    {
+    case GL_VERTEX_ARRAY:
+        return 1;
+    case GL_NORMAL_ARRAY:
+        return 1 << 1;
+    case GL_COLOR_ARRAY:
+        return 1 << 3;
+#ifdef GL_VERSION_1_4
+    case GL_SECONDARY_COLOR_ARRAY:
+        return 1 << 4;
+#endif
+    case GL_TEXTURE_COORD_ARRAY:
+        return 1 << (5 + c.mClientActiveTexture - GL_TEXTURE0);
+    default:
+        return 0;
+    }
+}
+
+void MarshalClientState::ClientActiveTexture(GLenum texture)
+{
+    mClientActiveTexture = texture;
+}
+
+void MarshalClientState::EnableClientState(GLenum cap)
+{
+    mEnabled |= _MarshalArrayBit(*this, cap);
+}
+
+void MarshalClientState::DisableClientState(GLenum cap)
+{
+    mEnabled &= ~_MarshalArrayBit(*this, cap);
+}
+
+void MarshalClientState::Enable(GLenum cap)
+{
+    if (mListMode != GL_COMPILE)
+    {
+        EnableClientState(cap);
+    }
+}
+
+void MarshalClientState::Disable(GLenum cap)
+{
+    if (mListMode != GL_COMPILE)
+    {
+        DisableClientState(cap);
+    }
+}
+
+static void _MarshalSetArray(MarshalClientState &c, MarshalClientState::Array &array, GLint size, GLenum type, GLsizei stride, const GLvoid *pointer)
+{
+    array.mSize = size;
+    array.mType = type;
+    array.mStride = stride == 0 ? size * _glstEnumTypeToSize(type) : stride;
+    array.mpPointer = pointer;
+    array.mVBO = c.mArrayVBO != 0;
+}
+
+void MarshalClientState::VertexPointer(GLint size, GLenum type, GLsizei stride, const GLvoid *pointer)
+{
+    _MarshalSetArray(*this, mVertex, size, type, stride, pointer);
+}
+
+void MarshalClientState::NormalPointer(GLenum type, GLsizei stride, const GLvoid *pointer)
+{
+    _MarshalSetArray(*this, mArrays[0], 3, type, stride, pointer);
+}
+
+void MarshalClientState::ColorPointer(GLint size, GLenum type, GLsizei stride, const GLvoid *pointer)
+{
+    _MarshalSetArray(*this, mArrays[2], size, type, stride, pointer);
+}
+
+void MarshalClientState::TexCoordPointer(GLint size, GLenum type, GLsizei stride, const GLvoid *pointer)
+{
+    _MarshalSetArray(*this, mArrays[4 + mClientActiveTexture - GL_TEXTURE0], size, type, stride, pointer);
+}
+
+void MarshalClientState::BindBuffer(GLenum target, GLuint buffer)
+{
+    BindBufferARB(target, buffer);
+}
+
+void MarshalClientState::BindBufferARB(GLenum target, GLuint buffer)
+{
+    if (mListMode != GL_NONE)
+    {
+        return;
+    }
+
+    switch (target)
+    {
+    case GL_ARRAY_BUFFER_ARB:
+        mArrayVBO = buffer;
+        break;
+    case GL_ELEMENT_ARRAY_BUFFER_ARB:
+        mElementVBO = buffer;
+        break;
+    }
+}
+
+void MarshalClientState::LockArraysEXT(GLint first, GLsizei count)
+{
+    if (mListMode != GL_COMPILE)
+    {
+        mLocked = 0;
+        mLocked = ClientArrays();
+    }
+}
+
+void MarshalClientState::UnlockArraysEXT()
+{
+    if (mListMode != GL_COMPILE)
+    {
+        mLocked = 0;
+    }
+}
+
+void MarshalClientState::NewList(GLuint list, GLenum mode)
+{
+    if (mListMode == GL_NONE)
+    {
+        mListMode = mode;
+    }
+}
+
+void MarshalClientState::EndList()
+{
+    mListMode = GL_NONE;
+}
+
+void Marshal::Initialize(State &s)
+{
+    mpState = &s;
+    mClient.Initialize();
+    mpBatches = new Batch[MARSHAL_NUM_BATCHES];
+    mpBatches[0].mUsed = 0;
+    mSubmitted = 0;
+    mExecuted = 0;
+    mQuit = false;
+    mSavedArrays = 0;
+    mThread = std::thread(ThreadMain, this);
+}
+
+void Marshal::Destroy()
+{
+    Sync();
+
+    {
+        std::unique_lock<std::mutex> lock(mLock);
+        mQuit = true;
+    }
+    mWork.notify_one();
+    mThread.join();
+
+    delete[] mpBatches;
+    mpBatches = NULL;
+}
+
+GLubyte *Marshal::Request(GLuint length)
+{
+    Batch *pBatch = &mpBatches[mSubmitted % MARSHAL_NUM_BATCHES];
+
+    // Leave room for the CMD_ENDOFCHUNK that terminates the batch.
+    if (pBatch->mUsed + length + sizeof(COMMAND) > MARSHAL_BATCH_SIZE)
+    {
+        Submit();
+        pBatch = &mpBatches[mSubmitted % MARSHAL_NUM_BATCHES];
+    }
+
+    GLubyte *pCmd = &pBatch->mData[pBatch->mUsed];
+    pBatch->mUsed += length;
+    return pCmd;
+}
+
+GLubyte *Marshal::RequestData(GLuint cmdLength, const GLvoid *pData, size_t length, const GLvoid *&pCopy)
+{
+    // CMD_MARSHALDATA, the bytes to skip, then the copy at the same 16 byte
+    // alignment as the client data
+    GLuint header = 2 * sizeof(GLuint);
+    if ((length > MARSHAL_BATCH_SIZE) || (header + length + 18 + cmdLength + sizeof(COMMAND) > MARSHAL_BATCH_SIZE))
+    {
+        return NULL;
+    }
+    GLuint skip = ((GLuint)length + 15 + 3) & ~3;
+
+    GLubyte *pCmd = Request(header + skip + cmdLength);
+    ((GLuint *)pCmd)[0] = CMD_MARSHALDATA;
+    ((GLuint *)pCmd)[1] = skip;
+
+    GLubyte *pDst = pCmd + header;
+    pDst += ((uintptr_t)pData - (uintptr_t)pDst) & 15;
+    memcpy(pDst, pData, length);
+    pCopy = pDst;
+
+    return pCmd + header + skip;
+}
+
+// Bytes of client memory the marshalled calls read; SIZE_MAX when the
+// arguments are invalid, which syncs and leaves the error to glim.
+static size_t MarshalCallListsSize(GLsizei n, GLenum type)
+{
+    switch (type)
+    {
+    case GL_BYTE:
+    case GL_UNSIGNED_BYTE:
+        return n;
+    case GL_SHORT:
+    case GL_UNSIGNED_SHORT:
+        return n * sizeof(GLshort);
+    case GL_INT:
+    case GL_UNSIGNED_INT:
+    case GL_FLOAT:
+        return n * sizeof(GLint);
+    default:
+        return SIZE_MAX;
+    }
+}
+
+static size_t MarshalFogSize(GLenum pname)
+{
+    return (pname == GL_FOG_COLOR ? 4 : 1) * sizeof(GLfloat);
+}
+
+static size_t MarshalPixelsSize(GLsizei width, GLsizei height, GLenum format, GLenum type)
+{
+    if ((width < 0) || (height < 0))
+    {
+        return SIZE_MAX;
+    }
+
+    size_t components;
+    switch (format)
+    {
+    case GL_RGBA:
+    case GL_BGRA:
+        components = 4;
+        break;
+    case GL_RGB:
+    case GL_BGR:
+        components = 3;
+        break;
+    case GL_LUMINANCE_ALPHA:
+        components = 2;
+        break;
+    case GL_ALPHA:
+    case GL_LUMINANCE:
+    case GL_DEPTH_COMPONENT:
+        components = 1;
+        break;
+    default:
+        return SIZE_MAX;
+    }
+
+    // Unpack state is ignored; rows are tightly packed.
+    size_t bpp;
+    switch (type)
+    {
+    case GL_UNSIGNED_BYTE:
+        bpp = components;
+        break;
+    case GL_FLOAT:
+        bpp = components * sizeof(GLfloat);
+        break;
+    case GL_UNSIGNED_SHORT_5_6_5:
+        bpp = sizeof(GLushort);
+        break;
+    case GL_UNSIGNED_INT_8_8_8_8_REV:
+        bpp = sizeof(GLuint);
+        break;
+    default:
+        return SIZE_MAX;
+    }
+
+    return (size_t)width * height * bpp;
+}
+
+void Marshal::Submit()
+{
+    Batch &batch = mpBatches[mSubmitted % MARSHAL_NUM_BATCHES];
+    *(GLuint *)&batch.mData[batch.mUsed] = CMD_ENDOFCHUNK;
+
+    {
+        std::unique_lock<std::mutex> lock(mLock);
+        ++mSubmitted;
+        mWork.notify_one();
+
+        // The next batch may still be queued from the previous lap.
+        while (mSubmitted - mExecuted >= MARSHAL_NUM_BATCHES)
+        {
+            mDone.wait(lock);
+        }
+    }
+
+    mpBatches[mSubmitted % MARSHAL_NUM_BATCHES].mUsed = 0;
+}
+
+void Marshal::Flush()
+{
+    if (mpBatches[mSubmitted % MARSHAL_NUM_BATCHES].mUsed)
+    {
+        Submit();
+    }
+}
+
+void Marshal::Sync()
+{
+    Flush();
+
+    std::unique_lock<std::mutex> lock(mLock);
+    while (mExecuted != mSubmitted)
+    {
+        mDone.wait(lock);
+    }
+}
+
+void Marshal::ThreadMain(Marshal *pMarshal)
+{
+    // The driver thread makes the API calls and shares the API thread's
+    // buckets; the application thread only calls in after a Sync().
+    RDTSC_INIT(0);
+
+    Marshal &m = *pMarshal;
+    for (;;)
+    {
+        GLuint batch;
+        {
+            std::unique_lock<std::mutex> lock(m.mLock);
+            while (!m.mQuit && (m.mExecuted == m.mSubmitted))
+            {
+                m.mWork.wait(lock);
+            }
+            if (m.mExecuted == m.mSubmitted)
+            {
+                return;
+            }
+            batch = m.mExecuted % MARSHAL_NUM_BATCHES;
+        }
+
+        ExecuteMarshal(*m.mpState, m.mpBatches[batch].mData);
+
+        {
+            std::unique_lock<std::mutex> lock(m.mLock);
+            ++m.mExecuted;
+        }
+        m.mDone.notify_all();
+    }
+}
+
 static OSALIGNSIMD(SWRL::m44f) sIdentity = SWRL::M44Id<GLfloat>();
 
 void DetermineMatrixClasses(SWRL::m44f const &m44, MatrixClass &cls)
@@ -172,20 +645,39 @@ void _CacheState(T *t, _simd_crcint &CRC)
     }
 }
 
-void CacheState(SaveableState &state, _simd_crcint seed, _simd_crcint &L0, _simd_crcint &L1, _simd_crcint &L2)
+// Rehashes the cacheable levels marked dirty; clean levels keep their CRC.
+void CacheStateGroups(SaveableState &state, GLuint dirty, _simd_crcint (&groupCRCs)[NUM_CACHE_LEVELS])
+{
+    if (dirty & DIRTY_L0)
+    {
+        groupCRCs[CACHE_L0] = 0;
+        _CacheState(static_cast<CacheableL0 *>(&state), groupCRCs[CACHE_L0]);
+    }
+    if (dirty & DIRTY_L1)
+    {
+        groupCRCs[CACHE_L1] = 0;
+        _CacheState(static_cast<CacheableL1 *>(&state), groupCRCs[CACHE_L1]);
+    }
+    if (dirty & DIRTY_L2)
+    {
+        groupCRCs[CACHE_L2] = 0;
+        _CacheState(static_cast<CacheableL2 *>(&state), groupCRCs[CACHE_L2]);
+    }
+}
+
+// Each level key folds in the keys of the levels below it.
+void CacheState(_simd_crcint seed, _simd_crcint const (&groupCRCs)[NUM_CACHE_LEVELS], _simd_crcint &L0, _simd_crcint &L1, _simd_crcint &L2)
 {
-    L0 = seed;
-    _CacheState(static_cast<CacheableL0 *>(&state), L0);
-    L1 = L0;
-    _CacheState(static_cast<CacheableL1 *>(&state), L1);
-    L2 = L1;
-    _CacheState(static_cast<CacheableL2 *>(&state), L2);
+    L0 = _simd_crc32(seed, groupCRCs[CACHE_L0]);
+    L1 = _simd_crc32(L0, groupCRCs[CACHE_L1]);
+    L2 = _simd_crc32(L1, groupCRCs[CACHE_L2]);
 }
 
 void Initialize(State &state)
 {
     state.mNoExecute = false;
     state.mLastError = GL_NONE;
+    state.mDirty = DIRTY_ALL;
 
     GetDDProcTable().pfnVBLayoutInfo(GetDDHandle(), state.mVBLayoutInfo.permuteWidth);
     switch (state.mVBLayoutInfo.permuteWidth)
@@ -230,6 +722,7 @@ void Initialize(State &state)
     state.mCaps.texGenR = 0;
     state.mCaps.texGenQ = 0;
     state.mCaps.textures = 0;
+    state.mCaps.texturesCube = 0;
     state.mCaps.vertexArray = 0;
     state.mCaps.attribArrayMask = 0;
 
@@ -238,7 +731,21 @@ void Initialize(State &state)
     state.mExecutingDL = std::stack<GLuint>();
 
     state.mRedundancyMap.Initialize(32); // XXX: should request from SWR its cache depth.
+    state.mCurrentAttrCache.mChanged.mask = 0xFFFFFFFF;
+    state.mCurrentAttrCache.mAttributes.mask = 0;
+    state.mCurrentAttrCache.mAttrFormats.mask = 0;
+    state.mCurrentAttrCache.mNumAttributes = 0;
     state.mpDrawingVB = &state._mVertexBuffer;
+    state.mStreamRing.Initialize(STREAM_RING_SIZE);
+    state.mhVertexCache = NULL;
+    state.mRenderMode = GL_RENDER;
+    state.mNameStack.clear();
+    state.mSelectNames.clear();
+    state.mpSelectBuffer = NULL;
+    state.mSelectBufferSize = 0;
+    state.mpFeedbackBuffer = NULL;
+    state.mFeedbackBufferSize = 0;
+    state.mFeedbackType = GL_2D;
     // XXX: we're adding two SIMD lanes of padding, to simplify our lives in SWR =)
     for (int i = 0; i < NUM_ATTRIBUTES; ++i)
     {
@@ -445,10 +952,33 @@ void Initialize(State &state)
         state.mTexUnit[i].mTexEnv.mColor[1] = 0.0;
         state.mTexUnit[i].mTexEnv.mColor[2] = 0.0;
         state.mTexUnit[i].mTexEnv.mColor[3] = 0.0;
+        for (GLuint c = 0; c < 2; ++c)
+        {
+            state.mTexUnit[i].mTexEnv.mCombine[c] = GL_MODULATE;
+            state.mTexUnit[i].mTexEnv.mSource[c][0] = GL_TEXTURE;
+            state.mTexUnit[i].mTexEnv.mSource[c][1] = GL_PREVIOUS;
+            state.mTexUnit[i].mTexEnv.mSource[c][2] = GL_CONSTANT;
+            state.mTexUnit[i].mTexEnv.mScale[c] = 1.0;
+        }
+        state.mTexUnit[i].mTexEnv.mOperand[0][0] = GL_SRC_COLOR;
+        state.mTexUnit[i].mTexEnv.mOperand[0][1] = GL_SRC_COLOR;
+        state.mTexUnit[i].mTexEnv.mOperand[0][2] = GL_SRC_ALPHA;
+        state.mTexUnit[i].mTexEnv.mOperand[1][0] = GL_SRC_ALPHA;
+        state.mTexUnit[i].mTexEnv.mOperand[1][1] = GL_SRC_ALPHA;
+        state.mTexUnit[i].mTexEnv.mOperand[1][2] = GL_SRC_ALPHA;
         state.mTexUnit[i].mNamedTexture1d = 0;
         state.mTexUnit[i].mNamedTexture2d = 0;
         state.mTexUnit[i].mNamedTexture3d = 0;
         state.mTexUnit[i].mNamedTextureCube = 0;
+        for (GLuint c = 0; c < 4; ++c)
+        {
+            state.mTexGenMode[i][c] = GL_EYE_LINEAR;
+            for (GLuint j = 0; j < 4; ++j)
+            {
+                state.mTexGenObjectPlane[i][c][j] = (c == j) && (c < 2) ? 1.0f : 0.0f;
+                state.mTexGenEyePlane[i][c][j] = state.mTexGenObjectPlane[i][c][j];
+            }
+        }
     }
 
     state.mArraysLocked = 0;
@@ -474,10 +1004,29 @@ void Initialize(State &state)
 #else
     state.mpLog = 0;
 #endif
+
+    state.mpMarshal = NULL;
+    if (getenv("SWR_GL_THREAD") && atoi(getenv("SWR_GL_THREAD")))
+    {
+        state.mpMarshal = new Marshal();
+        state.mpMarshal->Initialize(state);
+    }
 }
 
 void Destroy(State &state)
 {
+    if (state.mpMarshal)
+    {
+        state.mpMarshal->Destroy();
+        delete state.mpMarshal;
+        state.mpMarshal = NULL;
+    }
+
+    if (gpOglState == &state)
+    {
+        gpOglState = NULL;
+    }
+
     // Destroy textures
     for (std::unordered_map<GLuint, TexParameters>::iterator it = state.mTexParameters.begin(); it != state.mTexParameters.end(); ++it)
     {
@@ -491,6 +1040,14 @@ void Destroy(State &state)
 
     // Destroy display lists
     DisplayLists().clear();
+
+    if (state.mhVertexCache)
+    {
+        GetDDProcTable().pfnDestroyVertexCache(GetDDHandle(), state.mhVertexCache);
+        state.mhVertexCache = NULL;
+    }
+
+    state.mStreamRing.Destroy();
 }
 
 void InitializeVertexAttrFmts(VertexAttributeFormats &vAttrFormats)
@@ -509,7 +1066,6 @@ void InitializeVertexAttrFmts(VertexAttributeFormats &vAttrFormats)
 }
 }
 
-static OGL::State *gpOglState = 0;
 std::unordered_map<GLuint, OGL::DisplayList *> PrepDLs()
 {
     std::unordered_map<GLuint, OGL::DisplayList *> dls;
@@ -563,6 +1119,11 @@ void AnalyzeVertexAttributes(State &s)
     if (glimIsEnabled(s, GL_LIGHTING))
     {
         useColor = false;
+    }
+
+    // Reflection and normal map texgen read the normal too.
+    if (!useColor || TexGenUsesNormal(s))
+    {
         GetVB(s).mAttributes.normal = 1;
         ++GetVB(s).mNumAttributes;
         ++GetVB(s).mNumSideAttributes;
@@ -591,7 +1152,7 @@ void AnalyzeVertexAttributes(State &s)
 
     for (int i = 0; i < NUM_TEXTURES; ++i)
     {
-        if (s.mCaps.textures & (0x1 << i))
+        if (EnabledTextures(s) & (0x1 << i))
         {
             GetVB(s).mAttributes.texCoord |= (0x1ULL << i);
             ++GetVB(s).mNumAttributes;
@@ -626,6 +1187,12 @@ OGL::State &GetOGL()
 
 void SetOGL(OGL::State *pOglState)
 {
+    // Commands still queued for the old context run against it.
+    if (gpOglState && (gpOglState != pOglState))
+    {
+        MarshalSync(*gpOglState);
+    }
+
     gpOglState = pOglState;
 }
 
@@ -793,6 +1360,34 @@ SWRL::v4f ConvertTexEnvArgs(GLenum pname, const GLty *params)
     return result;
 }
 
+template <typename GLty>
+SWRL::v4f ConvertTexGenArgs(GLenum pname, GLty param)
+{
+    SWRL::v4f result;
+    result[0] = (GLfloat)param;
+    return result;
+}
+
+template <typename GLty>
+SWRL::v4f ConvertTexGenArgs(GLenum pname, const GLty *params)
+{
+    SWRL::v4f result;
+
+    if ((pname == GL_OBJECT_PLANE) || (pname == GL_EYE_PLANE))
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            result[i] = (GLfloat)params[i];
+        }
+    }
+    else
+    {
+        result[0] = (GLfloat)params[0];
+    }
+
+    return result;
+}
+
 template <typename GLty>
 SWRL::v4f ConvertTexParameterArgs(GLenum pname, GLty param)
 {
@@ -833,6 +1428,74 @@ float ConvertColorValue(GLty v)
     return (float)v;
 }
 
+#include "gldp.inl"
+#include "glmt.inl"
+
+namespace OGL
+{
+
+static ArrayPointerParameters &_MarshalArray(State &s, GLuint index)
+{
+    return index ? s.mArrayPointers.mArrays[index - 1] : s.mArrayPointers.mVertex;
+}
+
+// Points the arrays of a CMD_MARSHALARRAYS at their copies in the batch.
+static GLubyte const *_MarshalSetArrays(State &s, GLubyte const *pCursor)
+{
+    Marshal &m = *s.mpMarshal;
+    GLuint mask = ((GLuint *)pCursor)[1];
+    GLuint skip = ((GLuint *)pCursor)[2];
+    pCursor += 3 * sizeof(GLuint);
+
+    GLubyte const *pEntry = pCursor;
+    DWORD index;
+    for (GLuint arrays = mask; _BitScanForward(&index, arrays); arrays &= ~(1 << index))
+    {
+        ArrayPointerParameters &app = _MarshalArray(s, index);
+        m.mpSavedPointers[index] = app.mpElements;
+        memcpy(&app.mpElements, pEntry, sizeof(const GLvoid *));
+        pEntry += sizeof(const GLvoid *);
+    }
+    m.mSavedArrays = mask;
+
+    return pCursor + skip;
+}
+
+static void _MarshalRestoreArrays(State &s)
+{
+    Marshal &m = *s.mpMarshal;
+    DWORD index;
+    for (GLuint arrays = m.mSavedArrays; _BitScanForward(&index, arrays); arrays &= ~(1 << index))
+    {
+        _MarshalArray(s, index).mpElements = m.mpSavedPointers[index];
+    }
+    m.mSavedArrays = 0;
+}
+
+void ExecuteMarshal(State &s, GLubyte const *pCursor)
+{
+    for (;;)
+    {
+        switch (((GLuint *)pCursor)[0])
+        {
+#include "executemt.inl"
+        case CMD_MARSHALDATA:
+            pCursor += 2 * sizeof(GLuint) + ((GLuint *)pCursor)[1];
+            break;
+        case CMD_MARSHALARRAYS:
+            pCursor = _MarshalSetArrays(s, pCursor);
+            break;
+        case CMD_MARSHALRESTORE:
+            _MarshalRestoreArrays(s);
+            pCursor += sizeof(COMMAND);
+            break;
+        default:
+            return;
+        }
+    }
+}
+}
+
 extern "C" {
 
 #define MAKE_OGL_CALL(NAME, ...)                             \
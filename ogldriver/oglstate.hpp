@@ -16,10 +16,14 @@
 #define OGL_STATE_HPP
 
 #include <array>
+#include <condition_variable>
 #include <cstring>
+#include <deque>
 #include <list>
 #include <map>
+#include <mutex>
 #include <stack>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 #include <cstdio>
@@ -155,10 +159,159 @@ struct VertexBuffer
     GLuint *mpIndexBuffer;
     GLint mNumIndices;
 
+    // Edges of the baked triangle list in mhIndexBuffer, built on the first
+    // draw under glPolygonMode(GL_LINE).
+    DDHANDLE mhLineIndexBuffer;
+
     DDHANDLE mhNIB8;
     GLubyte *mpNIB8;
 };
 
+// Per-context ring that client arrays and indices are streamed through for
+// draws that don't own them. Each allocation is wrapped in a UP buffer;
+// ranges are reclaimed in allocation order by destroying that buffer, which
+// waits for the draws reading it to retire, so the API thread only blocks
+// once the ring wraps onto data still in flight.
+struct StreamRing
+{
+    struct Range
+    {
+        GLuint offset;
+        GLuint size;
+        DDHANDLE hBuffer;
+        GLuint generation; // draw the range was allocated for
+    };
+
+    void Initialize(GLuint size);
+    void Destroy();
+
+    // Starts a new draw; ranges of the current draw are never reclaimed.
+    void NewDraw()
+    {
+        ++mGeneration;
+    }
+
+    // Returns NULL if size doesn't fit in the ring without reclaiming the
+    // current draw's ranges.
+    DDHANDLE Alloc(GLuint size, GLvoid *&pData);
+
+    GLubyte *mpBase; // allocated on first use
+    GLuint mSize;
+    GLuint mHead;
+    GLuint mGeneration;
+    std::deque<Range> mLive;
+
+private:
+    void Retire();
+};
+
+struct State;
+
+// Client array state as the driver thread will see it once every command
+// encoded so far has executed, kept on the application thread so draws can
+// copy the client memory they read into the batch.
+struct MarshalClientState
+{
+    struct Array
+    {
+        GLint mSize;
+        GLenum mType;
+        GLsizei mStride;
+        const GLvoid *mpPointer;
+        GLboolean mVBO; // mpPointer is an offset into a VBO
+    };
+
+    void Initialize();
+
+    // Bytes of one element of an array.
+    static GLuint ElementSize(Array const &array);
+
+    // Mask of arrays a draw reads from client memory; bit 0 is the vertex
+    // array, bit i + 1 is attribute array i.
+    GLuint ClientArrays() const;
+
+    Array &GetArray(GLuint index)
+    {
+        return index ? mArrays[index - 1] : mVertex;
+    }
+
+    void ClientActiveTexture(GLenum texture);
+    void EnableClientState(GLenum cap);
+    void DisableClientState(GLenum cap);
+    void Enable(GLenum cap);
+    void Disable(GLenum cap);
+    void VertexPointer(GLint size, GLenum type, GLsizei stride, const GLvoid *pointer);
+    void NormalPointer(GLenum type, GLsizei stride, const GLvoid *pointer);
+    void ColorPointer(GLint size, GLenum type, GLsizei stride, const GLvoid *pointer);
+    void TexCoordPointer(GLint size, GLenum type, GLsizei stride, const GLvoid *pointer);
+    void BindBuffer(GLenum target, GLuint buffer);
+    void BindBufferARB(GLenum target, GLuint buffer);
+    void LockArraysEXT(GLint first, GLsizei count);
+    void UnlockArraysEXT();
+    void NewList(GLuint list, GLenum mode);
+    void EndList();
+
+    Array mVertex;
+    Array mArrays[NUM_ATTRIBUTES];
+    GLuint mEnabled; // same bits as ClientArrays()
+    GLuint mLocked;
+    GLenum mClientActiveTexture;
+    GLuint mArrayVBO;
+    GLuint mElementVBO;
+    GLenum mListMode;
+};
+
+// Optional driver thread for a context. GL calls are encoded into batches on
+// the application thread and executed in order by the driver thread; calls
+// that return data Sync() and then run on the application thread. Client
+// memory a call reads (pixels, indices, client arrays) is copied into the
+// batch along with the command.
+struct Marshal
+{
+    struct Batch
+    {
+        GLubyte mData[MARSHAL_BATCH_SIZE];
+        GLuint mUsed;
+    };
+
+    void Initialize(State &s);
+    void Destroy();
+
+    // Returns space for a command in the batch being filled.
+    GLubyte *Request(GLuint length);
+
+    // Returns space for a command preceded by a copy of length bytes at
+    // pData, setting pCopy to the copy, or NULL if the copy doesn't fit in a
+    // batch and the caller has to Sync() and run the command itself.
+    GLubyte *RequestData(GLuint cmdLength, const GLvoid *pData, size_t length, const GLvoid *&pCopy);
+
+    // Hands the batch being filled to the driver thread without waiting.
+    void Flush();
+
+    // Waits until every command encoded so far has executed.
+    void Sync();
+
+    State *mpState;
+    MarshalClientState mClient;
+    Batch *mpBatches;
+    GLuint mSubmitted; // batches handed to the driver thread
+    GLuint mExecuted;  // batches the driver thread has finished
+    bool mQuit;
+    std::mutex mLock;
+    std::condition_variable mWork;
+    std::condition_variable mDone;
+    std::thread mThread;
+
+    // Client array pointers a CMD_MARSHALARRAYS replaced, restored by the
+    // CMD_MARSHALRESTORE after the draw. Driver thread only.
+    const GLvoid *mpSavedPointers[1 + NUM_ATTRIBUTES];
+    GLuint mSavedArrays;
+
+private:
+    void Submit();
+    static void ThreadMain(Marshal *pMarshal);
+};
+
 struct VertexBufferObject
 {
     VertexBufferObject()
@@ -283,6 +436,10 @@ struct TexParameters
         mGenMIPs = GL_FALSE;
         mWidth = 0;
         mHeight = 0;
+        mLevelMask = 0;
+        mInternalFormat = 1;
+        mFormat = GL_RGBA;
+        mType = GL_UNSIGNED_BYTE;
 
         mhTexture = 0;
     }
@@ -303,12 +460,14 @@ struct TexParameters
     GLboolean mGenMIPs;
     GLuint mWidth;
     GLuint mHeight;
+    GLuint mLevelMask; // bit per mip level with an image
+    GLint mInternalFormat;
+    GLenum mFormat; // Level 0 upload format/type, they pick the storage format.
+    GLenum mType;
 
     // Texture
     DDHTEXTURE mhTexture;
 
-    // TexGen.
-    // XXX: holy crap, no?
 };
 
 struct TexEnvParameters
@@ -316,6 +475,12 @@ struct TexEnvParameters
     // TexEnv.
     GLenum mMode;
     GLfloat mColor[4];
+
+    // GL_COMBINE state, [0] is RGB and [1] is alpha.
+    GLenum mCombine[2];
+    GLenum mSource[2][3];
+    GLenum mOperand[2][3];
+    GLfloat mScale[2];
 };
 
 struct TextureUnit
@@ -366,6 +531,7 @@ struct Caps
     GLuint texGenR : NUM_TEXTURES;
     GLuint texGenQ : NUM_TEXTURES;
     GLuint textures : NUM_TEXTURES;
+    GLuint texturesCube : NUM_TEXTURES;
     GLuint twoSided : 1;
     GLuint vertexArray : 1;
 };
@@ -400,14 +566,26 @@ struct PixelStoreParameters
     GLint mPackRowLength;
 };
 
-template <GLuint NUM_ELEMENTS>
+// Finds a vertex among the last mDepth with the same attributes.
+// Open addressing with linear probing over a table at most half full; a
+// vertex leaves the table when its ring entry is reused mDepth vertices
+// later, so lookups never scan the whole window.
+template <GLuint NUM_ATTRS>
 struct RedundancyMap
 {
-    typedef SWRL::UncheckedFixedVector<GLfloat, NUM_ELEMENTS> value_type;
     enum
     {
-        OFFSET = 2166136261U,
-        PRIME = 16777619,
+        EMPTY = 0xFFFFFFFF,
+        OFFSET = 2166136261U, // hash seed
+    };
+
+    struct Entry
+    {
+        __m128 mAttr[NUM_ATTRS];
+        GLuint mNumAttributes;
+        GLuint mHash;
+        GLuint mIndex;
+        GLuint mSlot;
     };
 
     RedundancyMap(GLuint depth = 256)
@@ -420,58 +598,140 @@ struct RedundancyMap
         mHits = 0;
         mMisses = 0;
         mDepth = depth;
-        mHash.resize(mDepth);
-        mAttr.resize(mDepth);
-        mIndex.resize(mDepth);
+
+        GLuint numSlots = 1;
+        while (numSlots < depth * 2)
+        {
+            numSlots <<= 1;
+        }
+        mSlotMask = numSlots - 1;
+        mSlots.assign(numSlots, (GLuint)EMPTY);
+
+        mEntries.resize(mDepth);
+        for (GLuint i = 0; i < mDepth; ++i)
+        {
+            mEntries[i].mIndex = EMPTY;
+            mEntries[i].mSlot = EMPTY;
+        }
+    }
+
+    static GLuint Hash(__m128 const *pAttr, GLuint numAttr, GLuint hash)
+    {
+        for (GLuint i = 0; i < numAttr; ++i)
+        {
+            __m128i bits = _mm_castps_si128(pAttr[i]);
+            hash = _mm_crc32_u32(hash, _mm_cvtsi128_si32(bits));
+            hash = _mm_crc32_u32(hash, _mm_extract_epi32(bits, 1));
+            hash = _mm_crc32_u32(hash, _mm_extract_epi32(bits, 2));
+            hash = _mm_crc32_u32(hash, _mm_extract_epi32(bits, 3));
+        }
+        return hash;
     }
 
-    GLuint GetEarliestIndex(value_type const &key, GLuint curIndex)
+    // pAttr[0] is the position; hash is Hash() of the other attributes
+    // followed by the position. Returns the most recent copy of the vertex
+    // within the window, or curIndex if there is none. The table keeps one
+    // entry per distinct vertex, moved to the newest copy on every hit.
+    GLuint GetRecentIndex(GLuint hash, __m128 const *pAttr, GLuint numAttr, GLuint curIndex)
     {
-        union
+        // The entry being replaced holds a vertex that is mDepth old.
+        GLuint ring = curIndex % mDepth;
+        Remove(mEntries[ring]);
+
+        GLuint index = curIndex;
+        GLuint slot = hash & mSlotMask;
+        for (; mSlots[slot] != EMPTY; slot = (slot + 1) & mSlotMask)
         {
-            float F;
-            GLuint H;
-        } U;
+            Entry &match = mEntries[mSlots[slot]];
+            if ((match.mHash == hash) && (match.mNumAttributes == numAttr) &&
+                (curIndex > match.mIndex) && (curIndex - match.mIndex < mDepth) &&
+                Equal(match.mAttr, pAttr, numAttr))
+            {
+                index = match.mIndex;
+                match.mSlot = EMPTY;
+                break;
+            }
+        }
 
-        GLuint hash = OFFSET;
-        for (std::size_t i = 0; i < key.size(); ++i)
+        if (index != curIndex)
+        {
+            ++mHits;
+        }
+        else
         {
-            U.F = key[i];
-            hash ^= U.H;
-            hash *= PRIME;
+            ++mMisses;
         }
 
-        // Maintain key/hash state invariant.
-        GLuint killIndex = curIndex % mDepth;
-        mHash[killIndex] = hash;
-        mAttr[killIndex] = key;
-        mIndex[killIndex] = curIndex;
+        Entry &e = mEntries[ring];
+        memcpy(&e.mAttr[0], pAttr, numAttr * sizeof(__m128));
+        e.mNumAttributes = numAttr;
+        e.mHash = hash;
+        e.mIndex = curIndex;
+        e.mSlot = slot;
+        mSlots[slot] = ring;
 
-        // Starting at the further index from ours,
-        // try to find a copy of our value.
-        for (GLuint i = 1; i <= mDepth; ++i)
+        return index;
+    }
+
+    static bool Equal(__m128 const *pA, __m128 const *pB, GLuint numAttr)
+    {
+        for (GLuint i = 0; i < numAttr; ++i)
         {
-            GLuint lookIndex = (killIndex + i) % mDepth;
-            if ((mHash[lookIndex] == hash) && (mAttr[lookIndex] == key))
+            if (_mm_movemask_ps(_mm_cmpeq_ps(pA[i], pB[i])) != 0xF)
             {
-                if (i < mDepth)
-                    ++mHits;
-                else
-                    ++mMisses;
-                return mIndex[lookIndex];
+                return false;
             }
         }
+        return true;
+    }
+
+    // Backward shift deletion, keeps probe sequences unbroken without tombstones.
+    void Remove(Entry &e)
+    {
+        if (e.mSlot == EMPTY)
+        {
+            return;
+        }
 
-        assert(false && "This is unreachable.");
-        return 0;
+        GLuint hole = e.mSlot;
+        e.mSlot = EMPTY;
+        mSlots[hole] = EMPTY;
+        for (GLuint next = (hole + 1) & mSlotMask; mSlots[next] != EMPTY; next = (next + 1) & mSlotMask)
+        {
+            Entry &n = mEntries[mSlots[next]];
+            GLuint home = n.mHash & mSlotMask;
+            if (((next - home) & mSlotMask) >= ((next - hole) & mSlotMask))
+            {
+                mSlots[hole] = mSlots[next];
+                n.mSlot = hole;
+                mSlots[next] = EMPTY;
+                hole = next;
+            }
+        }
     }
 
     GLuint mHits;
     GLuint mMisses;
     GLuint mDepth;
-    std::vector<GLuint> mHash;
-    std::vector<value_type> mAttr;
-    std::vector<GLuint> mIndex;
+    GLuint mSlotMask;
+    std::vector<GLuint> mSlots; // index into mEntries, or EMPTY
+    std::vector<Entry> mEntries; // ring of the last mDepth vertices
+};
+
+// Current vertex attributes laid out in VB order, as glimAddVertexSWR
+// stores them for glVertex. Setters flag what they change in mChanged and
+// only those attributes are reloaded on the next vertex.
+struct CurrentAttributeCache
+{
+    __m128 mAttr[NUM_ATTRIBUTES]; // [0] is scratch for the position
+    __m128 mSideNormal;
+    GLuint mWidths[NUM_ATTRIBUTES];
+    GLuint mNumAttributes;
+    GLuint mHash; // RedundancyMap::Hash of mAttr[1..mNumAttributes)
+    VertexActiveAttributes mChanged;
+    VertexActiveAttributes mAttributes;
+    VertexAttributeFormats mAttrFormats;
+    GLboolean mNormalize;
 };
 
 OSALIGNLINE(struct) CacheableL0
@@ -489,6 +749,7 @@ OSALIGNLINE(struct) CacheableL0
 
     // Vertex state.
     GLenum mShadeModel;
+    GLenum mTexGenMode[NUM_TEXTURES][4]; // S, T, R, Q
 
     // Rasterizer state.
     GLenum mTopology;
@@ -567,6 +828,10 @@ OSALIGNLINE(struct) Uncacheable
 
     GLfloat mNormalScale;
 
+    // Texgen planes, S, T, R, Q. Eye planes are stored in eye space.
+    OSALIGNSIMD(SWRL::v4f) mTexGenObjectPlane[NUM_TEXTURES][4];
+    OSALIGNSIMD(SWRL::v4f) mTexGenEyePlane[NUM_TEXTURES][4];
+
     // Matrix mode state.
     GLenum mMatrixMode;
 
@@ -612,12 +877,38 @@ struct SaveableState : CacheableL0, CacheableL1, CacheableL2, Uncacheable
 
 typedef std::pair<GLbitfield, SaveableState *> AttribState;
 
+// State groups DDGenShaders uploads to the VS constant buffer. Setters mark
+// the groups they write so that only changed groups are uploaded, and only
+// the cache keys of changed groups are rehashed. Uncacheable state that is
+// only read on the CPU (array pointers, VBO bindings, locks) is not tracked.
+enum
+{
+    DIRTY_L0 = 0x1,          // CacheableL0
+    DIRTY_L1 = 0x2,          // CacheableL1
+    DIRTY_L2 = 0x4,          // CacheableL2
+    DIRTY_MATRICES = 0x8,    // matrix stacks and the matrices derived from them
+    DIRTY_UNCACHEABLE = 0x10, // Uncacheable, marked for fog and current vertex attributes
+    NUM_DIRTY_GROUPS = 5,
+    DIRTY_ALL = (1 << NUM_DIRTY_GROUPS) - 1,
+};
+
+enum
+{
+    CACHE_L0,
+    CACHE_L1,
+    CACHE_L2,
+    NUM_CACHE_LEVELS
+};
+
 typedef void (*PFN_RESIZE)(GLuint width, GLuint height);
 
 struct State : SaveableState
 {
     bool mNoExecute;
 
+    // DIRTY_* groups changed since the last DDGenShaders.
+    GLuint mDirty;
+
     // Error.
     GLenum mLastError;
 
@@ -626,9 +917,12 @@ struct State : SaveableState
     std::stack<GLuint> mExecutingDL;
 
     // Vertex state.
-    RedundancyMap<64> mRedundancyMap;
+    RedundancyMap<NUM_ATTRIBUTES> mRedundancyMap;
+    CurrentAttributeCache mCurrentAttrCache;
     VertexBuffer _mVertexBuffer;
     VertexBuffer *mpDrawingVB;
+    StreamRing mStreamRing;
+    DDHANDLE mhVertexCache; // VS outputs of the arrays locked in the main VB
 
 // Matrix mode state.
 // matrix stacks for 1 MV, 1 Proj, and NUM_TEXTURES textures
@@ -644,6 +938,20 @@ struct State : SaveableState
     // Attribs. (Good luck with this.)
     std::stack<AttribState> mAttribStack;
 
+    // Selection and feedback. In select mode each name stack change starts a
+    // new driver hit record; mSelectNames keeps the name stack of each one.
+    GLenum mRenderMode;
+    std::vector<GLuint> mNameStack;
+    std::vector<std::vector<GLuint> > mSelectNames;
+    GLuint *mpSelectBuffer;
+    GLsizei mSelectBufferSize;
+    GLfloat *mpFeedbackBuffer;
+    GLsizei mFeedbackBufferSize;
+    GLenum mFeedbackType;
+
+    // Driver thread, NULL unless SWR_GL_THREAD is set.
+    Marshal *mpMarshal;
+
     // Logging mechanism.
     FILE *mpLog;
 
@@ -668,12 +976,70 @@ private:
 };
 
 void MaintainMatrixInfoInvariant(State &state);
-void CacheState(SaveableState &state, _simd_crcint seed, _simd_crcint &L0, _simd_crcint &L1, _simd_crcint &L2);
+void CacheStateGroups(SaveableState &state, GLuint dirty, _simd_crcint (&groupCRCs)[NUM_CACHE_LEVELS]);
+void CacheState(_simd_crcint seed, _simd_crcint const (&groupCRCs)[NUM_CACHE_LEVELS], _simd_crcint &L0, _simd_crcint &L1, _simd_crcint &L2);
 void Initialize(State &);
 void Destroy(State &);
 void AnalyzeVertexAttributes(State &s);
 
 // State interface.
+INLINE void MarkDirty(State &s, GLuint groups)
+{
+    s.mDirty |= groups;
+}
+
+// Units with 2D or cube map texturing enabled. Cube maps take precedence.
+INLINE GLuint EnabledTextures(SaveableState const &s)
+{
+    return s.mCaps.textures | s.mCaps.texturesCube;
+}
+
+INLINE bool IsCubeMapFace(GLenum target)
+{
+    return (target >= GL_TEXTURE_CUBE_MAP_POSITIVE_X) && (target <= GL_TEXTURE_CUBE_MAP_NEGATIVE_Z);
+}
+
+INLINE bool IsDepthTextureFormat(GLint internalFormat)
+{
+    return (internalFormat == GL_DEPTH_COMPONENT) || (internalFormat == GL_DEPTH_COMPONENT16) ||
+           (internalFormat == GL_DEPTH_COMPONENT24) || (internalFormat == GL_DEPTH_COMPONENT32);
+}
+
+// Name of the texture bound to target on the active unit; cube map faces
+// (and their proxy) name the cube map.
+INLINE GLuint BoundTextureName(State &s, GLenum target)
+{
+    TextureUnit &texUnit = s.mTexUnit[s.mActiveTexture - GL_TEXTURE0];
+    if (IsCubeMapFace(target) || (target == GL_TEXTURE_CUBE_MAP) || (target == GL_PROXY_TEXTURE_CUBE_MAP))
+    {
+        return texUnit.mNamedTextureCube;
+    }
+    return texUnit.mNamedTexture2d;
+}
+
+// True if an enabled unit generates a coordinate from the eye space normal
+// or reflection vector.
+INLINE bool TexGenUsesNormal(SaveableState const &s)
+{
+    GLuint genCaps[3] = { s.mCaps.texGenS, s.mCaps.texGenT, s.mCaps.texGenR };
+    for (GLuint i = 0; i < NUM_TEXTURES; ++i)
+    {
+        if (!(EnabledTextures(s) & (0x1 << i)))
+        {
+            continue;
+        }
+        for (GLuint c = 0; c < 3; ++c)
+        {
+            GLenum mode = s.mTexGenMode[i][c];
+            if ((genCaps[c] & (0x1 << i)) && ((mode == GL_REFLECTION_MAP) || (mode == GL_NORMAL_MAP) || (mode == GL_SPHERE_MAP)))
+            {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
 INLINE bool IsCompilingDL(State &s)
 {
     return s.mDisplayListMode == GL_COMPILE;
@@ -684,6 +1050,16 @@ INLINE bool IsExecutingDL(State &s)
     return s.mDisplayListMode == GL_COMPILE_AND_EXECUTE;
 }
 
+// Callers outside the generated entry points must drain the driver thread
+// before touching the state or the DD.
+INLINE void MarshalSync(State &s)
+{
+    if (s.mpMarshal)
+    {
+        s.mpMarshal->Sync();
+    }
+}
+
 INLINE SWRL::FixedStack<SWRL::m44f, MAX_MATRIX_STACK_DEPTH> &CurrentMatrixStack(State &s)
 {
     if (s.mMatrixMode == GL_TEXTURE)
@@ -703,6 +1079,7 @@ INLINE SWRL::m44f &CurrentMatrix(State &s)
 INLINE void UpdateCurrentMatrix(State &s, SWRL::m44f const &mtx)
 {
     CurrentMatrix(s) = mtx;
+    MarkDirty(s, DIRTY_MATRICES);
 }
 
 INLINE void PushMatrix(State &s, SWRL::m44f const &m)
@@ -713,6 +1090,7 @@ INLINE void PushMatrix(State &s, SWRL::m44f const &m)
 INLINE void PopMatrix(State &s)
 {
     CurrentMatrixStack(s).pop();
+    MarkDirty(s, DIRTY_MATRICES);
 }
 
 INLINE VertexBuffer &GetVB(State &s)
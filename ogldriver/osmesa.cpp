@@ -108,6 +108,10 @@ GLAPI GLboolean GLAPIENTRY
     ctx->mWidth = width;
     ctx->mHeight = height;
 
+    // Render targets may still be in use by the previous context's commands.
+    if (gCurrentCtx)
+        OGL::MarshalSync(*gCurrentCtx->pState);
+
     DDProcTable &procTable = OGL::GetDDProcTable();
 
     if (ctx->mRenderBuffer)
@@ -204,6 +208,7 @@ GLAPI void GLAPIENTRY
     if (!gCurrentCtx)
         return;
 
+    OGL::MarshalSync(*gCurrentCtx->pState);
     OGL::GetDDProcTable().pfnPresent2(OGL::GetDDHandle(),
                                       gCurrentCtx->pBuffer,
                                       gCurrentCtx->mWidth * 4);
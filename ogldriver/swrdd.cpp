@@ -26,9 +26,11 @@
 
 #include "swrffgen.h"
 
+#include <deque>
 #include <map>
 #include <unordered_map>
 #include <queue>
+#include <vector>
 
 #define MAX_SHADER_QUEUE_SIZE 256
 
@@ -53,6 +55,26 @@ struct PipeInfo
 
 typedef std::unordered_map<_simd_crcint, PipeInfo> PipeMap;
 
+struct VSConstAlias
+{
+    UINT versions[OGL::NUM_DIRTY_GROUPS];
+};
+
+// Everything the cached VS outputs of the locked arrays depend on. Compared
+// bytewise by the core, so it is zeroed before being filled in.
+struct DDVertexCacheKey
+{
+    UINT32 numIEDs;
+    INPUT_ELEMENT_DESC IEDs[KNOB_NUM_STREAMS];
+    UINT32 strides[KNOB_NUM_STREAMS];
+    BYTE constants[KNOB_NUM_STREAMS * 16];
+    DDHBUFFER hBufs[KNOB_NUM_STREAMS];
+    PFN_VERTEX_FUNC pfnVS;
+    UINT vsConstVersions[OGL::NUM_DIRTY_GROUPS];
+};
+
+struct DDTextureInfo;
+
 struct DDPrivateData
 {
     HANDLE mhContext;
@@ -62,6 +84,7 @@ struct DDPrivateData
     UINT32 mNumIEDs;
     INPUT_ELEMENT_DESC mIEDs[KNOB_NUM_ATTRIBUTES];
     UINT32 mVBStrides[KNOB_NUM_STREAMS];
+    DDVertexCacheKey mVertexCacheKey;
 
     HANDLE mhNIB8;
     HANDLE mhFSConst;
@@ -74,15 +97,200 @@ struct DDPrivateData
 
     UINT mNumNumaNodes;
     UINT mCurrentNumaNode;
+
+    // Versioned VS constant ring: each DIRTY_* group gets a new version when it
+    // changes, and each alias of mhVSConst remembers the versions it holds so
+    // a discard lock only has to copy the groups that alias is missing.
+    OGL::State *mpVSConstState;
+    UINT mVSConstVersions[OGL::NUM_DIRTY_GROUPS];
+    std::unordered_map<void *, VSConstAlias> mVSConstAliases;
+    _simd_crcint mStateCRCs[OGL::NUM_CACHE_LEVELS];
+
+    // Post-transform cache of the locked arrays, armed for the next draw only.
+    HANDLE mhVertexCache;
+
+    // Select hit records, one per name stack change, and the feedback buffer.
+    // The core writes them from the FE so their addresses must stay fixed.
+    std::deque<SWR_SELECT_HIT> mSelectHits;
+    SWR_FEEDBACK_BUFFER mFeedback;
+
+    // Destroyed textures that queued draws may still sample, freed once the
+    // draws retire so destroy and re-specify don't stall.
+    std::vector<DDTextureInfo *> mRetiredTextures;
+};
+
+// Samplers may still be referenced by queued draws, so rather than
+// recreating one on every filter change keep one per combination.
+enum
+{
+    DD_NUM_SAMPLERS = 2 * 2 * 3 * 4 * 4, // min x mag x mip filter x u x v address mode
 };
 
 struct DDTextureInfo
 {
     HANDLE mhTexture;
     HANDLE mhTextureView;
-    HANDLE mhSampler;
+    HANDLE mhSamplers[DD_NUM_SAMPLERS];
+    SWR_FORMAT mFormat;
+
+    // Border color of the cached clamp-to-border samplers. Samplers replaced
+    // on a color change are kept until the texture is destroyed.
+    GLfloat mBorderColor[4];
+    std::vector<HANDLE> mRetiredSamplers;
+
+    // Depth compare state of all the cached samplers.
+    bool mCompareEnable;
+    SWR_ZFUNCTION mCompareFunc;
+    SWR_DEPTH_MODE mDepthMode;
 };
 
+SWR_ADDRESSING_MODE DDAddressMode(GLenum wrap)
+{
+    switch (wrap)
+    {
+    case GL_REPEAT:
+        return SWR_AM_WRAP;
+    case GL_MIRRORED_REPEAT:
+        return SWR_AM_MIRROR;
+    case GL_CLAMP_TO_BORDER:
+        return SWR_AM_DEFAULT;
+    case GL_CLAMP:
+    // XXX: GL_CLAMP should blend in the border color at the edge; treat it as
+    // clamp to edge, which is what most apps mean by it.
+    case GL_CLAMP_TO_EDGE:
+    default:
+        return SWR_AM_CLAMP;
+    }
+}
+
+SWR_ZFUNCTION GLDepthFuncToSWR(GLenum depthFunc);
+
+SWR_DEPTH_MODE DDDepthMode(GLenum depthMode)
+{
+    switch (depthMode)
+    {
+    case GL_INTENSITY:
+        return SWR_DEPTH_INTENSITY;
+    case GL_ALPHA:
+        return SWR_DEPTH_ALPHA;
+    case GL_LUMINANCE:
+    default:
+        return SWR_DEPTH_LUMINANCE;
+    }
+}
+
+// Returns the sampler for the texture's current filter and wrap state. A
+// texture object is only ever bound to one target, so arraySpec is fixed
+// per texture and needs no slot in the sampler cache.
+HANDLE DDGetSampler(DDPrivateData &ddPD, DDTextureInfo &texInfo, const OGL::TexParameters &texParams, SWR_ARRAY_SPEC arraySpec)
+{
+    // Samplers are only used with their texture, so the retired ones are
+    // free once no queued draw uses the texture.
+    if (!texInfo.mRetiredSamplers.empty() && !SwrTextureInUse(ddPD.mhContext, texInfo.mhTexture))
+    {
+        for (UINT i = 0; i < texInfo.mRetiredSamplers.size(); ++i)
+        {
+            SwrDestroySampler(ddPD.mhContext, texInfo.mRetiredSamplers[i]);
+        }
+        texInfo.mRetiredSamplers.clear();
+    }
+
+    SWR_CREATESAMPLER SmpArgs = { SWR_AM_CLAMP, arraySpec, TF_Linear, { 0, 0, 0, 0 } };
+
+    switch (texParams.mMinFilter)
+    {
+    case GL_NEAREST:
+        SmpArgs.minFilter = SWR_FILTER_POINT;
+        SmpArgs.mipFilter = SWR_MIPFILTER_NONE;
+        break;
+    case GL_LINEAR:
+        SmpArgs.minFilter = SWR_FILTER_LINEAR;
+        SmpArgs.mipFilter = SWR_MIPFILTER_NONE;
+        break;
+    case GL_NEAREST_MIPMAP_NEAREST:
+        SmpArgs.minFilter = SWR_FILTER_POINT;
+        SmpArgs.mipFilter = SWR_MIPFILTER_POINT;
+        break;
+    case GL_LINEAR_MIPMAP_NEAREST:
+        SmpArgs.minFilter = SWR_FILTER_LINEAR;
+        SmpArgs.mipFilter = SWR_MIPFILTER_POINT;
+        break;
+    case GL_NEAREST_MIPMAP_LINEAR:
+        SmpArgs.minFilter = SWR_FILTER_POINT;
+        SmpArgs.mipFilter = SWR_MIPFILTER_LINEAR;
+        break;
+    case GL_LINEAR_MIPMAP_LINEAR:
+    default:
+        SmpArgs.minFilter = SWR_FILTER_LINEAR;
+        SmpArgs.mipFilter = SWR_MIPFILTER_LINEAR;
+        break;
+    }
+    SmpArgs.magFilter = (texParams.mMagFilter == GL_NEAREST) ? SWR_FILTER_POINT : SWR_FILTER_LINEAR;
+
+    // XXX: GL disables texturing when a mipmapped texture is missing levels.
+    // Sampling level 0 instead keeps apps that never upload mips working.
+    GLuint numLevels = 1;
+    for (GLuint dim = std::max(texParams.mWidth, texParams.mHeight); dim > 1; dim >>= 1)
+    {
+        numLevels++;
+    }
+    GLuint fullMask = (numLevels >= 32) ? ~0U : ((1U << numLevels) - 1);
+    if ((texParams.mLevelMask & fullMask) != fullMask)
+    {
+        SmpArgs.mipFilter = SWR_MIPFILTER_NONE;
+    }
+
+    SmpArgs.addressU = DDAddressMode(texParams.mBorderMode[0]);
+    SmpArgs.addressV = DDAddressMode(texParams.mBorderMode[1]);
+    memcpy(&SmpArgs.defaultColor[0], &texParams.mBorderColor[0], sizeof(GLfloat) * 4);
+
+    if (memcmp(&texInfo.mBorderColor[0], &texParams.mBorderColor[0], sizeof(GLfloat) * 4) != 0)
+    {
+        for (UINT i = 0; i < DD_NUM_SAMPLERS; ++i)
+        {
+            UINT addressU = (i / 4) % 4;
+            UINT addressV = i % 4;
+            if (texInfo.mhSamplers[i] && ((addressU == SWR_AM_DEFAULT) || (addressV == SWR_AM_DEFAULT)))
+            {
+                texInfo.mRetiredSamplers.push_back(texInfo.mhSamplers[i]);
+                texInfo.mhSamplers[i] = NULL;
+            }
+        }
+        memcpy(&texInfo.mBorderColor[0], &texParams.mBorderColor[0], sizeof(GLfloat) * 4);
+    }
+
+    SmpArgs.compareEnable = (texParams.mCompareMode == GL_COMPARE_R_TO_TEXTURE);
+    SmpArgs.compareFunc = GLDepthFuncToSWR(texParams.mCompareFunc);
+    SmpArgs.depthMode = DDDepthMode(texParams.mDepthMode);
+
+    if ((texInfo.mCompareEnable != SmpArgs.compareEnable) || (texInfo.mCompareFunc != SmpArgs.compareFunc) ||
+        (texInfo.mDepthMode != SmpArgs.depthMode))
+    {
+        for (UINT i = 0; i < DD_NUM_SAMPLERS; ++i)
+        {
+            if (texInfo.mhSamplers[i])
+            {
+                texInfo.mRetiredSamplers.push_back(texInfo.mhSamplers[i]);
+                texInfo.mhSamplers[i] = NULL;
+            }
+        }
+        texInfo.mCompareEnable = SmpArgs.compareEnable;
+        texInfo.mCompareFunc = SmpArgs.compareFunc;
+        texInfo.mDepthMode = SmpArgs.depthMode;
+    }
+
+    UINT idx = (SmpArgs.mipFilter * 2 + SmpArgs.minFilter) * 2 + SmpArgs.magFilter;
+    idx = (idx * 4 + SmpArgs.addressU) * 4 + SmpArgs.addressV;
+    if (!texInfo.mhSamplers[idx])
+    {
+        texInfo.mhSamplers[idx] = SwrCreateSampler(ddPD.mhContext, SmpArgs);
+    }
+    return texInfo.mhSamplers[idx];
+}
+
+void DDFreeTexture(DDPrivateData &ddPD, DDTextureInfo *pTxI);
+void DDReapTextures(DDPrivateData &ddPD);
+
 DDHANDLE DDCreateContext()
 {
     DDPrivateData *ddPD = new DDPrivateData();
@@ -109,6 +317,11 @@ void DDDestroyContext(DDHANDLE hddPD)
 {
     DDPrivateData *ddPD = reinterpret_cast<DDPrivateData *>(hddPD);
 
+    for (UINT i = 0; i < ddPD->mRetiredTextures.size(); ++i)
+    {
+        DDFreeTexture(*ddPD, ddPD->mRetiredTextures[i]);
+    }
+
     SwrDestroyBuffer(ddPD->mhContext, ddPD->mhFSConst);
     SwrDestroyBuffer(ddPD->mhContext, ddPD->mhVSConst);
     SwrDestroyBuffer(ddPD->mhContext, ddPD->mhPSConst);
@@ -137,6 +350,9 @@ void DDPresent(DDHANDLE hddPD)
     DDPrivateData &ddPD = *reinterpret_cast<DDPrivateData *>(hddPD);
 
     SwrPresent(ddPD.mhContext);
+
+    // Frame boundary, free the textures the retired draws were holding.
+    DDReapTextures(ddPD);
 }
 
 void DDPresent2(DDHANDLE hddPD, void *pData, UINT pitch)
@@ -144,6 +360,8 @@ void DDPresent2(DDHANDLE hddPD, void *pData, UINT pitch)
     DDPrivateData &ddPD = *reinterpret_cast<DDPrivateData *>(hddPD);
 
     SwrPresent2(ddPD.mhContext, pData, pitch);
+
+    DDReapTextures(ddPD);
 }
 
 void DDSwapBuffer(DDHANDLE hddPD)
@@ -157,6 +375,15 @@ void DDSwapBuffer(DDHANDLE hddPD)
 #endif
 }
 
+void DDFinish(DDHANDLE hddPD)
+{
+    DDPrivateData &ddPD = *reinterpret_cast<DDPrivateData *>(hddPD);
+
+    SwrWaitForIdle(ddPD.mhContext);
+
+    DDReapTextures(ddPD);
+}
+
 void DDSetViewport(DDHANDLE hddPD, INT32 x, INT32 y, UINT32 width, UINT32 height, float minZ, float maxZ, bool scissorEnable)
 {
     DDPrivateData &ddPD = *reinterpret_cast<DDPrivateData *>(hddPD);
@@ -285,6 +512,13 @@ void *DDLockBufferDiscard(DDHANDLE hddPD, DDHBUFFER ddhB)
     return SwrLockResource(ddPD.mhContext, ddhB, LOCK_DISCARD);
 }
 
+void *DDLockBufferRename(DDHANDLE hddPD, DDHBUFFER ddhB)
+{
+    DDPrivateData &ddPD = *reinterpret_cast<DDPrivateData *>(hddPD);
+
+    return SwrLockResource(ddPD.mhContext, ddhB, LOCK_RENAME);
+}
+
 void DDUnlockBuffer(DDHANDLE hddPD, DDHBUFFER ddhB)
 {
     DDPrivateData &ddPD = *reinterpret_cast<DDPrivateData *>(hddPD);
@@ -519,6 +753,7 @@ void DDSetupSparseVertices(DDHANDLE hddPD, const OGL::State &s, OGL::VertexActiv
 
     // Dump the current vertex attributes to the constant buffer if needed
     BYTE *pFSConst = (BYTE *)DDLockBufferDiscard(hddPD, ddPD.mhFSConst);
+    BYTE *pFSConstBase = pFSConst;
 
     if (vAttrs.normal)
     {
@@ -653,6 +888,15 @@ void DDSetupSparseVertices(DDHANDLE hddPD, const OGL::State &s, OGL::VertexActiv
     // Convert iedx from an index to a size.
     ++iedx;
 
+    // Everything the fetch reads, for keying the post-transform cache.
+    DDVertexCacheKey &key = ddPD.mVertexCacheKey;
+    memset(&key, 0, sizeof(key));
+    key.numIEDs = iedx;
+    memcpy(key.IEDs, IEDs, iedx * sizeof(INPUT_ELEMENT_DESC));
+    memcpy(key.strides, strides, iedx * sizeof(UINT32));
+    memcpy(key.constants, pFSConstBase, pFSConst - pFSConstBase);
+    memcpy(key.hBufs, phBufs, numBufs * sizeof(DDHBUFFER));
+
     DDUnlockBuffer(hddPD, ddPD.mhFSConst);
     SwrSetFsConstantBuffer(ddPD.mhContext, ddPD.mhFSConst);
 
@@ -732,7 +976,7 @@ PFN_PIXEL_FUNC ChoosePixelShader(const OGL::State &s, UINT numTextures)
 
 // Choose pixel shader table based on combination of lighting and texturing
 #if KNOB_USE_UBER_FRAG_SHADER
-    if ((numTextures == 1) && s.mTexUnit[0].mTexEnv.mMode == GL_MODULATE &&
+    if ((OGL::EnabledTextures(s) == 1) && !s.mCaps.texturesCube && s.mTexUnit[0].mTexEnv.mMode == GL_MODULATE &&
         !s.mCaps.alphatest &&
         s.mBlendFuncSFactor == GL_SRC_ALPHA &&
         s.mBlendFuncDFactor == GL_ONE_MINUS_SRC_ALPHA &&
@@ -747,7 +991,7 @@ PFN_PIXEL_FUNC ChoosePixelShader(const OGL::State &s, UINT numTextures)
     (void)psTable;
     return GLFragFFTable[numTextures][depthFunc][depthMask];
 #else
-    if (s.mCaps.textures)
+    if (OGL::EnabledTextures(s))
     {
         if (s.mCaps.blend)
         {
@@ -774,20 +1018,81 @@ PFN_PIXEL_FUNC ChoosePixelShader(const OGL::State &s, UINT numTextures)
 #endif
 }
 
+// Byte range of SaveableState holding a DIRTY_* group, group is the bit index.
+static void GetVSConstRange(OGL::State &s, UINT group, size_t &offset, size_t &size)
+{
+    BYTE *pBase = (BYTE *)static_cast<OGL::SaveableState *>(&s);
+    BYTE *pBegin = NULL, *pEnd = NULL;
+    switch (1 << group)
+    {
+    case OGL::DIRTY_L0:
+        pBegin = (BYTE *)static_cast<OGL::CacheableL0 *>(&s);
+        pEnd = pBegin + sizeof(OGL::CacheableL0);
+        break;
+    case OGL::DIRTY_L1:
+        pBegin = (BYTE *)static_cast<OGL::CacheableL1 *>(&s);
+        pEnd = pBegin + sizeof(OGL::CacheableL1);
+        break;
+    case OGL::DIRTY_L2:
+        pBegin = (BYTE *)static_cast<OGL::CacheableL2 *>(&s);
+        pEnd = pBegin + sizeof(OGL::CacheableL2);
+        break;
+    case OGL::DIRTY_MATRICES:
+        pBegin = (BYTE *)&s.mModelViewProjection;
+        pEnd = (BYTE *)(&s.mNormalScale + 1);
+        break;
+    case OGL::DIRTY_UNCACHEABLE:
+        pBegin = (BYTE *)static_cast<OGL::Uncacheable *>(&s);
+        pEnd = pBegin + sizeof(OGL::Uncacheable);
+        break;
+    default:
+        assert(0);
+    }
+    offset = pBegin - pBase;
+    size = pEnd - pBegin;
+}
+
+SWR_TYPE GLTypeToSWRType(GLenum type)
+{
+    switch (type)
+    {
+    case GL_UNSIGNED_INT:
+        return SWR_TYPE_UINT32;
+    case GL_UNSIGNED_SHORT:
+        return SWR_TYPE_UINT16;
+    case GL_UNSIGNED_BYTE:
+        return SWR_TYPE_UINT8;
+    default:
+        assert(0 && "Unsupported type");
+    }
+
+    return SWR_TYPE_UINT32;
+}
+
 void DDGenShaders(DDHANDLE hddPD, OGL::State &s, bool isIndexed, GLenum idxType)
 {
     DDPrivateData &ddPD = *reinterpret_cast<DDPrivateData *>(hddPD);
 
+    // a different GL state object invalidates everything uploaded so far
+    GLuint dirty = s.mDirty;
+    if (ddPD.mpVSConstState != &s)
+    {
+        ddPD.mpVSConstState = &s;
+        dirty = OGL::DIRTY_ALL;
+    }
+    s.mDirty = 0;
+
     // pack active textures
     UINT curSlot = 0;
     for (UINT i = 0; i < KNOB_NUMBER_OF_TEXTURE_VIEWS; ++i)
     {
-        if (s.mCaps.textures & (1 << i))
+        if (OGL::EnabledTextures(s) & (1 << i))
         {
             OGL::TextureUnit &texUnit = s.mTexUnit[i];
+            bool isCube = (s.mCaps.texturesCube & (1 << i)) != 0;
 
             // set up texture state
-            OGL::TexParameters &texParams = s.mTexParameters[texUnit.mNamedTexture2d];
+            OGL::TexParameters &texParams = s.mTexParameters[isCube ? texUnit.mNamedTextureCube : texUnit.mNamedTexture2d];
             DDTextureInfo *texInfo = (DDTextureInfo *)texParams.mhTexture;
             SWR_TEXTUREVIEWINFO viewInfo;
             viewInfo.textureView = texInfo->mhTextureView;
@@ -796,12 +1101,16 @@ void DDGenShaders(DDHANDLE hddPD, OGL::State &s, bool isIndexed, GLenum idxType)
             SwrSetTextureView(ddPD.mhContext, viewInfo);
 
             SWR_SAMPLERINFO smpInfo = { 0 };
-            smpInfo.sampler = texInfo->mhSampler;
+            smpInfo.sampler = DDGetSampler(ddPD, *texInfo, texParams, isCube ? AS_TexCube : AS_2D);
             smpInfo.slot = curSlot;
             smpInfo.type = SHADER_PIXEL;
             SwrSetSampler(ddPD.mhContext, smpInfo);
 
-            s.mTexMatrix[i] = s.mMatrices[OGL::TEXTURE_BASE + i].top();
+            if (dirty & (OGL::DIRTY_L0 | OGL::DIRTY_MATRICES))
+            {
+                s.mTexMatrix[i] = s.mMatrices[OGL::TEXTURE_BASE + i].top();
+                dirty |= OGL::DIRTY_MATRICES;
+            }
 
             curSlot++;
         }
@@ -822,43 +1131,82 @@ void DDGenShaders(DDHANDLE hddPD, OGL::State &s, bool isIndexed, GLenum idxType)
         SwrSetSampler(ddPD.mhContext, smpInfo);
     }
 
-    // Maintain invariants.
-    s.mFrontSceneColor[0] = s.mFrontMaterial.mEmission[0] + s.mFrontMaterial.mAmbient[0] * s.mLightModel.mAmbient[0];
-    s.mFrontSceneColor[1] = s.mFrontMaterial.mEmission[1] + s.mFrontMaterial.mAmbient[1] * s.mLightModel.mAmbient[1];
-    s.mFrontSceneColor[2] = s.mFrontMaterial.mEmission[2] + s.mFrontMaterial.mAmbient[2] * s.mLightModel.mAmbient[2];
-    s.mFrontSceneColor[3] = s.mFrontMaterial.mEmission[3] + s.mFrontMaterial.mAmbient[3] * s.mLightModel.mAmbient[3];
+    // Maintain invariants, only for the groups they depend on.
+    if (dirty & OGL::DIRTY_L1)
+    {
+        s.mFrontSceneColor[0] = s.mFrontMaterial.mEmission[0] + s.mFrontMaterial.mAmbient[0] * s.mLightModel.mAmbient[0];
+        s.mFrontSceneColor[1] = s.mFrontMaterial.mEmission[1] + s.mFrontMaterial.mAmbient[1] * s.mLightModel.mAmbient[1];
+        s.mFrontSceneColor[2] = s.mFrontMaterial.mEmission[2] + s.mFrontMaterial.mAmbient[2] * s.mLightModel.mAmbient[2];
+        s.mFrontSceneColor[3] = s.mFrontMaterial.mEmission[3] + s.mFrontMaterial.mAmbient[3] * s.mLightModel.mAmbient[3];
+
+        s.mBackSceneColor[0] = s.mBackMaterial.mEmission[0] + s.mBackMaterial.mAmbient[0] * s.mLightModel.mAmbient[0];
+        s.mBackSceneColor[1] = s.mBackMaterial.mEmission[1] + s.mBackMaterial.mAmbient[1] * s.mLightModel.mAmbient[1];
+        s.mBackSceneColor[2] = s.mBackMaterial.mEmission[2] + s.mBackMaterial.mAmbient[2] * s.mLightModel.mAmbient[2];
+        s.mBackSceneColor[3] = s.mBackMaterial.mEmission[3] + s.mBackMaterial.mAmbient[3] * s.mLightModel.mAmbient[3];
+    }
 
-    s.mBackSceneColor[0] = s.mBackMaterial.mEmission[0] + s.mBackMaterial.mAmbient[0] * s.mLightModel.mAmbient[0];
-    s.mBackSceneColor[1] = s.mBackMaterial.mEmission[1] + s.mBackMaterial.mAmbient[1] * s.mLightModel.mAmbient[1];
-    s.mBackSceneColor[2] = s.mBackMaterial.mEmission[2] + s.mBackMaterial.mAmbient[2] * s.mLightModel.mAmbient[2];
-    s.mBackSceneColor[3] = s.mBackMaterial.mEmission[3] + s.mBackMaterial.mAmbient[3] * s.mLightModel.mAmbient[3];
+    if (dirty & OGL::DIRTY_MATRICES)
+    {
+        // matrix classes are part of L0, only dirty it if one changed class
+        OGL::MatrixClass matrixInfo[OGL::NUM_MATRIX_TYPES + 1];
+        memcpy(&matrixInfo[0], &s.mMatrixInfo[0], sizeof(s.mMatrixInfo));
+        matrixInfo[OGL::NUM_MATRIX_TYPES] = s.mMatrixInfoMVP;
 
-    MaintainMatrixInfoInvariant(s);
+        MaintainMatrixInfoInvariant(s);
 
-    s.mModelViewMatrix = s.mMatrices[OGL::MODELVIEW].top();
-    auto MV = SWRL::mget3x3(s.mModelViewMatrix);
-    auto MVinv = SWRL::minvert(MV);
-    auto Norm = SWRL::minsert3x3(MVinv);
-    auto Check = SWRL::mmult(Norm, s.mModelViewMatrix);
-    s.mNormalMatrix = s.mModelViewMatrix; //Norm;
-    s.mNormalScale = 1.0f;                // Should be: sqrt(||model-view^1_j||) for j == column 3
+        if (memcmp(&matrixInfo[0], &s.mMatrixInfo[0], sizeof(s.mMatrixInfo)) != 0 ||
+            memcmp(&matrixInfo[OGL::NUM_MATRIX_TYPES], &s.mMatrixInfoMVP, sizeof(s.mMatrixInfoMVP)) != 0)
+        {
+            dirty |= OGL::DIRTY_L0;
+        }
+
+        s.mModelViewMatrix = s.mMatrices[OGL::MODELVIEW].top();
+        s.mNormalMatrix = s.mModelViewMatrix; //Norm;
+        s.mNormalScale = 1.0f;                // Should be: sqrt(||model-view^1_j||) for j == column 3
+    }
+
+    if (dirty & (OGL::DIRTY_MATRICES | OGL::DIRTY_L2))
+    {
+        auto _44 = SWRL::minvert(s.mModelViewMatrix);
+        for (GLint i = 0; i < OGL::NUM_LIGHTS; ++i)
+        {
+            s.mLightSource[i].mOMPosition = SWRL::mvmult(_44, s.mLightSource[i].mPosition);
+            __m128 omp = _mm_loadu_ps(&s.mLightSource[i].mOMPosition[0]);
+            omp = _mm_div_ps(omp, _mm_sqrt_ps(_mm_dp_ps(omp, omp, 0xFF)));
+            _mm_storeu_ps(&s.mLightSource[i].mOMPosition[0], omp);
+        }
+        dirty |= OGL::DIRTY_L2;
+    }
 
-    auto _44 = SWRL::minvert(s.mModelViewMatrix);
-    for (GLint i = 0; i < OGL::NUM_LIGHTS; ++i)
+    // copy the changed state groups into the VS constant buffer
+    for (UINT group = 0; group < OGL::NUM_DIRTY_GROUPS; ++group)
     {
-        s.mLightSource[i].mOMPosition = SWRL::mvmult(_44, s.mLightSource[i].mPosition);
-        __m128 omp = _mm_loadu_ps(&s.mLightSource[i].mOMPosition[0]);
-        omp = _mm_div_ps(omp, _mm_sqrt_ps(_mm_dp_ps(omp, omp, 0xFF)));
-        _mm_storeu_ps(&s.mLightSource[i].mOMPosition[0], omp);
+        if (dirty & (1 << group))
+        {
+            ddPD.mVSConstVersions[group]++;
+        }
     }
 
-    // copy state into VS constant buffer
-    GLfloat *pVSConst = (GLfloat *)DDLockBufferDiscard(hddPD, ddPD.mhVSConst);
-    memcpy(pVSConst, static_cast<OGL::SaveableState *>(&s), sizeof(OGL::SaveableState));
-    OGL::SaveableState *vsS = reinterpret_cast<OGL::SaveableState *>(pVSConst);
+    if (dirty)
+    {
+        BYTE *pVSConst = (BYTE *)DDLockBufferDiscard(hddPD, ddPD.mhVSConst);
+        VSConstAlias &alias = ddPD.mVSConstAliases[pVSConst];
+        for (UINT group = 0; group < OGL::NUM_DIRTY_GROUPS; ++group)
+        {
+            if (alias.versions[group] != ddPD.mVSConstVersions[group])
+            {
+                size_t offset, size;
+                GetVSConstRange(s, group, offset, size);
+                memcpy(pVSConst + offset, (BYTE *)static_cast<OGL::SaveableState *>(&s) + offset, size);
+                alias.versions[group] = ddPD.mVSConstVersions[group];
+            }
+        }
+        DDUnlockBuffer(hddPD, ddPD.mhVSConst);
+    }
+    DDSetVsBuffer(hddPD, ddPD.mhVSConst);
 
     SWRC_WORDCODE ibType = isIndexed ? SWRC_DISCONTIGUOUS_IB : SWRC_CONTIGUOUS_IB;
-    SWR_TYPE indexType = (idxType == GL_UNSIGNED_INT) ? SWR_TYPE_UINT32 : SWR_TYPE_UINT16;
+    SWR_TYPE indexType = GLTypeToSWRType(idxType);
 
     // XXX: we need to allow multiple invocations of the compiler for L0 and L1 states.
     _simd_crcint L0, L1, L2;
@@ -873,10 +1221,8 @@ void DDGenShaders(DDHANDLE hddPD, OGL::State &s, bool isIndexed, GLenum idxType)
     }
     seed = _simd_crc32(seed, ibType);
     seed = _simd_crc32(seed, indexType);
-    OGL::CacheState(*vsS, seed, L0, L1, L2);
-
-    DDUnlockBuffer(hddPD, ddPD.mhVSConst);
-    DDSetVsBuffer(hddPD, ddPD.mhVSConst);
+    OGL::CacheStateGroups(s, dirty, ddPD.mStateCRCs);
+    OGL::CacheState(seed, ddPD.mStateCRCs, L0, L1, L2);
 
     auto vsItr = ddPD.mPipeCache.find(L1);
     if (vsItr == ddPD.mPipeCache.end())
@@ -904,6 +1250,119 @@ void DDGenShaders(DDHANDLE hddPD, OGL::State &s, bool isIndexed, GLenum idxType)
     SwrSetPixelFunc(ddPD.mhContext, vsItr->second.PS);
     SwrSetLinkageMaskFrontFace(ddPD.mhContext, vsItr->second.frontLinkageMask);
     SwrSetLinkageMaskBackFace(ddPD.mhContext, vsItr->second.backLinkageMask);
+
+    // The cached VS outputs depend on the fetched inputs, the VS and the VS
+    // constants it reads.
+    if (ddPD.mhVertexCache)
+    {
+        DDVertexCacheKey &key = ddPD.mVertexCacheKey;
+        key.pfnVS = vsItr->second.VS;
+        memcpy(key.vsConstVersions, ddPD.mVSConstVersions, sizeof(key.vsConstVersions));
+    }
+    SwrSetVertexCache(ddPD.mhContext, ddPD.mhVertexCache, &ddPD.mVertexCacheKey, sizeof(DDVertexCacheKey));
+    ddPD.mhVertexCache = NULL;
+}
+
+DDHANDLE DDCreateVertexCache(DDHANDLE hddPD, GLuint first, GLuint count)
+{
+    DDPrivateData &ddPD = *reinterpret_cast<DDPrivateData *>(hddPD);
+
+    return SwrCreateVertexCache(ddPD.mhContext, first, count);
+}
+
+void DDDestroyVertexCache(DDHANDLE hddPD, DDHANDLE hCache)
+{
+    DDPrivateData &ddPD = *reinterpret_cast<DDPrivateData *>(hddPD);
+
+    // Draws after this one mustn't inherit the cache from the draw state.
+    SwrSetVertexCache(ddPD.mhContext, NULL, NULL, 0);
+    SwrDestroyVertexCache(ddPD.mhContext, hCache);
+}
+
+void DDUseVertexCache(DDHANDLE hddPD, DDHANDLE hCache)
+{
+    DDPrivateData &ddPD = *reinterpret_cast<DDPrivateData *>(hddPD);
+
+    ddPD.mhVertexCache = hCache;
+}
+
+void DDNewSelectHit(DDHANDLE hddPD)
+{
+    DDPrivateData &ddPD = *reinterpret_cast<DDPrivateData *>(hddPD);
+
+    SWR_SELECT_HIT hit = { 0, 0xffffffff, 0 };
+    ddPD.mSelectHits.push_back(hit);
+    SwrSetRenderMode(ddPD.mhContext, SWR_RENDER_MODE_SELECT, &ddPD.mSelectHits.back(), NULL);
+}
+
+void DDSetRenderMode(DDHANDLE hddPD, GLenum mode, GLfloat *pFeedback, GLsizei size, GLenum feedbackType)
+{
+    DDPrivateData &ddPD = *reinterpret_cast<DDPrivateData *>(hddPD);
+
+    // Results of the previous mode are read back once its draws are done.
+    SwrWaitForIdle(ddPD.mhContext);
+
+    switch (mode)
+    {
+    case GL_SELECT:
+        ddPD.mSelectHits.clear();
+        DDNewSelectHit(hddPD);
+        break;
+
+    case GL_FEEDBACK:
+    {
+        SWR_FEEDBACK_BUFFER &feedback = ddPD.mFeedback;
+        feedback.pData = pFeedback;
+        feedback.size = size;
+        feedback.count = 0;
+        feedback.pointToken = (FLOAT)GL_POINT_TOKEN;
+        feedback.lineToken = (FLOAT)GL_LINE_TOKEN;
+        feedback.lineResetToken = (FLOAT)GL_LINE_RESET_TOKEN;
+        feedback.polygonToken = (FLOAT)GL_POLYGON_TOKEN;
+        feedback.numCoords = (feedbackType == GL_2D) ? 2 : (feedbackType == GL_4D_COLOR_TEXTURE) ? 4 : 3;
+        feedback.color = (feedbackType == GL_3D_COLOR || feedbackType == GL_3D_COLOR_TEXTURE || feedbackType == GL_4D_COLOR_TEXTURE);
+        feedback.texCoord = (feedbackType == GL_3D_COLOR_TEXTURE || feedbackType == GL_4D_COLOR_TEXTURE);
+        SwrSetRenderMode(ddPD.mhContext, SWR_RENDER_MODE_FEEDBACK, NULL, &feedback);
+        break;
+    }
+
+    default:
+        SwrSetRenderMode(ddPD.mhContext, SWR_RENDER_MODE_RENDER, NULL, NULL);
+        break;
+    }
+}
+
+bool DDGetSelectHit(DDHANDLE hddPD, GLuint index, GLuint &minZ, GLuint &maxZ)
+{
+    DDPrivateData &ddPD = *reinterpret_cast<DDPrivateData *>(hddPD);
+
+    const SWR_SELECT_HIT &hit = ddPD.mSelectHits[index];
+    minZ = hit.minZ;
+    maxZ = hit.maxZ;
+    return hit.hit != 0;
+}
+
+void DDPassThrough(DDHANDLE hddPD, GLfloat token)
+{
+    DDPrivateData &ddPD = *reinterpret_cast<DDPrivateData *>(hddPD);
+
+    // Feedback draws finish their FE before returning, so this lands in order.
+    SWR_FEEDBACK_BUFFER &feedback = ddPD.mFeedback;
+    GLfloat record[2] = { (GLfloat)GL_PASS_THROUGH_TOKEN, token };
+    for (UINT i = 0; i < 2; ++i, ++feedback.count)
+    {
+        if (feedback.count < feedback.size)
+        {
+            feedback.pData[feedback.count] = record[i];
+        }
+    }
+}
+
+GLsizei DDGetFeedbackCount(DDHANDLE hddPD)
+{
+    DDPrivateData &ddPD = *reinterpret_cast<DDPrivateData *>(hddPD);
+
+    return ddPD.mFeedback.count;
 }
 
 // @todo maybe these should match
@@ -936,21 +1395,6 @@ PRIMITIVE_TOPOLOGY GLTopoToSWRTopo(GLenum topology)
     return TOP_TRIANGLE_LIST;
 }
 
-SWR_TYPE GLTypeToSWRType(GLenum type)
-{
-    switch (type)
-    {
-    case GL_UNSIGNED_INT:
-        return SWR_TYPE_UINT32;
-    case GL_UNSIGNED_SHORT:
-        return SWR_TYPE_UINT16;
-    default:
-        assert(0 && "Unsupported type");
-    }
-
-    return SWR_TYPE_UINT32;
-}
-
 void DDDraw(DDHANDLE hddPD, GLenum topology, GLuint startVertex, GLuint numVertices)
 {
     DDPrivateData &ddPD = *reinterpret_cast<DDPrivateData *>(hddPD);
@@ -978,28 +1422,197 @@ void DDDrawIndexed(DDHANDLE hddPD, GLenum topology, GLenum type, GLuint numVerti
     SwrDrawIndexed(ddPD.mhContext, swrTopo, swrType, numVertices, indexOffset);
 }
 
-DDHTEXTURE DDCreateTexture(DDHANDLE hddPD, GLuint (&size)[3])
+// Picks the native storage format nearest to the requested internal format.
+// Float storage is only used for float uploads and depth textures, which keep
+// the depth buffer's R32_FLOAT so copies from it are exact.
+SWR_FORMAT TexStorageFormat(GLint internalFormat, GLenum format, GLenum type)
+{
+    switch (internalFormat)
+    {
+    case GL_DEPTH_COMPONENT:
+    case GL_DEPTH_COMPONENT16:
+    case GL_DEPTH_COMPONENT24:
+    case GL_DEPTH_COMPONENT32:
+        return R32_FLOAT;
+    default:
+        break;
+    }
+
+    if (type == GL_FLOAT)
+    {
+        return RGBA32_FLOAT;
+    }
+
+    switch (internalFormat)
+    {
+    case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+        return DXT1_UNORM;
+    case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+        return DXT1A_UNORM;
+    case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+        return DXT3_UNORM;
+    case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+        return DXT5_UNORM;
+    case GL_ALPHA:
+    case GL_ALPHA4:
+    case GL_ALPHA8:
+        return A8_UNORM;
+    case 1:
+    case GL_LUMINANCE:
+    case GL_LUMINANCE4:
+    case GL_LUMINANCE8:
+        return L8_UNORM;
+    case 2:
+    case GL_LUMINANCE_ALPHA:
+    case GL_LUMINANCE4_ALPHA4:
+    case GL_LUMINANCE8_ALPHA8:
+        return LA8_UNORM;
+    case 3:
+    case GL_RGB:
+    case GL_R3_G3_B2:
+    case GL_RGB4:
+    case GL_RGB5:
+        if (type == GL_UNSIGNED_SHORT_5_6_5)
+        {
+            return B5G6R5_UNORM;
+        }
+        break;
+    default:
+        break;
+    }
+
+    return ((format == GL_BGRA) || (format == GL_BGR)) ? BGRA8_UNORM : RGBA8_UNORM;
+}
+
+// Format of client texel data. Compressed images come in as their
+// internal format and are copied as is.
+SWR_FORMAT GLTexelFormat(GLenum format, GLenum type)
+{
+    switch (format)
+    {
+    case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+    case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+        return TexStorageFormat(format, format, type);
+    default:
+        break;
+    }
+
+    if (type == GL_FLOAT)
+    {
+        switch (format)
+        {
+        case GL_RGBA:
+            return RGBA32_FLOAT;
+        case GL_RGB:
+            return RGB32_FLOAT;
+        case GL_ALPHA:
+            return A32_FLOAT;
+        case GL_DEPTH_COMPONENT:
+            return R32_FLOAT;
+        default:
+            break;
+        }
+    }
+    else if (type == GL_UNSIGNED_SHORT_5_6_5)
+    {
+        return B5G6R5_UNORM;
+    }
+    else if (type == GL_UNSIGNED_INT_8_8_8_8_REV)
+    {
+        return (format == GL_BGRA) ? BGRA8_UNORM : RGBA8_UNORM;
+    }
+    else if (type == GL_UNSIGNED_BYTE)
+    {
+        switch (format)
+        {
+        case GL_RGBA:
+            return RGBA8_UNORM;
+        case GL_BGRA:
+            return BGRA8_UNORM;
+        case GL_RGB:
+            return RGB8_UNORM;
+        case GL_BGR:
+            return BGR8_UNORM;
+        case GL_ALPHA:
+            return A8_UNORM;
+        case GL_LUMINANCE:
+            return L8_UNORM;
+        case GL_LUMINANCE_ALPHA:
+            return LA8_UNORM;
+        default:
+            break;
+        }
+    }
+
+    assert(0 && "unsupported format");
+    return NULL_FORMAT;
+}
+
+void DDFreeTexture(DDPrivateData &ddPD, DDTextureInfo *pTxI)
+{
+    SwrDestroyTexture(ddPD.mhContext, pTxI->mhTexture);
+    SwrDestroyTextureView(ddPD.mhContext, pTxI->mhTextureView);
+    for (UINT i = 0; i < DD_NUM_SAMPLERS; ++i)
+    {
+        if (pTxI->mhSamplers[i])
+        {
+            SwrDestroySampler(ddPD.mhContext, pTxI->mhSamplers[i]);
+        }
+    }
+    for (UINT i = 0; i < pTxI->mRetiredSamplers.size(); ++i)
+    {
+        SwrDestroySampler(ddPD.mhContext, pTxI->mRetiredSamplers[i]);
+    }
+
+    delete pTxI;
+}
+
+// Frees the retired textures no queued draw uses anymore.
+void DDReapTextures(DDPrivateData &ddPD)
+{
+    UINT numRetired = 0;
+    for (UINT i = 0; i < ddPD.mRetiredTextures.size(); ++i)
+    {
+        if (SwrTextureInUse(ddPD.mhContext, ddPD.mRetiredTextures[i]->mhTexture))
+        {
+            ddPD.mRetiredTextures[numRetired++] = ddPD.mRetiredTextures[i];
+        }
+        else
+        {
+            DDFreeTexture(ddPD, ddPD.mRetiredTextures[i]);
+        }
+    }
+    ddPD.mRetiredTextures.resize(numRetired);
+}
+
+DDHTEXTURE DDCreateTexture(DDHANDLE hddPD, GLuint (&size)[3], GLint internalFormat, GLenum format, GLenum type)
 {
     DDPrivateData &ddPD = *reinterpret_cast<DDPrivateData *>(hddPD);
 
+    DDReapTextures(ddPD);
+
+    SWR_FORMAT storageFormat = TexStorageFormat(internalFormat, format, type);
+
     SWR_CREATETEXTURE ct = { 0 };
-    ct.eltSizeInBytes = 4 * sizeof(GLfloat);
+    ct.eltSizeInBytes = GetFormatInfo(storageFormat).Bpp;
     ct.width = size[0];
     ct.height = size[1];
     ct.planes = size[2];
     ct.mipLevels = 1000;
     ct.lockFlags = LOCK_NONE;
+    ct.tilingFormat = TF_TileZ;
+    ct.blockDim = FormatBlockDim(storageFormat);
 
     DDTextureInfo *pTxI = new DDTextureInfo();
 
     pTxI->mhTexture = SwrCreateTexture(ddPD.mhContext, ct);
+    pTxI->mFormat = storageFormat;
 
-    SWR_TEXTUREVIEW TxVwArgs = { pTxI->mhTexture, RGBA32_FLOAT, 0, 1000 }; // BTW: this "1000" isn't arbitrary. It is set by the OGL1 spec.
+    SWR_TEXTUREVIEW TxVwArgs = { pTxI->mhTexture, storageFormat, 0, 1000 }; // BTW: this "1000" isn't arbitrary. It is set by the OGL1 spec.
     pTxI->mhTextureView = SwrCreateTextureView(ddPD.mhContext, TxVwArgs);
 
-    SWR_CREATESAMPLER SmpArgs = { SWR_AM_CLAMP, AS_2D, TF_Linear, { 0, 0, 0, 0 } };
-    pTxI->mhSampler = SwrCreateSampler(ddPD.mhContext, SmpArgs);
-
     return pTxI;
 }
 
@@ -1035,59 +1648,39 @@ void DDUpdateSubtexture(DDHANDLE hddPD, DDHTEXTURE hTex, GLuint subtexIdx, GLenu
 {
     DDPrivateData &ddPD = *reinterpret_cast<DDPrivateData *>(hddPD);
 
-    SWR_GETSUBTEXTUREINFO GSTI = { LOCK_NONE, 0 };
-    GSTI.plane = 0;
-    GSTI.mipLevel = 0;
-    GSTI.subtextureIndex = subtexIdx;
-
-    SwrGetSubtextureInfo(reinterpret_cast<DDTextureInfo *>(hTex)->mhTexture, GSTI);
-
-    int numComps = 0;
-    switch (format)
-    {
-    case GL_RGBA:
-    case GL_BGRA:
-        numComps = 4;
-        break;
-    case GL_RGB:
-    case GL_BGR:
-        numComps = 3;
-        break;
-    case GL_ALPHA:
-        numComps = 1;
-        break;
-    default:
-        assert(0 && "unsupported format");
-    }
-
-    SWR_FORMAT swrFormat = GLToSWRFormat(numComps, format, type, true);
-
-    int Bpp = GetFormatInfo(swrFormat).Bpp;
+    DDTextureInfo *pTxI = reinterpret_cast<DDTextureInfo *>(hTex);
+    SWR_FORMAT srcFormat = GLTexelFormat(format, type);
+    UINT blockDim = FormatBlockDim(srcFormat);
+    UINT srcPitch = ((width + blockDim - 1) / blockDim) * GetFormatInfo(srcFormat).Bpp;
 
-    const BYTE *pData = (const BYTE *)pvData;
+    // Conversion and tiling into the texture layout run on the workers.
+    SwrUpdateSubtexture(ddPD.mhContext, pTxI->mhTexture, subtexIdx, srcFormat, pTxI->mFormat,
+                        pvData, srcPitch, xoffset, yoffset, width, height);
+}
 
-    // get pointer to texture data including any offsets
-    float *outData = (float *)GSTI.pData + yoffset * GSTI.physWidth * 4 + xoffset * 4;
+// Rebuilds the mip chain of a plane from its level 0 on the workers.
+void DDGenerateMips(DDHANDLE hddPD, DDHTEXTURE hTex, GLuint plane)
+{
+    DDPrivateData &ddPD = *reinterpret_cast<DDPrivateData *>(hddPD);
 
-    for (UINT y = 0; y < height; ++y, outData += GSTI.physWidth * 4)
-    {
-        float *pRow = outData;
-        for (UINT x = 0; x < width; ++x, pRow += 4, pData += Bpp)
-        {
-            ConvertPixel(swrFormat, (void *)pData, RGBA32_FLOAT, pRow);
-        }
-    }
+    DDTextureInfo *pTxI = reinterpret_cast<DDTextureInfo *>(hTex);
+    SwrGenerateMips(ddPD.mhContext, pTxI->mhTexture, plane, pTxI->mFormat);
 }
 
 void DDDestroyTexture(DDHANDLE hddPD, DDHTEXTURE hTex)
 {
     DDPrivateData &ddPD = *reinterpret_cast<DDPrivateData *>(hddPD);
 
-    SwrDestroyTexture(ddPD.mhContext, reinterpret_cast<DDTextureInfo *>(hTex)->mhTexture);
-    SwrDestroyTextureView(ddPD.mhContext, reinterpret_cast<DDTextureInfo *>(hTex)->mhTextureView);
-    SwrDestroySampler(ddPD.mhContext, reinterpret_cast<DDTextureInfo *>(hTex)->mhSampler);
+    DDReapTextures(ddPD);
+
+    DDTextureInfo *pTxI = reinterpret_cast<DDTextureInfo *>(hTex);
+    if (SwrTextureInUse(ddPD.mhContext, pTxI->mhTexture))
+    {
+        ddPD.mRetiredTextures.push_back(pTxI);
+        return;
+    }
 
-    delete reinterpret_cast<DDTextureInfo *>(hTex);
+    DDFreeTexture(ddPD, pTxI);
 }
 
 DDHANDLE DDNewDraw(DDHANDLE hddPD)
@@ -1116,7 +1709,7 @@ void DDCopyRenderTarget(DDHANDLE hddPD, const OGL::State &s, DDHTEXTURE hTex, GL
     {
         DDTextureInfo *pTxI = (DDTextureInfo *)hTex;
 
-        SwrCopyRenderTarget(ddPD.mhContext, rt, pTxI->mhTexture, NULL, RGBA32_FLOAT, 0, srcX, srcY, dstX, dstY, width, height);
+        SwrCopyRenderTarget(ddPD.mhContext, rt, pTxI->mhTexture, NULL, pTxI->mFormat, 0, srcX, srcY, dstX, dstY, width, height);
     }
     else
     {
@@ -1178,6 +1771,7 @@ bool DDInitProcTable(DDProcTable &procTable)
     procTable.pfnPresent = &DDPresent;
     procTable.pfnPresent2 = &DDPresent2;
     procTable.pfnSwapBuffer = &DDSwapBuffer;
+    procTable.pfnFinish = &DDFinish;
     procTable.pfnSetViewport = &DDSetViewport;
     procTable.pfnSetCullMode = &DDSetCullMode;
     procTable.pfnClear = &DDClear;
@@ -1192,6 +1786,7 @@ bool DDInitProcTable(DDProcTable &procTable)
     procTable.pfnLockBuffer = &DDLockBuffer;
     procTable.pfnLockBufferNoOverwrite = &DDLockBufferNoOverwrite;
     procTable.pfnLockBufferDiscard = &DDLockBufferDiscard;
+    procTable.pfnLockBufferRename = &DDLockBufferRename;
     procTable.pfnUnlockBuffer = &DDUnlockBuffer;
     procTable.pfnDestroyBuffer = &DDDestroyBuffer;
     procTable.pfnSetRenderTarget = &DDSetRenderTarget;
@@ -1201,6 +1796,7 @@ bool DDInitProcTable(DDProcTable &procTable)
     procTable.pfnUnlockTexture = &DDUnlockTexture;
     procTable.pfnGetSubtextureIndex = &DDGetSubtextureIndex;
     procTable.pfnUpdateSubtexture = &DDUpdateSubtexture;
+    procTable.pfnGenerateMips = &DDGenerateMips;
     procTable.pfnDestroyTexture = &DDDestroyTexture;
 
     procTable.pfnSetPsBuffer = &DDSetPsBuffer;
@@ -1210,6 +1806,16 @@ bool DDInitProcTable(DDProcTable &procTable)
 
     procTable.pfnGenShaders = &DDGenShaders;
 
+    procTable.pfnCreateVertexCache = &DDCreateVertexCache;
+    procTable.pfnDestroyVertexCache = &DDDestroyVertexCache;
+    procTable.pfnUseVertexCache = &DDUseVertexCache;
+
+    procTable.pfnSetRenderMode = &DDSetRenderMode;
+    procTable.pfnNewSelectHit = &DDNewSelectHit;
+    procTable.pfnGetSelectHit = &DDGetSelectHit;
+    procTable.pfnPassThrough = &DDPassThrough;
+    procTable.pfnGetFeedbackCount = &DDGetFeedbackCount;
+
     procTable.pfnDraw = &DDDraw;
     procTable.pfnDrawIndexed = &DDDrawIndexed;
 
@@ -87,6 +87,8 @@ struct FFGen
         GLFF_NORMAL_SCALE = offsetof(OGL::State, mNormalScale),
 
         GLFF_TEXTURE_MATRIX = offsetof(OGL::State, mTexMatrix),
+        GLFF_TEXGEN_OBJECT_PLANE = offsetof(OGL::State, mTexGenObjectPlane),
+        GLFF_TEXGEN_EYE_PLANE = offsetof(OGL::State, mTexGenEyePlane),
 
         GLFF_FOG_START = offsetof(OGL::State, mFog) + offsetof(OGL::FogParameters, mStart),
         GLFF_FOG_END = offsetof(OGL::State, mFog) + offsetof(OGL::FogParameters, mEnd),
@@ -376,24 +378,115 @@ struct FFGen
         swrcAddInstr(mpAsm, SWRC_MOV, mglFrontColor, prod1);
     }
 
+    // Replaces the coords of tex that have texgen enabled.
+    SWRC_WORDCODE GenTexCoords(UINT unit, SWRC_WORDCODE tex, SWRC_WORDCODE eyeNormal, SWRC_WORDCODE reflection)
+    {
+        GLuint genCaps[4] = { mState.mCaps.texGenS, mState.mCaps.texGenT, mState.mCaps.texGenR, mState.mCaps.texGenQ };
+        SWRC_WORDCODE sphere[2];
+        bool copied = false, sphereGenerated = false;
+        for (UINT c = 0; c < 4; ++c)
+        {
+            if (!(genCaps[c] & (0x1 << unit)))
+            {
+                continue;
+            }
+
+            // tex starts out as the input declaration, work on a copy.
+            if (!copied)
+            {
+                tex = swrcAddInstr(mpAsm, SWRC_MOV, tex);
+                copied = true;
+            }
+
+            SWRC_WORDCODE elt;
+            switch (mState.mTexGenMode[unit][c])
+            {
+            case GL_OBJECT_LINEAR:
+            {
+                auto plane = swrcAddConstant(mpAsm, GLFF_TEXGEN_OBJECT_PLANE + 64 * unit + 16 * c, SWRC_V4FP32);
+                elt = swrcAddInstr(mpAsm, SWRC_FDOT4, plane, mglVertex);
+            }
+            break;
+            case GL_EYE_LINEAR:
+            {
+                auto plane = swrcAddConstant(mpAsm, GLFF_TEXGEN_EYE_PLANE + 64 * unit + 16 * c, SWRC_V4FP32);
+                elt = swrcAddInstr(mpAsm, SWRC_FDOT4, plane, mEyeCoordPosition);
+            }
+            break;
+            case GL_SPHERE_MAP:
+                // s, t = r.xy / m + 1/2, m = 2 sqrt(rx^2 + ry^2 + (rz + 1)^2)
+                if (!sphereGenerated)
+                {
+                    auto m = swrcAddInstr(mpAsm, SWRC_SETELT, reflection, (SWRC_WORDCODE)2,
+                                          swrcAddInstr(mpAsm, SWRC_FADD, swrcAddInstr(mpAsm, SWRC_GETELT, reflection, (SWRC_WORDCODE)2), mImmediates[FF_ONE]));
+                    m = swrcAddInstr(mpAsm, SWRC_FDOT3, m, m);
+                    m = swrcAddInstr(mpAsm, SWRC_FMUL, swrcAddInstr(mpAsm, SWRC_FSQRT, m), mImmediates[FF_TWO]);
+                    for (UINT i = 0; i < 2; ++i)
+                    {
+                        sphere[i] = swrcAddInstr(mpAsm, SWRC_FDIV, swrcAddInstr(mpAsm, SWRC_GETELT, reflection, (SWRC_WORDCODE)i), m);
+                        sphere[i] = swrcAddInstr(mpAsm, SWRC_FADD, sphere[i], mImmediates[FF_HALF]);
+                    }
+                    sphereGenerated = true;
+                }
+                elt = sphere[c];
+                break;
+            case GL_REFLECTION_MAP:
+                elt = swrcAddInstr(mpAsm, SWRC_GETELT, reflection, (SWRC_WORDCODE)c);
+                break;
+            case GL_NORMAL_MAP:
+                elt = swrcAddInstr(mpAsm, SWRC_GETELT, eyeNormal, (SWRC_WORDCODE)c);
+                break;
+            default:
+                assert(0 && "Unknown texgen mode");
+                continue;
+            }
+
+            tex = swrcAddInstr(mpAsm, SWRC_SETELT, tex, (SWRC_WORDCODE)c, elt);
+        }
+
+        return tex;
+    }
+
     void GenTextures()
     {
         swrcAddNote(mpAsm, "Generate Textures");
+        SWRC_WORDCODE eyeNormal = mImmediates[FF_VZERO];
+        SWRC_WORDCODE reflection = mImmediates[FF_VZERO];
+        if (OGL::TexGenUsesNormal(mState))
+        {
+            // XXX: the normal matrix is the modelview, which is only right
+            // for rigid transforms.
+            eyeNormal = swrcAddInstr(mpAsm, SWRC_MKVEC,
+                                     swrcAddInstr(mpAsm, SWRC_FDOT3, mglNM[0], mNormal),
+                                     swrcAddInstr(mpAsm, SWRC_FDOT3, mglNM[1], mNormal),
+                                     swrcAddInstr(mpAsm, SWRC_FDOT3, mglNM[2], mNormal),
+                                     mImmediates[FF_ZERO]);
+
+            // r = u - 2 n (n . u), u the unit vector from the eye to the vertex.
+            auto u = swrcAddInstr(mpAsm, SWRC_SETELT, mEyeCoordPosition, (SWRC_WORDCODE)3, mImmediates[FF_ZERO]);
+            u = normalize(u, 3);
+            auto nu = swrcAddInstr(mpAsm, SWRC_FDOT3, eyeNormal, u);
+            nu = swrcAddInstr(mpAsm, SWRC_MKVEC, nu, nu, nu, nu);
+            auto nnu = swrcAddInstr(mpAsm, SWRC_FMUL, eyeNormal, nu);
+            reflection = swrcAddInstr(mpAsm, SWRC_FSUB, u, swrcAddInstr(mpAsm, SWRC_FADD, nnu, nnu));
+        }
+
         for (UINT i = 0, N = OGL::NUM_TEXTURES; i < N; ++i)
         {
-            if (mState.mCaps.textures & (0x1 << i))
+            if (OGL::EnabledTextures(mState) & (0x1 << i))
             {
                 auto tex = mglInTexCoord[i];
+                tex = GenTexCoords(i, tex, eyeNormal, reflection);
                 if (!mState.mMatrixInfo[OGL::TEXTURE_BASE + i].mIdentity)
                 {
                     auto glTexM0 = swrcAddConstant(mpAsm, GLFF_TEXTURE_MATRIX + 64 * i + 0 * 4 * 4, SWRC_V4FP32);
                     auto glTexM1 = swrcAddConstant(mpAsm, GLFF_TEXTURE_MATRIX + 64 * i + 1 * 4 * 4, SWRC_V4FP32);
                     auto glTexM2 = swrcAddConstant(mpAsm, GLFF_TEXTURE_MATRIX + 64 * i + 2 * 4 * 4, SWRC_V4FP32);
                     auto glTexM3 = swrcAddConstant(mpAsm, GLFF_TEXTURE_MATRIX + 64 * i + 3 * 4 * 4, SWRC_V4FP32);
-                    auto tex0 = swrcAddInstr(mpAsm, SWRC_FDOT4, glTexM0, mglInTexCoord[i]);
-                    auto tex1 = swrcAddInstr(mpAsm, SWRC_FDOT4, glTexM1, mglInTexCoord[i]);
-                    auto tex2 = swrcAddInstr(mpAsm, SWRC_FDOT4, glTexM2, mglInTexCoord[i]);
-                    auto tex3 = swrcAddInstr(mpAsm, SWRC_FDOT4, glTexM3, mglInTexCoord[i]);
+                    auto tex0 = swrcAddInstr(mpAsm, SWRC_FDOT4, glTexM0, tex);
+                    auto tex1 = swrcAddInstr(mpAsm, SWRC_FDOT4, glTexM1, tex);
+                    auto tex2 = swrcAddInstr(mpAsm, SWRC_FDOT4, glTexM2, tex);
+                    auto tex3 = swrcAddInstr(mpAsm, SWRC_FDOT4, glTexM3, tex);
                     tex = swrcAddInstr(mpAsm, SWRC_MKVEC, tex0, tex1, tex2, tex3);
                 }
                 swrcAddInstr(mpAsm, SWRC_MOV, mglOutTexCoord[i], tex);
@@ -672,9 +765,7 @@ struct FFGen
 
     void SetupGLVSStateInfo()
     {
-        // XXX: should be on if texturing is on, as well
-        mUseNormal = mState.mCaps.lighting != 0;
-        ;
+        mUseNormal = (mState.mCaps.lighting != 0) || OGL::TexGenUsesNormal(mState);
 
         mSeparateSpec = (GLint)(mState.mCaps.specularColor ? GL_SEPARATE_SPECULAR_COLOR : GL_SINGLE_COLOR);
         //mSeparateSpec			= mState.mCaps.twoSided;        //BMCDEBUG: ??? Why mSeparateSpec = twoSided, makes no sense!
@@ -814,7 +905,7 @@ struct FFGen
 
         for (UINT i = 0, N = OGL::NUM_TEXTURES; i < N; ++i)
         {
-            if (mState.mCaps.textures & (0x1 << i))
+            if (OGL::EnabledTextures(mState) & (0x1 << i))
             {
                 mglInTexCoord[i] = swrcAddDecl(mpAsm, VS_SLOT_TEXCOORD0 + i, SWRC_IN);
             }
@@ -840,7 +931,7 @@ struct FFGen
 
         for (UINT i = 0, N = OGL::NUM_TEXTURES; i < N; ++i)
         {
-            if (mState.mCaps.textures & (0x1 << i))
+            if (OGL::EnabledTextures(mState) & (0x1 << i))
             {
                 mglOutTexCoord[i] = swrcAddDecl(mpAsm, VS_SLOT_TEXCOORD0 + i, SWRC_OUT);
                 mFrontLinkageMask |= VS_ATTR_MASK(VS_SLOT_TEXCOORD0 + i);
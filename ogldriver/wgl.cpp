@@ -494,6 +494,7 @@ WINGDIAPI BOOL WINAPI DrvDeleteContext(HGLRC hglrc)
 
     OGL::State *pState = context.pState;
 
+    OGL::Destroy(*pState);
     pState->~State();
     _aligned_free(pState);
 
@@ -672,6 +673,7 @@ WINGDIAPI BOOL WINAPI SwapBuffers(HDC hdc)
     auto &ss = GetOGL();
 
     OGL_TRACE(SwapBuffers, GetOGL());
+    OGL::MarshalSync(ss);
 
     OGL::GetDDProcTable().pfnPresent(OGL::GetDDHandle());
 